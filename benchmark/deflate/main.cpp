@@ -0,0 +1,91 @@
+// Measures gzip throughput and compression ratio of every level, over the
+// files given as arguments or over a synthetic corpus of log and JSON text.
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+#include "deflate.hpp"
+
+using http1::ByteArray;
+using http1::DeflateEncoder;
+
+namespace {
+
+constexpr std::size_t SYNTHETIC_SIZE = 8 * 1024 * 1024;
+constexpr auto MIN_DURATION = std::chrono::milliseconds(500);
+
+ByteArray ReadFiles(int argc, char** argv) {
+  ByteArray corpus;
+  for (int index = 1; index < argc; ++index) {
+    std::ifstream file(argv[index], std::ios::binary);
+    const std::string content((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+    for (const char character : content) {
+      corpus.push_back(static_cast<std::byte>(character));
+    }
+  }
+  return corpus;
+}
+
+ByteArray MakeSyntheticCorpus() {
+  static constexpr const char* PATHS[] = {"/", "/index.html", "/api/users",
+                                          "/api/orders", "/asset/bg.jpg"};
+  static constexpr const char* METHODS[] = {"GET", "POST", "PUT"};
+  std::mt19937 random(42);
+  std::string text;
+  while (text.size() < SYNTHETIC_SIZE) {
+    const auto id = random() % 100000;
+    text += "10.0." + std::to_string(random() % 256) + "." +
+            std::to_string(random() % 256) + " - - \"" +
+            METHODS[random() % std::size(METHODS)] + " " +
+            PATHS[random() % std::size(PATHS)] + " HTTP/1.1\" 200 " +
+            std::to_string(random() % 65536) + "\n";
+    text += R"({"id":)" + std::to_string(id) + R"(,"name":"user)" +
+            std::to_string(id % 977) + R"(","active":)" +
+            (random() % 2 ? "true" : "false") + R"(,"score":)" +
+            std::to_string(random() % 1000) + "}\n";
+  }
+  ByteArray corpus;
+  for (const char character : text) {
+    corpus.push_back(static_cast<std::byte>(character));
+  }
+  return corpus;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const ByteArray corpus =
+      argc > 1 ? ReadFiles(argc, argv) : MakeSyntheticCorpus();
+  if (corpus.empty()) {
+    std::fprintf(stderr, "Usage: %s [file...]\n", argv[0]);
+    return 1;
+  }
+
+  std::printf("corpus: %zu bytes\n", corpus.size());
+  std::printf("level      MB/s     ratio\n");
+  for (int level = DeflateEncoder::MIN_LEVEL;
+       level <= DeflateEncoder::MAX_LEVEL; ++level) {
+    std::size_t compressed_size = 0;
+    std::size_t runs = 0;
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration::zero();
+    do {
+      compressed_size = http1::GzipCompress(corpus, level).size();
+      ++runs;
+      elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed < MIN_DURATION);
+
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    const double megabytes =
+        static_cast<double>(corpus.size() * runs) / (1024.0 * 1024.0);
+    std::printf("%5d %9.1f %9.3f\n", level, megabytes / seconds,
+                static_cast<double>(corpus.size()) /
+                    static_cast<double>(compressed_size));
+  }
+  return 0;
+}
@@ -0,0 +1,172 @@
+#ifndef HTTP1_ACCESS_LOG_HPP
+#define HTTP1_ACCESS_LOG_HPP
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "metrics.hpp"
+#include "spsc_ring.hpp"
+
+namespace http1 {
+
+// Unix time in nanoseconds, read from the vDSO like MonotonicNanoseconds
+inline std::int64_t UnixNanoseconds() noexcept {
+  timespec now{};
+  clock_gettime(CLOCK_REALTIME, &now);
+  return static_cast<std::int64_t>(now.tv_sec) * 1'000'000'000 +
+         static_cast<std::int64_t>(now.tv_nsec);
+}
+
+// Remote address of a connection, kept in binary form until it is rendered
+struct PeerAddress {
+  std::array<std::uint8_t, 16> address{};
+  std::uint16_t port = 0;
+  // AF_INET, AF_INET6 or AF_UNSPEC when unknown
+  std::uint8_t family = 0;
+
+  // Peer of a connected socket, with family AF_UNSPEC on failure
+  static PeerAddress Of(int socket_fd) noexcept;
+
+  // e.g. 192.0.2.1:8080 or [2001:db8::1]:8080, "-" when unknown
+  void AppendTo(std::string& output) const;
+};
+
+// One request of the access log. Fixed size and trivially copyable, so that
+// the event loop only copies it into a ring slot and formatting is left to
+// the log thread.
+struct AccessRecord {
+  // Longer paths are truncated
+  static constexpr std::size_t MAX_PATH_SIZE = 176;
+
+  // Unix time in nanoseconds when the response was handed to the socket
+  std::int64_t time = 0;
+  // Nanoseconds from the first byte of the request until then
+  std::uint64_t duration = 0;
+  // Response size including the header
+  std::uint64_t bytes = 0;
+  // Both point to static strings, e.g. of METHOD_NAMES
+  std::string_view method;
+  std::string_view version;
+  PeerAddress peer;
+  std::uint16_t status = 0;
+  std::uint8_t path_size = 0;
+  std::array<char, MAX_PATH_SIZE> path{};
+
+  void SetPath(std::string_view request_path) noexcept;
+
+  [[nodiscard]] inline std::string_view path_view() const noexcept {
+    return {path.data(), path_size};
+  }
+};
+
+enum class AccessLogFormat {
+  // 192.0.2.1:51234 [2026-10-18T09:30:00.123Z] "GET / HTTP/1.1" 200 512 87
+  // with the duration in microseconds last
+  Text,
+  // One JSON object per line with the same fields
+  Json
+};
+
+struct AccessLogOptions {
+  AccessLogFormat format = AccessLogFormat::Text;
+  // Records buffered per producer before further ones are dropped
+  std::size_t ring_capacity = 4096;
+  // Formatted records are written once this many bytes have accumulated, or
+  // when the rings run empty
+  std::size_t batch_size = 64 * 1024;
+  // How long the log thread sleeps when every ring is empty
+  std::chrono::milliseconds poll_interval{20};
+};
+
+// Appends formatted AccessRecord lines to a file descriptor from a thread
+// of its own. Every producer thread, e.g. event loop, gets a ring buffer of
+// its own, so that logging a request never takes a lock or makes a system
+// call on the producer. A full ring drops the record and counts it instead
+// of blocking the producer.
+class AccessLog {
+ public:
+  // Ring of one producer thread
+  class Producer {
+   public:
+    explicit Producer(std::size_t ring_capacity) : ring_(ring_capacity) {}
+
+    // Returns false and counts the record as dropped when the ring is full.
+    // Must only be called from the producer thread.
+    inline bool TryLog(const AccessRecord& record) noexcept {
+      if (ring_.TryPush(record)) {
+        return true;
+      }
+      dropped_.Add();
+      return false;
+    }
+
+    // Readable from any thread
+    [[nodiscard]] inline std::uint64_t dropped() const noexcept {
+      return dropped_.value();
+    }
+
+   private:
+    friend AccessLog;
+
+    SpscRing<AccessRecord> ring_;
+    Counter dropped_;
+  };
+
+  // Writes to fd, which stays owned by the caller and must stay open until
+  // the AccessLog is destroyed
+  explicit AccessLog(int fd, AccessLogOptions options = {});
+  // Writes every record still buffered before returning. Producers must
+  // have stopped logging by then.
+  ~AccessLog();
+
+  AccessLog(const AccessLog& other) = delete;
+  AccessLog(AccessLog&& other) = delete;
+
+  AccessLog& operator=(const AccessLog& other) = delete;
+  AccessLog& operator=(AccessLog&& other) = delete;
+
+  // Adds a ring for a new producer thread. The Producer lives as long as the
+  // AccessLog. Safe to call from any thread.
+  Producer& AddProducer();
+
+  // Records dropped by all producers. Safe to call from any thread.
+  [[nodiscard]] std::uint64_t dropped() const;
+
+  // Appends record as one line of format to output
+  static void Format(const AccessRecord& record, AccessLogFormat format,
+                     std::string& output);
+
+ private:
+  void Run();
+  // Moves the records of every ring into buffer_, writing full batches.
+  // Returns the number of records taken.
+  std::size_t Drain();
+  void Flush();
+
+  const int fd_;
+  const AccessLogOptions options_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable stop_condition_;
+  bool stopping_ = false;
+  std::vector<std::unique_ptr<Producer>> producers_;
+
+  // Only used by the log thread
+  std::string buffer_;
+
+  std::thread thread_;
+};
+
+}  // namespace http1
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef HTTP1_BYTE_RANGE_HPP
+#define HTTP1_BYTE_RANGE_HPP
+
+#include <cstddef>
+#include <ctime>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "http_server.hpp"
+
+namespace http1 {
+
+// Range requests of RFC 9110 section 14
+
+struct ByteRange {
+  std::size_t offset;
+  std::size_t size;
+};
+
+inline bool operator==(const ByteRange& lhs, const ByteRange& rhs) {
+  return lhs.offset == rhs.offset && lhs.size == rhs.size;
+}
+
+enum class RangeResult {
+  // No usable Range field, the whole representation is sent
+  Ignored,
+  Satisfiable,
+  // Answered with 416 Range Not Satisfiable
+  Unsatisfiable
+};
+
+struct RangeSelection {
+  RangeResult result = RangeResult::Ignored;
+  std::vector<ByteRange> ranges;
+};
+
+// Requests with more ranges are answered in full rather than with a costly
+// multipart body
+constexpr std::size_t MAX_RANGES = 16;
+
+// Parses a Range field value for a representation of size bytes. Ranges
+// are clipped to size; unsatisfiable ones are dropped.
+RangeSelection ParseRange(std::string_view value, std::size_t size);
+
+// Selects the ranges of a GET request for a representation of size bytes.
+// An If-Range field not matching etag, strongly, or last_modified, exactly,
+// makes the Range field be ignored. Overlapping and adjacent ranges are
+// merged and sorted, and ranges adding up to more than size are ignored.
+RangeSelection SelectRanges(const HttpRequest& request, std::size_t size,
+                            std::string_view etag = {},
+                            std::optional<std::time_t> last_modified = {});
+
+// Content-Range field value, "bytes */size" for unsatisfiable requests
+std::string FormatContentRange(std::optional<ByteRange> range,
+                               std::size_t size);
+
+// Builds the 206 or 416 response for a satisfiable or unsatisfiable
+// selection of content. A single range refers into content without copying
+// it, multiple ranges are copied into an owned multipart/byteranges body.
+// fields, e.g. validators, are added to the response.
+HttpResponse MakeRangeResponse(const RangeSelection& selection,
+                               ByteArrayView content,
+                               std::string_view content_type,
+                               const HeaderFields& fields = {});
+
+// Same for the content of file, whose ranges are sent with sendfile rather
+// than copied into the response
+HttpResponse MakeRangeResponse(const RangeSelection& selection,
+                               const std::shared_ptr<const MappedFile>& file,
+                               std::string_view content_type,
+                               const HeaderFields& fields = {});
+
+}  // namespace http1
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef HTTP1_CONTENT_CODING_HPP
+#define HTTP1_CONTENT_CODING_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace http1 {
+
+// Content codings of RFC 9110 section 8.4.1 the server can send
+enum class ContentCoding : std::uint8_t { Identity, Gzip, Brotli };
+
+constexpr std::size_t CONTENT_CODING_COUNT = 3;
+
+// Registered name, also used as file suffix of precompressed siblings
+// ("gz" for gzip)
+std::string_view NameOf(ContentCoding coding) noexcept;
+std::string_view FileSuffixOf(ContentCoding coding) noexcept;
+
+// Quality values of an Accept-Encoding field (RFC 9110 section 12.5.3)
+class AcceptedCodings {
+ public:
+  static constexpr std::uint16_t MAX_QUALITY = 1000;
+
+  // Without an Accept-Encoding field only identity is acceptable
+  AcceptedCodings() noexcept;
+
+  // Quality value of coding in thousandths, 0 if it is not acceptable.
+  // Codings not listed take the quality of "*"; identity is acceptable
+  // unless excluded explicitly or by "*;q=0".
+  [[nodiscard]] std::uint16_t quality(ContentCoding coding) const noexcept;
+
+  friend AcceptedCodings ParseAcceptEncoding(std::string_view value) noexcept;
+
+ private:
+  static constexpr std::uint16_t UNLISTED = 0xFFFF;
+
+  std::array<std::uint16_t, CONTENT_CODING_COUNT> listed_;
+  std::uint16_t any_ = UNLISTED;
+};
+
+// Malformed list elements are skipped, as are codings the server can not
+// send
+AcceptedCodings ParseAcceptEncoding(std::string_view value) noexcept;
+
+}  // namespace http1
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef HTTP1_DEFLATE_HPP
+#define HTTP1_DEFLATE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "byte_array.hpp"
+
+namespace http1 {
+
+// Streaming DEFLATE encoder (RFC 1951) with a hash chain matcher over a 32 KiB
+// window. Levels trade speed for ratio like zlib's: 0 only stores, 1 to 3
+// take the first good match, 4 to 9 search longer chains and defer matches
+// lazily. Every block is written stored, with fixed or with dynamic Huffman
+// codes, whichever is smallest.
+class DeflateEncoder {
+ public:
+  static constexpr int MIN_LEVEL = 0;
+  static constexpr int MAX_LEVEL = 9;
+  static constexpr int DEFAULT_LEVEL = 6;
+
+  // Throws std::invalid_argument for levels outside MIN_LEVEL to MAX_LEVEL
+  explicit DeflateEncoder(int level = DEFAULT_LEVEL);
+
+  // Compresses input and appends completed blocks to output. Up to a block
+  // of input is held back until more input, Flush or Finish.
+  void Write(ByteArrayView input, ByteArray& output);
+
+  // Ends the current block and byte-aligns output with an empty stored
+  // block, so that everything written so far can be decoded, e.g. before a
+  // chunk of a streamed response is sent.
+  void Flush(ByteArray& output);
+
+  // Writes the final block. The encoder must not be used afterwards.
+  void Finish(ByteArray& output);
+
+ private:
+  struct Symbol {
+    std::uint16_t distance;  // 0 for literals
+    std::uint16_t value;     // literal byte or match length - 3
+  };
+
+  struct HuffmanCode {
+    std::uint16_t code;  // bit-reversed, as DEFLATE writes codes MSB first
+    std::uint8_t length;
+  };
+
+  static constexpr std::size_t LITERAL_LENGTH_CODES = 286;
+  static constexpr std::size_t DISTANCE_CODES = 30;
+
+  using LiteralLengths = std::array<std::uint8_t, LITERAL_LENGTH_CODES>;
+  using DistanceLengths = std::array<std::uint8_t, DISTANCE_CODES>;
+
+  void Compress(bool flush);
+  void CompressStored();
+  void CompressGreedy(bool flush);
+  void CompressLazy(bool flush);
+  void Slide();
+
+  // Inserts the string at position into its hash chain and returns the
+  // previous head of the chain, or -1
+  std::int32_t Insert(std::int32_t position) noexcept;
+  std::size_t LongestMatch(std::int32_t chain_head,
+                           std::size_t previous_length) noexcept;
+
+  // Return true once the symbol buffer is full
+  bool TallyLiteral(std::byte literal) noexcept;
+  bool TallyMatch(std::size_t distance, std::size_t length) noexcept;
+
+  [[nodiscard]] std::int32_t TalliedEnd() const noexcept;
+  void EmitBlock(bool last);
+  void WriteStoredBlocks(ByteArrayView data, bool last);
+  void WriteSymbols(std::span<const HuffmanCode> literal_codes,
+                    std::span<const HuffmanCode> distance_codes);
+  [[nodiscard]] std::size_t SymbolBits(
+      std::span<const std::uint8_t> literal_lengths,
+      std::span<const std::uint8_t> distance_lengths) const noexcept;
+
+  void PutBits(std::uint32_t value, unsigned count);
+  void AlignToByte();
+
+  int level_;
+  std::size_t good_length_;
+  std::size_t max_lazy_;
+  std::size_t nice_length_;
+  std::size_t max_chain_;
+
+  // Two windows, the older half is dropped by Slide
+  ByteArray window_;
+  std::vector<std::int32_t> head_;
+  std::vector<std::int32_t> previous_;
+
+  std::int32_t position_ = 0;
+  std::size_t lookahead_ = 0;
+  std::int32_t block_start_ = 0;
+
+  // Lazy matching state carried across Write calls
+  std::size_t match_length_ = 0;
+  std::int32_t match_start_ = 0;
+  bool match_available_ = false;
+
+  std::vector<Symbol> symbols_;
+  std::array<std::uint32_t, LITERAL_LENGTH_CODES> literal_frequencies_{};
+  std::array<std::uint32_t, DISTANCE_CODES> distance_frequencies_{};
+
+  ByteArray* output_ = nullptr;
+  std::uint64_t bit_buffer_ = 0;
+  unsigned bit_count_ = 0;
+};
+
+// gzip member (RFC 1952) around a DeflateEncoder
+class GzipEncoder {
+ public:
+  explicit GzipEncoder(int level = DeflateEncoder::DEFAULT_LEVEL);
+
+  void Write(ByteArrayView input, ByteArray& output);
+  void Flush(ByteArray& output);
+  void Finish(ByteArray& output);
+
+ private:
+  void WriteHeader(ByteArray& output);
+
+  int level_;
+  DeflateEncoder deflate_;
+  std::uint32_t crc_ = 0;
+  std::uint32_t size_ = 0;  // modulo 2^32, as the trailer stores it
+  bool header_written_ = false;
+};
+
+ByteArray GzipCompress(ByteArrayView input,
+                       int level = DeflateEncoder::DEFAULT_LEVEL);
+
+}  // namespace http1
+
+#endif
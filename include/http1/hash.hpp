@@ -0,0 +1,21 @@
+#ifndef HTTP1_HASH_HPP
+#define HTTP1_HASH_HPP
+
+#include <cstdint>
+
+#include "byte_array.hpp"
+
+namespace http1 {
+
+// 64-bit non-cryptographic hash of data, the XXH64 algorithm. Used for
+// content validators such as strong ETags, where it has to be fast on
+// large inputs and stable across processes.
+std::uint64_t Hash64(ByteArrayView data, std::uint64_t seed = 0) noexcept;
+
+// CRC-32 of ISO 3309 as used by gzip, continued from the CRC of the
+// preceding data, so that streams can be checked piece by piece.
+std::uint32_t Crc32(ByteArrayView data, std::uint32_t crc = 0) noexcept;
+
+}  // namespace http1
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef HTTP1_HTTP_DATE_HPP
+#define HTTP1_HTTP_DATE_HPP
+
+#include <cstddef>
+#include <ctime>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace http1 {
+
+// Size of an IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+constexpr std::size_t HTTP_DATE_SIZE = 29;
+
+// Formats time as IMF-fixdate (RFC 9110 section 5.6.7) without gmtime or
+// strftime, so it is thread-safe and does not touch the locale.
+void FormatHttpDate(std::time_t time,
+                    std::span<char, HTTP_DATE_SIZE> output) noexcept;
+std::string FormatHttpDate(std::time_t time);
+
+// Parses an IMF-fixdate. The obsolete RFC 850 and asctime formats are not
+// accepted, a conditional request using them is answered in full.
+std::optional<std::time_t> ParseHttpDate(std::string_view date) noexcept;
+
+// Pre-formatted "date" and optional "server" field lines shared by every
+// response of an event loop. The date is only re-formatted when the second
+// changes.
+class CommonFieldsCache {
+ public:
+  CommonFieldsCache();
+
+  void SetServerName(std::string_view server_name);
+
+  // Returns true when the date line changed
+  bool Update(std::time_t now) noexcept;
+
+  // Field lines including their trailing CRLF
+  [[nodiscard]] inline std::string_view lines() const noexcept {
+    return lines_;
+  }
+
+ private:
+  static constexpr std::string_view DATE_PREFIX = "date: ";
+
+  std::string lines_;
+  std::time_t formatted_time_ = -1;
+};
+
+}  // namespace http1
+
+#endif
\ No newline at end of file
@@ -1,14 +1,27 @@
 #ifndef HTTP1_HTTP_SERVER_HPP
 #define HTTP1_HTTP_SERVER_HPP
 
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <unordered_map>
+#include <vector>
 
+#include "access_log.hpp"
+#include "deflate.hpp"
+#include "http_date.hpp"
+#include "mapped_file.hpp"
+#include "target.hpp"
 #include "tcp_server.hpp"
+#include "thread_pool.hpp"
 
 namespace http1 {
 
@@ -25,6 +38,8 @@ enum class HttpMethod {
   Patch
 };
 
+enum class HttpVersion { Http10, Http11 };
+
 enum class HttpStatusCode {
   // 1xx Informational
   Continue = 100,
@@ -98,9 +113,151 @@ enum class HttpStatusCode {
   NetworkAuthenticationRequired = 511
 };
 
+// Reason phrases as listed in RFC 9110
+constexpr std::string_view ReasonPhrase(HttpStatusCode status_code) noexcept {
+  switch (status_code) {
+    case HttpStatusCode::Continue:
+      return "Continue";
+    case HttpStatusCode::SwitchingProtocols:
+      return "Switching Protocols";
+    case HttpStatusCode::Processing:
+      return "Processing";
+    case HttpStatusCode::OK:
+      return "OK";
+    case HttpStatusCode::Created:
+      return "Created";
+    case HttpStatusCode::Accepted:
+      return "Accepted";
+    case HttpStatusCode::NonAuthoritativeInformation:
+      return "Non-Authoritative Information";
+    case HttpStatusCode::NoContent:
+      return "No Content";
+    case HttpStatusCode::ResetContent:
+      return "Reset Content";
+    case HttpStatusCode::PartialContent:
+      return "Partial Content";
+    case HttpStatusCode::MultiStatus:
+      return "Multi-Status";
+    case HttpStatusCode::AlreadyReported:
+      return "Already Reported";
+    case HttpStatusCode::IMUsed:
+      return "IM Used";
+    case HttpStatusCode::MultipleChoices:
+      return "Multiple Choices";
+    case HttpStatusCode::MovedPermanently:
+      return "Moved Permanently";
+    case HttpStatusCode::Found:
+      return "Found";
+    case HttpStatusCode::SeeOther:
+      return "See Other";
+    case HttpStatusCode::NotModified:
+      return "Not Modified";
+    case HttpStatusCode::UseProxy:
+      return "Use Proxy";
+    case HttpStatusCode::TemporaryRedirect:
+      return "Temporary Redirect";
+    case HttpStatusCode::PermanentRedirect:
+      return "Permanent Redirect";
+    case HttpStatusCode::BadRequest:
+      return "Bad Request";
+    case HttpStatusCode::Unauthorized:
+      return "Unauthorized";
+    case HttpStatusCode::PaymentRequired:
+      return "Payment Required";
+    case HttpStatusCode::Forbidden:
+      return "Forbidden";
+    case HttpStatusCode::NotFound:
+      return "Not Found";
+    case HttpStatusCode::MethodNotAllowed:
+      return "Method Not Allowed";
+    case HttpStatusCode::NotAcceptable:
+      return "Not Acceptable";
+    case HttpStatusCode::ProxyAuthenticationRequired:
+      return "Proxy Authentication Required";
+    case HttpStatusCode::RequestTimeout:
+      return "Request Timeout";
+    case HttpStatusCode::Conflict:
+      return "Conflict";
+    case HttpStatusCode::Gone:
+      return "Gone";
+    case HttpStatusCode::LengthRequired:
+      return "Length Required";
+    case HttpStatusCode::PreconditionFailed:
+      return "Precondition Failed";
+    case HttpStatusCode::PayloadTooLarge:
+      return "Content Too Large";
+    case HttpStatusCode::URITooLong:
+      return "URI Too Long";
+    case HttpStatusCode::UnsupportedMediaType:
+      return "Unsupported Media Type";
+    case HttpStatusCode::RangeNotSatisfiable:
+      return "Range Not Satisfiable";
+    case HttpStatusCode::ExpectationFailed:
+      return "Expectation Failed";
+    case HttpStatusCode::ImATeapot:
+      return "I'm a teapot";
+    case HttpStatusCode::MisdirectedRequest:
+      return "Misdirected Request";
+    case HttpStatusCode::UnprocessableEntity:
+      return "Unprocessable Content";
+    case HttpStatusCode::Locked:
+      return "Locked";
+    case HttpStatusCode::FailedDependency:
+      return "Failed Dependency";
+    case HttpStatusCode::TooEarly:
+      return "Too Early";
+    case HttpStatusCode::UpgradeRequired:
+      return "Upgrade Required";
+    case HttpStatusCode::PreconditionRequired:
+      return "Precondition Required";
+    case HttpStatusCode::TooManyRequests:
+      return "Too Many Requests";
+    case HttpStatusCode::RequestHeaderFieldsTooLarge:
+      return "Request Header Fields Too Large";
+    case HttpStatusCode::UnavailableForLegalReasons:
+      return "Unavailable For Legal Reasons";
+    case HttpStatusCode::InternalServerError:
+      return "Internal Server Error";
+    case HttpStatusCode::NotImplemented:
+      return "Not Implemented";
+    case HttpStatusCode::BadGateway:
+      return "Bad Gateway";
+    case HttpStatusCode::ServiceUnavailable:
+      return "Service Unavailable";
+    case HttpStatusCode::GatewayTimeout:
+      return "Gateway Timeout";
+    case HttpStatusCode::HTTPVersionNotSupported:
+      return "HTTP Version Not Supported";
+    case HttpStatusCode::VariantAlsoNegotiates:
+      return "Variant Also Negotiates";
+    case HttpStatusCode::InsufficientStorage:
+      return "Insufficient Storage";
+    case HttpStatusCode::LoopDetected:
+      return "Loop Detected";
+    case HttpStatusCode::NotExtended:
+      return "Not Extended";
+    case HttpStatusCode::NetworkAuthenticationRequired:
+      return "Network Authentication Required";
+  }
+  return "";
+}
+
+// Part of a request that could not be parsed
+enum class HttpParseErrorKind { RequestLine, Method, Version, Path, Field };
+
+inline constexpr std::array<std::string_view, 5> PARSE_ERROR_KIND_NAMES = {
+    "request_line", "method", "version", "path", "field"};
+
 class HttpParseError : public std::invalid_argument {
  public:
-  explicit HttpParseError(const std::string& error_message);
+  HttpParseError(HttpParseErrorKind kind, const std::string& error_message);
+
+  [[nodiscard]] inline HttpParseErrorKind kind() const noexcept {
+    return kind_;
+  }
+
+ private:
+  HttpParseErrorKind kind_;
 };
 
 class HttpSerializeError : public std::invalid_argument {
@@ -108,6 +265,22 @@ class HttpSerializeError : public std::invalid_argument {
   explicit HttpSerializeError(const std::string& error_message);
 };
 
+inline constexpr std::array<std::string_view, 10> METHOD_NAMES = {
+    "", "GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE",
+    "PATCH"};
+
+constexpr std::string_view SerializeMethod(HttpMethod method) {
+  const auto index = static_cast<std::size_t>(method);
+  if (method == HttpMethod::Unknown || index >= METHOD_NAMES.size()) {
+    throw HttpSerializeError("Invalid HTTP method");
+  }
+  return METHOD_NAMES[index];
+}
+
+constexpr std::string_view SerializeVersion(HttpVersion version) noexcept {
+  return version == HttpVersion::Http10 ? "HTTP/1.0" : "HTTP/1.1";
+}
+
 struct HeaderField {
   std::string name;
   std::string value;
@@ -125,8 +298,17 @@ using HeaderFields = std::vector<HeaderField>;
 class HttpMessage {
  public:
   void AddField(const HeaderField& field);
+  void AddField(HeaderField&& field);
   void SetBody(const ByteArrayView& body);
 
+  // Replaces the value of the first field called field.name, or adds field
+  void SetField(const HeaderField& field);
+
+  // Value of the first field called name, which must be lowercase for
+  // parsed requests
+  [[nodiscard]] std::optional<std::string_view> FindField(
+      std::string_view name) const noexcept;
+
   [[nodiscard]] inline const HeaderFields& header_fields() const noexcept {
     return header_fields_;
   }
@@ -143,20 +325,27 @@ class HttpMessage {
 
 class HttpRequest : public HttpMessage {
  public:
-  static HttpRequest ParseHeader(const std::string_view& header);
-  HttpRequest(HttpMethod method, std::string path, std::string version);
+  // The path of the target is normalized with NormalizePath, invalid paths
+  // raise HttpParseError.
+  static HttpRequest ParseHeader(const std::string_view& header,
+                                 const PathOptions& path_options = {});
+  HttpRequest(HttpMethod method, std::string path, HttpVersion version);
   HttpRequest() = default;
 
   void UpdateFields(const HeaderField& field);
+  void UpdateFields(HeaderField&& field);
   void UpdateFields(const std::string& name, const std::string& value);
 
   [[nodiscard]] inline HttpMethod method() const noexcept { return method_; }
 
+  // Raw request-target, including the query
   [[nodiscard]] inline const std::string& path() const noexcept {
     return path_;
   }
 
-  [[nodiscard]] inline const std::string& version() const noexcept {
+  [[nodiscard]] inline Target target() const noexcept { return Target(path_); }
+
+  [[nodiscard]] inline HttpVersion version() const noexcept {
     return version_;
   }
 
@@ -167,7 +356,7 @@ class HttpRequest : public HttpMessage {
  private:
   HttpMethod method_ = HttpMethod::Unknown;
   std::string path_;
-  std::string version_;
+  HttpVersion version_ = HttpVersion::Http11;
 
   std::size_t content_length_ = 0;
 };
@@ -188,48 +377,856 @@ class HttpRequestParser {
  public:
   using RequestCallback = std::function<void(const HttpRequest&)>;
   explicit HttpRequestParser(RequestCallback callback);
+  HttpRequestParser() = default;
+
+  inline void SetPathOptions(const PathOptions& path_options) noexcept {
+    path_options_ = path_options;
+  }
+
   void Feed(const ByteArrayView& data);
 
+  // Calls on_request for every request completed by data. The callback is a
+  // template parameter so that it can be inlined into the parse loop.
+  template <class Callback>
+  void Feed(const ByteArrayView& data, Callback&& on_request) {
+    std::size_t offset = 0;
+    while (ParseNext(data, offset)) {
+      on_request(static_cast<const HttpRequest&>(request_));
+      FinishRequest();
+    }
+  }
+
   [[nodiscard]] inline const HttpRequest& request() const noexcept {
     return request_;
   }
 
+  // Whether no part of a request has been buffered, so that the next byte
+  // fed starts a new request
+  [[nodiscard]] inline bool idle() const noexcept {
+    return state_ == State::BeforeCr1 && buffer_.empty();
+  }
+
  private:
   enum class State { BeforeCr1, Cr1, Lf1, Cr2, Body };
 
+  // Consumes data from offset until a request is complete and returns true,
+  // or buffers the rest of data and returns false.
+  bool ParseNext(const ByteArrayView& data, std::size_t& offset);
+  void FinishRequest();
+
   ByteArray buffer_;
   State state_ = State::BeforeCr1;
   HttpRequest request_;
   RequestCallback on_request_;
+  PathOptions path_options_;
+};
+
+class HttpResponse;
+
+// Range of a mapped file sent as a response body. Holding file keeps the
+// mapping and descriptor open until the response has been written.
+struct FileBody {
+  std::shared_ptr<const MappedFile> file;
+  std::size_t offset;
+  std::size_t size;
+};
+
+// Part of a body assembled from mapped files, e.g. of multipart/byteranges:
+// prefix is written from memory, then file is sent like a FileBody
+struct FileBodyPart {
+  std::string prefix;
+  FileBody file;
+};
+
+// Response serialized once, e.g. at startup, into an immutable buffer shared
+// by all of its copies. A handler returning it skips serialization, the
+// server writes the buffer by reference with only the common fields added.
+class PreparedResponse {
+ public:
+  explicit PreparedResponse(const HttpResponse& response);
+
+  // Status line including CRLF, common fields are written right after it
+  [[nodiscard]] ByteArrayView status_line() const noexcept;
+  [[nodiscard]] ByteArrayView fields_and_body() const noexcept;
+  // Field lines including the empty line, as answered to HEAD
+  [[nodiscard]] ByteArrayView fields() const noexcept;
+
+  // Serialized size without common fields
+  [[nodiscard]] inline std::size_t size() const noexcept {
+    return data_->size();
+  }
+
+  [[nodiscard]] inline HttpStatusCode status_code() const noexcept {
+    return status_code_;
+  }
+
+ private:
+  std::shared_ptr<const ByteArray> data_;
+  std::size_t status_line_size_;
+  std::size_t header_size_;
+  HttpStatusCode status_code_;
+};
+
+// Field of a HeaderTemplate whose value is patched per response
+struct TemplateSlot {
+  std::string name;
+  std::size_t width;
+};
+
+// Status line and fields shared by many responses, e.g. of one route,
+// serialized once with fixed-width slots for the values that change. A
+// response using it copies the block and patches only the slot bytes.
+// Slot values are padded with trailing spaces, which RFC 9110 strips as
+// optional whitespace. A slot named content-length is filled from the
+// response's content length or body size.
+class HeaderTemplate {
+ public:
+  // Bytes available to all slot values other than content-length
+  static constexpr std::size_t MAX_SLOT_STORAGE = 96;
+
+  HeaderTemplate(HttpStatusCode status_code, const HeaderFields& fields,
+                 const std::vector<TemplateSlot>& slots);
+
+  [[nodiscard]] inline HttpStatusCode status_code() const noexcept {
+    return layout_->status_code;
+  }
+
+  [[nodiscard]] inline bool has_content_length_slot() const noexcept {
+    return layout_->has_content_length_slot;
+  }
+
+ private:
+  friend class HttpResponse;
+
+  struct SlotLayout {
+    std::size_t offset;  // of the value in block
+    std::size_t width;
+    std::size_t storage_offset;
+    bool is_content_length;
+  };
+
+  struct Layout {
+    HttpStatusCode status_code;
+    std::string block;  // status line and field lines, without the final CRLF
+    std::size_t status_line_size;
+    std::vector<SlotLayout> slots;
+    std::size_t storage_size;
+    bool has_content_length_slot;
+  };
+
+  std::shared_ptr<const Layout> layout_;
 };
 
 class HttpResponse : public HttpMessage {
  public:
   explicit HttpResponse(HttpStatusCode status_code);
 
+  // Serializes the status line and fields of header_template, followed by
+  // the fields added to this response.
+  explicit HttpResponse(HeaderTemplate header_template);
+
+  // Lets handlers return a PreparedResponse directly. A body set on such a
+  // response is ignored, fields added to it are written before the prepared
+  // ones, e.g. by middleware.
+  // NOLINTNEXTLINE(google-explicit-constructor,hicpp-explicit-conversions)
+  HttpResponse(PreparedResponse prepared);
+
+  // Overrides the reason phrase, which defaults to ReasonPhrase(status_code)
   void SetReason(const std::string& reason);
 
-  [[nodiscard]] ByteArray Serialize() const;
+  // Emits a content-length field, formatted during serialization
+  void SetContentLength(std::size_t content_length);
+
+  // Exact number of bytes written by SerializeTo. common_fields are
+  // pre-formatted field lines, including CRLF, inserted after the status
+  // line, e.g. the cached date and server fields of the event loop. Throws
+  // HttpSerializeError for a status code outside of 100 to 599.
+  [[nodiscard]] std::size_t SerializedSize(
+      std::string_view common_fields = {}) const;
+
+  // Appends the serialized response to output with a single exact resize.
+  // No allocation happens when output already has enough capacity.
+  void SerializeTo(ByteArray& output,
+                   std::string_view common_fields = {}) const;
+
+  // Writes the serialized response to the start of output and returns the
+  // number of bytes written. Throws HttpSerializeError when output is smaller
+  // than SerializedSize().
+  std::size_t SerializeTo(std::span<std::byte> output,
+                          std::string_view common_fields = {}) const;
+
+  [[nodiscard]] ByteArray Serialize(std::string_view common_fields = {}) const;
+
+  // Appends everything but the file body, which the server sends with
+  // sendfile instead of copying it.
+  void SerializeHeaderTo(ByteArray& output,
+                         std::string_view common_fields = {}) const;
+
+  // Sends part of a mapped file as the body, in place of body()
+  void SetFileBody(FileBody file_body);
+
+  // Sends parts one after another as the body, in place of body(), so that
+  // the file ranges are not copied into memory
+  void SetFileBodyParts(std::vector<FileBodyPart> parts);
+
+  // Sets a body owned by the response, and by its copies, for content built
+  // per request
+  void SetOwnedBody(ByteArray body);
+
+  // Leaves out the body when serializing, as answered to HEAD, while the
+  // fields stay those of the full response. A body without a content length
+  // gets one, so that the length is still announced.
+  void OmitBody();
+
+  [[nodiscard]] inline bool body_omitted() const noexcept {
+    return body_omitted_;
+  }
+
+  // Prepared field lines followed by the body, unless omitted
+  [[nodiscard]] ByteArrayView prepared_tail() const noexcept;
+
+  [[nodiscard]] inline const std::optional<FileBody>& file_body()
+      const noexcept {
+    return file_body_;
+  }
+
+  [[nodiscard]] inline const std::vector<FileBodyPart>& file_body_parts()
+      const noexcept {
+    return file_body_parts_;
+  }
+
+  [[nodiscard]] inline HttpStatusCode status_code() const noexcept {
+    return status_code_;
+  }
+
+  [[nodiscard]] inline const std::optional<PreparedResponse>& prepared()
+      const noexcept {
+    return prepared_;
+  }
+
+  [[nodiscard]] inline const std::optional<std::size_t>& content_length()
+      const noexcept {
+    return content_length_;
+  }
+
+  // Sets the value of a slot of the header template. Throws
+  // HttpSerializeError when the value does not fit the slot or is not a
+  // valid field value.
+  void SetSlot(std::size_t slot, std::string_view value);
 
  private:
-  static constexpr const char* VERSION = "HTTP/1.1";
+  [[nodiscard]] std::size_t HeaderSize(std::string_view common_fields) const;
+  [[nodiscard]] std::size_t BodySize() const noexcept;
+  [[nodiscard]] bool HasContentLengthLine() const noexcept;
+  char* SerializeHeader(char* cursor, std::string_view common_fields) const;
+  char* SerializeTemplate(char* cursor, std::string_view common_fields) const;
 
   HttpStatusCode status_code_;
   std::optional<std::string> reason_;
+  std::optional<std::size_t> content_length_;
+  std::optional<PreparedResponse> prepared_;
+
+  std::optional<HeaderTemplate> header_template_;
+  std::array<char, HeaderTemplate::MAX_SLOT_STORAGE> slot_values_{};
+
+  std::optional<FileBody> file_body_;
+  std::vector<FileBodyPart> file_body_parts_;
+  std::shared_ptr<const ByteArray> owned_body_;
+  bool body_omitted_ = false;
+};
+
+// On-the-fly gzip of responses built per request
+struct CompressionOptions {
+  int level = DeflateEncoder::DEFAULT_LEVEL;
+
+  // Smaller bodies save too little to pay for setting up the encoder
+  std::size_t min_size = 1024;
+};
+
+// Whether content_type is text-like, e.g. HTML, JSON or SVG. Images, video,
+// fonts and archives are compressed already.
+bool IsCompressible(std::string_view content_type) noexcept;
+
+// Replaces the body of response by its gzip encoding when request accepts
+// gzip and the body is at least options.min_size bytes of a compressible
+// content-type. Prepared responses, file bodies, already encoded bodies and
+// partial content are left alone, as are bodies whose content length, set or
+// added as a field, does not match them. Adds content-encoding and vary,
+// updates the content length and weakens a strong etag, which belongs to the
+// unencoded body. Returns true when the body was compressed.
+bool CompressResponse(const HttpRequest& request, HttpResponse& response,
+                      const CompressionOptions& options = {});
+
+// Counters of the requests of one event loop, written by the loop thread
+// only. Responses of offloaded requests are counted once they are back on
+// the loop.
+struct alignas(CACHE_LINE_SIZE) HttpMetrics {
+  static constexpr std::size_t STATUS_CLASS_COUNT = 5;
+
+  // By HttpMethod
+  std::array<Counter, METHOD_NAMES.size()> requests;
+  // By status class, 1xx to 5xx
+  std::array<Counter, STATUS_CLASS_COUNT> responses;
+  // By HttpParseErrorKind
+  std::array<Counter, PARSE_ERROR_KIND_NAMES.size()> parse_errors;
+
+  void RecordResponse(HttpStatusCode status_code) noexcept;
+  void WriteTo(MetricsWriter& writer) const;
 };
 
-class HttpServer : public TcpServer {
+// Phases of a request timed by LatencyMetrics
+enum class RequestPhase { Parse, Handle, Serialize, Write };
+
+inline constexpr std::array<std::string_view, 4> REQUEST_PHASE_NAMES = {
+    "parse", "handle", "serialize", "write"};
+
+// Latency histograms of the request phases of one event loop, in
+// nanoseconds and written by the loop thread only:
+//   parse      from the first byte of a request until it is complete
+//   handle     the handler, including compression
+//   serialize  the response into bytes, 0 for prepared responses
+//   write      until the last byte of the response is handed to the kernel
+// Offloaded requests are timed on the worker and recorded back on the loop.
+// Responses written after an earlier offloaded one get no write time.
+struct alignas(CACHE_LINE_SIZE) LatencyMetrics {
+  std::array<Histogram, REQUEST_PHASE_NAMES.size()> phases;
+
+  inline void Record(RequestPhase phase, std::uint64_t nanoseconds) noexcept {
+    phases[static_cast<std::size_t>(phase)].Record(nanoseconds);
+  }
+
+  // Writes a summary with the median, 99th and 99.9th percentile in seconds
+  void WriteTo(MetricsWriter& writer) const;
+};
+
+// 200 OK response with metrics in the Prometheus text format as body
+HttpResponse MakeMetricsResponse(std::string_view text);
+
+// Per-connection state of BasicHttpServer
+struct HttpConnection {
+  explicit HttpConnection(std::uint64_t id);
+
+  HttpRequestParser parser;
+  std::uint64_t id;
+
+  // Responses are written in request order, finished holds the ones that
+  // completed before an earlier offloaded request.
+  std::uint64_t next_sequence = 0;
+  std::uint64_t next_to_write = 0;
+  std::map<std::uint64_t, ByteArray> finished;
+
+  // Only looked up while an access log is enabled
+  PeerAddress peer;
+
+  // MonotonicNanoseconds when the first byte of the request being parsed
+  // arrived
+  std::uint64_t request_start_time = 0;
+
+  // Writes response once every earlier response has been written
+  void Complete(const TcpServerCore::Socket& socket, std::uint64_t sequence,
+                ByteArray response);
+};
+
+// Statically dispatched HTTP server. Handler is the derived class and must
+// provide
+//   HttpResponse OnRequest(const HttpRequest& request);
+// and may provide
+//   bool ShouldOffload(const HttpRequest& request) const;
+//   using StaticRoutes = StaticRouteTable<Route<...>, ...>;
+// accessible to BasicHttpServer<Handler>. Requests for a path of
+// StaticRoutes are dispatched through its table, with handler functions
+// receiving the Handler, and only the others reach OnRequest. Parsing,
+// handling and serializing a request is then one statically bound call chain
+// from the event loop. A ShouldOffload that is not const fails to compile.
+template <class Handler>
+class BasicHttpServer : public BasicTcpServer<BasicHttpServer<Handler>> {
+  friend BasicTcpServer<BasicHttpServer<Handler>>;
+
+ public:
+  using Socket = TcpServerCore::Socket;
+  using CallBack = TcpServerCore::CallBack;
+
+  explicit BasicHttpServer(std::uint16_t port)
+      : BasicTcpServer<BasicHttpServer<Handler>>(port) {}
+
+  // Requests selected by ShouldOffload are handed to a pool of worker_count
+  // threads. When queue_capacity requests are already waiting, the request
+  // is answered with 503 Service Unavailable instead. OnRequest is then
+  // called on worker threads for those requests and must be thread-safe.
+  void EnableWorkerPool(std::size_t worker_count, std::size_t queue_capacity) {
+    worker_pool_ = std::make_unique<ThreadPool>(worker_count, queue_capacity);
+  }
+
+  [[nodiscard]] std::optional<ThreadPool::Stats> worker_pool_stats() const {
+    if (!worker_pool_) {
+      return std::nullopt;
+    }
+    return worker_pool_->stats();
+  }
+
+  // Every response gets a cached date field, and a server field once a
+  // non-empty name is set.
+  void SetServerName(std::string_view server_name) {
+    common_fields_.SetServerName(server_name);
+  }
+
+  // Passes every response returned by OnRequest through CompressResponse,
+  // on the worker thread for offloaded requests. Handlers may still call
+  // CompressResponse with other options for single routes, as an encoded
+  // response is not compressed again.
+  void EnableCompression(CompressionOptions options = {}) {
+    compression_ = options;
+  }
+
+  // Answers GET requests for path with the metrics of WriteMetrics, ahead
+  // of StaticRoutes and OnRequest
+  void EnableMetrics(std::string path = "/metrics") {
+    metrics_path_ = std::move(path);
+  }
+
+  // Logs every response to access_log, which must outlive the server.
+  // Records are queued on a ring of this loop without blocking it, and
+  // dropped when the ring is full.
+  void EnableAccessLog(AccessLog& access_log) {
+    access_log_ = &access_log.AddProducer();
+  }
+
+  // Appends the connection and request metrics in the Prometheus text
+  // format. Safe to call from any thread, e.g. of a MetricsServer.
+  void WriteMetrics(std::string& output) const {
+    MetricsWriter writer(output);
+    this->tcp_metrics().WriteTo(writer);
+    http_metrics_.WriteTo(writer);
+    latency_metrics_.WriteTo(writer);
+    this->loop_monitor().WriteTo(writer);
+    if (access_log_ != nullptr) {
+      writer.Family("http1_access_log_dropped_total", "counter",
+                    "Access log records dropped because the ring was full.");
+      writer.Sample("http1_access_log_dropped_total", {},
+                    access_log_->dropped());
+    }
+  }
+
+  [[nodiscard]] inline const HttpMetrics& http_metrics() const noexcept {
+    return http_metrics_;
+  }
+
+  [[nodiscard]] inline const LatencyMetrics& latency_metrics() const noexcept {
+    return latency_metrics_;
+  }
+
+  // Request paths are normalized before they reach handlers, by default
+  // keeping encoded slashes and collapsing empty segments. Applies to
+  // connections accepted afterwards.
+  void SetPathOptions(PathOptions options) { path_options_ = options; }
+
+ private:
+  inline Handler& handler() noexcept { return static_cast<Handler&>(*this); }
+
+  void OnData(const Socket& socket, const ByteArrayView& data);
+  void OnClose(const Socket& socket) {
+    connection_table.erase(socket.socket_fd());
+  }
+
+  void HandleRequest(const Socket& socket, HttpConnection& connection,
+                     const HttpRequest& request, std::uint64_t start_time);
+  void LogAccess(const PeerAddress& peer, const HttpRequest& request,
+                 HttpStatusCode status_code, std::size_t bytes,
+                 std::uint64_t start_time);
+  // Callback recording the write phase of a response serialized at
+  // serialized_time
+  CallBack RecordWrite(std::uint64_t serialized_time);
+  // Writes the prefixes and sends the file ranges of parts in order, then
+  // calls on_written
+  static void SendFileBodyParts(const Socket& socket,
+                                const std::vector<FileBodyPart>& parts,
+                                CallBack on_written);
+  HttpResponse Respond(const HttpRequest& request);
+  HttpResponse MetricsResponse() const;
+  std::string_view CommonFields() noexcept;
+  bool IsOffloaded(const HttpRequest& request);
+  bool Offload(const Socket& socket, std::uint64_t connection_id,
+               std::uint64_t sequence, const HttpRequest& request,
+               std::uint64_t start_time);
+
+  std::unordered_map<int, HttpConnection> connection_table;
+  std::uint64_t next_connection_id_ = 0;
+
+  // Reused for every response written directly from the loop, so that its
+  // capacity settles and serialization stops allocating.
+  ByteArray response_buffer_;
+  CommonFieldsCache common_fields_;
+
+  std::unique_ptr<ThreadPool> worker_pool_;
+  std::optional<CompressionOptions> compression_;
+  PathOptions path_options_;
+
+  HttpMetrics http_metrics_;
+  LatencyMetrics latency_metrics_;
+  std::optional<std::string> metrics_path_;
+  AccessLog::Producer* access_log_ = nullptr;
+};
+
+template <class Handler>
+void BasicHttpServer<Handler>::OnData(const Socket& socket,
+                                      const ByteArrayView& data) {
+  auto connection_iterator = connection_table.find(socket.socket_fd());
+  if (connection_iterator == connection_table.end()) {
+    std::tie(connection_iterator, std::ignore) = connection_table.try_emplace(
+        socket.socket_fd(), next_connection_id_++);
+    connection_iterator->second.parser.SetPathOptions(path_options_);
+    if (access_log_ != nullptr) {
+      connection_iterator->second.peer = PeerAddress::Of(socket.socket_fd());
+    }
+  }
+  auto& connection = connection_iterator->second;
+
+  // Requests continued from an earlier read keep the time of its arrival,
+  // pipelined ones following in data start with data.
+  const std::uint64_t received_time = MonotonicNanoseconds();
+  if (connection.parser.idle()) {
+    connection.request_start_time = received_time;
+  }
+
+  try {
+    connection.parser.Feed(data, [this, &socket, &connection, received_time](
+                                     const HttpRequest& request) {
+      HandleRequest(socket, connection, request,
+                    connection.request_start_time);
+      connection.request_start_time = received_time;
+    });
+    return;
+  } catch (const HttpParseError& parse_error) {
+    http_metrics_.parse_errors[static_cast<std::size_t>(parse_error.kind())]
+        .Add();
+    std::cerr << "HTTP request parse failed: " << parse_error.what()
+              << std::endl;
+  } catch (const HttpSerializeError& serialize_error) {
+    std::cerr << "HTTP response serialize failed: " << serialize_error.what()
+              << std::endl;
+  }
+
+  socket.Close();
+}
+
+template <class Handler>
+void BasicHttpServer<Handler>::HandleRequest(const Socket& socket,
+                                             HttpConnection& connection,
+                                             const HttpRequest& request,
+                                             std::uint64_t start_time) {
+  const std::uint64_t sequence = connection.next_sequence++;
+  http_metrics_.requests[static_cast<std::size_t>(request.method())].Add();
+  const InFlightRequest in_flight(
+      this->loop_monitor(),
+      METHOD_NAMES[static_cast<std::size_t>(request.method())],
+      request.path(), connection.id);
+  const std::uint64_t parsed_time = MonotonicNanoseconds();
+  latency_metrics_.Record(RequestPhase::Parse, parsed_time - start_time);
+
+  if (IsOffloaded(request)) {
+    if (Offload(socket, connection.id, sequence, request, start_time)) {
+      return;
+    }
+
+    HttpResponse unavailable(HttpStatusCode::ServiceUnavailable);
+    unavailable.SetContentLength(0);
+    http_metrics_.RecordResponse(unavailable.status_code());
+    ByteArray serialized = unavailable.Serialize(CommonFields());
+    LogAccess(connection.peer, request, unavailable.status_code(),
+              serialized.size(), start_time);
+    connection.Complete(socket, sequence, std::move(serialized));
+    return;
+  }
+
+  if (sequence == connection.next_to_write) {
+    ++connection.next_to_write;
+    const HttpResponse response = Respond(request);
+    http_metrics_.RecordResponse(response.status_code());
+    const std::uint64_t handled_time = MonotonicNanoseconds();
+    latency_metrics_.Record(RequestPhase::Handle, handled_time - parsed_time);
+    const std::string_view common_fields = CommonFields();
+
+    if (const auto& file_body = response.file_body()) {
+      response_buffer_.clear();
+      response.SerializeHeaderTo(response_buffer_, common_fields);
+      const std::uint64_t serialized_time = MonotonicNanoseconds();
+      latency_metrics_.Record(RequestPhase::Serialize,
+                              serialized_time - handled_time);
+      if (file_body->size == 0) {
+        LogAccess(connection.peer, request, response.status_code(),
+                  response_buffer_.size(), start_time);
+        socket.Write(response_buffer_, RecordWrite(serialized_time));
+        return;
+      }
+      LogAccess(connection.peer, request, response.status_code(),
+                response_buffer_.size() + file_body->size, start_time);
+      socket.Write(response_buffer_);
+      socket.SendFile(file_body->file->fd(), file_body->offset,
+                      file_body->size,
+                      [this, serialized_time, file = file_body->file] {
+                        latency_metrics_.Record(
+                            RequestPhase::Write,
+                            MonotonicNanoseconds() - serialized_time);
+                      });
+      return;
+    }
+
+    if (!response.file_body_parts().empty()) {
+      response_buffer_.clear();
+      response.SerializeHeaderTo(response_buffer_, common_fields);
+      const std::uint64_t serialized_time = MonotonicNanoseconds();
+      latency_metrics_.Record(RequestPhase::Serialize,
+                              serialized_time - handled_time);
+      LogAccess(connection.peer, request, response.status_code(),
+                response.SerializedSize(common_fields), start_time);
+      socket.Write(response_buffer_);
+      SendFileBodyParts(socket, response.file_body_parts(),
+                        RecordWrite(serialized_time));
+      return;
+    }
+
+    const auto& prepared = response.prepared();
+    if (prepared && response.header_fields().empty()) {
+      latency_metrics_.Record(RequestPhase::Serialize, 0);
+      const std::array<ByteArrayView, 3> parts = {
+          prepared->status_line(),
+          ByteArrayView(
+              reinterpret_cast<const std::byte*>(common_fields.data()),
+              common_fields.size()),
+          response.prepared_tail()};
+      LogAccess(connection.peer, request, response.status_code(),
+                parts[0].size() + parts[1].size() + parts[2].size(),
+                start_time);
+      socket.Write(parts, RecordWrite(handled_time));
+      return;
+    }
+
+    response_buffer_.clear();
+    response.SerializeTo(response_buffer_, common_fields);
+    const std::uint64_t serialized_time = MonotonicNanoseconds();
+    latency_metrics_.Record(RequestPhase::Serialize,
+                            serialized_time - handled_time);
+    LogAccess(connection.peer, request, response.status_code(),
+              response_buffer_.size(), start_time);
+    socket.Write(response_buffer_, RecordWrite(serialized_time));
+    return;
+  }
+
+  const HttpResponse response = Respond(request);
+  http_metrics_.RecordResponse(response.status_code());
+  const std::uint64_t handled_time = MonotonicNanoseconds();
+  latency_metrics_.Record(RequestPhase::Handle, handled_time - parsed_time);
+  ByteArray serialized = response.Serialize(CommonFields());
+  latency_metrics_.Record(RequestPhase::Serialize,
+                          MonotonicNanoseconds() - handled_time);
+  LogAccess(connection.peer, request, response.status_code(),
+            serialized.size(), start_time);
+  connection.Complete(socket, sequence, std::move(serialized));
+}
+
+template <class Handler>
+void BasicHttpServer<Handler>::LogAccess(const PeerAddress& peer,
+                                         const HttpRequest& request,
+                                         HttpStatusCode status_code,
+                                         std::size_t bytes,
+                                         std::uint64_t start_time) {
+  if (access_log_ == nullptr) {
+    return;
+  }
+
+  AccessRecord record;
+  record.time = UnixNanoseconds();
+  record.duration = MonotonicNanoseconds() - start_time;
+  record.bytes = bytes;
+  record.method = METHOD_NAMES[static_cast<std::size_t>(request.method())];
+  record.version = SerializeVersion(request.version());
+  record.peer = peer;
+  record.status = static_cast<std::uint16_t>(status_code);
+  record.SetPath(request.path());
+  access_log_->TryLog(record);
+}
+
+template <class Handler>
+auto BasicHttpServer<Handler>::RecordWrite(
+    std::uint64_t serialized_time) -> CallBack {
+  return [this, serialized_time] {
+    latency_metrics_.Record(RequestPhase::Write,
+                            MonotonicNanoseconds() - serialized_time);
+  };
+}
+
+template <class Handler>
+void BasicHttpServer<Handler>::SendFileBodyParts(
+    const Socket& socket, const std::vector<FileBodyPart>& parts,
+    CallBack on_written) {
+  for (std::size_t index = 0; index < parts.size(); ++index) {
+    const FileBodyPart& part = parts[index];
+    CallBack callback =
+        index + 1 == parts.size() ? std::move(on_written) : nullptr;
+    const ByteArrayView prefix(
+        reinterpret_cast<const std::byte*>(part.prefix.data()),
+        part.prefix.size());
+    if (part.file.size == 0) {
+      socket.Write(prefix, std::move(callback));
+      continue;
+    }
+
+    if (!prefix.empty()) {
+      socket.Write(prefix);
+    }
+    socket.SendFile(part.file.file->fd(), part.file.offset, part.file.size,
+                    [file = part.file.file, callback = std::move(callback)] {
+                      if (callback) {
+                        callback();
+                      }
+                    });
+  }
+}
+
+template <class Handler>
+HttpResponse BasicHttpServer<Handler>::Respond(const HttpRequest& request) {
+  HttpResponse response = [this, &request] {
+    if (metrics_path_ && request.method() == HttpMethod::Get &&
+        request.target().path() == *metrics_path_) {
+      return MetricsResponse();
+    }
+    if constexpr (requires { typename Handler::StaticRoutes; }) {
+      auto routed = Handler::StaticRoutes::Dispatch(request, handler());
+      if (routed) {
+        return std::move(*routed);
+      }
+    }
+    return handler().OnRequest(request);
+  }();
+  if (compression_) {
+    CompressResponse(request, response, *compression_);
+  }
+  // Handlers reached through HEAD, e.g. GET routes, may build the full
+  // response, which must not carry its body
+  if (request.method() == HttpMethod::Head) {
+    response.OmitBody();
+  }
+  return response;
+}
+
+template <class Handler>
+HttpResponse BasicHttpServer<Handler>::MetricsResponse() const {
+  std::string text;
+  WriteMetrics(text);
+  return MakeMetricsResponse(text);
+}
+
+template <class Handler>
+std::string_view BasicHttpServer<Handler>::CommonFields() noexcept {
+  common_fields_.Update(this->loop_time());
+  return common_fields_.lines();
+}
+
+template <class Handler>
+bool BasicHttpServer<Handler>::IsOffloaded(const HttpRequest& request) {
+  // Detected through a non-const Handler, so that a non-const overload is
+  // rejected rather than silently never called
+  if constexpr (requires(Handler& offloading_handler) {
+                  offloading_handler.ShouldOffload(request);
+                }) {
+    static_assert(
+        requires(const Handler& offloading_handler) {
+          offloading_handler.ShouldOffload(request);
+        },
+        "Handler::ShouldOffload must be const, it runs on the event loop "
+        "while workers call OnRequest");
+    return worker_pool_ &&
+           static_cast<const Handler&>(handler()).ShouldOffload(request);
+  } else {
+    return false;
+  }
+}
+
+template <class Handler>
+bool BasicHttpServer<Handler>::Offload(const Socket& socket,
+                                       std::uint64_t connection_id,
+                                       std::uint64_t sequence,
+                                       const HttpRequest& request,
+                                       std::uint64_t start_time) {
+  // The body still points into the parser buffer, which is reused as soon as
+  // this request has been dispatched.
+  ByteArray body =
+      request.body() ? ByteArray(request.body().value()) : ByteArray{};
+
+  // Workers must not touch the loop's cache, they get a snapshot instead
+  return worker_pool_->TrySubmit([this, socket, connection_id, sequence,
+                                  start_time, request = HttpRequest(request),
+                                  body = std::move(body),
+                                  common_fields =
+                                      std::string(CommonFields())]() mutable {
+    if (request.body()) {
+      request.SetBody(body);
+    }
+
+    std::optional<ByteArray> response;
+    auto status_code = HttpStatusCode::InternalServerError;
+    std::uint64_t handle_duration = 0;
+    std::uint64_t serialize_duration = 0;
+    try {
+      const std::uint64_t picked_time = MonotonicNanoseconds();
+      const HttpResponse handled = Respond(request);
+      status_code = handled.status_code();
+      const std::uint64_t handled_time = MonotonicNanoseconds();
+      response = handled.Serialize(common_fields);
+      handle_duration = handled_time - picked_time;
+      serialize_duration = MonotonicNanoseconds() - handled_time;
+    } catch (const HttpSerializeError& serialize_error) {
+      std::cerr << "HTTP response serialize failed: " << serialize_error.what()
+                << std::endl;
+    }
+
+    // The request goes back to the loop for the access log, which must not
+    // read its body, as that stays with this task
+    this->Post([this, socket, connection_id, sequence, start_time,
+                status_code, handle_duration, serialize_duration,
+                request = std::move(request),
+                response = std::move(response)]() mutable {
+      const auto connection_iterator =
+          connection_table.find(socket.socket_fd());
+      const bool connected = connection_iterator != connection_table.end() &&
+                             connection_iterator->second.id == connection_id;
+      if (response) {
+        http_metrics_.RecordResponse(status_code);
+        latency_metrics_.Record(RequestPhase::Handle, handle_duration);
+        latency_metrics_.Record(RequestPhase::Serialize, serialize_duration);
+        LogAccess(connected ? connection_iterator->second.peer
+                            : PeerAddress{},
+                  request, status_code, response->size(), start_time);
+      }
+      if (!connected) {
+        // Connection was closed while the request was being handled
+        return;
+      }
+
+      if (!response) {
+        socket.Close();
+        return;
+      }
+
+      connection_iterator->second.Complete(socket, sequence,
+                                           std::move(response.value()));
+    });
+  });
+}
+
+// Run-time polymorphic server built on BasicHttpServer
+class HttpServer : public BasicHttpServer<HttpServer> {
+  friend BasicHttpServer<HttpServer>;
+
  public:
   explicit HttpServer(std::uint16_t port);
+  virtual ~HttpServer();
 
  protected:
   virtual HttpResponse OnRequest(const HttpRequest& request) = 0;
 
- private:
-  void OnData(const Socket& socket, const ByteArrayView& data) override;
-  void OnClose(const Socket& socket) override;
-
-  std::unordered_map<int, HttpRequestParser> parser_table;
+  // Opt-in for CPU-heavy routes, evaluated on the event loop thread.
+  [[nodiscard]] virtual bool ShouldOffload(const HttpRequest& request) const;
 };
 
 }  // namespace http1
@@ -0,0 +1,169 @@
+#ifndef HTTP1_HTTP_TOKENIZER_HPP
+#define HTTP1_HTTP_TOKENIZER_HPP
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace http1 {
+
+// Character classes of RFC 9110 used by the tokenizer, as bit flags
+enum CharClass : std::uint8_t {
+  TOKEN_CHAR = 1U << 0U,        // tchar, allowed in methods and field names
+  FIELD_VALUE_CHAR = 1U << 1U,  // VCHAR and obs-text
+  WHITESPACE_CHAR = 1U << 2U,   // SP and HTAB
+  TARGET_CHAR = 1U << 3U        // VCHAR, allowed in the request-target
+};
+
+constexpr std::array<std::uint8_t, 256> MakeCharClassTable() {
+  std::array<std::uint8_t, 256> table{};
+  constexpr std::string_view TOKEN_SYMBOLS = "!#$%&'*+-.^_`|~";
+
+  for (std::size_t character = 0; character < table.size(); ++character) {
+    std::uint8_t char_class = 0;
+    const bool is_alpha = (character >= 'a' && character <= 'z') ||
+                          (character >= 'A' && character <= 'Z');
+    const bool is_digit = character >= '0' && character <= '9';
+    if (is_alpha || is_digit ||
+        TOKEN_SYMBOLS.find(static_cast<char>(character)) !=
+            std::string_view::npos) {
+      char_class |= TOKEN_CHAR;
+    }
+    if ((character > 0x20 && character < 0x7F) || character >= 0x80) {
+      char_class |= FIELD_VALUE_CHAR;
+    }
+    if (character > 0x20 && character < 0x7F) {
+      char_class |= TARGET_CHAR;
+    }
+    if (character == ' ' || character == '\t') {
+      char_class |= WHITESPACE_CHAR;
+    }
+    table.at(character) = char_class;
+  }
+
+  return table;
+}
+
+constexpr std::array<char, 256> MakeLowercaseTable() {
+  std::array<char, 256> table{};
+  for (std::size_t character = 0; character < table.size(); ++character) {
+    const bool is_upper = character >= 'A' && character <= 'Z';
+    table.at(character) =
+        static_cast<char>(is_upper ? character + ('a' - 'A') : character);
+  }
+  return table;
+}
+
+inline constexpr std::array<std::uint8_t, 256> CHAR_CLASS_TABLE =
+    MakeCharClassTable();
+inline constexpr std::array<char, 256> LOWERCASE_TABLE = MakeLowercaseTable();
+
+[[nodiscard]] constexpr std::uint8_t ClassOf(char character) noexcept {
+  return CHAR_CLASS_TABLE[static_cast<unsigned char>(character)];
+}
+
+// Compares text to an already lowercase string, ignoring the case of text
+[[nodiscard]] constexpr bool EqualsLowercase(std::string_view lowercase,
+                                             std::string_view text) noexcept {
+  if (lowercase.size() != text.size()) {
+    return false;
+  }
+  for (std::size_t index = 0; index < text.size(); ++index) {
+    if (LOWERCASE_TABLE[static_cast<unsigned char>(text[index])] !=
+        lowercase[index]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Strips optional whitespace (SP and HTAB) from both ends of text
+[[nodiscard]] constexpr std::string_view TrimWhitespace(
+    std::string_view text) noexcept {
+  while (!text.empty() && (ClassOf(text.front()) & WHITESPACE_CHAR) != 0) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && (ClassOf(text.back()) & WHITESPACE_CHAR) != 0) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+// Packs up to 8 bytes of token into an integer, first byte in the lowest
+// bits, so that short tokens can be matched with a single compare.
+constexpr std::uint64_t PackToken(std::string_view token) noexcept {
+  std::uint64_t packed = 0;
+  for (std::size_t index = 0; index < token.size() && index < 8; ++index) {
+    const auto byte = static_cast<unsigned char>(token[index]);
+    packed |= static_cast<std::uint64_t>(byte) << (8 * index);
+  }
+  return packed;
+}
+
+// Loads 8 bytes from data packed the same way as PackToken
+inline std::uint64_t LoadPacked(const char* data) noexcept {
+  std::uint64_t packed = 0;
+  std::memcpy(&packed, data, sizeof(packed));
+  if constexpr (std::endian::native == std::endian::big) {
+    packed = __builtin_bswap64(packed);
+  }
+  return packed;
+}
+
+// Position of a token inside the tokenized header
+struct TokenRange {
+  std::size_t offset = 0;
+  std::size_t size = 0;
+
+  [[nodiscard]] inline std::string_view In(
+      std::string_view header) const noexcept {
+    return header.substr(offset, size);
+  }
+};
+
+struct RequestLineTokens {
+  TokenRange method;
+  TokenRange target;
+  TokenRange version;
+};
+
+struct FieldTokens {
+  TokenRange name;
+  TokenRange value;
+};
+
+// Defined with HttpParseError in http_server.hpp
+enum class HttpParseErrorKind;
+
+// Single pass tokenizer for a request header ending with an empty line.
+// Every byte is classified once through CHAR_CLASS_TABLE, invalid bytes
+// raise HttpParseError.
+class HttpTokenizer {
+ public:
+  explicit HttpTokenizer(std::string_view header) noexcept;
+
+  RequestLineTokens ParseRequestLine();
+
+  // Tokenizes the next field line and stores its name, lowercased, into
+  // lowercase_name. Returns false once the empty line ending the header has
+  // been reached.
+  bool NextField(FieldTokens& tokens, std::string& lowercase_name);
+
+ private:
+  // Advances over bytes of char_class and returns their range
+  TokenRange Scan(std::uint8_t char_class) noexcept;
+  bool Skip(char expected) noexcept;
+  // Advances over CRLF, or throws an HttpParseError of kind
+  void ExpectLineEnd(HttpParseErrorKind kind);
+
+  std::string_view header_;
+  std::size_t position_ = 0;
+};
+
+}  // namespace http1
+
+#endif
\ No newline at end of file
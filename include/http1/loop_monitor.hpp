@@ -0,0 +1,147 @@
+#ifndef HTTP1_LOOP_MONITOR_HPP
+#define HTTP1_LOOP_MONITOR_HPP
+
+#include <pthread.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "metrics.hpp"
+
+namespace http1 {
+
+// Progress of one event loop, written by the loop thread and readable from
+// any thread, e.g. of a Watchdog. The loop marks the start and end of every
+// iteration, so that a loop blocked in epoll_wait is idle rather than
+// stalled, and records how long iterations take.
+class LoopMonitor {
+ public:
+  // Longer paths of in-flight requests are truncated
+  static constexpr std::size_t MAX_PATH_SIZE = 128;
+
+  // Request being handled by the loop
+  struct Request {
+    std::string method;
+    std::string path;
+    std::uint64_t connection_id;
+    // MonotonicNanoseconds when handling started
+    std::uint64_t start_time;
+  };
+
+  // The following must be called from the loop thread.
+
+  void SetLoopThread() noexcept;
+
+  // Called once the loop has stopped. Waits for a signal being sent to the
+  // loop thread, and no signal is sent after it returns.
+  void ClearLoopThread() noexcept;
+
+  inline void BeginIteration() noexcept {
+    busy_since_.store(MonotonicNanoseconds(), std::memory_order_relaxed);
+  }
+
+  inline void EndIteration() noexcept {
+    const std::uint64_t busy_since =
+        busy_since_.load(std::memory_order_relaxed);
+    if (busy_since != 0) {
+      iteration_durations_.Record(MonotonicNanoseconds() - busy_since);
+      busy_since_.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Requests are only published while a Watchdog watches the loop
+  [[nodiscard]] inline bool watched() const noexcept {
+    return watched_.load(std::memory_order_relaxed);
+  }
+
+  void BeginRequest(std::string_view method, std::string_view path,
+                    std::uint64_t connection_id) noexcept;
+  void EndRequest() noexcept;
+
+  // The following are safe to call from any thread.
+
+  inline void SetWatched(bool watched) noexcept {
+    watched_.store(watched, std::memory_order_relaxed);
+  }
+
+  // MonotonicNanoseconds when the current iteration started, 0 while the
+  // loop waits for events or is not running
+  [[nodiscard]] inline std::uint64_t busy_since() const noexcept {
+    return busy_since_.load(std::memory_order_relaxed);
+  }
+
+  // Sends signal to the loop thread while the loop runs. Returns false once
+  // the loop has stopped, when the thread may be gone.
+  bool SignalLoopThread(int signal) noexcept;
+
+  // The request in flight, if any, read without blocking the loop
+  [[nodiscard]] std::optional<Request> request() const;
+
+  [[nodiscard]] inline const Histogram& iteration_durations() const noexcept {
+    return iteration_durations_;
+  }
+
+  void WriteTo(MetricsWriter& writer) const;
+
+ private:
+  static constexpr std::size_t WORD_SIZE = sizeof(std::uint64_t);
+
+  // Written by the loop, so kept apart from the lines other threads read
+  struct alignas(CACHE_LINE_SIZE) PublishedRequest {
+    // Odd while the loop is writing the fields below
+    std::atomic<std::uint64_t> sequence = 0;
+    std::atomic<std::uint64_t> start_time = 0;
+    std::atomic<std::uint64_t> connection_id = 0;
+    std::atomic<std::uint64_t> method = 0;
+    std::atomic<std::uint64_t> path_size = 0;
+    std::array<std::atomic<std::uint64_t>, MAX_PATH_SIZE / WORD_SIZE> path{};
+  };
+
+  alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> busy_since_ = 0;
+  // Held while signalling the loop thread, so that it stays alive
+  std::mutex loop_thread_mutex_;
+  std::optional<pthread_t> loop_thread_;
+  std::atomic<bool> watched_ = false;
+
+  PublishedRequest request_;
+  Histogram iteration_durations_;
+};
+
+// Publishes a request to a watched LoopMonitor for the lifetime of the
+// scope, and does nothing while no Watchdog watches the loop
+class InFlightRequest {
+ public:
+  inline InFlightRequest(LoopMonitor& monitor, std::string_view method,
+                         std::string_view path,
+                         std::uint64_t connection_id) noexcept
+      : monitor_(monitor.watched() ? &monitor : nullptr) {
+    if (monitor_ != nullptr) {
+      monitor_->BeginRequest(method, path, connection_id);
+    }
+  }
+
+  inline ~InFlightRequest() {
+    if (monitor_ != nullptr) {
+      monitor_->EndRequest();
+    }
+  }
+
+  InFlightRequest(const InFlightRequest& other) = delete;
+  InFlightRequest(InFlightRequest&& other) = delete;
+
+  InFlightRequest& operator=(const InFlightRequest& other) = delete;
+  InFlightRequest& operator=(InFlightRequest&& other) = delete;
+
+ private:
+  LoopMonitor* monitor_;
+};
+
+}  // namespace http1
+
+#endif
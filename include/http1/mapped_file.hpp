@@ -0,0 +1,52 @@
+#ifndef HTTP1_MAPPED_FILE_HPP
+#define HTTP1_MAPPED_FILE_HPP
+
+#include <sys/stat.h>
+
+#include <cstddef>
+#include <string>
+
+#include "byte_array.hpp"
+
+namespace http1 {
+
+// Regular file opened read-only and mapped into memory once. Shared through
+// std::shared_ptr by caches and by responses still being written, so that it
+// stays open until the last of them is done with it.
+class MappedFile {
+ public:
+  // Throws std::system_error when path can not be opened or mapped, and
+  // std::invalid_argument when it is not a regular file.
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile& other) = delete;
+  MappedFile(MappedFile&& other) = delete;
+
+  MappedFile& operator=(const MappedFile& other) = delete;
+  MappedFile& operator=(MappedFile&& other) = delete;
+
+  [[nodiscard]] inline int fd() const noexcept { return fd_; }
+
+  [[nodiscard]] inline ByteArrayView data() const noexcept {
+    return {static_cast<const std::byte*>(address_), size()};
+  }
+
+  [[nodiscard]] inline std::size_t size() const noexcept {
+    return static_cast<std::size_t>(status_.st_size);
+  }
+
+  // Result of fstat at the time the file was opened
+  [[nodiscard]] inline const struct stat& status() const noexcept {
+    return status_;
+  }
+
+ private:
+  int fd_ = -1;
+  void* address_ = nullptr;
+  struct stat status_ {};
+};
+
+}  // namespace http1
+
+#endif
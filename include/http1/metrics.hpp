@@ -0,0 +1,172 @@
+#ifndef HTTP1_METRICS_HPP
+#define HTTP1_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace http1 {
+
+// Metrics written by different threads live on cache lines of their own,
+// so that recording never invalidates a line another core is writing.
+inline constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+// Counter with a single writing thread, e.g. an event loop, readable from
+// any thread. Add is a relaxed load and store rather than a locked
+// read-modify-write, so recording costs about as much as incrementing a
+// plain integer.
+class Counter {
+ public:
+  inline void Add(std::uint64_t amount = 1) noexcept {
+    value_.store(value_.load(std::memory_order_relaxed) + amount,
+                 std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] inline std::uint64_t value() const noexcept {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<std::uint64_t> value_ = 0;
+};
+
+// Value that goes up and down, with a single writing thread like Counter
+class Gauge {
+ public:
+  inline void Add(std::int64_t amount) noexcept {
+    value_.store(value_.load(std::memory_order_relaxed) + amount,
+                 std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] inline std::int64_t value() const noexcept {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<std::int64_t> value_ = 0;
+};
+
+// Nanoseconds of the monotonic clock. clock_gettime is served from the vDSO
+// without entering the kernel. Unlike the coarse clocks it resolves
+// nanoseconds, and unlike raw TSC reads it needs no calibration.
+inline std::uint64_t MonotonicNanoseconds() noexcept {
+  timespec now{};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<std::uint64_t>(now.tv_sec) * 1'000'000'000U +
+         static_cast<std::uint64_t>(now.tv_nsec);
+}
+
+// Log-linear histogram in the style of HdrHistogram: values below 256 are
+// counted exactly, larger ones in 128 linear sub-buckets per power of two,
+// so every bucket is within 1% of its values. Memory is fixed, values
+// above MAX_VALUE count as MAX_VALUE. Recording is an index computation and
+// two Counter updates, with the single writer of Counter.
+class Histogram {
+ public:
+  static constexpr int SUB_BUCKET_BITS = 7;
+  static constexpr int MAX_VALUE_BITS = 36;
+  static constexpr std::uint64_t MAX_VALUE = (1ULL << MAX_VALUE_BITS) - 1;
+
+  // Two rows of sub-buckets for the exact values, one more row for every
+  // further power of two up to MAX_VALUE
+  static constexpr std::size_t BUCKET_COUNT =
+      static_cast<std::size_t>(MAX_VALUE_BITS - SUB_BUCKET_BITS + 1)
+      << SUB_BUCKET_BITS;
+
+  inline void Record(std::uint64_t value) noexcept {
+    value = value < MAX_VALUE ? value : MAX_VALUE;
+    counts_[IndexOf(value)].Add();
+    sum_.Add(value);
+  }
+
+  static constexpr std::size_t IndexOf(std::uint64_t value) noexcept {
+    const int width = std::bit_width(value);
+    const int shift = width > SUB_BUCKET_BITS + 1
+                          ? width - SUB_BUCKET_BITS - 1
+                          : 0;
+    return (static_cast<std::size_t>(shift) << SUB_BUCKET_BITS) +
+           static_cast<std::size_t>(value >> shift);
+  }
+
+  // Largest value counted in the bucket at index
+  static constexpr std::uint64_t HighestValueOf(std::size_t index) noexcept {
+    constexpr std::size_t SUB_BUCKET_COUNT = std::size_t{1} << SUB_BUCKET_BITS;
+    if (index < 2 * SUB_BUCKET_COUNT) {
+      return index;
+    }
+    const std::size_t shift = index / SUB_BUCKET_COUNT - 1;
+    const std::uint64_t sub_bucket = index - shift * SUB_BUCKET_COUNT;
+    return ((sub_bucket + 1) << shift) - 1;
+  }
+
+ private:
+  friend class HistogramSnapshot;
+
+  std::array<Counter, BUCKET_COUNT> counts_;
+  Counter sum_;
+};
+
+// Counts of one or more Histograms, read without stopping their writers,
+// e.g. of every event loop
+class HistogramSnapshot {
+ public:
+  HistogramSnapshot() : counts_(Histogram::BUCKET_COUNT) {}
+
+  // Adds the current counts of histogram
+  void Merge(const Histogram& histogram) noexcept;
+
+  [[nodiscard]] inline std::uint64_t count() const noexcept { return count_; }
+  [[nodiscard]] inline std::uint64_t sum() const noexcept { return sum_; }
+
+  // Smallest value, up to the bucket precision, that quantile, e.g. 0.99,
+  // of the values do not exceed. 0 without values.
+  [[nodiscard]] std::uint64_t ValueAtQuantile(double quantile) const noexcept;
+
+ private:
+  std::vector<std::uint64_t> counts_;
+  std::uint64_t count_ = 0;
+  std::uint64_t sum_ = 0;
+};
+
+// Appends metrics in the Prometheus text exposition format 0.0.4
+class MetricsWriter {
+ public:
+  static constexpr std::string_view CONTENT_TYPE =
+      "text/plain; version=0.0.4; charset=utf-8";
+
+  explicit MetricsWriter(std::string& output) noexcept : output_(output) {}
+
+  // Starts a family of samples, type is "counter", "gauge", "summary" or
+  // "histogram"
+  void Family(std::string_view name, std::string_view type,
+              std::string_view help);
+
+  // Writes a sample line. labels are formatted already, e.g.
+  // method="GET",class="2xx", and may be empty.
+  void Sample(std::string_view name, std::string_view labels,
+              std::uint64_t value);
+  void Sample(std::string_view name, std::string_view labels,
+              std::int64_t value);
+  void Sample(std::string_view name, std::string_view labels, double value);
+
+  // Writes the median, 99th and 99.9th percentile and the _sum and _count
+  // samples of a summary of nanoseconds, converted to seconds. A snapshot
+  // keeps quantiles and count consistent while the histograms are written.
+  void Summary(std::string_view name, std::string_view labels,
+               const HistogramSnapshot& snapshot);
+
+ private:
+  void SampleName(std::string_view name, std::string_view labels);
+
+  std::string& output_;
+};
+
+}  // namespace http1
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef HTTP1_METRICS_SERVER_HPP
+#define HTTP1_METRICS_SERVER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "http_server.hpp"
+
+namespace http1 {
+
+// Serves metrics on a port of its own, e.g. one not exposed to clients,
+// with an event loop of its own: run Start on a separate thread. source
+// appends the metrics for every scrape, e.g. through WriteMetrics of the
+// servers to observe, which is safe from this thread.
+class MetricsServer : public BasicHttpServer<MetricsServer> {
+  friend BasicHttpServer<MetricsServer>;
+
+ public:
+  using Source = std::function<void(std::string& output)>;
+
+  MetricsServer(std::uint16_t port, Source source);
+
+ private:
+  HttpResponse OnRequest(const HttpRequest& request);
+
+  Source source_;
+};
+
+}  // namespace http1
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef HTTP1_MPSC_QUEUE_HPP
+#define HTTP1_MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace http1 {
+
+// Unbounded lock-free multiple-producer single-consumer queue (Vyukov's
+// node based design). Push may be called from any thread, Pop only from the
+// owning consumer thread.
+template <class T>
+class MpscQueue {
+ public:
+  MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+  ~MpscQueue() {
+    while (Pop()) {
+    }
+    if (tail_ != &stub_) {
+      delete tail_;
+    }
+  }
+
+  MpscQueue(const MpscQueue& other) = delete;
+  MpscQueue(MpscQueue&& other) = delete;
+
+  MpscQueue& operator=(const MpscQueue& other) = delete;
+  MpscQueue& operator=(MpscQueue&& other) = delete;
+
+  void Push(T value) {
+    auto* node = new Node{.next = nullptr, .value = std::move(value)};
+    Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+  }
+
+  std::optional<T> Pop() {
+    Node* tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      return std::nullopt;
+    }
+
+    std::optional<T> result = std::move(next->value);
+    next->value.reset();
+    tail_ = next;
+    if (tail != &stub_) {
+      delete tail;
+    }
+
+    return result;
+  }
+
+ private:
+  struct Node {
+    std::atomic<Node*> next;
+    std::optional<T> value;
+  };
+
+  Node stub_{.next = nullptr, .value = std::nullopt};
+  std::atomic<Node*> head_;
+  Node* tail_;
+};
+
+}  // namespace http1
+
+#endif
\ No newline at end of file
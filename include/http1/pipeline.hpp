@@ -0,0 +1,175 @@
+#ifndef HTTP1_PIPELINE_HPP
+#define HTTP1_PIPELINE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "http_server.hpp"
+
+namespace http1 {
+
+// Middleware composed at compile time, e.g.
+//   Pipeline<RequestId, Cors, Gzip, Router>
+// Every layer but the last provides
+//   template <class Next>
+//   HttpResponse Handle(const HttpRequest& request, Next next);
+// and either returns a response of its own, short-circuiting the layers
+// after it, or calls next(request) and may change the response it returns.
+// The last layer provides HttpResponse Handle(const HttpRequest&) or, like
+// Router and VirtualHosts, HttpResponse Dispatch(const HttpRequest&). Next
+// is a pointer-sized type naming the following layer, so the whole chain is
+// statically bound and inlines into one call without allocating.
+//
+// Layers are called concurrently from event loops and worker threads and
+// must be thread-safe.
+template <class... Layers>
+class Pipeline {
+  static_assert(sizeof...(Layers) > 0, "Pipelines need a last layer");
+
+ public:
+  Pipeline() = default;
+  explicit Pipeline(Layers... layers) : layers_(std::move(layers)...) {}
+
+  inline HttpResponse Handle(const HttpRequest& request) {
+    return Call<0>(request);
+  }
+
+  // The layer of type Layer, e.g. to add routes to a Router
+  template <class Layer>
+  [[nodiscard]] inline Layer& layer() noexcept {
+    return std::get<Layer>(layers_);
+  }
+
+  template <std::size_t Index>
+  [[nodiscard]] inline auto& layer() noexcept {
+    return std::get<Index>(layers_);
+  }
+
+ private:
+  static constexpr std::size_t LAST = sizeof...(Layers) - 1;
+
+  // Calls the layers from Index on
+  template <std::size_t Index>
+  class Next {
+   public:
+    explicit Next(Pipeline& pipeline) noexcept : pipeline_(&pipeline) {}
+
+    inline HttpResponse operator()(const HttpRequest& request) const {
+      return pipeline_->template Call<Index>(request);
+    }
+
+   private:
+    Pipeline* pipeline_;
+  };
+
+  template <std::size_t Index>
+  inline HttpResponse Call(const HttpRequest& request) {
+    auto& current = std::get<Index>(layers_);
+    if constexpr (Index < LAST) {
+      return current.Handle(request, Next<Index + 1>(*this));
+    } else if constexpr (requires { current.Handle(request); }) {
+      return current.Handle(request);
+    } else {
+      return current.Dispatch(request);
+    }
+  }
+
+  std::tuple<Layers...> layers_;
+};
+
+// Tags every response with the x-request-id of its request, or with a new
+// random id when the request has none or an invalid one, so that logs of
+// proxies, the server and clients can be correlated.
+class RequestId {
+ public:
+  static constexpr std::string_view FIELD_NAME = "x-request-id";
+  static constexpr std::size_t MAX_SIZE = 64;
+
+  template <class Next>
+  HttpResponse Handle(const HttpRequest& request, Next next) const {
+    HttpResponse response = next(request);
+    response.AddField(HeaderField{.name = std::string(FIELD_NAME),
+                                  .value = Of(request)});
+    return response;
+  }
+
+  // Id of request: its x-request-id when that has at most MAX_SIZE
+  // characters out of letters, digits, "-", "_", ".", ":", otherwise 16
+  // random hex digits
+  static std::string Of(const HttpRequest& request);
+};
+
+struct CorsOptions {
+  // Origins allowed to read responses, e.g. "https://example.com". Empty
+  // allows every origin.
+  std::vector<std::string> allowed_origins;
+  std::string allowed_methods = "GET, HEAD, POST";
+  std::string allowed_headers = "content-type";
+  // Seconds for which clients may cache a preflight response
+  std::uint32_t max_age = 600;
+  // Lets requests with cookies or authorization read responses
+  bool allow_credentials = false;
+};
+
+// Cross-origin resource sharing (Fetch standard section 3.2). Preflight
+// requests of allowed origins are answered with 204 No Content without
+// reaching later layers, other requests of allowed origins get the
+// access-control fields added to their response. Requests of other origins
+// pass through unchanged, so browsers withhold their responses.
+class Cors {
+ public:
+  Cors() = default;
+  explicit Cors(CorsOptions options);
+
+  template <class Next>
+  HttpResponse Handle(const HttpRequest& request, Next next) const {
+    const auto origin = request.FindField("origin");
+    if (!origin) {
+      return next(request);
+    }
+    const bool allowed = IsAllowed(*origin);
+    if (allowed && IsPreflight(request)) {
+      return Preflight(*origin);
+    }
+
+    HttpResponse response = next(request);
+    AddFields(*origin, allowed, response);
+    return response;
+  }
+
+ private:
+  [[nodiscard]] bool IsAllowed(std::string_view origin) const noexcept;
+  static bool IsPreflight(const HttpRequest& request) noexcept;
+  [[nodiscard]] HttpResponse Preflight(std::string_view origin) const;
+  void AddFields(std::string_view origin, bool allowed,
+                 HttpResponse& response) const;
+
+  CorsOptions options_;
+};
+
+// Gzips the responses of later layers through CompressResponse, for servers
+// that compress only some routes rather than calling EnableCompression
+class Gzip {
+ public:
+  Gzip() = default;
+  explicit Gzip(CompressionOptions options) : options_(options) {}
+
+  template <class Next>
+  HttpResponse Handle(const HttpRequest& request, Next next) const {
+    HttpResponse response = next(request);
+    CompressResponse(request, response, options_);
+    return response;
+  }
+
+ private:
+  CompressionOptions options_;
+};
+
+}  // namespace http1
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef HTTP1_ROUTER_HPP
+#define HTTP1_ROUTER_HPP
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+#include "http_server.hpp"
+
+namespace http1 {
+
+struct RouteParam {
+  std::string_view name;
+  std::string_view value;
+};
+
+// Values captured by the {name} and *name segments of a matched route. They
+// view the router and the request path, which must outlive them.
+class RouteParams {
+ public:
+  static constexpr std::size_t MAX_PARAMS = 8;
+
+  // Value of the parameter called name, or std::nullopt
+  [[nodiscard]] std::optional<std::string_view> Find(
+      std::string_view name) const noexcept;
+
+  [[nodiscard]] inline std::size_t size() const noexcept { return size_; }
+
+  [[nodiscard]] inline const RouteParam* begin() const noexcept {
+    return params_.data();
+  }
+
+  [[nodiscard]] inline const RouteParam* end() const noexcept {
+    return std::next(params_.data(), static_cast<std::ptrdiff_t>(size_));
+  }
+
+ private:
+  friend class Router;
+
+  std::array<RouteParam, MAX_PARAMS> params_{};
+  std::size_t size_ = 0;
+};
+
+enum class RouteStatus { Found, NotFound, MethodNotAllowed };
+
+// Dispatches requests by path and method through a compressed radix tree,
+// so that matching costs are proportional to the length of the path, not
+// to the number of routes.
+//
+// Patterns start with "/" and consist of literal text, {name} segments
+// matching one non-empty path segment and a final *name segment matching
+// the rest of the path, e.g. "/users/{id}/posts" or "/static/*path".
+// Literal text is preferred over a parameter and a parameter over a
+// wildcard, falling back to the next when the more specific branch does not
+// lead to a route. The query is ignored and captured values are not
+// percent-decoded. HEAD requests are dispatched to the GET handler unless a
+// HEAD handler is added, the server then leaves out the body it builds.
+class Router {
+ public:
+  using Handler =
+      std::function<HttpResponse(const HttpRequest&, const RouteParams&)>;
+
+  struct Match {
+    RouteStatus status;
+    const Handler* handler;  // set when found
+    // Value of the allow field, e.g. "GET, HEAD", unless not found
+    std::string_view allow;
+  };
+
+  Router();
+  ~Router();
+
+  Router(const Router& other) = delete;
+  Router(Router&& other) noexcept;
+
+  Router& operator=(const Router& other) = delete;
+  Router& operator=(Router&& other) noexcept;
+
+  // Throws std::invalid_argument for malformed patterns, more than
+  // RouteParams::MAX_PARAMS parameters, a parameter named differently than
+  // one at the same position of another pattern, and routes added twice.
+  void Add(HttpMethod method, std::string_view pattern, Handler handler);
+
+  // Finds the route for method and the path part of target. params receives
+  // the captured values, also when the method is not allowed.
+  Match Find(HttpMethod method, std::string_view target,
+             RouteParams& params) const;
+
+  // Calls the handler of the matching route, or answers with 404 Not Found,
+  // or with 405 Method Not Allowed and an allow field.
+  HttpResponse Dispatch(const HttpRequest& request) const;
+
+ private:
+  struct Endpoint;
+  struct Node;
+
+  // Inserts literal text below node, splitting nodes at the first byte
+  // their prefix differs, and returns the node at its end
+  static Node* InsertLiteral(Node* node, std::string_view text);
+  static const Node* Lookup(const Node& node, std::string_view rest,
+                            RouteParams& params) noexcept;
+
+  std::unique_ptr<Node> root_;
+};
+
+}  // namespace http1
+
+#endif
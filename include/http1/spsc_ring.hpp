@@ -0,0 +1,84 @@
+#ifndef HTTP1_SPSC_RING_HPP
+#define HTTP1_SPSC_RING_HPP
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+#include "metrics.hpp"
+
+namespace http1 {
+
+// Bounded lock-free single-producer single-consumer ring buffer. TryPush may
+// only be called from one producer thread and TryPop from one consumer
+// thread. Both indices keep growing and are masked into the slots, the
+// producer and consumer side each live on a cache line of their own and
+// cache the other side's index, so that they only touch the shared line
+// when the ring looks full or empty.
+template <class T>
+class SpscRing {
+ public:
+  // capacity is rounded up to a power of two
+  explicit SpscRing(std::size_t capacity)
+      : slots_(std::bit_ceil(capacity < 2 ? 2 : capacity)),
+        mask_(slots_.size() - 1) {}
+
+  SpscRing(const SpscRing& other) = delete;
+  SpscRing(SpscRing&& other) = delete;
+
+  SpscRing& operator=(const SpscRing& other) = delete;
+  SpscRing& operator=(SpscRing&& other) = delete;
+
+  // Returns false without copying value when the ring is full
+  bool TryPush(const T& value) noexcept {
+    const std::size_t head = producer_.head.load(std::memory_order_relaxed);
+    if (head - producer_.cached_tail == slots_.size()) {
+      producer_.cached_tail = consumer_.tail.load(std::memory_order_acquire);
+      if (head - producer_.cached_tail == slots_.size()) {
+        return false;
+      }
+    }
+    slots_[head & mask_] = value;
+    producer_.head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false without touching value when the ring is empty
+  bool TryPop(T& value) noexcept {
+    const std::size_t tail = consumer_.tail.load(std::memory_order_relaxed);
+    if (tail == consumer_.cached_head) {
+      consumer_.cached_head = producer_.head.load(std::memory_order_acquire);
+      if (tail == consumer_.cached_head) {
+        return false;
+      }
+    }
+    value = slots_[tail & mask_];
+    consumer_.tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  [[nodiscard]] inline std::size_t capacity() const noexcept {
+    return slots_.size();
+  }
+
+ private:
+  struct alignas(CACHE_LINE_SIZE) Producer {
+    std::atomic<std::size_t> head = 0;
+    std::size_t cached_tail = 0;
+  };
+
+  struct alignas(CACHE_LINE_SIZE) Consumer {
+    std::atomic<std::size_t> tail = 0;
+    std::size_t cached_head = 0;
+  };
+
+  Producer producer_;
+  Consumer consumer_;
+  std::vector<T> slots_;
+  const std::size_t mask_;
+};
+
+}  // namespace http1
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef HTTP1_STATIC_FILE_HANDLER_HPP
+#define HTTP1_STATIC_FILE_HANDLER_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "content_coding.hpp"
+#include "http_server.hpp"
+#include "mapped_file.hpp"
+#include "tcp_server.hpp"
+
+namespace http1 {
+
+// MIME type of a file extension such as "html", looked up case-insensitively
+// in a perfect hash table built at compile time. Unknown extensions map to
+// application/octet-stream.
+std::string_view MimeTypeOf(std::string_view extension) noexcept;
+
+struct StaticFileOptions {
+  // Number of open files kept in the cache
+  std::size_t cache_capacity = 1024;
+
+  // A cached file is checked with stat at most once per interval
+  std::chrono::milliseconds revalidate_interval{1000};
+
+  // Served for request paths naming a directory
+  std::string index_file = "index.html";
+};
+
+// Serves the files below document_root for request paths starting with
+// prefix. Files are kept open and mapped in a bounded LRU cache together with
+// their pre-serialized response header, and bodies are sent with sendfile.
+// Every file gets a strong ETag from a hash of its content, and requests
+// whose If-None-Match or If-Modified-Since matches are answered with a
+// prepared 304 response. Single byte ranges are sent with sendfile from
+// the requested offset, multiple ranges as multipart/byteranges.
+// Precompressed ".gz" and ".br" siblings of a file are picked up when it is
+// loaded and served with content-encoding to clients accepting them.
+// Not thread-safe, it must be used from the event loop thread only.
+class StaticFileHandler {
+ public:
+  StaticFileHandler(std::string prefix, std::string document_root,
+                    StaticFileOptions options = {});
+  ~StaticFileHandler();
+
+  StaticFileHandler(const StaticFileHandler& other) = delete;
+  StaticFileHandler(StaticFileHandler&& other) = delete;
+
+  StaticFileHandler& operator=(const StaticFileHandler& other) = delete;
+  StaticFileHandler& operator=(StaticFileHandler&& other) = delete;
+
+  // Evicts cached files as soon as inotify reports a change to them, through
+  // an inotify fd watched by loop, and stops revalidating them with stat.
+  // The next request loads the new content while responses already being
+  // written keep the old file. Call from the loop thread or before Start;
+  // loop must outlive the handler.
+  void WatchChanges(TcpServerCore& loop);
+
+  // Returns std::nullopt for request paths outside of prefix
+  std::optional<HttpResponse> Handle(const HttpRequest& request);
+
+  [[nodiscard]] inline std::size_t cache_size() const noexcept {
+    return cache_index_.size();
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  // The file itself or one of its precompressed siblings
+  struct Representation {
+    ContentCoding coding;
+    std::shared_ptr<const MappedFile> file;
+    HeaderTemplate header;
+    // 206 header with a content-range and a content-length slot
+    HeaderTemplate partial_header;
+    // etag and last-modified, followed by content-encoding and vary when
+    // the file has precompressed siblings
+    HeaderFields fields;
+    PreparedResponse not_modified;
+  };
+
+  struct CachedFile {
+    std::string key;
+    std::string full_path;
+    std::string_view content_type;
+    // Identity first, then the siblings smaller than it
+    std::vector<Representation> representations;
+    Clock::time_point validated_at;
+  };
+
+  using CacheList = std::list<CachedFile>;
+
+  // Writes the percent-decoded path below document_root into
+  // relative_path_. Returns false for paths outside of prefix or escaping
+  // document_root.
+  bool ResolvePath(std::string_view target);
+  const CachedFile* Lookup(Clock::time_point now);
+  bool Revalidate(CachedFile& cached_file, Clock::time_point now) const;
+  std::optional<CachedFile> Load(Clock::time_point now);
+  static Representation MakeRepresentation(
+      ContentCoding coding, std::shared_ptr<const MappedFile> file,
+      std::string_view content_type, bool negotiated);
+  static const Representation& Negotiate(const CachedFile& cached_file,
+                                         const HttpRequest& request) noexcept;
+  void Evict(const std::string& key);
+  void EvictBelow(std::string_view directory_key);
+
+  void AddDirectoryWatch(const std::string& directory_key);
+  void ReadChanges();
+
+  std::string prefix_;
+  std::string document_root_;
+  StaticFileOptions options_;
+
+  CacheList cache_;
+  std::unordered_map<std::string, CacheList::iterator> cache_index_;
+
+  // Reused for every request, so that cache hits do not allocate
+  std::string relative_path_;
+
+  TcpServerCore* loop_ = nullptr;
+  int inotify_fd_ = -1;
+  // Watch descriptor to the key of the watched directory
+  std::unordered_map<int, std::string> watched_directories_;
+};
+
+}  // namespace http1
+
+#endif
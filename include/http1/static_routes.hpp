@@ -0,0 +1,310 @@
+#ifndef HTTP1_STATIC_ROUTES_HPP
+#define HTTP1_STATIC_ROUTES_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "http_server.hpp"
+
+namespace http1 {
+
+// String literal usable as a template argument, e.g. in Route<"/health", ...>
+template <std::size_t N>
+struct RoutePath {
+  // NOLINTNEXTLINE(google-explicit-constructor,hicpp-explicit-conversions)
+  constexpr RoutePath(const char (&text)[N]) noexcept {
+    std::copy_n(text, N, data);
+  }
+
+  [[nodiscard]] constexpr std::string_view view() const noexcept {
+    return {data, N - 1};
+  }
+
+  char data[N]{};
+};
+
+// Route fully known at compile time. Handler is a function taking the
+// request, or a function or member function pointer taking the arguments
+// passed to StaticRouteTable::Dispatch followed by the request, e.g.
+//   Route<"/health", HttpMethod::Get, &Server::Health>
+template <RoutePath Path, HttpMethod Method, auto Handler>
+struct Route {
+  static_assert(Path.view().starts_with('/'), "Route paths start with /");
+  static_assert(Method != HttpMethod::Unknown, "Invalid route method");
+
+  static constexpr std::string_view path = Path.view();
+  static constexpr HttpMethod method = Method;
+  static constexpr auto handler = Handler;
+};
+
+// Exact-match dispatch table for Routes, built at compile time. Paths are
+// looked up in a perfect hash table, hash and displace style: one hash of
+// the path selects a bucket, whose displacement moves the path to a slot of
+// its own, so that a lookup is one hash and one comparison with no heap
+// structures. Handlers are then called through a jump table.
+template <class... Routes>
+class StaticRouteTable {
+ public:
+  // Returns std::nullopt when no route has the path of request, ignoring
+  // the query. Otherwise calls the handler of the route for the method of
+  // request, with args when it accepts them, or answers with 405 Method Not
+  // Allowed and an allow field. GET handlers also answer HEAD unless a HEAD
+  // route is added, the server then leaves out the body they build.
+  template <class... Args>
+  static std::optional<HttpResponse> Dispatch(const HttpRequest& request,
+                                              Args&... args);
+
+ private:
+  static constexpr std::size_t ROUTE_COUNT = sizeof...(Routes);
+  static constexpr std::size_t METHOD_COUNT = METHOD_NAMES.size();
+  static constexpr std::uint16_t NONE = 0xFFFF;
+  // At most half full, with two slots per bucket
+  static constexpr std::size_t TABLE_SIZE = std::bit_ceil(2 * ROUTE_COUNT);
+  static constexpr std::size_t BUCKET_COUNT = TABLE_SIZE / 2;
+  static constexpr std::uint64_t MAX_SEED = 64;
+
+  static_assert(ROUTE_COUNT > 0 && ROUTE_COUNT < NONE);
+
+  struct PathEntry {
+    std::string_view path;
+    // Index into Routes by method, or NONE
+    std::array<std::uint16_t, METHOD_COUNT> routes;
+  };
+
+  struct Paths {
+    std::array<PathEntry, ROUTE_COUNT> entries;
+    std::size_t size;
+    bool has_duplicates;
+  };
+
+  struct HashTable {
+    std::uint64_t seed;  // 0 when no perfect hash was found
+    std::array<std::uint16_t, BUCKET_COUNT> displacements;
+    // Index into Paths::entries, or NONE
+    std::array<std::uint16_t, TABLE_SIZE> slots;
+  };
+
+  // FNV-1a mixed with seed, followed by the MurmurHash3 finalizer
+  static constexpr std::uint64_t Hash(std::string_view path,
+                                      std::uint64_t seed) noexcept {
+    std::uint64_t hash =
+        14695981039346656037ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+    for (const char character : path) {
+      hash ^= static_cast<unsigned char>(character);
+      hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33U;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33U;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    return hash ^ (hash >> 33U);
+  }
+
+  static constexpr std::size_t BucketOf(std::uint64_t hash) noexcept {
+    return static_cast<std::size_t>(hash >> 32U) & (BUCKET_COUNT - 1);
+  }
+
+  static constexpr std::size_t SlotOf(std::uint64_t hash,
+                                      std::uint16_t displacement) noexcept {
+    return static_cast<std::size_t>(hash ^ displacement) & (TABLE_SIZE - 1);
+  }
+
+  static constexpr Paths CollectPaths() noexcept;
+  static constexpr HashTable BuildTable() noexcept;
+
+  template <class AnyRoute, class... Args>
+  static HttpResponse Invoke(const HttpRequest& request, Args&... args);
+
+  static HttpResponse MethodNotAllowed(const PathEntry& entry);
+
+  static constexpr Paths PATHS = CollectPaths();
+  static_assert(!PATHS.has_duplicates, "Route added twice");
+
+  static constexpr HashTable TABLE = BuildTable();
+  static_assert(TABLE.seed != 0, "No perfect hash for the route paths");
+};
+
+template <class... Routes>
+constexpr auto StaticRouteTable<Routes...>::CollectPaths() noexcept -> Paths {
+  constexpr std::array<std::string_view, ROUTE_COUNT> ROUTE_PATHS = {
+      Routes::path...};
+  constexpr std::array<HttpMethod, ROUTE_COUNT> ROUTE_METHODS = {
+      Routes::method...};
+
+  // Sorted by path, so that the routes of a path are adjacent
+  std::array<std::uint16_t, ROUTE_COUNT> order{};
+  for (std::size_t route = 0; route < ROUTE_COUNT; ++route) {
+    order.at(route) = static_cast<std::uint16_t>(route);
+  }
+  std::sort(order.begin(), order.end(),
+            [&ROUTE_PATHS](std::uint16_t lhs, std::uint16_t rhs) {
+              return ROUTE_PATHS.at(lhs) < ROUTE_PATHS.at(rhs);
+            });
+
+  Paths paths{};
+  for (std::size_t position = 0; position < ROUTE_COUNT; ++position) {
+    const std::uint16_t route = order.at(position);
+    if (position == 0 ||
+        ROUTE_PATHS.at(order.at(position - 1)) != ROUTE_PATHS.at(route)) {
+      PathEntry& entry = paths.entries.at(paths.size++);
+      entry.path = ROUTE_PATHS.at(route);
+      entry.routes.fill(NONE);
+    }
+
+    std::uint16_t& method_route = paths.entries.at(paths.size - 1)
+                                      .routes.at(static_cast<std::size_t>(
+                                          ROUTE_METHODS.at(route)));
+    paths.has_duplicates = paths.has_duplicates || method_route != NONE;
+    method_route = route;
+  }
+
+  for (std::size_t index = 0; index < paths.size; ++index) {
+    auto& routes = paths.entries.at(index).routes;
+    std::uint16_t& head = routes.at(static_cast<std::size_t>(HttpMethod::Head));
+    if (head == NONE) {
+      head = routes.at(static_cast<std::size_t>(HttpMethod::Get));
+    }
+  }
+  return paths;
+}
+
+template <class... Routes>
+constexpr auto StaticRouteTable<Routes...>::BuildTable() noexcept
+    -> HashTable {
+  for (std::uint64_t seed = 1; seed <= MAX_SEED; ++seed) {
+    HashTable table{};
+    table.seed = seed;
+    table.slots.fill(NONE);
+
+    std::array<std::uint64_t, ROUTE_COUNT> hashes{};
+    std::array<std::size_t, BUCKET_COUNT> bucket_sizes{};
+    std::array<std::uint16_t, ROUTE_COUNT> order{};
+    for (std::size_t index = 0; index < PATHS.size; ++index) {
+      hashes.at(index) = Hash(PATHS.entries.at(index).path, seed);
+      ++bucket_sizes.at(BucketOf(hashes.at(index)));
+      order.at(index) = static_cast<std::uint16_t>(index);
+    }
+
+    // Paths grouped by bucket, the largest buckets are placed first
+    std::sort(order.begin(), std::next(order.begin(), PATHS.size),
+              [&hashes, &bucket_sizes](std::uint16_t lhs, std::uint16_t rhs) {
+                const std::size_t lhs_bucket = BucketOf(hashes.at(lhs));
+                const std::size_t rhs_bucket = BucketOf(hashes.at(rhs));
+                if (bucket_sizes.at(lhs_bucket) !=
+                    bucket_sizes.at(rhs_bucket)) {
+                  return bucket_sizes.at(lhs_bucket) >
+                         bucket_sizes.at(rhs_bucket);
+                }
+                return lhs_bucket < rhs_bucket;
+              });
+
+    bool placed_all = true;
+    std::size_t begin = 0;
+    while (placed_all && begin < PATHS.size) {
+      const std::size_t bucket = BucketOf(hashes.at(order.at(begin)));
+      const std::size_t end = begin + bucket_sizes.at(bucket);
+
+      // Smallest displacement moving every path of the bucket to a free slot
+      bool placed = false;
+      for (std::size_t displacement = 0; !placed && displacement < TABLE_SIZE;
+           ++displacement) {
+        const auto slot_of = [&hashes, &order, displacement](
+                                 std::size_t position) {
+          return SlotOf(hashes.at(order.at(position)),
+                        static_cast<std::uint16_t>(displacement));
+        };
+        placed = true;
+        for (std::size_t position = begin; placed && position < end;
+             ++position) {
+          placed = table.slots.at(slot_of(position)) == NONE;
+          for (std::size_t other = begin; placed && other < position;
+               ++other) {
+            placed = slot_of(other) != slot_of(position);
+          }
+        }
+        if (placed) {
+          table.displacements.at(bucket) =
+              static_cast<std::uint16_t>(displacement);
+          for (std::size_t position = begin; position < end; ++position) {
+            table.slots.at(slot_of(position)) = order.at(position);
+          }
+        }
+      }
+      placed_all = placed;
+      begin = end;
+    }
+
+    if (placed_all) {
+      return table;
+    }
+  }
+  return HashTable{};
+}
+
+template <class... Routes>
+template <class... Args>
+std::optional<HttpResponse> StaticRouteTable<Routes...>::Dispatch(
+    const HttpRequest& request, Args&... args) {
+  const std::string_view path = request.target().path();
+  const std::uint64_t hash = Hash(path, TABLE.seed);
+  const std::uint16_t index =
+      TABLE.slots[SlotOf(hash, TABLE.displacements[BucketOf(hash)])];
+  if (index == NONE || PATHS.entries[index].path != path) {
+    return std::nullopt;
+  }
+
+  const PathEntry& entry = PATHS.entries[index];
+  const std::uint16_t route =
+      entry.routes[static_cast<std::size_t>(request.method())];
+  if (route == NONE) {
+    return MethodNotAllowed(entry);
+  }
+
+  static constexpr std::array<HttpResponse (*)(const HttpRequest&, Args&...),
+                              ROUTE_COUNT>
+      HANDLERS = {&Invoke<Routes, Args...>...};
+  return HANDLERS[route](request, args...);
+}
+
+template <class... Routes>
+template <class AnyRoute, class... Args>
+HttpResponse StaticRouteTable<Routes...>::Invoke(const HttpRequest& request,
+                                                 Args&... args) {
+  if constexpr (std::is_invocable_r_v<HttpResponse, decltype(AnyRoute::handler),
+                                      Args&..., const HttpRequest&>) {
+    return std::invoke(AnyRoute::handler, args..., request);
+  } else {
+    return std::invoke(AnyRoute::handler, request);
+  }
+}
+
+template <class... Routes>
+HttpResponse StaticRouteTable<Routes...>::MethodNotAllowed(
+    const PathEntry& entry) {
+  std::string allow;
+  for (std::size_t method = 1; method < METHOD_COUNT; ++method) {
+    if (entry.routes.at(method) != NONE) {
+      if (!allow.empty()) {
+        allow.append(", ");
+      }
+      allow.append(METHOD_NAMES.at(method));
+    }
+  }
+
+  HttpResponse response(HttpStatusCode::MethodNotAllowed);
+  response.AddField(HeaderField{.name = "allow", .value = std::move(allow)});
+  response.SetContentLength(0);
+  return response;
+}
+
+}  // namespace http1
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef HTTP1_TARGET_HPP
+#define HTTP1_TARGET_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace http1 {
+
+// Name and value of a query parameter, still percent-encoded
+struct QueryParam {
+  std::string_view name;
+  std::string_view value;
+};
+
+// Parameters of a query such as "a=1&b=2", split lazily while iterating.
+// Empty parameters are skipped and a parameter without "=" has an empty
+// value.
+class QueryParams {
+ public:
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = QueryParam;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const QueryParam*;
+    using reference = const QueryParam&;
+
+    Iterator() noexcept = default;
+
+    inline reference operator*() const noexcept { return param_; }
+    inline pointer operator->() const noexcept { return &param_; }
+
+    Iterator& operator++() noexcept;
+    Iterator operator++(int) noexcept;
+
+    inline bool operator==(const Iterator& other) const noexcept {
+      return rest_.data() == other.rest_.data() &&
+             param_.name.data() == other.param_.name.data();
+    }
+
+   private:
+    friend class QueryParams;
+
+    explicit Iterator(std::string_view query) noexcept;
+
+    QueryParam param_;
+    // Query after the current parameter
+    std::string_view rest_;
+  };
+
+  explicit QueryParams(std::string_view query) noexcept : query_(query) {}
+
+  [[nodiscard]] inline Iterator begin() const noexcept {
+    return Iterator(query_);
+  }
+
+  [[nodiscard]] inline Iterator end() const noexcept { return {}; }
+
+  // Encoded value of the first parameter whose encoded name is name
+  [[nodiscard]] std::optional<std::string_view> Find(
+      std::string_view name) const noexcept;
+
+ private:
+  std::string_view query_;
+};
+
+// View of a request-target in origin-form, e.g. "/search?q=a+b", split into
+// path and query on demand. Nothing is copied or decoded.
+class Target {
+ public:
+  explicit constexpr Target(std::string_view target) noexcept
+      : target_(target) {}
+
+  // Target up to the "?"
+  [[nodiscard]] constexpr std::string_view path() const noexcept {
+    return target_.substr(0, target_.find('?'));
+  }
+
+  // Target after the "?", empty without a query
+  [[nodiscard]] constexpr std::string_view query() const noexcept {
+    const std::size_t separator = target_.find('?');
+    return separator == std::string_view::npos
+               ? std::string_view()
+               : target_.substr(separator + 1);
+  }
+
+  [[nodiscard]] constexpr bool has_query() const noexcept {
+    return target_.find('?') != std::string_view::npos;
+  }
+
+  [[nodiscard]] inline QueryParams query_params() const noexcept {
+    return QueryParams(query());
+  }
+
+  [[nodiscard]] constexpr std::string_view text() const noexcept {
+    return target_;
+  }
+
+ private:
+  std::string_view target_;
+};
+
+// Length of the prefix of text without "%", nor "+" when plus_as_space is
+// set, scanning 8 bytes at a time
+std::size_t FindEscape(std::string_view text, bool plus_as_space) noexcept;
+
+// Decodes %XX escapes, and "+" into a space when plus_as_space is set as in
+// queries of HTML forms, into output, which may be encoded itself for
+// in-place decoding. Returns the decoded text inside output, or
+// std::nullopt for malformed escapes or when output is smaller than
+// encoded. Runs without escapes are copied as a whole.
+std::optional<std::string_view> PercentDecode(std::string_view encoded,
+                                              std::span<char> output,
+                                              bool plus_as_space) noexcept;
+
+// How a path normalizer treats an encoded slash, "%2F"
+enum class EncodedSlash {
+  Keep,    // stays encoded, as part of its segment
+  Decode,  // separates segments like "/"
+  Reject   // makes the path invalid
+};
+
+struct PathOptions {
+  EncodedSlash encoded_slash = EncodedSlash::Keep;
+  // Collapses empty segments, e.g. "/a//b" to "/a/b"
+  bool collapse_slashes = true;
+};
+
+enum class PathStatus { Normal, Normalized, Invalid };
+
+struct NormalizedPath {
+  PathStatus status;
+  std::size_t size;  // of the normalized path at the start of the buffer
+};
+
+// Normalizes an absolute path, without query, in place: escapes of
+// unreserved characters are decoded and the hex digits of the others
+// uppercased (RFC 3986 section 6.2.2), dot segments are removed (section
+// 5.2.4), with ".." never leaving the root, and empty segments collapsed
+// as configured. Paths not starting with "/", e.g. "*", are left alone.
+// Paths that are already normal are recognized in a single scan without
+// writing. Malformed escapes make the path invalid.
+NormalizedPath NormalizePath(std::span<char> path,
+                             const PathOptions& options = {}) noexcept;
+
+}  // namespace http1
+
+#endif
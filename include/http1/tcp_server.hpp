@@ -1,92 +1,350 @@
 #ifndef HTTP1_TCP_SERVER_HPP
 #define HTTP1_TCP_SERVER_HPP
 
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
 #include <array>
+#include <atomic>
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
+#include <ctime>
 #include <functional>
 #include <optional>
 #include <ostream>
 #include <queue>
+#include <span>
 #include <streambuf>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include "byte_array.hpp"
+#include "loop_monitor.hpp"
+#include "metrics.hpp"
+#include "mpsc_queue.hpp"
 
 namespace http1 {
 
-class TcpServer {
+// Counters of one event loop, written by the loop thread only
+struct alignas(CACHE_LINE_SIZE) TcpMetrics {
+  Counter accepted_connections;
+  Counter closed_connections;
+  Gauge active_connections;
+  Counter received_bytes;
+  Counter sent_bytes;
+  // Writes the socket buffer could not take whole
+  Counter partial_writes;
+  // Bytes waiting in write queues for the socket buffer to drain
+  Gauge queued_write_bytes;
+  // Returns of epoll_wait and the ready events they reported
+  Counter wakeups;
+  Counter events;
+
+  void WriteTo(MetricsWriter& writer) const;
+};
+
+// Event loop, listening socket and write queues shared by every TCP server.
+// Dispatching received data to the application is left to BasicTcpServer.
+class TcpServerCore {
  public:
   static constexpr std::size_t DEFAULT_BUFFER_SIZE = 2048;
+  static constexpr std::size_t MAX_WRITE_PARTS = 8;
 
-  explicit TcpServer(std::uint16_t port,
-                     std::size_t receive_buffer_size = DEFAULT_BUFFER_SIZE);
-  virtual ~TcpServer();
+  using CallBack = std::function<void()>;
+  using WatchCallBack = std::function<void(std::uint32_t events)>;
 
-  TcpServer(const TcpServer& other) = delete;
-  TcpServer(TcpServer&& other) = delete;
+  TcpServerCore(const TcpServerCore& other) = delete;
+  TcpServerCore(TcpServerCore&& other) = delete;
 
-  TcpServer& operator=(const TcpServer& other) = delete;
-  TcpServer& operator=(TcpServer&& other) = delete;
+  TcpServerCore& operator=(const TcpServerCore& other) = delete;
+  TcpServerCore& operator=(TcpServerCore&& other) = delete;
 
-  void Start();
+  // Makes Start return after the current loop iteration. Safe to call from
+  // any thread.
+  void Stop();
 
- protected:
-  using CallBack = std::function<void()>;
+  // Runs task on the event loop thread. Safe to call from any thread.
+  void Post(CallBack task);
+
+  // The following must be called from the event loop thread, or before
+  // Start.
+
+  // Runs task at the end of the current loop iteration, after all ready
+  // events have been handled.
+  void Defer(CallBack task);
+
+  // Adds fd to the loop's epoll set and calls callback with the ready epoll
+  // event flags. The caller keeps ownership of fd.
+  void Watch(int fd, std::uint32_t events, WatchCallBack callback);
+  void Unwatch(int fd);
+
+  // Wall clock seconds sampled once per loop iteration from the coarse
+  // clock, cheap enough to be read for every request.
+  [[nodiscard]] inline std::time_t loop_time() const noexcept {
+    return loop_time_;
+  }
+
+  // Readable from any thread
+  [[nodiscard]] inline const TcpMetrics& tcp_metrics() const noexcept {
+    return tcp_metrics_;
+  }
+
+  // Iteration progress of the loop, e.g. for a Watchdog
+  [[nodiscard]] inline LoopMonitor& loop_monitor() noexcept {
+    return loop_monitor_;
+  }
+  [[nodiscard]] inline const LoopMonitor& loop_monitor() const noexcept {
+    return loop_monitor_;
+  }
+
+  // Port of the listening socket, the one picked by the kernel for port 0.
+  // Valid once the loop has started.
+  [[nodiscard]] std::uint16_t port() const;
 
   class Socket {
-    friend TcpServer;
+    friend TcpServerCore;
 
    public:
-    void Write(const ByteArrayView& data,
-               const std::optional<CallBack>& callback = std::nullopt) const;
-    void Close() const;
+    inline void Write(const ByteArrayView& data) const {
+      server_.TryWrite(socket_fd_, data, nullptr);
+    }
+
+    // Calls callback once all of data has been handed to the kernel
+    inline void Write(const ByteArrayView& data, CallBack callback) const {
+      server_.TryWrite(socket_fd_, data, std::move(callback));
+    }
+
+    // Writes up to MAX_WRITE_PARTS parts back to back with a single gather
+    // write, so they need not be copied into one buffer first.
+    inline void Write(std::span<const ByteArrayView> parts) const {
+      server_.TryWrite(socket_fd_, parts, nullptr);
+    }
+
+    // Calls callback once all of parts have been handed to the kernel
+    inline void Write(std::span<const ByteArrayView> parts,
+                      CallBack callback) const {
+      server_.TryWrite(socket_fd_, parts, std::move(callback));
+    }
+
+    // Sends size bytes of file_fd starting at offset with sendfile, after
+    // every earlier write. file_fd must stay open until callback has been
+    // called or destroyed, e.g. by capturing its owner.
+    inline void SendFile(int file_fd, std::size_t offset, std::size_t size,
+                         CallBack callback) const {
+      server_.TrySendFile(socket_fd_,
+                          FileRange{.fd = file_fd, .offset = offset,
+                                    .size = size},
+                          std::move(callback));
+    }
+
+    inline void Close() const { server_.AddToCloseQueue(socket_fd_); }
 
     [[nodiscard]] inline int socket_fd() const noexcept { return socket_fd_; }
 
    private:
-    Socket(int socket_fd, TcpServer& server);
+    inline Socket(int socket_fd, TcpServerCore& server)
+        : socket_fd_(socket_fd), server_(server) {}
+
     int socket_fd_;
 
-    TcpServer& server_;
+    TcpServerCore& server_;
   };
 
-  virtual void OnData(const Socket& socket, const ByteArrayView& data) = 0;
-  virtual void OnClose(const Socket& socket) = 0;
+ protected:
+  static constexpr int MAX_EPOLL_EVENTS = 64;
+
+  explicit TcpServerCore(std::uint16_t port,
+                         std::size_t receive_buffer_size = DEFAULT_BUFFER_SIZE);
+  // Servers are destroyed through their most derived type only
+  ~TcpServerCore();
+
+  inline Socket MakeSocket(int socket_fd) noexcept {
+    return Socket(socket_fd, *this);
+  }
+
+  void Listen();
+  int WaitForEvents(std::array<epoll_event, MAX_EPOLL_EVENTS>& event_list);
+
+  // Handles events of the listening socket, the wakeup fd and watched fds.
+  // Returns false for client sockets.
+  bool HandleLoopEvent(const epoll_event& event);
+
+  void ContinueWrite(int socket_fd);
+  void CloseSocket(int socket_fd);
+  void AddToCloseQueue(int socket_fd);
+  void RunDeferredTasks();
+  void RemoveUnwatched();
+
+  bool running_ = false;
+
+  ByteArray receive_buffer = {};
+  std::queue<int> close_queue;
+
+  TcpMetrics tcp_metrics_;
+  LoopMonitor loop_monitor_;
 
  private:
+  struct Watcher {
+    WatchCallBack callback;
+    bool active;
+  };
+
+  struct FileRange {
+    int fd;
+    std::size_t offset;
+    std::size_t size;
+  };
+
+  // Writes either data or, when set, file
   struct WriteTask {
     ByteArray data;
     std::size_t written_size;
-    std::optional<CallBack> callback;
+    CallBack callback;
+    std::optional<FileRange> file = std::nullopt;
   };
 
+  enum class WriteStatus { Done, Blocked, Failed };
+
   static void SetNonBlocking(int socket_fd);
   void AddEvent(int socket_fd, std::uint32_t event_flags,
                 bool update = false) const;
-  void LoopEvents();
   void AcceptNewClients();
-  void ReceiveData(int socket_fd);
-  void CloseSocket(int socket_fd);
-  void AddToCloseQueue(int socket_fd);
-  void ConsumeCloseQueue();
-  void TryWrite(int socket_fd, const ByteArrayView& data,
-                const std::optional<CallBack>& callback = std::nullopt);
-
-  void ContinueWrite(int socket_fd);
+  void TryWrite(int socket_fd, const ByteArrayView& data, CallBack callback);
+  void TryWrite(int socket_fd, std::span<const ByteArrayView> parts,
+                CallBack callback);
+  void QueueWrite(int socket_fd, ByteArray data, std::size_t written_size,
+                  CallBack callback);
+  void TrySendFile(int socket_fd, FileRange file, CallBack callback);
+  static std::size_t RemainingSize(const WriteTask& task) noexcept;
+  WriteStatus WriteSome(int socket_fd, WriteTask& task);
+  void FlushWriteQueue(int socket_fd, std::queue<WriteTask>& task_queue);
+  void RunPostedTasks();
 
   const std::uint16_t port_;
+  std::time_t loop_time_ = 0;
 
   int server_fd_ = -1;
   int epoll_fd_ = -1;
+  int event_fd_ = -1;
 
-  ByteArray receive_buffer = {};
-  std::queue<int> close_queue;
+  MpscQueue<CallBack> posted_tasks_;
+  std::atomic<bool> wakeup_pending_ = false;
+
+  std::vector<CallBack> deferred_tasks_;
+  std::unordered_map<int, Watcher> watch_table_;
+  std::vector<int> unwatched_fds_;
 
   std::unordered_map<int, std::queue<WriteTask>> write_task_table;
 };
 
+// Statically dispatched TCP server. Derived must provide
+//   void OnData(const Socket& socket, const ByteArrayView& data);
+//   void OnClose(const Socket& socket);
+// accessible to BasicTcpServer<Derived>, which lets the compiler inline the
+// whole receive path into the event loop.
+template <class Derived>
+class BasicTcpServer : public TcpServerCore {
+ public:
+  explicit BasicTcpServer(std::uint16_t port,
+                          std::size_t receive_buffer_size = DEFAULT_BUFFER_SIZE)
+      : TcpServerCore(port, receive_buffer_size) {}
+
+  void Start() {
+    Listen();
+    LoopEvents();
+    loop_monitor_.EndIteration();
+    loop_monitor_.ClearLoopThread();
+  }
+
+ private:
+  inline Derived& derived() noexcept { return static_cast<Derived&>(*this); }
+
+  void LoopEvents();
+  void ReceiveData(int socket_fd);
+  void ConsumeCloseQueue();
+};
+
+template <class Derived>
+void BasicTcpServer<Derived>::LoopEvents() {
+  std::array<epoll_event, MAX_EPOLL_EVENTS> epoll_event_list{};
+  while (running_) {
+    const int number_of_fds = WaitForEvents(epoll_event_list);
+    for (int fd_iterator = 0; fd_iterator < number_of_fds; ++fd_iterator) {
+      const auto& current_event = epoll_event_list.at(fd_iterator);
+      if (HandleLoopEvent(current_event)) {
+        continue;
+      }
+
+      if ((current_event.events & EPOLLIN) != 0U) {
+        ReceiveData(current_event.data.fd);
+      }
+      if ((current_event.events & EPOLLOUT) != 0U) {
+        ContinueWrite(current_event.data.fd);
+      }
+
+      if ((current_event.events & EPOLLHUP) != 0U ||
+          (current_event.events & EPOLLRDHUP) != 0U) {
+        AddToCloseQueue(current_event.data.fd);
+      }
+    }
+
+    RunDeferredTasks();
+    ConsumeCloseQueue();
+    RemoveUnwatched();
+  }
+}
+
+template <class Derived>
+void BasicTcpServer<Derived>::ReceiveData(int socket_fd) {
+  while (true) {
+    const ssize_t return_value =
+        recv(socket_fd, receive_buffer.data(), receive_buffer.size(), 0);
+    if (return_value == 0) {
+      break;
+    }
+
+    if (return_value < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        AddToCloseQueue(socket_fd);
+      }
+      break;
+    }
+
+    tcp_metrics_.received_bytes.Add(static_cast<std::size_t>(return_value));
+    derived().OnData(MakeSocket(socket_fd),
+                     ByteArrayView(receive_buffer.data(),
+                                   static_cast<std::size_t>(return_value)));
+  }
+}
+
+template <class Derived>
+void BasicTcpServer<Derived>::ConsumeCloseQueue() {
+  while (!close_queue.empty()) {
+    const int socket_fd = close_queue.front();
+    close_queue.pop();
+
+    CloseSocket(socket_fd);
+    derived().OnClose(MakeSocket(socket_fd));
+  }
+}
+
+// Run-time polymorphic server built on BasicTcpServer
+class TcpServer : public BasicTcpServer<TcpServer> {
+  friend BasicTcpServer<TcpServer>;
+
+ public:
+  explicit TcpServer(std::uint16_t port,
+                     std::size_t receive_buffer_size = DEFAULT_BUFFER_SIZE);
+  virtual ~TcpServer();
+
+ protected:
+  virtual void OnData(const Socket& socket, const ByteArrayView& data) = 0;
+  virtual void OnClose(const Socket& socket) = 0;
+};
+
 }  // namespace http1
 
 #endif
\ No newline at end of file
@@ -0,0 +1,88 @@
+#ifndef HTTP1_THREAD_POOL_HPP
+#define HTTP1_THREAD_POOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+namespace http1 {
+
+// Bounded work-stealing pool for CPU-heavy work that must not run on the
+// event loop thread. Every worker owns a queue, tasks are spread over the
+// queues round-robin and idle workers steal from the back of the others.
+class ThreadPool {
+ public:
+  using Task = std::function<void()>;
+
+  struct Stats {
+    std::size_t queue_depth;
+    std::size_t queue_capacity;
+    std::uint64_t submitted;
+    std::uint64_t rejected;
+    std::uint64_t completed;
+    std::chrono::nanoseconds total_wait_time;
+    std::chrono::nanoseconds max_wait_time;
+  };
+
+  ThreadPool(std::size_t worker_count, std::size_t queue_capacity);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool& other) = delete;
+  ThreadPool(ThreadPool&& other) = delete;
+
+  ThreadPool& operator=(const ThreadPool& other) = delete;
+  ThreadPool& operator=(ThreadPool&& other) = delete;
+
+  // Returns false without queueing the task when the pool already holds
+  // queue_capacity tasks that have not been picked up by a worker.
+  [[nodiscard]] bool TrySubmit(Task task);
+
+  [[nodiscard]] Stats stats() const noexcept;
+
+  [[nodiscard]] inline std::size_t worker_count() const noexcept {
+    return workers_.size();
+  }
+
+ private:
+  struct PendingTask {
+    Task task;
+    std::chrono::steady_clock::time_point submit_time;
+  };
+
+  struct alignas(64) WorkerQueue {
+    std::mutex mutex;
+    std::deque<PendingTask> tasks;
+  };
+
+  void RunWorker(std::size_t index);
+  std::optional<PendingTask> TakeTask(std::size_t index);
+  void RecordWait(std::chrono::nanoseconds wait_time) noexcept;
+
+  const std::size_t queue_capacity_;
+
+  std::vector<WorkerQueue> queues_;
+  std::vector<std::thread> workers_;
+  std::counting_semaphore<> available_{0};
+  std::atomic<bool> stopping_ = false;
+
+  std::atomic<std::size_t> queued_ = 0;
+  std::atomic<std::size_t> next_queue_ = 0;
+
+  std::atomic<std::uint64_t> submitted_ = 0;
+  std::atomic<std::uint64_t> rejected_ = 0;
+  std::atomic<std::uint64_t> completed_ = 0;
+  std::atomic<std::uint64_t> total_wait_ns_ = 0;
+  std::atomic<std::uint64_t> max_wait_ns_ = 0;
+};
+
+}  // namespace http1
+
+#endif
\ No newline at end of file
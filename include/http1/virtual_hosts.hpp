@@ -0,0 +1,85 @@
+#ifndef HTTP1_VIRTUAL_HOSTS_HPP
+#define HTTP1_VIRTUAL_HOSTS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "http_server.hpp"
+
+namespace http1 {
+
+// Host name of a host field value, without port and trailing dot, e.g.
+// "example.com" for "Example.COM.:8080". IPv6 literals keep their brackets.
+// Returns std::nullopt for empty or malformed values.
+std::optional<std::string_view> HostNameOf(std::string_view host) noexcept;
+
+// Dispatches requests to the handler of the site named by their host field,
+// so that several sites share one server and event loop. Sites are added as
+// exact names, e.g. "example.com", or as wildcards, e.g. "*.example.com"
+// for every subdomain of example.com at any depth but not example.com
+// itself. Exact names win over wildcards and longer wildcards over shorter
+// ones. Names are compared case-insensitively through open addressing hash
+// tables that are rebuilt by Add, so a lookup hashes the host once plus
+// once per label stripped for wildcards, without allocating.
+class VirtualHosts {
+ public:
+  using Handler = std::function<HttpResponse(const HttpRequest&)>;
+
+  // Throws std::invalid_argument for empty or malformed names and names
+  // added twice.
+  void Add(std::string_view host, Handler handler);
+
+  // Handles requests whose host matches no site
+  void SetDefault(Handler handler);
+
+  // Handler of the site for a host field value, the default handler, or
+  // nullptr
+  [[nodiscard]] const Handler* Find(std::string_view host) const noexcept;
+
+  // Calls the handler of the site named by the host field of request.
+  // HTTP/1.1 requests without a host field get 400 Bad Request, requests
+  // for unknown sites without a default handler 421 Misdirected Request.
+  HttpResponse Dispatch(const HttpRequest& request) const;
+
+ private:
+  struct Site {
+    std::string name;  // lowercase, without "*." for wildcards
+    std::uint64_t hash;
+    Handler handler;
+  };
+
+  // Open addressing table with linear probing over sites
+  class SiteTable {
+   public:
+    // Throws std::invalid_argument when a site of the same name exists
+    void Add(std::string name, Handler handler);
+    [[nodiscard]] const Handler* Find(std::string_view name,
+                                      std::uint64_t hash) const noexcept;
+
+    [[nodiscard]] inline bool empty() const noexcept {
+      return sites_.empty();
+    }
+
+   private:
+    static constexpr std::uint32_t EMPTY = 0xFFFFFFFF;
+
+    void Rebuild();
+
+    std::vector<Site> sites_;
+    // Index into sites_, or EMPTY. The size is a power of two.
+    std::vector<std::uint32_t> slots_;
+  };
+
+  SiteTable exact_;
+  SiteTable wildcards_;
+  Handler default_handler_;
+};
+
+}  // namespace http1
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef HTTP1_WATCHDOG_HPP
+#define HTTP1_WATCHDOG_HPP
+
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "loop_monitor.hpp"
+
+namespace http1 {
+
+struct WatchdogOptions {
+  // Loop iterations running longer are reported as stalls
+  std::chrono::milliseconds threshold{200};
+  // Also write the stack of the stalled loop thread, captured by a handler
+  // of stack_signal running on that thread. Only one Watchdog at a time may
+  // capture stacks, and stack_signal stays ignored once it is destroyed.
+  bool capture_stack = false;
+  int stack_signal = SIGUSR2;
+};
+
+// Thread checking watched event loops every quarter of the threshold. A
+// loop whose iteration has been running for the threshold is reported once
+// per iteration to a log file descriptor, with the request it is handling,
+// the iteration durations seen so far and, optionally, its stack.
+class Watchdog {
+ public:
+  // Writes reports to fd, which stays owned by the caller and must stay
+  // open until the Watchdog is destroyed
+  explicit Watchdog(int fd, WatchdogOptions options = {});
+  ~Watchdog();
+
+  Watchdog(const Watchdog& other) = delete;
+  Watchdog(Watchdog&& other) = delete;
+
+  Watchdog& operator=(const Watchdog& other) = delete;
+  Watchdog& operator=(Watchdog&& other) = delete;
+
+  // Watches the loop of monitor, e.g. TcpServerCore::loop_monitor(), which
+  // must outlive the Watchdog. Safe to call from any thread.
+  void Watch(LoopMonitor& monitor);
+
+  // Stalls reported so far
+  [[nodiscard]] inline std::uint64_t stalls() const noexcept {
+    return stalls_.load(std::memory_order_relaxed);
+  }
+
+  // Appends a report of a loop busy for busy_time nanoseconds to output
+  static void FormatStall(const LoopMonitor& monitor, std::uint64_t busy_time,
+                          std::string& output);
+
+ private:
+  struct WatchedLoop {
+    LoopMonitor* monitor;
+    // busy_since of the last reported iteration
+    std::uint64_t reported_since;
+  };
+
+  void Run();
+  void Check(WatchedLoop& loop);
+
+  const int fd_;
+  const WatchdogOptions options_;
+
+  std::mutex mutex_;
+  std::condition_variable stop_condition_;
+  bool stopping_ = false;
+  std::vector<WatchedLoop> loops_;
+
+  std::atomic<std::uint64_t> stalls_ = 0;
+
+  std::thread thread_;
+};
+
+}  // namespace http1
+
+#endif
@@ -0,0 +1,267 @@
+#include "access_log.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <ctime>
+#include <utility>
+
+using http1::AccessLog;
+using http1::AccessLogFormat;
+using http1::AccessRecord;
+using http1::PeerAddress;
+
+namespace {
+
+constexpr std::int64_t NANOSECONDS_PER_SECOND = 1'000'000'000;
+constexpr std::int64_t NANOSECONDS_PER_MILLISECOND = 1'000'000;
+constexpr std::uint64_t NANOSECONDS_PER_MICROSECOND = 1'000;
+
+template <class Integer>
+void AppendDecimal(std::string& output, Integer value) {
+  std::array<char, 24> digits{};
+  const auto result =
+      std::to_chars(digits.data(), digits.data() + digits.size(), value);
+  output.append(digits.data(), result.ptr);
+}
+
+void AppendPadded(std::string& output, int value, int width) {
+  std::array<char, 8> digits{};
+  const auto result =
+      std::to_chars(digits.data(), digits.data() + digits.size(), value);
+  output.append(
+      static_cast<std::size_t>(std::max<std::ptrdiff_t>(
+          0, width - (result.ptr - digits.data()))),
+      '0');
+  output.append(digits.data(), result.ptr);
+}
+
+// ISO 8601 in UTC with milliseconds, e.g. 2026-10-18T09:30:00.123Z
+void AppendTime(std::string& output, std::int64_t unix_nanoseconds) {
+  const std::time_t seconds = unix_nanoseconds / NANOSECONDS_PER_SECOND;
+  std::tm calendar{};
+  gmtime_r(&seconds, &calendar);
+
+  AppendPadded(output, calendar.tm_year + 1900, 4);
+  output.push_back('-');
+  AppendPadded(output, calendar.tm_mon + 1, 2);
+  output.push_back('-');
+  AppendPadded(output, calendar.tm_mday, 2);
+  output.push_back('T');
+  AppendPadded(output, calendar.tm_hour, 2);
+  output.push_back(':');
+  AppendPadded(output, calendar.tm_min, 2);
+  output.push_back(':');
+  AppendPadded(output, calendar.tm_sec, 2);
+  output.push_back('.');
+  AppendPadded(output,
+               static_cast<int>(unix_nanoseconds % NANOSECONDS_PER_SECOND /
+                                NANOSECONDS_PER_MILLISECOND),
+               3);
+  output.push_back('Z');
+}
+
+// Appends text with quotes, backslashes and control characters escaped, as
+// \" \\ and \u00XX for JSON or \xXX for the text format
+void AppendEscaped(std::string& output, std::string_view text,
+                   AccessLogFormat format) {
+  constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+  for (const char character : text) {
+    const auto byte = static_cast<unsigned char>(character);
+    if (format == AccessLogFormat::Json && (byte == '"' || byte == '\\')) {
+      output.push_back('\\');
+      output.push_back(character);
+    } else if (byte < 0x20 || byte == 0x7f || byte == '"' || byte == '\\') {
+      output.append(format == AccessLogFormat::Json ? "\\u00" : "\\x");
+      output.push_back(HEX_DIGITS[byte >> 4]);
+      output.push_back(HEX_DIGITS[byte & 0xf]);
+    } else {
+      output.push_back(character);
+    }
+  }
+}
+
+}  // namespace
+
+PeerAddress PeerAddress::Of(int socket_fd) noexcept {
+  PeerAddress peer;
+  sockaddr_storage address{};
+  socklen_t address_size = sizeof(address);
+  if (getpeername(socket_fd, reinterpret_cast<sockaddr*>(&address),
+                  &address_size) != 0) {
+    return peer;
+  }
+
+  if (address.ss_family == AF_INET) {
+    const auto& ipv4 = reinterpret_cast<const sockaddr_in&>(address);
+    std::memcpy(peer.address.data(), &ipv4.sin_addr, sizeof(ipv4.sin_addr));
+    peer.port = ntohs(ipv4.sin_port);
+    peer.family = AF_INET;
+  } else if (address.ss_family == AF_INET6) {
+    const auto& ipv6 = reinterpret_cast<const sockaddr_in6&>(address);
+    std::memcpy(peer.address.data(), &ipv6.sin6_addr, sizeof(ipv6.sin6_addr));
+    peer.port = ntohs(ipv6.sin6_port);
+    peer.family = AF_INET6;
+  }
+  return peer;
+}
+
+void PeerAddress::AppendTo(std::string& output) const {
+  if (family != AF_INET && family != AF_INET6) {
+    output.push_back('-');
+    return;
+  }
+
+  std::array<char, INET6_ADDRSTRLEN> text{};
+  inet_ntop(family, address.data(), text.data(), text.size());
+  if (family == AF_INET6) {
+    output.push_back('[');
+  }
+  output.append(text.data());
+  if (family == AF_INET6) {
+    output.push_back(']');
+  }
+  output.push_back(':');
+  AppendDecimal(output, port);
+}
+
+void AccessRecord::SetPath(std::string_view request_path) noexcept {
+  path_size = static_cast<std::uint8_t>(
+      std::min(request_path.size(), MAX_PATH_SIZE));
+  std::copy_n(request_path.begin(), path_size, path.begin());
+}
+
+AccessLog::AccessLog(int fd, AccessLogOptions options)
+    : fd_(fd), options_(options), thread_([this] { Run(); }) {}
+
+AccessLog::~AccessLog() {
+  {
+    const std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  stop_condition_.notify_one();
+  thread_.join();
+}
+
+auto AccessLog::AddProducer() -> Producer& {
+  const std::lock_guard lock(mutex_);
+  return *producers_.emplace_back(
+      std::make_unique<Producer>(options_.ring_capacity));
+}
+
+std::uint64_t AccessLog::dropped() const {
+  const std::lock_guard lock(mutex_);
+  std::uint64_t dropped = 0;
+  for (const auto& producer : producers_) {
+    dropped += producer->dropped();
+  }
+  return dropped;
+}
+
+void AccessLog::Format(const AccessRecord& record, AccessLogFormat format,
+                       std::string& output) {
+  if (format == AccessLogFormat::Json) {
+    output.append("{\"time\":\"");
+    AppendTime(output, record.time);
+    output.append("\",\"peer\":\"");
+    record.peer.AppendTo(output);
+    output.append("\",\"method\":\"").append(record.method);
+    output.append("\",\"path\":\"");
+    AppendEscaped(output, record.path_view(), format);
+    output.append("\",\"version\":\"").append(record.version);
+    output.append("\",\"status\":");
+    AppendDecimal(output, record.status);
+    output.append(",\"bytes\":");
+    AppendDecimal(output, record.bytes);
+    output.append(",\"duration_us\":");
+    AppendDecimal(output, record.duration / NANOSECONDS_PER_MICROSECOND);
+    output.append("}\n");
+    return;
+  }
+
+  record.peer.AppendTo(output);
+  output.append(" [");
+  AppendTime(output, record.time);
+  output.append("] \"").append(record.method).append(" ");
+  AppendEscaped(output, record.path_view(), format);
+  output.append(" ").append(record.version).append("\" ");
+  AppendDecimal(output, record.status);
+  output.push_back(' ');
+  AppendDecimal(output, record.bytes);
+  output.push_back(' ');
+  AppendDecimal(output, record.duration / NANOSECONDS_PER_MICROSECOND);
+  output.push_back('\n');
+}
+
+void AccessLog::Run() {
+  buffer_.reserve(options_.batch_size);
+  while (true) {
+    // Read before draining, so that records logged before the destructor
+    // was called are written by the last round
+    bool stopping = false;
+    {
+      const std::lock_guard lock(mutex_);
+      stopping = stopping_;
+    }
+
+    if (Drain() > 0) {
+      continue;
+    }
+    Flush();
+    if (stopping) {
+      return;
+    }
+
+    std::unique_lock lock(mutex_);
+    stop_condition_.wait_for(lock, options_.poll_interval,
+                             [this] { return stopping_; });
+  }
+}
+
+std::size_t AccessLog::Drain() {
+  // Producers may be added meanwhile, their rings are reached next round
+  std::vector<Producer*> producers;
+  {
+    const std::lock_guard lock(mutex_);
+    producers.reserve(producers_.size());
+    for (const auto& producer : producers_) {
+      producers.push_back(producer.get());
+    }
+  }
+
+  std::size_t drained = 0;
+  AccessRecord record;
+  for (Producer* producer : producers) {
+    while (producer->ring_.TryPop(record)) {
+      Format(record, options_.format, buffer_);
+      ++drained;
+      if (buffer_.size() >= options_.batch_size) {
+        Flush();
+      }
+    }
+  }
+  return drained;
+}
+
+void AccessLog::Flush() {
+  std::size_t written_size = 0;
+  while (written_size < buffer_.size()) {
+    const ssize_t return_value = write(fd_, buffer_.data() + written_size,
+                                       buffer_.size() - written_size);
+    if (return_value < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // Nothing else to report the failure to, the batch is lost
+      break;
+    }
+    written_size += static_cast<std::size_t>(return_value);
+  }
+  buffer_.clear();
+}
@@ -0,0 +1,326 @@
+#include "byte_range.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "http_date.hpp"
+#include "http_tokenizer.hpp"
+
+using http1::ByteRange;
+using http1::HttpResponse;
+using http1::RangeResult;
+using http1::RangeSelection;
+
+namespace {
+
+constexpr std::string_view BYTES_UNIT = "bytes";
+constexpr std::string_view MULTIPART_BOUNDARY = "http1_b7f3c2a91e5d48a6";
+constexpr std::string_view CRLF = "\r\n";
+
+// Saturates at the maximum instead of failing, a huge position is still
+// valid syntax and just unsatisfiable
+std::optional<std::size_t> ParsePosition(std::string_view digits) noexcept {
+  if (digits.empty()) {
+    return std::nullopt;
+  }
+
+  constexpr std::size_t MAX_POSITION = std::numeric_limits<std::size_t>::max();
+  std::size_t value = 0;
+  for (const char character : digits) {
+    if (character < '0' || character > '9') {
+      return std::nullopt;
+    }
+    const auto digit = static_cast<std::size_t>(character - '0');
+    value = value > (MAX_POSITION - digit) / 10 ? MAX_POSITION
+                                                : value * 10 + digit;
+  }
+  return value;
+}
+
+void AppendText(http1::ByteArray& output, std::string_view text) {
+  output.append(reinterpret_cast<const std::byte*>(text.data()), text.size());
+}
+
+// Sorts ranges and merges overlapping or adjacent ones. Requests whose
+// ranges add up to more than the representation, which takes overlapping
+// ranges, are answered in full instead, as RFC 9110 section 14.2 allows, so
+// that repeated ranges cannot multiply the work of sending them.
+void CoalesceRanges(RangeSelection& selection, std::size_t size) {
+  std::size_t requested_size = 0;
+  for (const auto& range : selection.ranges) {
+    requested_size += range.size;
+  }
+  if (requested_size > size) {
+    selection = RangeSelection{};
+    return;
+  }
+
+  auto& ranges = selection.ranges;
+  std::sort(ranges.begin(), ranges.end(),
+            [](const ByteRange& lhs, const ByteRange& rhs) {
+              return lhs.offset < rhs.offset;
+            });
+  std::size_t merged = 0;
+  for (std::size_t index = 1; index < ranges.size(); ++index) {
+    ByteRange& last = ranges[merged];
+    const ByteRange& range = ranges[index];
+    if (range.offset <= last.offset + last.size) {
+      last.size = std::max(last.offset + last.size, range.offset + range.size) -
+                  last.offset;
+    } else {
+      ranges[++merged] = range;
+    }
+  }
+  if (!ranges.empty()) {
+    ranges.resize(merged + 1);
+  }
+}
+
+// Boundary and fields of a part of a multipart/byteranges body, preceded by
+// the CRLF ending the previous part
+std::string PartHeader(const ByteRange& range, std::size_t size,
+                       std::string_view content_type, bool first) {
+  std::string header(first ? "" : CRLF);
+  header.append("--").append(MULTIPART_BOUNDARY).append(CRLF);
+  header.append("content-type: ").append(content_type).append(CRLF);
+  header.append("content-range: ")
+      .append(http1::FormatContentRange(range, size))
+      .append(CRLF)
+      .append(CRLF);
+  return header;
+}
+
+std::string MultipartEnd() {
+  return std::string(CRLF)
+      .append("--")
+      .append(MULTIPART_BOUNDARY)
+      .append("--")
+      .append(CRLF);
+}
+
+HttpResponse MakeUnsatisfiableResponse(std::size_t size) {
+  HttpResponse response(http1::HttpStatusCode::RangeNotSatisfiable);
+  response.AddField(http1::HeaderField{
+      .name = "content-range",
+      .value = http1::FormatContentRange(std::nullopt, size)});
+  response.SetContentLength(0);
+  return response;
+}
+
+HttpResponse MakeMultipartResponse(const http1::HeaderFields& fields) {
+  HttpResponse response(http1::HttpStatusCode::PartialContent);
+  for (const auto& field : fields) {
+    response.AddField(field);
+  }
+  response.AddField(http1::HeaderField{
+      .name = "content-type",
+      .value = "multipart/byteranges; boundary=" +
+               std::string(MULTIPART_BOUNDARY)});
+  return response;
+}
+
+}  // namespace
+
+RangeSelection http1::ParseRange(std::string_view value, std::size_t size) {
+  RangeSelection selection;
+
+  const std::size_t equals = value.find('=');
+  if (equals == std::string_view::npos ||
+      !EqualsLowercase(BYTES_UNIT, TrimWhitespace(value.substr(0, equals)))) {
+    return selection;
+  }
+  value.remove_prefix(equals + 1);
+
+  std::size_t range_count = 0;
+  while (!value.empty()) {
+    const std::size_t comma = value.find(',');
+    const std::string_view range_spec = TrimWhitespace(value.substr(0, comma));
+    value.remove_prefix(comma == std::string_view::npos ? value.size()
+                                                        : comma + 1);
+    if (range_spec.empty()) {
+      // Empty list elements are allowed
+      continue;
+    }
+
+    if (++range_count > MAX_RANGES) {
+      selection.ranges.clear();
+      return selection;
+    }
+
+    const std::size_t dash = range_spec.find('-');
+    if (dash == std::string_view::npos) {
+      selection.ranges.clear();
+      return selection;
+    }
+    const auto first = ParsePosition(range_spec.substr(0, dash));
+    const auto last = ParsePosition(range_spec.substr(dash + 1));
+
+    if (!first) {
+      // Suffix range, the last suffix-length bytes
+      if (!last || dash != 0) {
+        selection.ranges.clear();
+        return selection;
+      }
+      if (*last > 0 && size > 0) {
+        const std::size_t length = std::min(*last, size);
+        selection.ranges.push_back(
+            ByteRange{.offset = size - length, .size = length});
+      }
+      continue;
+    }
+
+    if (last && *last < *first) {
+      // Invalid, which makes the whole field invalid
+      selection.ranges.clear();
+      return selection;
+    }
+    if (!last && dash + 1 != range_spec.size()) {
+      selection.ranges.clear();
+      return selection;
+    }
+    if (*first >= size) {
+      continue;
+    }
+
+    const std::size_t end = last ? std::min(*last, size - 1) + 1 : size;
+    selection.ranges.push_back(
+        ByteRange{.offset = *first, .size = end - *first});
+  }
+
+  if (range_count == 0) {
+    return selection;
+  }
+  selection.result = selection.ranges.empty() ? RangeResult::Unsatisfiable
+                                              : RangeResult::Satisfiable;
+  return selection;
+}
+
+RangeSelection http1::SelectRanges(const HttpRequest& request,
+                                   std::size_t size, std::string_view etag,
+                                   std::optional<std::time_t> last_modified) {
+  if (request.method() != HttpMethod::Get) {
+    return {};
+  }
+
+  const auto range = request.FindField("range");
+  if (!range) {
+    return {};
+  }
+
+  if (const auto if_range = request.FindField("if-range")) {
+    const std::string_view validator = TrimWhitespace(*if_range);
+    if (validator.starts_with('"') || validator.starts_with("W/")) {
+      // Weak tags never match, strong comparison is required
+      if (etag.empty() || validator != etag) {
+        return {};
+      }
+    } else {
+      const auto date = ParseHttpDate(validator);
+      if (!date || !last_modified || *date != *last_modified) {
+        return {};
+      }
+    }
+  }
+
+  RangeSelection selection = ParseRange(*range, size);
+  if (selection.result == RangeResult::Satisfiable) {
+    CoalesceRanges(selection, size);
+  }
+  return selection;
+}
+
+std::string http1::FormatContentRange(std::optional<ByteRange> range,
+                                      std::size_t size) {
+  std::string result(BYTES_UNIT);
+  if (range) {
+    result.append(" ").append(std::to_string(range->offset));
+    result.append("-").append(std::to_string(range->offset + range->size - 1));
+  } else {
+    result.append(" *");
+  }
+  return result.append("/").append(std::to_string(size));
+}
+
+HttpResponse http1::MakeRangeResponse(const RangeSelection& selection,
+                                      ByteArrayView content,
+                                      std::string_view content_type,
+                                      const HeaderFields& fields) {
+  if (selection.result != RangeResult::Satisfiable) {
+    return MakeUnsatisfiableResponse(content.size());
+  }
+
+  if (selection.ranges.size() == 1) {
+    const ByteRange range = selection.ranges.front();
+    HttpResponse response(HttpStatusCode::PartialContent);
+    for (const auto& field : fields) {
+      response.AddField(field);
+    }
+    response.AddField(HeaderField{.name = "content-type",
+                                  .value = std::string(content_type)});
+    response.AddField(
+        HeaderField{.name = "content-range",
+                    .value = FormatContentRange(range, content.size())});
+    response.SetBody(content.substr(range.offset, range.size));
+    response.SetContentLength(range.size);
+    return response;
+  }
+
+  ByteArray body;
+  for (const auto& range : selection.ranges) {
+    AppendText(body, PartHeader(range, content.size(), content_type,
+                                body.empty()));
+    body.append(content.substr(range.offset, range.size));
+  }
+  AppendText(body, MultipartEnd());
+
+  HttpResponse response = MakeMultipartResponse(fields);
+  response.SetContentLength(body.size());
+  response.SetOwnedBody(std::move(body));
+  return response;
+}
+
+HttpResponse http1::MakeRangeResponse(
+    const RangeSelection& selection,
+    const std::shared_ptr<const MappedFile>& file,
+    std::string_view content_type, const HeaderFields& fields) {
+  const std::size_t size = file->size();
+  if (selection.result != RangeResult::Satisfiable) {
+    return MakeUnsatisfiableResponse(size);
+  }
+
+  if (selection.ranges.size() == 1) {
+    const ByteRange range = selection.ranges.front();
+    HttpResponse response(HttpStatusCode::PartialContent);
+    for (const auto& field : fields) {
+      response.AddField(field);
+    }
+    response.AddField(HeaderField{.name = "content-type",
+                                  .value = std::string(content_type)});
+    response.AddField(HeaderField{
+        .name = "content-range", .value = FormatContentRange(range, size)});
+    response.SetFileBody(
+        FileBody{.file = file, .offset = range.offset, .size = range.size});
+    response.SetContentLength(range.size);
+    return response;
+  }
+
+  std::vector<FileBodyPart> parts;
+  parts.reserve(selection.ranges.size() + 1);
+  std::size_t body_size = 0;
+  for (const auto& range : selection.ranges) {
+    parts.push_back(FileBodyPart{
+        .prefix = PartHeader(range, size, content_type, parts.empty()),
+        .file = FileBody{
+            .file = file, .offset = range.offset, .size = range.size}});
+    body_size += parts.back().prefix.size() + range.size;
+  }
+  parts.push_back(FileBodyPart{
+      .prefix = MultipartEnd(),
+      .file = FileBody{.file = file, .offset = 0, .size = 0}});
+  body_size += parts.back().prefix.size();
+
+  HttpResponse response = MakeMultipartResponse(fields);
+  response.SetContentLength(body_size);
+  response.SetFileBodyParts(std::move(parts));
+  return response;
+}
@@ -0,0 +1,107 @@
+#include "content_coding.hpp"
+
+#include <optional>
+
+#include "http_tokenizer.hpp"
+
+using http1::AcceptedCodings;
+using http1::ContentCoding;
+
+namespace {
+
+constexpr std::array<std::string_view, http1::CONTENT_CODING_COUNT>
+    CODING_NAMES = {"identity", "gzip", "br"};
+constexpr std::array<std::string_view, http1::CONTENT_CODING_COUNT>
+    FILE_SUFFIXES = {"", "gz", "br"};
+
+// qvalue = ( "0" [ "." 0*3DIGIT ] ) / ( "1" [ "." 0*3("0") ] ), in
+// thousandths
+std::optional<std::uint16_t> ParseQuality(std::string_view text) noexcept {
+  if (text.empty() || (text[0] != '0' && text[0] != '1') ||
+      (text.size() > 1 && text[1] != '.') || text.size() > 5) {
+    return std::nullopt;
+  }
+
+  std::uint16_t quality = text[0] == '1' ? AcceptedCodings::MAX_QUALITY : 0;
+  std::uint16_t scale = 100;
+  for (const char character : text.substr(text.size() > 1 ? 2 : 1)) {
+    if (character < '0' || character > '9') {
+      return std::nullopt;
+    }
+    quality += static_cast<std::uint16_t>((character - '0') * scale);
+    scale /= 10;
+  }
+  if (quality > AcceptedCodings::MAX_QUALITY) {
+    return std::nullopt;
+  }
+  return quality;
+}
+
+}  // namespace
+
+std::string_view http1::NameOf(ContentCoding coding) noexcept {
+  return CODING_NAMES.at(static_cast<std::size_t>(coding));
+}
+
+std::string_view http1::FileSuffixOf(ContentCoding coding) noexcept {
+  return FILE_SUFFIXES.at(static_cast<std::size_t>(coding));
+}
+
+AcceptedCodings::AcceptedCodings() noexcept {
+  listed_.fill(UNLISTED);
+}
+
+std::uint16_t AcceptedCodings::quality(ContentCoding coding) const noexcept {
+  const std::uint16_t listed = listed_.at(static_cast<std::size_t>(coding));
+  if (listed != UNLISTED) {
+    return listed;
+  }
+  if (any_ != UNLISTED) {
+    return any_;
+  }
+  return coding == ContentCoding::Identity ? MAX_QUALITY : 0;
+}
+
+AcceptedCodings http1::ParseAcceptEncoding(std::string_view value) noexcept {
+  AcceptedCodings accepted;
+  while (!value.empty()) {
+    const std::size_t comma = value.find(',');
+    const std::string_view element = value.substr(0, comma);
+    value.remove_prefix(comma == std::string_view::npos ? value.size()
+                                                        : comma + 1);
+
+    const std::size_t semicolon = element.find(';');
+    const std::string_view coding =
+        TrimWhitespace(element.substr(0, semicolon));
+    if (coding.empty()) {
+      continue;
+    }
+
+    std::optional<std::uint16_t> quality = AcceptedCodings::MAX_QUALITY;
+    if (semicolon != std::string_view::npos) {
+      const std::string_view weight =
+          TrimWhitespace(element.substr(semicolon + 1));
+      quality = weight.size() > 2 && (weight[0] == 'q' || weight[0] == 'Q') &&
+                        weight[1] == '='
+                    ? ParseQuality(weight.substr(2))
+                    : std::nullopt;
+    }
+    if (!quality) {
+      continue;
+    }
+
+    if (coding == "*") {
+      accepted.any_ = *quality;
+      continue;
+    }
+    for (std::size_t index = 0; index < CONTENT_CODING_COUNT; ++index) {
+      // "x-gzip" is an alias of gzip
+      if (EqualsLowercase(CODING_NAMES.at(index), coding) ||
+          (index == static_cast<std::size_t>(ContentCoding::Gzip) &&
+           EqualsLowercase("x-gzip", coding))) {
+        accepted.listed_.at(index) = *quality;
+      }
+    }
+  }
+  return accepted;
+}
@@ -0,0 +1,878 @@
+#include "deflate.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+#include "hash.hpp"
+
+using http1::DeflateEncoder;
+using http1::GzipEncoder;
+
+namespace {
+
+constexpr std::size_t WINDOW_SIZE = 32768;
+constexpr std::size_t WINDOW_MASK = WINDOW_SIZE - 1;
+constexpr std::size_t MIN_MATCH = 3;
+constexpr std::size_t MAX_MATCH = 258;
+// Bytes kept ahead of the current position, so that matches of any length
+// can be found without checking for the end of input
+constexpr std::size_t MIN_LOOKAHEAD = MAX_MATCH + MIN_MATCH + 1;
+constexpr std::size_t MAX_DISTANCE = WINDOW_SIZE - MIN_LOOKAHEAD;
+// Matches of MIN_MATCH bytes farther away cost more than their literals
+constexpr std::size_t TOO_FAR = 4096;
+// Room behind the window for word-sized loads past its end
+constexpr std::size_t WINDOW_PADDING = MAX_MATCH + 8;
+
+constexpr unsigned HASH_BITS = 15;
+constexpr std::size_t HASH_SIZE = std::size_t{1} << HASH_BITS;
+constexpr std::int32_t NIL = -1;
+
+constexpr std::size_t SYMBOL_BUFFER_SIZE = 16384;
+constexpr std::size_t MAX_STORED_SIZE = 65535;
+
+constexpr std::size_t END_OF_BLOCK = 256;
+constexpr std::size_t FIRST_LENGTH_CODE = 257;
+constexpr std::size_t CODE_LENGTH_CODES = 19;
+constexpr unsigned MAX_CODE_BITS = 15;
+constexpr unsigned MAX_CODE_LENGTH_BITS = 7;
+
+// Block types of the 2-bit BTYPE field
+constexpr std::uint32_t STORED_BLOCK = 0;
+constexpr std::uint32_t FIXED_BLOCK = 1;
+constexpr std::uint32_t DYNAMIC_BLOCK = 2;
+
+struct LevelConfig {
+  std::uint16_t good_length;  // quarter the chain once a match is this long
+  std::uint16_t max_lazy;     // no lazy search, or insertion, beyond this
+  std::uint16_t nice_length;  // stop searching once a match is this long
+  std::uint16_t max_chain;
+};
+
+// zlib's tuning, which has been measured on a wide range of inputs
+constexpr std::array<LevelConfig, 10> LEVEL_CONFIGS = {{
+    {0, 0, 0, 0},
+    {4, 4, 8, 4},
+    {4, 5, 16, 8},
+    {4, 6, 32, 32},
+    {4, 4, 16, 16},
+    {8, 16, 32, 32},
+    {8, 16, 128, 128},
+    {8, 32, 128, 256},
+    {32, 128, 258, 1024},
+    {32, 258, 258, 4096},
+}};
+constexpr int LAST_GREEDY_LEVEL = 3;
+
+constexpr std::array<std::uint16_t, 29> LENGTH_BASE = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr std::array<std::uint8_t, 29> LENGTH_EXTRA_BITS = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+    2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr std::array<std::uint16_t, 30> DISTANCE_BASE = {
+    1,   2,   3,   4,   5,   7,    9,    13,   17,   25,
+    33,  49,  65,  97,  129, 193,  257,  385,  513,  769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr std::array<std::uint8_t, 30> DISTANCE_EXTRA_BITS = {
+    0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr std::array<std::uint8_t, CODE_LENGTH_CODES> CODE_LENGTH_ORDER = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Length code, minus FIRST_LENGTH_CODE, of each match length - MIN_MATCH
+constexpr auto LENGTH_CODES = [] {
+  std::array<std::uint8_t, MAX_MATCH - MIN_MATCH + 1> codes{};
+  for (std::size_t code = 0; code < LENGTH_BASE.size(); ++code) {
+    const std::size_t first = LENGTH_BASE[code] - MIN_MATCH;
+    const std::size_t count = std::size_t{1} << LENGTH_EXTRA_BITS[code];
+    for (std::size_t index = first;
+         index < first + count && index < codes.size(); ++index) {
+      codes[index] = static_cast<std::uint8_t>(code);
+    }
+  }
+  // 258 has a code of its own rather than the last of the previous one
+  codes.back() = static_cast<std::uint8_t>(LENGTH_BASE.size() - 1);
+  return codes;
+}();
+
+// Distance codes of distance - 1, directly below 256 and in steps of 128
+// from 256 on, where every code spans at least 128 distances
+constexpr auto DISTANCE_CODES = [] {
+  std::array<std::uint8_t, 512> codes{};
+  for (std::size_t code = 0; code < DISTANCE_BASE.size(); ++code) {
+    const std::size_t first = DISTANCE_BASE[code] - 1U;
+    const std::size_t count = std::size_t{1} << DISTANCE_EXTRA_BITS[code];
+    for (std::size_t distance = first; distance < first + count;
+         ++distance) {
+      codes[distance < 256 ? distance : 256 + (distance >> 7U)] =
+          static_cast<std::uint8_t>(code);
+    }
+  }
+  return codes;
+}();
+
+constexpr std::size_t DistanceCode(std::size_t distance) noexcept {
+  const std::size_t index = distance - 1;
+  return DISTANCE_CODES[index < 256 ? index : 256 + (index >> 7U)];
+}
+
+constexpr auto FIXED_LITERAL_LENGTHS = [] {
+  std::array<std::uint8_t, 288> lengths{};
+  for (std::size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+    lengths[symbol] = symbol < 144   ? 8
+                      : symbol < 256 ? 9
+                      : symbol < 280 ? 7
+                                     : 8;
+  }
+  return lengths;
+}();
+
+constexpr auto FIXED_DISTANCE_LENGTHS = [] {
+  std::array<std::uint8_t, 30> lengths{};
+  lengths.fill(5);
+  return lengths;
+}();
+
+std::uint64_t LoadWord(const std::byte* data) noexcept {
+  std::uint64_t word = 0;
+  std::memcpy(&word, data, sizeof(word));
+  if constexpr (std::endian::native == std::endian::big) {
+    word = __builtin_bswap64(word);
+  }
+  return word;
+}
+
+std::uint32_t HashOf(const std::byte* data) noexcept {
+  std::uint32_t bytes = 0;
+  std::memcpy(&bytes, data, sizeof(bytes));
+  if constexpr (std::endian::native == std::endian::big) {
+    bytes = __builtin_bswap32(bytes);
+  }
+  // Multiplicative hash of the first MIN_MATCH bytes
+  return ((bytes & 0xFFFFFFU) * 0x9E3779B1U) >> (32U - HASH_BITS);
+}
+
+// Number of equal leading bytes, compared a word at a time
+std::size_t MatchLength(const std::byte* scan, const std::byte* match,
+                        std::size_t max_length) noexcept {
+  std::size_t length = 0;
+  while (length + 8 <= max_length) {
+    const std::uint64_t difference =
+        LoadWord(std::next(scan, static_cast<std::ptrdiff_t>(length))) ^
+        LoadWord(std::next(match, static_cast<std::ptrdiff_t>(length)));
+    if (difference != 0) {
+      return length + static_cast<std::size_t>(std::countr_zero(difference)) /
+                          8;
+    }
+    length += 8;
+  }
+  while (length < max_length && scan[length] == match[length]) {
+    ++length;
+  }
+  return length;
+}
+
+// Huffman code lengths of at most max_bits for frequencies. When the
+// optimal tree is too deep, frequencies are halved until it fits, which
+// costs little since it only happens for very skewed inputs.
+void BuildCodeLengths(std::span<const std::uint32_t> frequencies,
+                      unsigned max_bits, std::span<std::uint8_t> lengths) {
+  std::vector<std::uint64_t> weights(frequencies.begin(), frequencies.end());
+
+  // Decoders expect complete codes, so at least two symbols get one
+  std::size_t used = static_cast<std::size_t>(
+      std::count_if(weights.begin(), weights.end(),
+                    [](std::uint64_t weight) { return weight != 0; }));
+  for (auto& weight : weights) {
+    if (used >= 2) {
+      break;
+    }
+    if (weight == 0) {
+      weight = 1;
+      ++used;
+    }
+  }
+
+  using Node = std::pair<std::uint64_t, std::size_t>;
+  const std::size_t leaf_count = weights.size();
+  std::vector<std::size_t> parents(2 * leaf_count);
+  std::vector<unsigned> depths(2 * leaf_count);
+
+  while (true) {
+    std::priority_queue<Node, std::vector<Node>, std::greater<>> queue;
+    for (std::size_t symbol = 0; symbol < leaf_count; ++symbol) {
+      if (weights[symbol] != 0) {
+        queue.emplace(weights[symbol], symbol);
+      }
+    }
+
+    std::size_t next_node = leaf_count;
+    while (queue.size() > 1) {
+      const Node first = queue.top();
+      queue.pop();
+      const Node second = queue.top();
+      queue.pop();
+      parents[first.second] = next_node;
+      parents[second.second] = next_node;
+      queue.emplace(first.first + second.first, next_node++);
+    }
+
+    // Parents are created after their children, so a reverse walk sees
+    // every parent's depth first
+    const std::size_t root = next_node - 1;
+    depths[root] = 0;
+    unsigned max_depth = 0;
+    for (std::size_t node = root; node-- > 0;) {
+      if (node >= leaf_count || weights[node] != 0) {
+        depths[node] = depths[parents[node]] + 1;
+        max_depth = node < leaf_count ? std::max(max_depth, depths[node])
+                                      : max_depth;
+      }
+    }
+
+    if (max_depth <= max_bits) {
+      for (std::size_t symbol = 0; symbol < leaf_count; ++symbol) {
+        lengths[symbol] =
+            weights[symbol] != 0 ? static_cast<std::uint8_t>(depths[symbol])
+                                 : 0;
+      }
+      return;
+    }
+
+    for (auto& weight : weights) {
+      weight = weight != 0 ? (weight + 1) / 2 : 0;
+    }
+  }
+}
+
+template <std::size_t N>
+std::array<std::uint16_t, N> CanonicalCodes(
+    std::span<const std::uint8_t> lengths) {
+  std::array<std::uint16_t, MAX_CODE_BITS + 1> length_counts{};
+  for (const std::uint8_t length : lengths) {
+    ++length_counts[length];
+  }
+  length_counts[0] = 0;
+
+  std::array<std::uint16_t, MAX_CODE_BITS + 1> next_codes{};
+  std::uint16_t code = 0;
+  for (unsigned bits = 1; bits <= MAX_CODE_BITS; ++bits) {
+    code = static_cast<std::uint16_t>((code + length_counts[bits - 1]) << 1U);
+    next_codes[bits] = code;
+  }
+
+  std::array<std::uint16_t, N> codes{};
+  for (std::size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+    const unsigned length = lengths[symbol];
+    if (length == 0) {
+      continue;
+    }
+    // Reversed, since codes are packed starting with their first bit
+    std::uint16_t value = next_codes[length]++;
+    std::uint16_t reversed = 0;
+    for (unsigned bit = 0; bit < length; ++bit) {
+      reversed = static_cast<std::uint16_t>((reversed << 1U) | (value & 1U));
+      value >>= 1U;
+    }
+    codes[symbol] = reversed;
+  }
+  return codes;
+}
+
+// Code length symbols 0 to 15, and 16 to 18 for runs, of the concatenated
+// literal/length and distance code lengths
+struct CodeLengthEncoding {
+  std::vector<std::pair<std::uint8_t, std::uint8_t>> symbols;  // with extra
+  std::array<std::uint32_t, CODE_LENGTH_CODES> frequencies{};
+};
+
+CodeLengthEncoding EncodeCodeLengths(std::span<const std::uint8_t> lengths) {
+  CodeLengthEncoding encoding;
+  auto add = [&encoding](std::uint8_t symbol, std::uint8_t extra) {
+    encoding.symbols.emplace_back(symbol, extra);
+    ++encoding.frequencies.at(symbol);
+  };
+
+  for (std::size_t index = 0; index < lengths.size();) {
+    const std::uint8_t length = lengths[index];
+    std::size_t run = 1;
+    while (index + run < lengths.size() && lengths[index + run] == length) {
+      ++run;
+    }
+    index += run;
+
+    if (length == 0) {
+      while (run >= 11) {
+        const std::size_t count = std::min<std::size_t>(run, 138);
+        add(18, static_cast<std::uint8_t>(count - 11));
+        run -= count;
+      }
+      if (run >= 3) {
+        add(17, static_cast<std::uint8_t>(run - 3));
+        run = 0;
+      }
+    } else {
+      add(length, 0);
+      --run;
+      while (run >= 3) {
+        const std::size_t count = std::min<std::size_t>(run, 6);
+        add(16, static_cast<std::uint8_t>(count - 3));
+        run -= count;
+      }
+    }
+    for (; run > 0; --run) {
+      add(length, 0);
+    }
+  }
+  return encoding;
+}
+
+constexpr std::array<unsigned, CODE_LENGTH_CODES> CODE_LENGTH_EXTRA_BITS =
+    [] {
+      std::array<unsigned, CODE_LENGTH_CODES> bits{};
+      bits[16] = 2;
+      bits[17] = 3;
+      bits[18] = 7;
+      return bits;
+    }();
+
+void AppendLittleEndian32(http1::ByteArray& output, std::uint32_t value) {
+  for (unsigned shift = 0; shift < 32; shift += 8) {
+    output.push_back(static_cast<std::byte>((value >> shift) & 0xFFU));
+  }
+}
+
+}  // namespace
+
+DeflateEncoder::DeflateEncoder(int level) : level_(level) {
+  if (level < MIN_LEVEL || level > MAX_LEVEL) {
+    throw std::invalid_argument("Invalid DEFLATE level");
+  }
+
+  const auto& config = LEVEL_CONFIGS.at(static_cast<std::size_t>(level));
+  good_length_ = config.good_length;
+  max_lazy_ = config.max_lazy;
+  nice_length_ = config.nice_length;
+  max_chain_ = config.max_chain;
+
+  window_.resize(2 * WINDOW_SIZE + WINDOW_PADDING);
+  if (level_ != 0) {
+    head_.assign(HASH_SIZE, NIL);
+    previous_.assign(WINDOW_SIZE, NIL);
+    symbols_.reserve(SYMBOL_BUFFER_SIZE);
+  }
+  match_length_ = MIN_MATCH - 1;
+}
+
+void DeflateEncoder::Write(ByteArrayView input, ByteArray& output) {
+  output_ = &output;
+  while (!input.empty()) {
+    std::size_t window_end = static_cast<std::size_t>(position_) + lookahead_;
+    if (window_end == 2 * WINDOW_SIZE) {
+      Slide();
+      window_end -= WINDOW_SIZE;
+    }
+
+    const std::size_t size =
+        std::min(input.size(), 2 * WINDOW_SIZE - window_end);
+    std::memcpy(std::next(window_.data(),
+                          static_cast<std::ptrdiff_t>(window_end)),
+                input.data(), size);
+    input.remove_prefix(size);
+    lookahead_ += size;
+    Compress(false);
+  }
+  output_ = nullptr;
+}
+
+void DeflateEncoder::Flush(ByteArray& output) {
+  output_ = &output;
+  Compress(true);
+  if (TalliedEnd() != block_start_) {
+    EmitBlock(false);
+  }
+  // Empty stored block, its length fields start on a byte boundary
+  PutBits(STORED_BLOCK << 1U, 3);
+  AlignToByte();
+  AppendLittleEndian32(output, 0xFFFF0000U);
+  output_ = nullptr;
+}
+
+void DeflateEncoder::Finish(ByteArray& output) {
+  output_ = &output;
+  Compress(true);
+  EmitBlock(true);
+  AlignToByte();
+  output_ = nullptr;
+}
+
+void DeflateEncoder::Compress(bool flush) {
+  if (level_ == 0) {
+    CompressStored();
+  } else if (level_ <= LAST_GREEDY_LEVEL) {
+    CompressGreedy(flush);
+  } else {
+    CompressLazy(flush);
+  }
+}
+
+void DeflateEncoder::CompressStored() {
+  position_ += static_cast<std::int32_t>(lookahead_);
+  lookahead_ = 0;
+  // Emitted before Slide could drop the start of the block
+  if (static_cast<std::size_t>(position_ - block_start_) >= WINDOW_SIZE) {
+    EmitBlock(false);
+  }
+}
+
+void DeflateEncoder::CompressGreedy(bool flush) {
+  while (lookahead_ >= MIN_LOOKAHEAD || (flush && lookahead_ > 0)) {
+    const std::int32_t chain_head =
+        lookahead_ >= MIN_MATCH ? Insert(position_) : NIL;
+    std::size_t length = 0;
+    if (chain_head != NIL &&
+        static_cast<std::size_t>(position_ - chain_head) <= MAX_DISTANCE) {
+      length = LongestMatch(chain_head, MIN_MATCH - 1);
+    }
+
+    bool full = false;
+    if (length >= MIN_MATCH) {
+      full = TallyMatch(static_cast<std::size_t>(position_ - match_start_),
+                        length);
+      lookahead_ -= length;
+      if (length <= max_lazy_ && lookahead_ >= MIN_MATCH) {
+        // Short matches are indexed completely, long ones are skipped
+        for (--length; length > 0; --length) {
+          Insert(++position_);
+        }
+        ++position_;
+      } else {
+        position_ += static_cast<std::int32_t>(length);
+      }
+    } else {
+      full = TallyLiteral(window_[static_cast<std::size_t>(position_)]);
+      ++position_;
+      --lookahead_;
+    }
+
+    if (full) {
+      EmitBlock(false);
+    }
+  }
+}
+
+void DeflateEncoder::CompressLazy(bool flush) {
+  while (lookahead_ >= MIN_LOOKAHEAD || (flush && lookahead_ > 0)) {
+    const std::int32_t chain_head =
+        lookahead_ >= MIN_MATCH ? Insert(position_) : NIL;
+
+    // A match found at the previous position is only taken when this
+    // position does not start a longer one
+    const std::size_t previous_length = match_length_;
+    const std::int32_t previous_start = match_start_;
+    match_length_ = MIN_MATCH - 1;
+    if (chain_head != NIL && previous_length < max_lazy_ &&
+        static_cast<std::size_t>(position_ - chain_head) <= MAX_DISTANCE) {
+      match_length_ = LongestMatch(chain_head, previous_length);
+      if (match_length_ == MIN_MATCH &&
+          static_cast<std::size_t>(position_ - match_start_) > TOO_FAR) {
+        match_length_ = MIN_MATCH - 1;
+      }
+    }
+
+    if (previous_length >= MIN_MATCH && match_length_ <= previous_length) {
+      const auto max_insert = static_cast<std::int32_t>(
+          static_cast<std::size_t>(position_) + lookahead_ - MIN_MATCH);
+      const bool full = TallyMatch(
+          static_cast<std::size_t>(position_ - 1 - previous_start),
+          previous_length);
+
+      // The match started at the previous position, which is indexed
+      // already, as is the current one
+      lookahead_ -= previous_length - 1;
+      for (std::size_t count = previous_length - 2; count > 0; --count) {
+        if (++position_ <= max_insert) {
+          Insert(position_);
+        }
+      }
+      ++position_;
+      match_available_ = false;
+      match_length_ = MIN_MATCH - 1;
+
+      if (full) {
+        EmitBlock(false);
+      }
+    } else if (match_available_) {
+      const bool full =
+          TallyLiteral(window_[static_cast<std::size_t>(position_ - 1)]);
+      ++position_;
+      --lookahead_;
+      if (full) {
+        EmitBlock(false);
+      }
+    } else {
+      match_available_ = true;
+      ++position_;
+      --lookahead_;
+    }
+  }
+
+  if (flush && match_available_) {
+    const bool full =
+        TallyLiteral(window_[static_cast<std::size_t>(position_ - 1)]);
+    match_available_ = false;
+    if (full) {
+      EmitBlock(false);
+    }
+  }
+}
+
+void DeflateEncoder::Slide() {
+  std::memmove(window_.data(), std::next(window_.data(), WINDOW_SIZE),
+               WINDOW_SIZE);
+
+  constexpr auto SHIFT = static_cast<std::int32_t>(WINDOW_SIZE);
+  position_ -= SHIFT;
+  match_start_ -= SHIFT;
+  // A negative start only rules out a stored block
+  block_start_ -= SHIFT;
+
+  auto slide_positions = [](std::vector<std::int32_t>& positions) {
+    for (auto& position : positions) {
+      position = position >= SHIFT ? position - SHIFT : NIL;
+    }
+  };
+  slide_positions(head_);
+  slide_positions(previous_);
+}
+
+std::int32_t DeflateEncoder::Insert(std::int32_t position) noexcept {
+  const std::uint32_t hash = HashOf(
+      std::next(window_.data(), static_cast<std::ptrdiff_t>(position)));
+  std::int32_t& chain_head = head_[hash];
+  const std::int32_t previous = chain_head;
+  previous_[static_cast<std::size_t>(position) & WINDOW_MASK] = previous;
+  chain_head = position;
+  return previous;
+}
+
+std::size_t DeflateEncoder::LongestMatch(
+    std::int32_t chain_head, std::size_t previous_length) noexcept {
+  const std::size_t max_length = std::min(MAX_MATCH, lookahead_);
+  std::size_t best_length = previous_length;
+  if (best_length >= max_length) {
+    return best_length;
+  }
+
+  std::size_t chain_length = max_chain_;
+  if (previous_length >= good_length_) {
+    chain_length >>= 2U;
+  }
+  const std::size_t nice_length = std::min(nice_length_, max_length);
+  const std::int32_t limit =
+      static_cast<std::size_t>(position_) > MAX_DISTANCE
+          ? position_ - static_cast<std::int32_t>(MAX_DISTANCE)
+          : 0;
+
+  const std::byte* const scan =
+      std::next(window_.data(), static_cast<std::ptrdiff_t>(position_));
+  std::int32_t candidate = chain_head;
+  do {
+    const std::byte* const match =
+        std::next(window_.data(), static_cast<std::ptrdiff_t>(candidate));
+    // Only a longer match helps, which must end with the same byte
+    if (match[best_length] != scan[best_length] || match[0] != scan[0]) {
+      continue;
+    }
+
+    const std::size_t length = MatchLength(scan, match, max_length);
+    if (length > best_length) {
+      match_start_ = candidate;
+      best_length = length;
+      if (length >= nice_length) {
+        break;
+      }
+    }
+  } while ((candidate = previous_[static_cast<std::size_t>(candidate) &
+                                  WINDOW_MASK]) > limit &&
+           --chain_length != 0);
+
+  return best_length;
+}
+
+bool DeflateEncoder::TallyLiteral(std::byte literal) noexcept {
+  const auto value = static_cast<std::uint16_t>(literal);
+  symbols_.push_back(Symbol{.distance = 0, .value = value});
+  ++literal_frequencies_[value];
+  return symbols_.size() == SYMBOL_BUFFER_SIZE;
+}
+
+bool DeflateEncoder::TallyMatch(std::size_t distance,
+                                std::size_t length) noexcept {
+  const std::size_t value = length - MIN_MATCH;
+  symbols_.push_back(Symbol{.distance = static_cast<std::uint16_t>(distance),
+                            .value = static_cast<std::uint16_t>(value)});
+  ++literal_frequencies_[FIRST_LENGTH_CODE + LENGTH_CODES[value]];
+  ++distance_frequencies_[DistanceCode(distance)];
+  return symbols_.size() == SYMBOL_BUFFER_SIZE;
+}
+
+std::int32_t DeflateEncoder::TalliedEnd() const noexcept {
+  // The byte before position is not tallied while a lazy match is pending
+  return match_available_ ? position_ - 1 : position_;
+}
+
+void DeflateEncoder::EmitBlock(bool last) {
+  const std::int32_t block_end = TalliedEnd();
+  const auto raw_size = static_cast<std::size_t>(block_end - block_start_);
+  // Slide may have dropped the start of a long block
+  const bool can_store = block_start_ >= 0;
+  const ByteArrayView raw =
+      can_store ? ByteArrayView(window_).substr(
+                      static_cast<std::size_t>(block_start_), raw_size)
+                : ByteArrayView();
+  block_start_ = block_end;
+
+  if (level_ == 0) {
+    WriteStoredBlocks(raw, last);
+    return;
+  }
+
+  literal_frequencies_[END_OF_BLOCK] = 1;
+  LiteralLengths literal_lengths{};
+  DistanceLengths distance_lengths{};
+  BuildCodeLengths(literal_frequencies_, MAX_CODE_BITS, literal_lengths);
+  BuildCodeLengths(distance_frequencies_, MAX_CODE_BITS, distance_lengths);
+
+  std::size_t literal_count = LITERAL_LENGTH_CODES;
+  while (literal_count > FIRST_LENGTH_CODE &&
+         literal_lengths[literal_count - 1] == 0) {
+    --literal_count;
+  }
+  std::size_t distance_count = DISTANCE_CODES;
+  while (distance_count > 1 && distance_lengths[distance_count - 1] == 0) {
+    --distance_count;
+  }
+
+  std::vector<std::uint8_t> all_lengths(
+      literal_lengths.begin(),
+      std::next(literal_lengths.begin(),
+                static_cast<std::ptrdiff_t>(literal_count)));
+  all_lengths.insert(all_lengths.end(), distance_lengths.begin(),
+                     std::next(distance_lengths.begin(),
+                               static_cast<std::ptrdiff_t>(distance_count)));
+  const CodeLengthEncoding encoding = EncodeCodeLengths(all_lengths);
+
+  std::array<std::uint8_t, CODE_LENGTH_CODES> code_length_lengths{};
+  BuildCodeLengths(encoding.frequencies, MAX_CODE_LENGTH_BITS,
+                   code_length_lengths);
+  std::size_t code_length_count = CODE_LENGTH_CODES;
+  while (code_length_count > 4 &&
+         code_length_lengths[CODE_LENGTH_ORDER[code_length_count - 1]] == 0) {
+    --code_length_count;
+  }
+
+  // Sizes in bits of the three ways to write the block
+  std::size_t dynamic_bits = 3 + 5 + 5 + 4 + 3 * code_length_count +
+                             SymbolBits(literal_lengths, distance_lengths);
+  for (std::size_t symbol = 0; symbol < CODE_LENGTH_CODES; ++symbol) {
+    dynamic_bits += encoding.frequencies[symbol] *
+                    (code_length_lengths[symbol] +
+                     CODE_LENGTH_EXTRA_BITS[symbol]);
+  }
+  const std::size_t fixed_bits =
+      3 + SymbolBits(FIXED_LITERAL_LENGTHS, FIXED_DISTANCE_LENGTHS);
+  const std::size_t stored_chunks =
+      std::max<std::size_t>(1, (raw_size + MAX_STORED_SIZE - 1) /
+                                   MAX_STORED_SIZE);
+  const std::size_t stored_bits =
+      can_store ? stored_chunks * (3 + 7 + 32) + raw_size * 8 : SIZE_MAX;
+
+  if (stored_bits <= fixed_bits && stored_bits <= dynamic_bits) {
+    WriteStoredBlocks(raw, last);
+  } else if (fixed_bits <= dynamic_bits) {
+    PutBits((FIXED_BLOCK << 1U) | (last ? 1U : 0U), 3);
+    const auto literal_codes =
+        CanonicalCodes<FIXED_LITERAL_LENGTHS.size()>(FIXED_LITERAL_LENGTHS);
+    const auto distance_codes =
+        CanonicalCodes<DISTANCE_CODES>(FIXED_DISTANCE_LENGTHS);
+    std::array<HuffmanCode, FIXED_LITERAL_LENGTHS.size()> literals{};
+    std::array<HuffmanCode, DISTANCE_CODES> distances{};
+    for (std::size_t symbol = 0; symbol < literals.size(); ++symbol) {
+      literals[symbol] = {literal_codes[symbol],
+                          FIXED_LITERAL_LENGTHS[symbol]};
+    }
+    for (std::size_t symbol = 0; symbol < distances.size(); ++symbol) {
+      distances[symbol] = {distance_codes[symbol],
+                           FIXED_DISTANCE_LENGTHS[symbol]};
+    }
+    WriteSymbols(literals, distances);
+  } else {
+    PutBits((DYNAMIC_BLOCK << 1U) | (last ? 1U : 0U), 3);
+    PutBits(static_cast<std::uint32_t>(literal_count - FIRST_LENGTH_CODE), 5);
+    PutBits(static_cast<std::uint32_t>(distance_count - 1), 5);
+    PutBits(static_cast<std::uint32_t>(code_length_count - 4), 4);
+    for (std::size_t index = 0; index < code_length_count; ++index) {
+      PutBits(code_length_lengths[CODE_LENGTH_ORDER[index]], 3);
+    }
+
+    const auto code_length_codes =
+        CanonicalCodes<CODE_LENGTH_CODES>(code_length_lengths);
+    for (const auto& [symbol, extra] : encoding.symbols) {
+      PutBits(code_length_codes[symbol], code_length_lengths[symbol]);
+      PutBits(extra, CODE_LENGTH_EXTRA_BITS[symbol]);
+    }
+
+    const auto literal_codes =
+        CanonicalCodes<LITERAL_LENGTH_CODES>(literal_lengths);
+    const auto distance_codes =
+        CanonicalCodes<DISTANCE_CODES>(distance_lengths);
+    std::array<HuffmanCode, LITERAL_LENGTH_CODES> literals{};
+    std::array<HuffmanCode, DISTANCE_CODES> distances{};
+    for (std::size_t symbol = 0; symbol < literals.size(); ++symbol) {
+      literals[symbol] = {literal_codes[symbol], literal_lengths[symbol]};
+    }
+    for (std::size_t symbol = 0; symbol < distances.size(); ++symbol) {
+      distances[symbol] = {distance_codes[symbol], distance_lengths[symbol]};
+    }
+    WriteSymbols(literals, distances);
+  }
+
+  symbols_.clear();
+  literal_frequencies_.fill(0);
+  distance_frequencies_.fill(0);
+}
+
+void DeflateEncoder::WriteStoredBlocks(ByteArrayView data, bool last) {
+  do {
+    const std::size_t size = std::min(data.size(), MAX_STORED_SIZE);
+    const bool last_chunk = size == data.size();
+    PutBits((STORED_BLOCK << 1U) | (last && last_chunk ? 1U : 0U), 3);
+    AlignToByte();
+    const auto length = static_cast<std::uint32_t>(size);
+    AppendLittleEndian32(*output_, length | ((~length & 0xFFFFU) << 16U));
+    output_->append(data.substr(0, size));
+    data.remove_prefix(size);
+  } while (!data.empty());
+
+  symbols_.clear();
+  literal_frequencies_.fill(0);
+  distance_frequencies_.fill(0);
+}
+
+void DeflateEncoder::WriteSymbols(
+    std::span<const HuffmanCode> literal_codes,
+    std::span<const HuffmanCode> distance_codes) {
+  for (const Symbol symbol : symbols_) {
+    if (symbol.distance == 0) {
+      const HuffmanCode literal = literal_codes[symbol.value];
+      PutBits(literal.code, literal.length);
+      continue;
+    }
+
+    const std::size_t length_code = LENGTH_CODES[symbol.value];
+    const HuffmanCode length = literal_codes[FIRST_LENGTH_CODE + length_code];
+    PutBits(length.code, length.length);
+    PutBits(static_cast<std::uint32_t>(symbol.value + MIN_MATCH -
+                                       LENGTH_BASE[length_code]),
+            LENGTH_EXTRA_BITS[length_code]);
+
+    const std::size_t distance_code = DistanceCode(symbol.distance);
+    const HuffmanCode distance = distance_codes[distance_code];
+    PutBits(distance.code, distance.length);
+    PutBits(symbol.distance - DISTANCE_BASE[distance_code],
+            DISTANCE_EXTRA_BITS[distance_code]);
+  }
+
+  const HuffmanCode end_of_block = literal_codes[END_OF_BLOCK];
+  PutBits(end_of_block.code, end_of_block.length);
+}
+
+std::size_t DeflateEncoder::SymbolBits(
+    std::span<const std::uint8_t> literal_lengths,
+    std::span<const std::uint8_t> distance_lengths) const noexcept {
+  std::size_t bits = 0;
+  for (std::size_t symbol = 0; symbol < LITERAL_LENGTH_CODES; ++symbol) {
+    bits += std::size_t{literal_frequencies_[symbol]} *
+            literal_lengths[symbol];
+  }
+  for (std::size_t code = 0; code < LENGTH_EXTRA_BITS.size(); ++code) {
+    bits += std::size_t{literal_frequencies_[FIRST_LENGTH_CODE + code]} *
+            LENGTH_EXTRA_BITS[code];
+  }
+  for (std::size_t code = 0; code < DISTANCE_CODES; ++code) {
+    bits += std::size_t{distance_frequencies_[code]} *
+            (distance_lengths[code] + DISTANCE_EXTRA_BITS[code]);
+  }
+  return bits;
+}
+
+void DeflateEncoder::PutBits(std::uint32_t value, unsigned count) {
+  bit_buffer_ |= std::uint64_t{value} << bit_count_;
+  bit_count_ += count;
+  if (bit_count_ >= 32) {
+    AppendLittleEndian32(*output_, static_cast<std::uint32_t>(bit_buffer_));
+    bit_buffer_ >>= 32U;
+    bit_count_ -= 32;
+  }
+}
+
+void DeflateEncoder::AlignToByte() {
+  while (bit_count_ > 0) {
+    output_->push_back(static_cast<std::byte>(bit_buffer_ & 0xFFU));
+    bit_buffer_ >>= 8U;
+    bit_count_ = bit_count_ > 8 ? bit_count_ - 8 : 0;
+  }
+  bit_buffer_ = 0;
+}
+
+GzipEncoder::GzipEncoder(int level) : level_(level), deflate_(level) {}
+
+void GzipEncoder::Write(ByteArrayView input, ByteArray& output) {
+  WriteHeader(output);
+  crc_ = Crc32(input, crc_);
+  size_ += static_cast<std::uint32_t>(input.size());
+  deflate_.Write(input, output);
+}
+
+void GzipEncoder::Flush(ByteArray& output) {
+  WriteHeader(output);
+  deflate_.Flush(output);
+}
+
+void GzipEncoder::Finish(ByteArray& output) {
+  WriteHeader(output);
+  deflate_.Finish(output);
+  AppendLittleEndian32(output, crc_);
+  AppendLittleEndian32(output, size_);
+}
+
+void GzipEncoder::WriteHeader(ByteArray& output) {
+  if (header_written_) {
+    return;
+  }
+  header_written_ = true;
+
+  // No name and no modification time, so that equal input gives equal
+  // output. XFL tells the slowest and the fastest level apart.
+  const auto extra_flags = static_cast<std::byte>(
+      level_ == DeflateEncoder::MAX_LEVEL ? 2U : level_ <= 1 ? 4U : 0U);
+  constexpr std::byte UNIX_OS{3};
+  const std::array<std::byte, 10> header = {
+      std::byte{0x1F}, std::byte{0x8B}, std::byte{8}, std::byte{0},
+      std::byte{0},    std::byte{0},    std::byte{0}, std::byte{0},
+      extra_flags,     UNIX_OS};
+  output.append(header.data(), header.size());
+}
+
+http1::ByteArray http1::GzipCompress(ByteArrayView input, int level) {
+  ByteArray output;
+  GzipEncoder encoder(level);
+  encoder.Write(input, output);
+  encoder.Finish(output);
+  return output;
+}
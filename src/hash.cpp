@@ -0,0 +1,152 @@
+#include "hash.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+
+namespace {
+
+constexpr std::uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr std::uint64_t PRIME_3 = 0x165667B19E3779F9ULL;
+constexpr std::uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr std::uint64_t PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+constexpr std::size_t STRIPE_SIZE = 32;
+
+template <class T>
+T LoadLittleEndian(const std::byte* data) noexcept {
+  T value = 0;
+  std::memcpy(&value, data, sizeof(value));
+  if constexpr (std::endian::native == std::endian::big) {
+    if constexpr (sizeof(T) == sizeof(std::uint64_t)) {
+      value = __builtin_bswap64(value);
+    } else {
+      value = __builtin_bswap32(value);
+    }
+  }
+  return value;
+}
+
+constexpr std::uint64_t Round(std::uint64_t accumulator,
+                              std::uint64_t input) noexcept {
+  accumulator += input * PRIME_2;
+  accumulator = std::rotl(accumulator, 31);
+  return accumulator * PRIME_1;
+}
+
+constexpr std::uint64_t MergeRound(std::uint64_t hash,
+                                   std::uint64_t accumulator) noexcept {
+  hash ^= Round(0, accumulator);
+  return hash * PRIME_1 + PRIME_4;
+}
+
+constexpr std::uint32_t CRC_POLYNOMIAL = 0xEDB88320U;
+
+// Slicing-by-8 tables, table[k][byte] is the CRC of byte followed by k zero
+// bytes, so that eight input bytes are folded in per step.
+constexpr auto CRC_TABLES = [] {
+  std::array<std::array<std::uint32_t, 256>, 8> tables{};
+  for (std::uint32_t byte = 0; byte < 256; ++byte) {
+    std::uint32_t crc = byte;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1U) ^ ((crc & 1U) != 0 ? CRC_POLYNOMIAL : 0U);
+    }
+    tables[0][byte] = crc;
+  }
+  for (std::size_t slice = 1; slice < tables.size(); ++slice) {
+    for (std::size_t byte = 0; byte < 256; ++byte) {
+      const std::uint32_t previous = tables[slice - 1][byte];
+      tables[slice][byte] = (previous >> 8U) ^ tables[0][previous & 0xFFU];
+    }
+  }
+  return tables;
+}();
+
+}  // namespace
+
+std::uint64_t http1::Hash64(ByteArrayView data, std::uint64_t seed) noexcept {
+  const std::byte* cursor = data.data();
+  const std::byte* const end = std::next(data.data(), data.size());
+  std::uint64_t hash = 0;
+
+  if (data.size() >= STRIPE_SIZE) {
+    // Four independent lanes keep the multipliers busy
+    std::uint64_t lane_1 = seed + PRIME_1 + PRIME_2;
+    std::uint64_t lane_2 = seed + PRIME_2;
+    std::uint64_t lane_3 = seed;
+    std::uint64_t lane_4 = seed - PRIME_1;
+
+    const std::byte* const last_stripe = std::prev(end, STRIPE_SIZE);
+    while (cursor <= last_stripe) {
+      lane_1 = Round(lane_1, LoadLittleEndian<std::uint64_t>(cursor));
+      cursor = std::next(cursor, 8);
+      lane_2 = Round(lane_2, LoadLittleEndian<std::uint64_t>(cursor));
+      cursor = std::next(cursor, 8);
+      lane_3 = Round(lane_3, LoadLittleEndian<std::uint64_t>(cursor));
+      cursor = std::next(cursor, 8);
+      lane_4 = Round(lane_4, LoadLittleEndian<std::uint64_t>(cursor));
+      cursor = std::next(cursor, 8);
+    }
+
+    hash = std::rotl(lane_1, 1) + std::rotl(lane_2, 7) +
+           std::rotl(lane_3, 12) + std::rotl(lane_4, 18);
+    hash = MergeRound(hash, lane_1);
+    hash = MergeRound(hash, lane_2);
+    hash = MergeRound(hash, lane_3);
+    hash = MergeRound(hash, lane_4);
+  } else {
+    hash = seed + PRIME_5;
+  }
+
+  hash += data.size();
+
+  while (end - cursor >= 8) {
+    hash ^= Round(0, LoadLittleEndian<std::uint64_t>(cursor));
+    hash = std::rotl(hash, 27) * PRIME_1 + PRIME_4;
+    cursor = std::next(cursor, 8);
+  }
+
+  if (end - cursor >= 4) {
+    hash ^= LoadLittleEndian<std::uint32_t>(cursor) * PRIME_1;
+    hash = std::rotl(hash, 23) * PRIME_2 + PRIME_3;
+    cursor = std::next(cursor, 4);
+  }
+
+  while (cursor < end) {
+    hash ^= static_cast<std::uint64_t>(*cursor) * PRIME_5;
+    hash = std::rotl(hash, 11) * PRIME_1;
+    cursor = std::next(cursor);
+  }
+
+  hash ^= hash >> 33U;
+  hash *= PRIME_2;
+  hash ^= hash >> 29U;
+  hash *= PRIME_3;
+  hash ^= hash >> 32U;
+  return hash;
+}
+
+std::uint32_t http1::Crc32(ByteArrayView data, std::uint32_t crc) noexcept {
+  const std::byte* cursor = data.data();
+  const std::byte* const end = std::next(data.data(), data.size());
+  crc = ~crc;
+
+  while (end - cursor >= 8) {
+    const std::uint32_t low = LoadLittleEndian<std::uint32_t>(cursor) ^ crc;
+    const std::uint32_t high =
+        LoadLittleEndian<std::uint32_t>(std::next(cursor, 4));
+    crc = CRC_TABLES[7][low & 0xFFU] ^ CRC_TABLES[6][(low >> 8U) & 0xFFU] ^
+          CRC_TABLES[5][(low >> 16U) & 0xFFU] ^ CRC_TABLES[4][low >> 24U] ^
+          CRC_TABLES[3][high & 0xFFU] ^ CRC_TABLES[2][(high >> 8U) & 0xFFU] ^
+          CRC_TABLES[1][(high >> 16U) & 0xFFU] ^ CRC_TABLES[0][high >> 24U];
+    cursor = std::next(cursor, 8);
+  }
+
+  while (cursor < end) {
+    crc = (crc >> 8U) ^
+          CRC_TABLES[0][(crc ^ static_cast<std::uint32_t>(*cursor)) & 0xFFU];
+    cursor = std::next(cursor);
+  }
+  return ~crc;
+}
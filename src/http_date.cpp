@@ -0,0 +1,191 @@
+#include "http_date.hpp"
+
+#include <array>
+#include <cstdint>
+
+using http1::CommonFieldsCache;
+
+namespace {
+
+constexpr std::array<std::string_view, 7> WEEKDAY_NAMES = {
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+constexpr std::array<std::string_view, 12> MONTH_NAMES = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+constexpr std::int64_t SECONDS_PER_DAY = 86400;
+
+struct CivilDate {
+  std::int64_t year;
+  unsigned month;  // 1 - 12
+  unsigned day;    // 1 - 31
+};
+
+// Days since 1970-01-01 to proleptic Gregorian date, see
+// https://howardhinnant.github.io/date_algorithms.html#civil_from_days
+constexpr CivilDate CivilFromDays(std::int64_t days) noexcept {
+  days += 719468;
+  const std::int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  const auto day_of_era = static_cast<unsigned>(days - era * 146097);
+  const unsigned year_of_era =
+      (day_of_era - day_of_era / 1460 + day_of_era / 36524 -
+       day_of_era / 146096) /
+      365;
+  const unsigned day_of_year =
+      day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  const unsigned month_index = (5 * day_of_year + 2) / 153;
+  const unsigned day = day_of_year - (153 * month_index + 2) / 5 + 1;
+  const unsigned month = month_index < 10 ? month_index + 3 : month_index - 9;
+  const std::int64_t year =
+      static_cast<std::int64_t>(year_of_era) + era * 400 + (month <= 2 ? 1 : 0);
+  return CivilDate{.year = year, .month = month, .day = day};
+}
+
+// Proleptic Gregorian date to days since 1970-01-01, see
+// https://howardhinnant.github.io/date_algorithms.html#days_from_civil
+constexpr std::int64_t DaysFromCivil(std::int64_t year, unsigned month,
+                                     unsigned day) noexcept {
+  year -= month <= 2 ? 1 : 0;
+  const std::int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const auto year_of_era = static_cast<unsigned>(year - era * 400);
+  const unsigned day_of_year =
+      (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  const unsigned day_of_era =
+      year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + static_cast<std::int64_t>(day_of_era) - 719468;
+}
+
+// Parses a fixed number of decimal digits
+std::optional<unsigned> ParseDigits(std::string_view text) noexcept {
+  unsigned value = 0;
+  for (const char character : text) {
+    if (character < '0' || character > '9') {
+      return std::nullopt;
+    }
+    value = value * 10 + static_cast<unsigned>(character - '0');
+  }
+  return value;
+}
+
+template <std::size_t N>
+std::optional<std::size_t> IndexOfName(
+    const std::array<std::string_view, N>& names,
+    std::string_view name) noexcept {
+  for (std::size_t index = 0; index < names.size(); ++index) {
+    if (names[index] == name) {
+      return index;
+    }
+  }
+  return std::nullopt;
+}
+
+char* WriteTwoDigits(char* output, unsigned value) noexcept {
+  *output++ = static_cast<char>('0' + value / 10);
+  *output++ = static_cast<char>('0' + value % 10);
+  return output;
+}
+
+char* WriteName(char* output, std::string_view name) noexcept {
+  for (const char character : name) {
+    *output++ = character;
+  }
+  return output;
+}
+
+}  // namespace
+
+void http1::FormatHttpDate(std::time_t time,
+                           std::span<char, HTTP_DATE_SIZE> output) noexcept {
+  const std::int64_t seconds = time;
+  std::int64_t days = seconds / SECONDS_PER_DAY;
+  std::int64_t seconds_of_day = seconds % SECONDS_PER_DAY;
+  if (seconds_of_day < 0) {
+    seconds_of_day += SECONDS_PER_DAY;
+    --days;
+  }
+
+  const auto date = CivilFromDays(days);
+  // 1970-01-01 was a Thursday
+  const auto weekday = static_cast<std::size_t>(((days % 7) + 11) % 7);
+  const auto year = static_cast<unsigned>(date.year % 10000);
+  const auto second_of_day = static_cast<unsigned>(seconds_of_day);
+
+  char* cursor = output.data();
+  cursor = WriteName(cursor, WEEKDAY_NAMES.at(weekday));
+  cursor = WriteName(cursor, ", ");
+  cursor = WriteTwoDigits(cursor, date.day);
+  *cursor++ = ' ';
+  cursor = WriteName(cursor, MONTH_NAMES.at(date.month - 1));
+  *cursor++ = ' ';
+  cursor = WriteTwoDigits(cursor, year / 100);
+  cursor = WriteTwoDigits(cursor, year % 100);
+  *cursor++ = ' ';
+  cursor = WriteTwoDigits(cursor, second_of_day / 3600);
+  *cursor++ = ':';
+  cursor = WriteTwoDigits(cursor, second_of_day / 60 % 60);
+  *cursor++ = ':';
+  cursor = WriteTwoDigits(cursor, second_of_day % 60);
+  WriteName(cursor, " GMT");
+}
+
+std::string http1::FormatHttpDate(std::time_t time) {
+  std::string result(HTTP_DATE_SIZE, ' ');
+  FormatHttpDate(time, std::span<char, HTTP_DATE_SIZE>(result.data(),
+                                                       HTTP_DATE_SIZE));
+  return result;
+}
+
+std::optional<std::time_t> http1::ParseHttpDate(
+    std::string_view date) noexcept {
+  // "Sun, 06 Nov 1994 08:49:37 GMT"
+  if (date.size() != HTTP_DATE_SIZE || date.substr(3, 2) != ", " ||
+      date[7] != ' ' || date[11] != ' ' || date[16] != ' ' ||
+      date[19] != ':' || date[22] != ':' || date.substr(25) != " GMT" ||
+      !IndexOfName(WEEKDAY_NAMES, date.substr(0, 3))) {
+    return std::nullopt;
+  }
+
+  const auto day = ParseDigits(date.substr(5, 2));
+  const auto month = IndexOfName(MONTH_NAMES, date.substr(8, 3));
+  const auto year = ParseDigits(date.substr(12, 4));
+  const auto hour = ParseDigits(date.substr(17, 2));
+  const auto minute = ParseDigits(date.substr(20, 2));
+  const auto second = ParseDigits(date.substr(23, 2));
+  if (!day || !month || !year || !hour || !minute || !second ||
+      *day == 0 || *day > 31 || *hour > 23 || *minute > 59 || *second > 60) {
+    return std::nullopt;
+  }
+
+  const std::int64_t days =
+      DaysFromCivil(*year, static_cast<unsigned>(*month + 1), *day);
+  return static_cast<std::time_t>(days * SECONDS_PER_DAY + *hour * 3600 +
+                                  *minute * 60 + *second);
+}
+
+CommonFieldsCache::CommonFieldsCache() {
+  lines_.append(DATE_PREFIX);
+  lines_.append(HTTP_DATE_SIZE, ' ');
+  lines_.append("\r\n");
+  Update(std::time(nullptr));
+}
+
+void CommonFieldsCache::SetServerName(std::string_view server_name) {
+  lines_.resize(DATE_PREFIX.size() + HTTP_DATE_SIZE + 2);
+  if (!server_name.empty()) {
+    lines_.append("server: ");
+    lines_.append(server_name);
+    lines_.append("\r\n");
+  }
+}
+
+bool CommonFieldsCache::Update(std::time_t now) noexcept {
+  if (now == formatted_time_) {
+    return false;
+  }
+
+  FormatHttpDate(now, std::span<char, HTTP_DATE_SIZE>(
+                          std::next(lines_.data(), DATE_PREFIX.size()),
+                          HTTP_DATE_SIZE));
+  formatted_time_ = now;
+  return true;
+}
\ No newline at end of file
@@ -1,79 +1,192 @@
 #include "http_server.hpp"
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
 #include <gsl/narrow>
 #include <iostream>
-#include <sstream>
+#include <limits>
+#include <string>
 #include <tuple>
 #include <utility>
 
+#include "content_coding.hpp"
+#include "http_tokenizer.hpp"
+
+using http1::FieldTokens;
 using http1::HeaderField;
+using http1::HeaderTemplate;
+using http1::HttpConnection;
 using http1::HttpMessage;
+using http1::HttpMetrics;
 using http1::HttpMethod;
 using http1::HttpParseError;
+using http1::HttpParseErrorKind;
 using http1::HttpRequest;
 using http1::HttpRequestParser;
 using http1::HttpResponse;
 using http1::HttpSerializeError;
+using http1::HttpStatusCode;
 using http1::HttpServer;
+using http1::HttpTokenizer;
+using http1::HttpVersion;
+using http1::LatencyMetrics;
+using http1::PreparedResponse;
+using http1::TcpServerCore;
+
+namespace {
+
+constexpr std::string_view CRLF = "\r\n";
+constexpr std::string_view FIELD_SEPARATOR = ": ";
+constexpr std::string_view CONTENT_LENGTH_PREFIX = "content-length: ";
+constexpr std::size_t MAX_DECIMAL_SIZE =
+    std::numeric_limits<std::size_t>::digits10 + 1;
+
+constexpr int MIN_STATUS_CODE = 100;
+constexpr int MAX_STATUS_CODE = 599;
+
+// "HTTP/1.1 404 Not Found\r\n" fits into a line of the table
+constexpr std::size_t MAX_STATUS_LINE_SIZE = 48;
+constexpr std::size_t STATUS_PREFIX_SIZE = 13;  // "HTTP/1.1 404 "
+
+struct StatusLineEntry {
+  std::array<char, MAX_STATUS_LINE_SIZE> text{};
+  std::size_t size = 0;
+};
+
+constexpr StatusLineEntry MakeStatusLine(int code) {
+  StatusLineEntry entry;
+  auto append = [&entry](std::string_view part) {
+    for (const char character : part) {
+      entry.text.at(entry.size++) = character;
+    }
+  };
+
+  append("HTTP/1.1 ");
+  for (const int digit : {code / 100, code / 10 % 10, code % 10}) {
+    entry.text.at(entry.size++) = static_cast<char>('0' + digit);
+  }
+  append(" ");
+  append(http1::ReasonPhrase(static_cast<HttpStatusCode>(code)));
+  append(CRLF);
+  return entry;
+}
+
+// Every status line is formatted at compile time, indexed by status code
+constexpr auto STATUS_LINE_TABLE = [] {
+  std::array<StatusLineEntry, MAX_STATUS_CODE - MIN_STATUS_CODE + 1> table{};
+  for (int code = MIN_STATUS_CODE; code <= MAX_STATUS_CODE; ++code) {
+    table.at(code - MIN_STATUS_CODE) = MakeStatusLine(code);
+  }
+  return table;
+}();
+
+const StatusLineEntry& StatusLineOf(HttpStatusCode status_code) {
+  const int code = static_cast<int>(status_code);
+  if (code < MIN_STATUS_CODE || code > MAX_STATUS_CODE) {
+    throw HttpSerializeError("Invalid HTTP status code");
+  }
+  return STATUS_LINE_TABLE.at(code - MIN_STATUS_CODE);
+}
+
+std::string_view StatusLine(HttpStatusCode status_code) {
+  const auto& entry = StatusLineOf(status_code);
+  return {entry.text.data(), entry.size};
+}
+
+std::string_view StatusLinePrefix(HttpStatusCode status_code) {
+  return {StatusLineOf(status_code).text.data(), STATUS_PREFIX_SIZE};
+}
+
+constexpr std::size_t DecimalSize(std::size_t value) noexcept {
+  std::size_t size = 1;
+  while (value >= 10) {
+    value /= 10;
+    ++size;
+  }
+  return size;
+}
+
+char* Append(char* output, std::string_view data) noexcept {
+  std::memcpy(output, data.data(), data.size());
+  return std::next(output, static_cast<std::ptrdiff_t>(data.size()));
+}
+
+char* AppendFields(char* output, const http1::HeaderFields& fields) noexcept {
+  for (const auto& field : fields) {
+    output = Append(output, field.name);
+    output = Append(output, FIELD_SEPARATOR);
+    output = Append(output, field.value);
+    output = Append(output, CRLF);
+  }
+  return output;
+}
 
-HttpMethod ParseMethod(const std::string_view& method) {
-  if (method == "GET") {
-    return HttpMethod::Get;
-  }
-  if (method == "HEAD") {
-    return HttpMethod::Head;
-  }
-  if (method == "POST") {
-    return HttpMethod::Post;
-  }
-  if (method == "PUT") {
-    return HttpMethod::Put;
-  }
-  if (method == "DELETE") {
-    return HttpMethod::Delete;
-  }
-  if (method == "CONNECT") {
-    return HttpMethod::Connect;
-  }
-  if (method == "OPTIONS") {
-    return HttpMethod::Options;
-  }
-  if (method == "TRACE") {
-    return HttpMethod::Trace;
-  }
-  if (method == "PATCH") {
-    return HttpMethod::Patch;
-  }
-  throw HttpParseError("Invalid HTTP method");
-}
-
-std::string SerializeMethod(HttpMethod method) {
-  switch (method) {
-    case HttpMethod::Get:
-      return "GET";
-    case HttpMethod::Head:
-      return "HEAD";
-    case HttpMethod::Post:
-      return "POST";
-    case HttpMethod::Put:
-      return "PUT";
-    case HttpMethod::Delete:
-      return "DELETE";
-    case HttpMethod::Connect:
-      return "CONNECT";
-    case HttpMethod::Options:
-      return "OPTIONS";
-    case HttpMethod::Trace:
-      return "TRACE";
-    case HttpMethod::Patch:
-      return "PATCH";
+// Matches the method with one 8 byte load when the header has enough bytes
+// after the method, which holds for every complete request line.
+HttpMethod ParseMethod(std::string_view header, http1::TokenRange method) {
+  constexpr std::size_t MAX_METHOD_SIZE = 7;
+  if (method.size > MAX_METHOD_SIZE) {
+    throw HttpParseError(HttpParseErrorKind::Method, "Invalid HTTP method");
+  }
+
+  std::uint64_t packed = 0;
+  if (header.size() - method.offset >= sizeof(packed)) {
+    const std::uint64_t mask = (std::uint64_t{1} << (8 * method.size)) - 1;
+    packed = http1::LoadPacked(std::next(header.data(), method.offset)) & mask;
+  } else {
+    packed = http1::PackToken(method.In(header));
+  }
+
+  using http1::PackToken;
+  switch (packed) {
+    case PackToken("GET"):
+      return HttpMethod::Get;
+    case PackToken("HEAD"):
+      return HttpMethod::Head;
+    case PackToken("POST"):
+      return HttpMethod::Post;
+    case PackToken("PUT"):
+      return HttpMethod::Put;
+    case PackToken("DELETE"):
+      return HttpMethod::Delete;
+    case PackToken("CONNECT"):
+      return HttpMethod::Connect;
+    case PackToken("OPTIONS"):
+      return HttpMethod::Options;
+    case PackToken("TRACE"):
+      return HttpMethod::Trace;
+    case PackToken("PATCH"):
+      return HttpMethod::Patch;
     default:
-      throw HttpSerializeError("Invalid HTTP method");
+      throw HttpParseError(HttpParseErrorKind::Method, "Invalid HTTP method");
   }
 }
 
-HttpParseError::HttpParseError(const std::string& error_message)
-    : std::invalid_argument(error_message) {}
+HttpVersion ParseVersion(std::string_view version) {
+  if (version.size() != sizeof(std::uint64_t)) {
+    throw HttpParseError(HttpParseErrorKind::Version,
+                         "Unsupported HTTP version");
+  }
+
+  using http1::PackToken;
+  switch (http1::LoadPacked(version.data())) {
+    case PackToken("HTTP/1.1"):
+      return HttpVersion::Http11;
+    case PackToken("HTTP/1.0"):
+      return HttpVersion::Http10;
+    default:
+      throw HttpParseError(HttpParseErrorKind::Version,
+                         "Unsupported HTTP version");
+  }
+}
+
+}  // namespace
+
+HttpParseError::HttpParseError(HttpParseErrorKind kind,
+                               const std::string& error_message)
+    : std::invalid_argument(error_message), kind_(kind) {}
 
 HttpSerializeError::HttpSerializeError(const std::string& error_message)
     : std::invalid_argument(error_message) {}
@@ -81,7 +194,7 @@ HttpSerializeError::HttpSerializeError(const std::string& error_message)
 HeaderField HeaderField::Parse(const std::string_view& data) {
   const std::size_t name_end = data.find(':');
   if (name_end == std::string::npos) {
-    throw HttpParseError("Invalid header field");
+    throw HttpParseError(HttpParseErrorKind::Field, "Invalid header field");
   }
 
   auto name = std::string(data.substr(0, name_end));
@@ -109,51 +222,79 @@ void HttpMessage::AddField(const HeaderField& field) {
   header_fields_.push_back(field);
 }
 
-void HttpMessage::SetBody(const ByteArrayView& body) { body_ = body; }
+void HttpMessage::AddField(HeaderField&& field) {
+  header_fields_.push_back(std::move(field));
+}
 
-HttpRequest HttpRequest::ParseHeader(const std::string_view& header) {
-  const std::size_t request_line_end = header.find("\r\n");
-  if (request_line_end == std::string_view::npos) {
-    throw HttpParseError("Can not parse request line");
-  }
+void HttpMessage::SetBody(const ByteArrayView& body) { body_ = body; }
 
-  const std::size_t method_end = header.find(' ');
-  if (method_end == std::string_view::npos) {
-    throw HttpParseError("Can not parse method from request line");
+void HttpMessage::SetField(const HeaderField& field) {
+  for (auto& existing_field : header_fields_) {
+    if (existing_field.name == field.name) {
+      existing_field.value = field.value;
+      return;
+    }
   }
+  AddField(field);
+}
 
-  const std::size_t path_end = header.find(' ', method_end + 1);
-  if (path_end == std::string_view::npos) {
-    throw HttpParseError("Can not parse path from request line");
+auto HttpMessage::FindField(std::string_view name) const noexcept
+    -> std::optional<std::string_view> {
+  for (const auto& field : header_fields_) {
+    if (field.name == name) {
+      return field.value;
+    }
   }
+  return std::nullopt;
+}
 
-  const std::size_t version_end = header.find("\r\n", path_end + 1);
-  if (version_end == std::string_view::npos) {
-    throw HttpParseError("Can not parse version from request line");
+HttpRequest HttpRequest::ParseHeader(const std::string_view& header,
+                                     const PathOptions& path_options) {
+  HttpTokenizer tokenizer(header);
+  const auto request_line = tokenizer.ParseRequestLine();
+
+  auto result = HttpRequest(ParseMethod(header, request_line.method),
+                            std::string(request_line.target.In(header)),
+                            ParseVersion(request_line.version.In(header)));
+
+  // In place, the query is moved up behind the shortened path
+  std::string& target = result.path_;
+  const std::size_t path_size = result.target().path().size();
+  const auto normalized = http1::NormalizePath(
+      std::span<char>(target.data(), path_size), path_options);
+  if (normalized.status == http1::PathStatus::Invalid) {
+    throw HttpParseError(HttpParseErrorKind::Path, "Invalid request path");
   }
+  target.erase(normalized.size, path_size - normalized.size);
 
-  auto result = HttpRequest(
-      ParseMethod(header.substr(0, method_end)),
-      std::string(header.substr(method_end + 1, path_end - method_end - 1)),
-      std::string(
-          header.substr(path_end + 1, request_line_end - path_end - 1)));
-
-  std::size_t field_start = request_line_end + 2;
-  while (field_start < header.size() - 2) {
-    const std::size_t field_end = header.find("\r\n", field_start);
-    result.UpdateFields(HeaderField::Parse(
-        header.substr(field_start, field_end - field_start)));
-    field_start = field_end + 2;
+  FieldTokens field_tokens;
+  HeaderField field;
+  while (tokenizer.NextField(field_tokens, field.name)) {
+    field.value.assign(field_tokens.value.In(header));
+    result.UpdateFields(std::move(field));
   }
 
   return result;
 }
 
 void HttpRequest::UpdateFields(const HeaderField& field) {
-  AddField(field);
+  UpdateFields(HeaderField(field));
+}
+
+void HttpRequest::UpdateFields(HeaderField&& field) {
   if (field.name == "content-length") {
-    content_length_ = std::stoi(field.value);
+    std::size_t content_length = 0;
+    const char* const end = std::next(
+        field.value.data(), static_cast<std::ptrdiff_t>(field.value.size()));
+    const auto result =
+        std::from_chars(field.value.data(), end, content_length);
+    if (field.value.empty() || result.ec != std::errc() || result.ptr != end) {
+      throw HttpParseError(HttpParseErrorKind::Field,
+                           "Invalid content-length field");
+    }
+    content_length_ = content_length;
   }
+  AddField(std::move(field));
 }
 
 void HttpRequest::UpdateFields(const std::string& name,
@@ -162,14 +303,15 @@ void HttpRequest::UpdateFields(const std::string& name,
 }
 
 HttpRequest::HttpRequest(HttpMethod method, std::string path,
-                         std::string version)
-    : method_(method), path_(std::move(path)), version_(std::move(version)) {}
+                         HttpVersion version)
+    : method_(method), path_(std::move(path)), version_(version) {}
 
 std::ostream& http1::operator<<(std::ostream& output_stream,
                                 const HttpRequest& request) {
   output_stream << "Method: \"" << SerializeMethod(request.method()) << "\", "
                 << "Path: \"" << request.path() << "\", "
-                << "Version: \"" << request.version() << "\"" << std::endl;
+                << "Version: \"" << SerializeVersion(request.version()) << "\""
+                << std::endl;
 
   output_stream << "Fields:" << std::endl;
   for (const auto& field : request.header_fields()) {
@@ -184,13 +326,18 @@ HttpRequestParser::HttpRequestParser(RequestCallback callback)
     : on_request_(std::move(callback)) {}
 
 void HttpRequestParser::Feed(const ByteArrayView& data) {
+  Feed(data, on_request_);
+}
+
+bool HttpRequestParser::ParseNext(const ByteArrayView& data,
+                                  std::size_t& offset) {
   constexpr auto CARRIAGE_RETURN = std::byte{13};
   constexpr auto LINE_FEED = std::byte{10};
 
-  bool done = false;
-  std::size_t consumed = 0;
+  std::size_t consumed = offset;
 
-  for (std::size_t current_it = 0; current_it < data.size() && !done;) {
+  for (std::size_t current_it = offset; current_it < data.size();
+       ++current_it) {
     const std::byte& current = data[current_it];
     switch (state_) {
       case State::BeforeCr1: {
@@ -230,17 +377,14 @@ void HttpRequestParser::Feed(const ByteArrayView& data) {
           }
           consumed = current_it + 1;
 
-          request_ = HttpRequest::ParseHeader(header);
+          request_ = HttpRequest::ParseHeader(header, path_options_);
           buffer_.clear();
 
-          if (request_.content_length() > 0) {
-            state_ = State::Body;
-          } else {
-            on_request_(request_);
-
-            request_ = HttpRequest{};
-            state_ = State::BeforeCr1;
+          if (request_.content_length() == 0) {
+            offset = consumed;
+            return true;
           }
+          state_ = State::Body;
         } else if (current == CARRIAGE_RETURN) {
           state_ = State::Cr1;
         } else {
@@ -251,92 +395,534 @@ void HttpRequestParser::Feed(const ByteArrayView& data) {
       case State::Body: {
         if ((data.size() - current_it) + buffer_.size() <
             request_.content_length()) {
-          done = true;
-          break;
+          buffer_.append(data.substr(consumed));
+          offset = data.size();
+          return false;
         }
 
+        const std::size_t missing =
+            request_.content_length() - buffer_.size();
         if (buffer_.empty()) {
-          consumed += request_.content_length();
-          request_.SetBody(data.substr(current_it, request_.content_length()));
+          request_.SetBody(data.substr(current_it, missing));
         } else {
-          consumed += request_.content_length() - buffer_.size();
-          buffer_.append(data.substr(
-              current_it, request_.content_length() - buffer_.size()));
+          buffer_.append(data.substr(current_it, missing));
           request_.SetBody(buffer_);
         }
 
-        current_it = consumed;
-
-        on_request_(request_);
-        buffer_.clear();
-
-        request_ = HttpRequest{};
-        state_ = State::BeforeCr1;
-
-        break;
+        offset = current_it + missing;
+        return true;
       }
     }
-    ++current_it;
   }
 
   buffer_.append(data.substr(consumed));
+  offset = data.size();
+  return false;
+}
+
+void HttpRequestParser::FinishRequest() {
+  buffer_.clear();
+  request_ = HttpRequest{};
+  state_ = State::BeforeCr1;
 }
 
 void HttpResponse::SetReason(const std::string& reason) { reason_ = reason; }
 
+void HttpResponse::SetContentLength(std::size_t content_length) {
+  content_length_ = content_length;
+}
+
 HttpResponse::HttpResponse(HttpStatusCode status_code)
     : status_code_(status_code) {}
 
-auto HttpResponse::Serialize() const -> ByteArray {
-  std::stringstream header;
-  header << VERSION << " " << static_cast<int>(status_code_) << " ";
-  if (reason_) {
-    header << reason_.value();
+HttpResponse::HttpResponse(PreparedResponse prepared)
+    : status_code_(prepared.status_code()), prepared_(std::move(prepared)) {}
+
+HttpResponse::HttpResponse(HeaderTemplate header_template)
+    : status_code_(header_template.status_code()),
+      header_template_(std::move(header_template)) {
+  const auto& layout = *header_template_->layout_;
+  std::fill_n(slot_values_.begin(), layout.storage_size, ' ');
+}
+
+void HttpResponse::SetSlot(std::size_t slot, std::string_view value) {
+  if (!header_template_ || slot >= header_template_->layout_->slots.size()) {
+    throw HttpSerializeError("Response has no such template slot");
   }
 
-  header << "\r\n";
+  const auto& slot_layout = header_template_->layout_->slots[slot];
+  if (slot_layout.is_content_length) {
+    throw HttpSerializeError("Content length slot is filled automatically");
+  }
+  if (value.size() > slot_layout.width) {
+    throw HttpSerializeError("Value is wider than its template slot");
+  }
+  for (const char character : value) {
+    if ((http1::ClassOf(character) &
+         (http1::FIELD_VALUE_CHAR | http1::WHITESPACE_CHAR)) == 0) {
+      throw HttpSerializeError("Invalid character in field value");
+    }
+  }
 
+  const auto storage = std::next(
+      slot_values_.begin(),
+      static_cast<std::ptrdiff_t>(slot_layout.storage_offset));
+  std::fill_n(std::copy(value.begin(), value.end(), storage),
+              slot_layout.width - value.size(), ' ');
+}
+
+void HttpResponse::SetFileBody(FileBody file_body) {
+  file_body_ = std::move(file_body);
+}
+
+void HttpResponse::SetFileBodyParts(std::vector<FileBodyPart> parts) {
+  file_body_parts_ = std::move(parts);
+}
+
+void HttpResponse::SetOwnedBody(ByteArray body) {
+  // Shared, so that the view stays valid when the response is moved
+  owned_body_ = std::make_shared<const ByteArray>(std::move(body));
+  SetBody(*owned_body_);
+}
+
+void HttpResponse::OmitBody() {
+  if (!prepared_ && !content_length_ &&
+      (body() || file_body_ || !file_body_parts_.empty()) &&
+      !FindField("content-length")) {
+    content_length_ = BodySize();
+  }
+  file_body_.reset();
+  file_body_parts_.clear();
+  body_omitted_ = true;
+}
+
+auto HttpResponse::prepared_tail() const noexcept -> ByteArrayView {
+  if (!prepared_) {
+    return {};
+  }
+  return body_omitted_ ? prepared_->fields() : prepared_->fields_and_body();
+}
+
+auto HttpResponse::SerializedSize(std::string_view common_fields) const
+    -> std::size_t {
+  return HeaderSize(common_fields) + BodySize();
+}
+
+void HttpResponse::SerializeTo(ByteArray& output,
+                               std::string_view common_fields) const {
+  const std::size_t offset = output.size();
+  output.resize(offset + SerializedSize(common_fields));
+  SerializeTo(std::span<std::byte>(output).subspan(offset), common_fields);
+}
+
+auto HttpResponse::SerializeTo(std::span<std::byte> output,
+                               std::string_view common_fields) const
+    -> std::size_t {
+  const std::size_t size = SerializedSize(common_fields);
+  if (output.size() < size) {
+    throw HttpSerializeError("Output buffer is too small for the response");
+  }
+
+  char* cursor =
+      SerializeHeader(reinterpret_cast<char*>(output.data()), common_fields);
+  if (file_body_) {
+    const auto mapped = file_body_->file->data().substr(file_body_->offset,
+                                                        file_body_->size);
+    std::memcpy(cursor, mapped.data(), mapped.size());
+  } else if (!file_body_parts_.empty()) {
+    for (const auto& part : file_body_parts_) {
+      cursor = Append(cursor, part.prefix);
+      const auto mapped =
+          part.file.file->data().substr(part.file.offset, part.file.size);
+      std::memcpy(cursor, mapped.data(), mapped.size());
+      cursor = std::next(cursor, static_cast<std::ptrdiff_t>(mapped.size()));
+    }
+  } else if (body() && !prepared_ && !body_omitted_) {
+    std::memcpy(cursor, body()->data(), body()->size());
+  }
+
+  return size;
+}
+
+void HttpResponse::SerializeHeaderTo(ByteArray& output,
+                                     std::string_view common_fields) const {
+  const std::size_t offset = output.size();
+  output.resize(offset + HeaderSize(common_fields));
+  SerializeHeader(
+      reinterpret_cast<char*>(std::next(
+          output.data(), static_cast<std::ptrdiff_t>(offset))),
+      common_fields);
+}
+
+auto HttpResponse::HeaderSize(std::string_view common_fields) const
+    -> std::size_t {
+  std::size_t size = common_fields.size();
   for (const auto& field : header_fields()) {
-    header << field.name << ": " << field.value << "\r\n";
+    size += field.name.size() + FIELD_SEPARATOR.size() + field.value.size() +
+            CRLF.size();
+  }
+
+  if (prepared_) {
+    return size + prepared_->status_line().size() + prepared_tail().size();
   }
 
-  header << "\r\n";
+  if (header_template_) {
+    size += header_template_->layout_->block.size();
+  } else if (reason_) {
+    size += StatusLinePrefix(status_code_).size() + reason_->size() +
+            CRLF.size();
+  } else {
+    size += StatusLine(status_code_).size();
+  }
 
-  const auto header_string = header.str();
-  ByteArray result{reinterpret_cast<const std::byte*>(header_string.data()),
-                   header_string.size()};
-  if (body()) {
-    result.append(body().value());
+  if (HasContentLengthLine()) {
+    size += CONTENT_LENGTH_PREFIX.size() + DecimalSize(*content_length_) +
+            CRLF.size();
   }
 
+  return size + CRLF.size();
+}
+
+auto HttpResponse::BodySize() const noexcept -> std::size_t {
+  if (prepared_ || body_omitted_) {
+    return 0;
+  }
+  if (file_body_) {
+    return file_body_->size;
+  }
+  if (!file_body_parts_.empty()) {
+    std::size_t size = 0;
+    for (const auto& part : file_body_parts_) {
+      size += part.prefix.size() + part.file.size;
+    }
+    return size;
+  }
+  return body() ? body()->size() : 0;
+}
+
+char* HttpResponse::SerializeHeader(char* cursor,
+                                    std::string_view common_fields) const {
+  if (prepared_) {
+    const auto status_line = prepared_->status_line();
+    const auto tail = prepared_tail();
+    std::memcpy(cursor, status_line.data(), status_line.size());
+    cursor = Append(
+        std::next(cursor, static_cast<std::ptrdiff_t>(status_line.size())),
+        common_fields);
+    cursor = AppendFields(cursor, header_fields());
+    std::memcpy(cursor, tail.data(), tail.size());
+    return std::next(cursor, static_cast<std::ptrdiff_t>(tail.size()));
+  }
+
+  if (header_template_) {
+    cursor = SerializeTemplate(cursor, common_fields);
+  } else {
+    if (reason_) {
+      cursor = Append(cursor, StatusLinePrefix(status_code_));
+      cursor = Append(cursor, *reason_);
+      cursor = Append(cursor, CRLF);
+    } else {
+      cursor = Append(cursor, StatusLine(status_code_));
+    }
+    cursor = Append(cursor, common_fields);
+  }
+
+  cursor = AppendFields(cursor, header_fields());
+
+  if (HasContentLengthLine()) {
+    cursor = Append(cursor, CONTENT_LENGTH_PREFIX);
+    cursor = std::to_chars(cursor, std::next(cursor, MAX_DECIMAL_SIZE),
+                           *content_length_)
+                 .ptr;
+    cursor = Append(cursor, CRLF);
+  }
+
+  return Append(cursor, CRLF);
+}
+
+bool HttpResponse::HasContentLengthLine() const noexcept {
+  // A content-length slot of the template takes precedence
+  return content_length_ &&
+         !(header_template_ && header_template_->has_content_length_slot());
+}
+
+char* HttpResponse::SerializeTemplate(char* cursor,
+                                      std::string_view common_fields) const {
+  const auto& layout = *header_template_->layout_;
+  const std::string_view block = layout.block;
+  cursor = Append(cursor, block.substr(0, layout.status_line_size));
+  cursor = Append(cursor, common_fields);
+
+  char* const fields = cursor;
+  cursor = Append(cursor, block.substr(layout.status_line_size));
+
+  const std::size_t content_length =
+      content_length_ ? *content_length_ : BodySize();
+
+  for (const auto& slot : layout.slots) {
+    char* const value = std::next(
+        fields,
+        static_cast<std::ptrdiff_t>(slot.offset - layout.status_line_size));
+    if (slot.is_content_length) {
+      // The block already holds the padding behind the digits
+      const auto [end, error] = std::to_chars(
+          value, std::next(value, static_cast<std::ptrdiff_t>(slot.width)),
+          content_length);
+      if (error != std::errc{}) {
+        throw HttpSerializeError("Content length is wider than its slot");
+      }
+      continue;
+    }
+    std::memcpy(value, std::next(slot_values_.data(), slot.storage_offset),
+                slot.width);
+  }
+
+  return cursor;
+}
+
+auto HttpResponse::Serialize(std::string_view common_fields) const
+    -> ByteArray {
+  ByteArray result;
+  SerializeTo(result, common_fields);
   return result;
 }
 
-HttpServer::HttpServer(std::uint16_t port) : TcpServer(port) {};
+PreparedResponse::PreparedResponse(const HttpResponse& response)
+    : status_code_(response.status_code()) {
+  auto data = std::make_shared<ByteArray>(response.Serialize());
+
+  // A status line never contains CRLF, so the first one ends it, and the
+  // first empty line ends the fields
+  constexpr std::array<std::byte, 4> HEADER_END = {
+      std::byte{'\r'}, std::byte{'\n'}, std::byte{'\r'}, std::byte{'\n'}};
+  const ByteArrayView line_end(HEADER_END.data(), 2);
+  const ByteArrayView header_end(HEADER_END.data(), HEADER_END.size());
+  status_line_size_ = data->find(line_end) + line_end.size();
+  header_size_ = data->find(header_end) + header_end.size();
+  data_ = std::move(data);
+}
 
-void HttpServer::OnData(const Socket& socket, const ByteArrayView& data) {
-  auto parser_iterator = parser_table.find(socket.socket_fd());
-  if (parser_iterator == parser_table.end()) {
-    std::tie(parser_iterator, std::ignore) = parser_table.insert(std::make_pair(
-        socket.socket_fd(), [this, socket](const HttpRequest& req) {
-          socket.Write(OnRequest(req).Serialize());
-        }));
+HeaderTemplate::HeaderTemplate(HttpStatusCode status_code,
+                               const HeaderFields& fields,
+                               const std::vector<TemplateSlot>& slots) {
+  auto layout = std::make_shared<Layout>();
+  layout->status_code = status_code;
+  layout->block = StatusLine(status_code);
+  layout->status_line_size = layout->block.size();
+  layout->storage_size = 0;
+  layout->has_content_length_slot = false;
+
+  for (const auto& field : fields) {
+    layout->block.append(field.name).append(FIELD_SEPARATOR);
+    layout->block.append(field.value).append(CRLF);
   }
 
-  try {
-    parser_iterator->second.Feed(data);
-    return;
-  } catch (const HttpParseError& parse_error) {
-    std::cerr << "HTTP request parse failed: " << parse_error.what()
-              << std::endl;
-  } catch (const HttpSerializeError& serialize_error) {
-    std::cerr << "HTTP response serialize failed: " << serialize_error.what()
-              << std::endl;
+  for (const auto& slot : slots) {
+    const bool is_content_length = slot.name == "content-length";
+    if (!is_content_length) {
+      if (layout->storage_size + slot.width > MAX_SLOT_STORAGE) {
+        throw HttpSerializeError("Template slots are too wide");
+      }
+    }
+
+    layout->block.append(slot.name).append(FIELD_SEPARATOR);
+    layout->slots.push_back(
+        SlotLayout{.offset = layout->block.size(),
+                   .width = slot.width,
+                   .storage_offset = layout->storage_size,
+                   .is_content_length = is_content_length});
+    layout->block.append(slot.width, ' ').append(CRLF);
+    layout->storage_size += is_content_length ? 0 : slot.width;
+    layout->has_content_length_slot |= is_content_length;
   }
 
-  socket.Close();
+  layout_ = std::move(layout);
+}
+
+auto PreparedResponse::status_line() const noexcept -> ByteArrayView {
+  return ByteArrayView(*data_).substr(0, status_line_size_);
 }
 
-void HttpServer::OnClose(const Socket& socket) {
-  parser_table.erase(socket.socket_fd());
-}
\ No newline at end of file
+auto PreparedResponse::fields_and_body() const noexcept -> ByteArrayView {
+  return ByteArrayView(*data_).substr(status_line_size_);
+}
+
+auto PreparedResponse::fields() const noexcept -> ByteArrayView {
+  return ByteArrayView(*data_).substr(status_line_size_,
+                                      header_size_ - status_line_size_);
+}
+
+void HttpMetrics::RecordResponse(HttpStatusCode status_code) noexcept {
+  const auto status_class = static_cast<std::size_t>(status_code) / 100;
+  responses[std::clamp<std::size_t>(status_class, 1, STATUS_CLASS_COUNT) - 1]
+      .Add();
+}
+
+void HttpMetrics::WriteTo(MetricsWriter& writer) const {
+  std::string labels;
+  writer.Family("http1_requests_total", "counter",
+                "Parsed requests by method.");
+  for (std::size_t method = 1; method < requests.size(); ++method) {
+    labels.assign("method=\"").append(METHOD_NAMES[method]).append("\"");
+    writer.Sample("http1_requests_total", labels, requests[method].value());
+  }
+
+  writer.Family("http1_responses_total", "counter",
+                "Responses by status class.");
+  for (std::size_t index = 0; index < responses.size(); ++index) {
+    labels.assign("class=\"").append(std::to_string(index + 1)).append("xx\"");
+    writer.Sample("http1_responses_total", labels, responses[index].value());
+  }
+
+  writer.Family("http1_parse_errors_total", "counter",
+                "Requests that could not be parsed, by the failing part.");
+  for (std::size_t kind = 0; kind < parse_errors.size(); ++kind) {
+    labels.assign("kind=\"").append(PARSE_ERROR_KIND_NAMES[kind]).append("\"");
+    writer.Sample("http1_parse_errors_total", labels,
+                  parse_errors[kind].value());
+  }
+}
+
+void LatencyMetrics::WriteTo(MetricsWriter& writer) const {
+  writer.Family("http1_request_phase_seconds", "summary",
+                "Request latency by phase: parse, handle, serialize and "
+                "write to the kernel.");
+  std::string labels;
+  for (std::size_t phase = 0; phase < phases.size(); ++phase) {
+    HistogramSnapshot snapshot;
+    snapshot.Merge(phases[phase]);
+    labels.assign("phase=\"")
+        .append(REQUEST_PHASE_NAMES[phase])
+        .append("\"");
+    writer.Summary("http1_request_phase_seconds", labels, snapshot);
+  }
+}
+
+HttpResponse http1::MakeMetricsResponse(std::string_view text) {
+  HttpResponse response(HttpStatusCode::OK);
+  response.AddField(
+      HeaderField{.name = "content-type",
+                  .value = std::string(MetricsWriter::CONTENT_TYPE)});
+  response.SetContentLength(text.size());
+  response.SetOwnedBody(
+      ByteArray(reinterpret_cast<const std::byte*>(text.data()), text.size()));
+  return response;
+}
+
+HttpConnection::HttpConnection(std::uint64_t id) : id(id) {}
+
+void HttpConnection::Complete(const TcpServerCore::Socket& socket,
+                              std::uint64_t sequence, ByteArray response) {
+  finished.emplace(sequence, std::move(response));
+
+  auto finished_iterator = finished.begin();
+  while (finished_iterator != finished.end() &&
+         finished_iterator->first == next_to_write) {
+    socket.Write(finished_iterator->second);
+    ++next_to_write;
+    finished_iterator = finished.erase(finished_iterator);
+  }
+}
+
+HttpServer::HttpServer(std::uint16_t port) : BasicHttpServer(port) {}
+
+HttpServer::~HttpServer() = default;
+
+bool HttpServer::ShouldOffload(const HttpRequest& /*request*/) const {
+  return false;
+}
+
+bool http1::IsCompressible(std::string_view content_type) noexcept {
+  const std::string_view media_type =
+      TrimWhitespace(content_type.substr(0, content_type.find(';')));
+  const std::size_t slash = media_type.find('/');
+  if (slash == std::string_view::npos) {
+    return false;
+  }
+
+  const std::string_view type = media_type.substr(0, slash);
+  const std::string_view subtype = media_type.substr(slash + 1);
+  if (EqualsLowercase("text", type)) {
+    return true;
+  }
+
+  // Structured syntax suffixes of RFC 6839, e.g. application/ld+json
+  const std::size_t plus = subtype.rfind('+');
+  const std::string_view syntax =
+      plus == std::string_view::npos ? subtype : subtype.substr(plus + 1);
+  for (const std::string_view compressible :
+       {"json", "xml", "javascript", "ecmascript", "wasm", "x-yaml",
+        "yaml"}) {
+    if (EqualsLowercase(compressible, syntax)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool http1::CompressResponse(const HttpRequest& request,
+                             HttpResponse& response,
+                             const CompressionOptions& options) {
+  const HttpStatusCode status_code = response.status_code();
+  if (response.prepared() || response.file_body() || !response.body() ||
+      status_code == HttpStatusCode::PartialContent ||
+      status_code == HttpStatusCode::NoContent ||
+      response.FindField("content-encoding")) {
+    return false;
+  }
+
+  const ByteArrayView body = *response.body();
+  const auto content_type = response.FindField("content-type");
+  const auto content_length = response.content_length();
+  // Responses may also carry their length as a plain field, which is then
+  // rewritten along with the body
+  const auto content_length_field = response.FindField("content-length");
+  if (body.size() < options.min_size || !content_type ||
+      !IsCompressible(*content_type) ||
+      (content_length && *content_length != body.size()) ||
+      (content_length_field &&
+       *content_length_field != std::to_string(body.size()))) {
+    return false;
+  }
+
+  // Caches must not hand the encoded body to clients not accepting it
+  const auto vary = response.FindField("vary");
+  if (!vary) {
+    response.AddField(HeaderField{.name = "vary", .value = "accept-encoding"});
+  } else if (*vary != "*" &&
+             vary->find("accept-encoding") == std::string::npos) {
+    response.SetField(HeaderField{
+        .name = "vary", .value = std::string(*vary) + ", accept-encoding"});
+  }
+
+  const auto accept_encoding = request.FindField("accept-encoding");
+  const AcceptedCodings accepted = accept_encoding
+                                       ? ParseAcceptEncoding(*accept_encoding)
+                                       : AcceptedCodings();
+  const std::uint16_t gzip_quality = accepted.quality(ContentCoding::Gzip);
+  if (gzip_quality == 0 ||
+      gzip_quality < accepted.quality(ContentCoding::Identity)) {
+    return false;
+  }
+
+  ByteArray compressed = GzipCompress(body, options.level);
+  if (compressed.size() >= body.size()) {
+    return false;
+  }
+
+  if (const auto etag = response.FindField("etag");
+      etag && etag->starts_with('"')) {
+    response.SetField(
+        HeaderField{.name = "etag", .value = "W/" + std::string(*etag)});
+  }
+  response.AddField(HeaderField{.name = "content-encoding", .value = "gzip"});
+  if (content_length) {
+    response.SetContentLength(compressed.size());
+  }
+  if (content_length_field) {
+    response.SetField(HeaderField{.name = "content-length",
+                                  .value = std::to_string(compressed.size())});
+  }
+  response.SetOwnedBody(std::move(compressed));
+  return true;
+}
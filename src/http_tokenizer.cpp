@@ -0,0 +1,109 @@
+#include "http_tokenizer.hpp"
+
+#include "http_server.hpp"
+
+using http1::FieldTokens;
+using http1::HttpParseError;
+using http1::HttpParseErrorKind;
+using http1::HttpTokenizer;
+using http1::RequestLineTokens;
+
+HttpTokenizer::HttpTokenizer(std::string_view header) noexcept
+    : header_(header) {}
+
+RequestLineTokens HttpTokenizer::ParseRequestLine() {
+  RequestLineTokens tokens;
+
+  tokens.method = Scan(TOKEN_CHAR);
+  if (tokens.method.size == 0 || !Skip(' ')) {
+    throw HttpParseError(HttpParseErrorKind::RequestLine,
+                         "Can not parse method from request line");
+  }
+
+  tokens.target = Scan(TARGET_CHAR);
+  if (tokens.target.size == 0 || !Skip(' ')) {
+    throw HttpParseError(HttpParseErrorKind::RequestLine,
+                         "Can not parse path from request line");
+  }
+
+  tokens.version = Scan(TARGET_CHAR);
+  if (tokens.version.size == 0) {
+    throw HttpParseError(HttpParseErrorKind::RequestLine,
+                         "Can not parse version from request line");
+  }
+  ExpectLineEnd(HttpParseErrorKind::RequestLine);
+
+  return tokens;
+}
+
+bool HttpTokenizer::NextField(FieldTokens& tokens,
+                              std::string& lowercase_name) {
+  const std::size_t size = header_.size();
+  if (position_ < size && header_[position_] == '\r') {
+    ExpectLineEnd(HttpParseErrorKind::Field);
+    return false;
+  }
+
+  lowercase_name.clear();
+  tokens.name.offset = position_;
+  while (position_ < size) {
+    const char character = header_[position_];
+    if ((ClassOf(character) & TOKEN_CHAR) == 0) {
+      break;
+    }
+    lowercase_name.push_back(
+        LOWERCASE_TABLE[static_cast<unsigned char>(character)]);
+    ++position_;
+  }
+  tokens.name.size = position_ - tokens.name.offset;
+
+  // No whitespace is allowed between the field name and the colon
+  if (tokens.name.size == 0 || !Skip(':')) {
+    throw HttpParseError(HttpParseErrorKind::Field, "Invalid header field");
+  }
+  Scan(WHITESPACE_CHAR);
+
+  // Trailing whitespace is trimmed by remembering the end of the last
+  // visible character instead of scanning backwards.
+  tokens.value.offset = position_;
+  std::size_t value_end = position_;
+  while (position_ < size) {
+    const std::uint8_t char_class = ClassOf(header_[position_]);
+    if ((char_class & (FIELD_VALUE_CHAR | WHITESPACE_CHAR)) == 0) {
+      break;
+    }
+    ++position_;
+    value_end = (char_class & FIELD_VALUE_CHAR) != 0 ? position_ : value_end;
+  }
+  tokens.value.size = value_end - tokens.value.offset;
+
+  ExpectLineEnd(HttpParseErrorKind::Field);
+  return true;
+}
+
+void HttpTokenizer::ExpectLineEnd(HttpParseErrorKind kind) {
+  if (position_ + 1 >= header_.size() || header_[position_] != '\r' ||
+      header_[position_ + 1] != '\n') {
+    throw HttpParseError(kind, kind == HttpParseErrorKind::RequestLine
+                                   ? "Invalid character in request line"
+                                   : "Invalid character in header");
+  }
+  position_ += 2;
+}
+
+http1::TokenRange HttpTokenizer::Scan(std::uint8_t char_class) noexcept {
+  const std::size_t offset = position_;
+  while (position_ < header_.size() &&
+         (ClassOf(header_[position_]) & char_class) != 0) {
+    ++position_;
+  }
+  return TokenRange{.offset = offset, .size = position_ - offset};
+}
+
+bool HttpTokenizer::Skip(char expected) noexcept {
+  if (position_ >= header_.size() || header_[position_] != expected) {
+    return false;
+  }
+  ++position_;
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "loop_monitor.hpp"
+
+#include <signal.h>
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+
+using http1::LoopMonitor;
+
+namespace {
+
+// Packs text into words stored one by one, so that a reader racing with the
+// loop reads torn words at worst, which the sequence check discards
+void StoreText(std::span<std::atomic<std::uint64_t>> words,
+               std::string_view text) noexcept {
+  for (std::size_t offset = 0, index = 0; offset < text.size();
+       offset += sizeof(std::uint64_t), ++index) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, text.data() + offset,
+                std::min(sizeof(word), text.size() - offset));
+    words[index].store(word, std::memory_order_relaxed);
+  }
+}
+
+std::string LoadText(std::span<const std::atomic<std::uint64_t>> words,
+                     std::size_t size) {
+  std::string text(size, '\0');
+  for (std::size_t offset = 0, index = 0; offset < size;
+       offset += sizeof(std::uint64_t), ++index) {
+    const std::uint64_t word = words[index].load(std::memory_order_relaxed);
+    std::memcpy(text.data() + offset, &word,
+                std::min(sizeof(word), size - offset));
+  }
+  return text;
+}
+
+}  // namespace
+
+void LoopMonitor::SetLoopThread() noexcept {
+  const std::lock_guard lock(loop_thread_mutex_);
+  loop_thread_ = pthread_self();
+}
+
+void LoopMonitor::ClearLoopThread() noexcept {
+  const std::lock_guard lock(loop_thread_mutex_);
+  loop_thread_.reset();
+}
+
+bool LoopMonitor::SignalLoopThread(int signal) noexcept {
+  const std::lock_guard lock(loop_thread_mutex_);
+  return loop_thread_ && pthread_kill(*loop_thread_, signal) == 0;
+}
+
+// The request is published as a sequence lock: readers retry when the
+// sequence was odd or changed while they copied the fields.
+void LoopMonitor::BeginRequest(std::string_view method, std::string_view path,
+                               std::uint64_t connection_id) noexcept {
+  path = path.substr(0, MAX_PATH_SIZE);
+  std::uint64_t method_word = 0;
+  std::memcpy(&method_word, method.data(), std::min(method.size(), WORD_SIZE));
+
+  const std::uint64_t sequence =
+      request_.sequence.load(std::memory_order_relaxed);
+  request_.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  request_.start_time.store(MonotonicNanoseconds(), std::memory_order_relaxed);
+  request_.connection_id.store(connection_id, std::memory_order_relaxed);
+  request_.method.store(method_word, std::memory_order_relaxed);
+  request_.path_size.store(path.size(), std::memory_order_relaxed);
+  StoreText(request_.path, path);
+
+  request_.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void LoopMonitor::EndRequest() noexcept {
+  const std::uint64_t sequence =
+      request_.sequence.load(std::memory_order_relaxed);
+  request_.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  request_.start_time.store(0, std::memory_order_relaxed);
+  request_.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+auto LoopMonitor::request() const -> std::optional<Request> {
+  while (true) {
+    const std::uint64_t sequence =
+        request_.sequence.load(std::memory_order_acquire);
+    if (sequence % 2 == 1) {
+      continue;
+    }
+
+    Request request{
+        .method = {},
+        .path = {},
+        .connection_id =
+            request_.connection_id.load(std::memory_order_relaxed),
+        .start_time = request_.start_time.load(std::memory_order_relaxed)};
+    if (request.start_time != 0) {
+      const std::uint64_t method =
+          request_.method.load(std::memory_order_relaxed);
+      request.method.assign(reinterpret_cast<const char*>(&method),
+                            strnlen(reinterpret_cast<const char*>(&method),
+                                    sizeof(method)));
+      request.path = LoadText(
+          request_.path,
+          std::min<std::size_t>(
+              request_.path_size.load(std::memory_order_relaxed),
+              MAX_PATH_SIZE));
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (request_.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+    if (request.start_time == 0) {
+      return std::nullopt;
+    }
+    return request;
+  }
+}
+
+void LoopMonitor::WriteTo(MetricsWriter& writer) const {
+  HistogramSnapshot snapshot;
+  snapshot.Merge(iteration_durations_);
+  writer.Family("http1_loop_iteration_seconds", "summary",
+                "Time from an epoll_wait wakeup until the loop waits again.");
+  writer.Summary("http1_loop_iteration_seconds", {}, snapshot);
+}
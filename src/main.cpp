@@ -1,66 +1,78 @@
-#include <fstream>
-#include <gsl/narrow>
-#include <iostream>
-#include <sstream>
+#include <unistd.h>
+
 #include <string>
+#include <utility>
 
+#include "access_log.hpp"
 #include "http_server.hpp"
+#include "pipeline.hpp"
+#include "router.hpp"
+#include "static_file_handler.hpp"
+#include "static_routes.hpp"
+#include "watchdog.hpp"
 
 class ExampleHttpServer : public http1::HttpServer {
  public:
-  explicit ExampleHttpServer(std::uint16_t port) : HttpServer(port) {
-    index = open_file("index.html");
-    background = open_file("bg.jpg");
+  explicit ExampleHttpServer(std::uint16_t port)
+      : HttpServer(port),
+        static_files("/", "asset"),
+        health_response(make_health_response()) {
+    static_files.WatchChanges(*this);
+
+    // Every path without a static route is looked up below the "/" prefix
+    // of static_files
+    pipeline.layer<http1::Router>().Add(
+        http1::HttpMethod::Get, "/*path",
+        [this](const http1::HttpRequest& req,
+               const http1::RouteParams& /*params*/) {
+          return static_files.Handle(req).value();
+        });
   }
 
  private:
-  static http1::ByteArray open_file(const std::string& path) {
-    std::ifstream file(path, std::ios::binary);
-    if (!file) {
-      throw std::invalid_argument("Can not open file: " + path);
-    }
-
-    file.seekg(0, std::ios::end);
-    const std::size_t size = file.tellg();
-
-    file.seekg(0, std::ios::beg);
-
-    http1::ByteArray content(size, std::byte{0});
-
-    file.read(reinterpret_cast<char*>(content.data()),
-              gsl::narrow<std::streamsize>(size));
-    file.close();
+  // Constant responses are serialized once and written by reference
+  static http1::PreparedResponse make_health_response() {
+    static constexpr std::string_view BODY = "ok";
+    http1::HttpResponse res(http1::HttpStatusCode::OK);
+    res.SetBody(http1::ByteArrayView(
+        reinterpret_cast<const std::byte*>(BODY.data()), BODY.size()));
+    res.SetContentLength(BODY.size());
+    res.AddField(
+        http1::HeaderField{.name = "content-type", .value = "text/plain"});
+    return http1::PreparedResponse(res);
+  }
 
-    return content;
+  http1::HttpResponse Health(const http1::HttpRequest& /*req*/) {
+    return health_response;
   }
 
+  // Exact paths resolved through a perfect hash table built at compile time
+  using StaticRoutes = http1::StaticRouteTable<
+      http1::Route<"/health", http1::HttpMethod::Get,
+                   &ExampleHttpServer::Health>>;
+
   http1::HttpResponse OnRequest(const http1::HttpRequest& req) override {
-    http1::HttpResponse res(http1::HttpStatusCode::OK);
-    if (req.path() == "/") {
-      res.SetBody(index);
-      res.AddField(http1::HeaderField{.name = "content-length",
-                                      .value = std::to_string(index.size())});
-      res.AddField(http1::HeaderField{.name = "content-type",
-                                      .value = "text/html; charset=UTF-8"});
-    } else if (req.path() == "/bg.jpg") {
-      res.SetBody(background);
-      res.AddField(
-          http1::HeaderField{.name = "content-length",
-                             .value = std::to_string(background.size())});
-      res.AddField(
-          http1::HeaderField{.name = "content-type", .value = "image/jpeg"});
+    if (auto response = StaticRoutes::Dispatch(req, *this)) {
+      return std::move(*response);
     }
-
-    return res;
+    return pipeline.Handle(req);
   }
 
-  http1::ByteArray index;
-  http1::ByteArray background;
+  http1::StaticFileHandler static_files;
+  http1::PreparedResponse health_response;
+  // Routed responses are tagged with an x-request-id
+  http1::Pipeline<http1::RequestId, http1::Router> pipeline;
 };
 
 int main() {
   constexpr std::uint16_t DEFAULT_PORT = 8000;
   auto server = ExampleHttpServer(DEFAULT_PORT);
+  server.SetServerName("http1");
+  server.EnableMetrics("/metrics");
+  http1::AccessLog access_log(STDOUT_FILENO);
+  server.EnableAccessLog(access_log);
+  http1::Watchdog watchdog(STDERR_FILENO);
+  watchdog.Watch(server.loop_monitor());
   server.Start();
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,42 @@
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+#include "syscall_wrapper.hpp"
+
+using http1::MappedFile;
+
+MappedFile::MappedFile(const std::string& path) {
+  fd_ = wrap_syscall(open(path.c_str(), O_RDONLY | O_CLOEXEC),
+                     "Can not open file");
+
+  try {
+    wrap_syscall(fstat(fd_, &status_), "Can not stat file");
+    if (!S_ISREG(status_.st_mode)) {
+      throw std::invalid_argument("Not a regular file: " + path);
+    }
+
+    // Empty files can not be mapped and need no mapping
+    if (size() > 0) {
+      address_ = mmap(nullptr, size(), PROT_READ, MAP_PRIVATE, fd_, 0);
+      if (address_ == MAP_FAILED) {
+        address_ = nullptr;
+        wrap_syscall(-1, "Can not map file");
+      }
+    }
+  } catch (...) {
+    close(fd_);
+    throw;
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (address_ != nullptr) {
+    munmap(address_, size());
+  }
+  close(fd_);
+}
@@ -0,0 +1,115 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <utility>
+
+using http1::Histogram;
+using http1::HistogramSnapshot;
+using http1::MetricsWriter;
+
+namespace {
+
+template <class Number>
+void AppendDecimal(std::string& output, Number value) {
+  std::array<char, 32> digits{};
+  const auto result =
+      std::to_chars(digits.data(), digits.data() + digits.size(), value);
+  output.append(digits.data(), result.ptr);
+}
+
+}  // namespace
+
+void HistogramSnapshot::Merge(const Histogram& histogram) noexcept {
+  // Counted from the buckets rather than a separate total, so that count
+  // and quantiles agree while the writer goes on
+  for (std::size_t index = 0; index < counts_.size(); ++index) {
+    const std::uint64_t count = histogram.counts_[index].value();
+    counts_[index] += count;
+    count_ += count;
+  }
+  sum_ += histogram.sum_.value();
+}
+
+std::uint64_t HistogramSnapshot::ValueAtQuantile(
+    double quantile) const noexcept {
+  if (count_ == 0) {
+    return 0;
+  }
+  const auto rank = std::max<std::uint64_t>(
+      1, static_cast<std::uint64_t>(
+             std::ceil(quantile * static_cast<double>(count_))));
+
+  std::uint64_t seen = 0;
+  for (std::size_t index = 0; index < counts_.size(); ++index) {
+    seen += counts_[index];
+    if (seen >= rank) {
+      return Histogram::HighestValueOf(index);
+    }
+  }
+  return Histogram::MAX_VALUE;
+}
+
+void MetricsWriter::Family(std::string_view name, std::string_view type,
+                           std::string_view help) {
+  output_.append("# HELP ").append(name).append(" ").append(help);
+  output_.append("\n# TYPE ").append(name).append(" ").append(type);
+  output_.append("\n");
+}
+
+void MetricsWriter::Sample(std::string_view name, std::string_view labels,
+                           std::uint64_t value) {
+  SampleName(name, labels);
+  AppendDecimal(output_, value);
+  output_.append("\n");
+}
+
+void MetricsWriter::Sample(std::string_view name, std::string_view labels,
+                           std::int64_t value) {
+  SampleName(name, labels);
+  AppendDecimal(output_, value);
+  output_.append("\n");
+}
+
+void MetricsWriter::Sample(std::string_view name, std::string_view labels,
+                           double value) {
+  SampleName(name, labels);
+  AppendDecimal(output_, value);
+  output_.append("\n");
+}
+
+void MetricsWriter::Summary(std::string_view name, std::string_view labels,
+                            const HistogramSnapshot& snapshot) {
+  constexpr std::array<std::pair<double, std::string_view>, 3> QUANTILES = {
+      {{0.5, "0.5"}, {0.99, "0.99"}, {0.999, "0.999"}}};
+  constexpr double NANOSECONDS_PER_SECOND = 1e9;
+
+  std::string quantile_labels;
+  for (const auto& [quantile, quantile_name] : QUANTILES) {
+    quantile_labels.assign(labels);
+    if (!labels.empty()) {
+      quantile_labels.append(",");
+    }
+    quantile_labels.append("quantile=\"").append(quantile_name).append("\"");
+    Sample(name, quantile_labels,
+           static_cast<double>(snapshot.ValueAtQuantile(quantile)) /
+               NANOSECONDS_PER_SECOND);
+  }
+
+  std::string total_name(name);
+  Sample(total_name.append("_sum"), labels,
+         static_cast<double>(snapshot.sum()) / NANOSECONDS_PER_SECOND);
+  total_name.assign(name);
+  Sample(total_name.append("_count"), labels, snapshot.count());
+}
+
+void MetricsWriter::SampleName(std::string_view name,
+                               std::string_view labels) {
+  output_.append(name);
+  if (!labels.empty()) {
+    output_.append("{").append(labels).append("}");
+  }
+  output_.append(" ");
+}
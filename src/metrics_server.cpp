@@ -0,0 +1,20 @@
+#include "metrics_server.hpp"
+
+using http1::HttpResponse;
+using http1::MetricsServer;
+
+MetricsServer::MetricsServer(std::uint16_t port, Source source)
+    : BasicHttpServer(port), source_(std::move(source)) {}
+
+HttpResponse MetricsServer::OnRequest(const HttpRequest& request) {
+  if (request.method() != HttpMethod::Get) {
+    HttpResponse response(HttpStatusCode::MethodNotAllowed);
+    response.AddField(HeaderField{.name = "allow", .value = "GET"});
+    response.SetContentLength(0);
+    return response;
+  }
+
+  std::string text;
+  source_(text);
+  return MakeMetricsResponse(text);
+}
@@ -0,0 +1,92 @@
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <utility>
+
+using http1::Cors;
+using http1::HeaderField;
+using http1::HttpResponse;
+using http1::RequestId;
+
+namespace {
+
+constexpr bool IsRequestIdChar(char character) noexcept {
+  return (character >= 'a' && character <= 'z') ||
+         (character >= 'A' && character <= 'Z') ||
+         (character >= '0' && character <= '9') || character == '-' ||
+         character == '_' || character == '.' || character == ':';
+}
+
+std::string RandomRequestId() {
+  // One generator per thread, so that loops and workers never contend
+  thread_local std::mt19937_64 generator{std::random_device{}()};
+  constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+
+  std::uint64_t value = generator();
+  std::string id(16, '0');
+  for (char& digit : id) {
+    digit = HEX_DIGITS[value & 0xF];
+    value >>= 4;
+  }
+  return id;
+}
+
+}  // namespace
+
+std::string RequestId::Of(const HttpRequest& request) {
+  const auto id = request.FindField(FIELD_NAME);
+  if (id && !id->empty() && id->size() <= MAX_SIZE &&
+      std::all_of(id->begin(), id->end(), IsRequestIdChar)) {
+    return std::string(*id);
+  }
+  return RandomRequestId();
+}
+
+Cors::Cors(CorsOptions options) : options_(std::move(options)) {}
+
+bool Cors::IsAllowed(std::string_view origin) const noexcept {
+  return options_.allowed_origins.empty() ||
+         std::find(options_.allowed_origins.begin(),
+                   options_.allowed_origins.end(),
+                   origin) != options_.allowed_origins.end();
+}
+
+bool Cors::IsPreflight(const HttpRequest& request) noexcept {
+  return request.method() == HttpMethod::Options &&
+         request.FindField("access-control-request-method");
+}
+
+HttpResponse Cors::Preflight(std::string_view origin) const {
+  HttpResponse response(HttpStatusCode::NoContent);
+  AddFields(origin, true, response);
+  response.AddField(HeaderField{.name = "access-control-allow-methods",
+                                .value = options_.allowed_methods});
+  response.AddField(HeaderField{.name = "access-control-allow-headers",
+                                .value = options_.allowed_headers});
+  response.AddField(HeaderField{.name = "access-control-max-age",
+                                .value = std::to_string(options_.max_age)});
+  return response;
+}
+
+void Cors::AddFields(std::string_view origin, bool allowed,
+                     HttpResponse& response) const {
+  // Credentialed requests must not see "*" and get the origin echoed
+  const bool per_origin =
+      !options_.allowed_origins.empty() || options_.allow_credentials;
+  if (allowed) {
+    response.AddField(
+        HeaderField{.name = "access-control-allow-origin",
+                    .value = per_origin ? std::string(origin) : "*"});
+    if (options_.allow_credentials) {
+      response.AddField(HeaderField{
+          .name = "access-control-allow-credentials", .value = "true"});
+    }
+  }
+  // Caches must keep the responses for different origins apart
+  if (per_origin) {
+    response.AddField(HeaderField{.name = "vary", .value = "origin"});
+  }
+}
@@ -0,0 +1,292 @@
+#include "router.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using http1::HeaderField;
+using http1::HttpMethod;
+using http1::HttpResponse;
+using http1::HttpStatusCode;
+using http1::Router;
+using http1::RouteParams;
+using http1::RouteStatus;
+
+namespace {
+
+constexpr std::size_t METHOD_COUNT = http1::METHOD_NAMES.size();
+
+// Position of the next "{" or "*" starting a segment of pattern, or npos.
+// Throws for braces anywhere else.
+std::size_t FindParameter(std::string_view pattern) {
+  for (std::size_t index = 0; index < pattern.size(); ++index) {
+    const char character = pattern[index];
+    const bool starts_segment = index > 0 && pattern[index - 1] == '/';
+    if ((character == '{' || character == '*') && starts_segment) {
+      return index;
+    }
+    if (character == '{' || character == '}') {
+      throw std::invalid_argument("Parameters must be whole path segments");
+    }
+  }
+  return std::string_view::npos;
+}
+
+void ValidateName(std::string_view name) {
+  if (name.empty() ||
+      name.find_first_of("/{}*") != std::string_view::npos) {
+    throw std::invalid_argument("Invalid route parameter name");
+  }
+}
+
+}  // namespace
+
+struct Router::Endpoint {
+  std::array<Handler, METHOD_COUNT> handlers;
+  std::string allow;
+};
+
+struct Router::Node {
+  std::string prefix;
+  // First byte of the prefix of each literal child, in the same order
+  std::string indices;
+  std::vector<std::unique_ptr<Node>> children;
+  // Reached by a {name} segment, with an empty prefix
+  std::unique_ptr<Node> parameter;
+  // Reached by a final *name segment
+  std::unique_ptr<Node> wildcard;
+  // Of the parameter or wildcard leading to this node
+  std::string name;
+  std::unique_ptr<Endpoint> endpoint;
+};
+
+std::optional<std::string_view> RouteParams::Find(
+    std::string_view name) const noexcept {
+  for (const RouteParam& param : *this) {
+    if (param.name == name) {
+      return param.value;
+    }
+  }
+  return std::nullopt;
+}
+
+Router::Router() : root_(std::make_unique<Node>()) {}
+
+Router::~Router() = default;
+
+Router::Router(Router&& other) noexcept = default;
+
+Router& Router::operator=(Router&& other) noexcept = default;
+
+void Router::Add(HttpMethod method, std::string_view pattern,
+                 Handler handler) {
+  const auto method_index = static_cast<std::size_t>(method);
+  if (method == HttpMethod::Unknown || method_index >= METHOD_COUNT) {
+    throw std::invalid_argument("Invalid route method");
+  }
+  if (!pattern.starts_with('/')) {
+    throw std::invalid_argument("Route patterns must start with /");
+  }
+
+  // Split into literal text and parameters before touching the tree
+  struct Part {
+    std::string_view literal;
+    std::string_view name;
+    bool is_wildcard;
+  };
+  std::vector<Part> parts;
+  while (!pattern.empty()) {
+    const std::size_t start = FindParameter(pattern);
+    Part part{.literal = pattern.substr(0, start), .name = {},
+              .is_wildcard = false};
+    if (start == std::string_view::npos) {
+      parts.push_back(part);
+      break;
+    }
+
+    pattern.remove_prefix(start);
+    if (pattern.front() == '*') {
+      part.name = pattern.substr(1);
+      part.is_wildcard = true;
+      pattern = {};
+    } else {
+      const std::size_t end = pattern.find('}');
+      if (end == std::string_view::npos) {
+        throw std::invalid_argument("Unterminated route parameter");
+      }
+      part.name = pattern.substr(1, end - 1);
+      pattern.remove_prefix(end + 1);
+      if (!pattern.empty() && pattern.front() != '/') {
+        throw std::invalid_argument("Parameters must be whole path segments");
+      }
+    }
+    ValidateName(part.name);
+    parts.push_back(part);
+  }
+  if (std::ranges::count_if(parts, [](const Part& part) {
+        return !part.name.empty();
+      }) > static_cast<std::ptrdiff_t>(RouteParams::MAX_PARAMS)) {
+    throw std::invalid_argument("Too many route parameters");
+  }
+
+  Node* node = root_.get();
+  for (const Part& part : parts) {
+    node = InsertLiteral(node, part.literal);
+    if (part.name.empty()) {
+      continue;
+    }
+
+    auto& child = part.is_wildcard ? node->wildcard : node->parameter;
+    if (!child) {
+      child = std::make_unique<Node>();
+      child->name = part.name;
+    } else if (child->name != part.name) {
+      throw std::invalid_argument("Conflicting route parameter names");
+    }
+    node = child.get();
+  }
+
+  if (!node->endpoint) {
+    node->endpoint = std::make_unique<Endpoint>();
+  }
+  Endpoint& endpoint = *node->endpoint;
+  if (endpoint.handlers.at(method_index)) {
+    throw std::invalid_argument("Route added twice");
+  }
+  endpoint.handlers.at(method_index) = std::move(handler);
+
+  // GET handlers also answer HEAD
+  endpoint.allow.clear();
+  for (std::size_t index = 1; index < METHOD_COUNT; ++index) {
+    const auto get_index = static_cast<std::size_t>(HttpMethod::Get);
+    if (endpoint.handlers.at(index) ||
+        (index == static_cast<std::size_t>(HttpMethod::Head) &&
+         endpoint.handlers.at(get_index))) {
+      if (!endpoint.allow.empty()) {
+        endpoint.allow.append(", ");
+      }
+      endpoint.allow.append(http1::METHOD_NAMES.at(index));
+    }
+  }
+}
+
+auto Router::InsertLiteral(Node* node, std::string_view text) -> Node* {
+  while (!text.empty()) {
+    const std::size_t index = node->indices.find(text.front());
+    if (index == std::string::npos) {
+      auto child = std::make_unique<Node>();
+      child->prefix = text;
+      node->indices.push_back(text.front());
+      node->children.push_back(std::move(child));
+      return node->children.back().get();
+    }
+
+    std::unique_ptr<Node>& child = node->children[index];
+    std::size_t common = 0;
+    while (common < text.size() && common < child->prefix.size() &&
+           text[common] == child->prefix[common]) {
+      ++common;
+    }
+    if (common < child->prefix.size()) {
+      // Split the child at the first differing byte
+      auto split = std::make_unique<Node>();
+      split->prefix = child->prefix.substr(0, common);
+      child->prefix.erase(0, common);
+      split->indices.push_back(child->prefix.front());
+      split->children.push_back(std::move(child));
+      child = std::move(split);
+    }
+    text.remove_prefix(common);
+    node = child.get();
+  }
+  return node;
+}
+
+auto Router::Lookup(const Node& node, std::string_view rest,
+                    RouteParams& params) noexcept -> const Node* {
+  if (rest.empty()) {
+    if (node.endpoint) {
+      return &node;
+    }
+  } else {
+    const std::size_t index = node.indices.find(rest.front());
+    if (index != std::string::npos) {
+      const Node& child = *node.children[index];
+      if (rest.starts_with(child.prefix)) {
+        const Node* found =
+            Lookup(child, rest.substr(child.prefix.size()), params);
+        if (found != nullptr) {
+          return found;
+        }
+      }
+    }
+
+    if (node.parameter) {
+      const std::size_t end = std::min(rest.find('/'), rest.size());
+      if (end > 0) {
+        params.params_[params.size_++] =
+            RouteParam{.name = node.parameter->name,
+                       .value = rest.substr(0, end)};
+        const Node* found = Lookup(*node.parameter, rest.substr(end), params);
+        if (found != nullptr) {
+          return found;
+        }
+        --params.size_;
+      }
+    }
+  }
+
+  if (node.wildcard && node.wildcard->endpoint) {
+    params.params_[params.size_++] =
+        RouteParam{.name = node.wildcard->name, .value = rest};
+    return node.wildcard.get();
+  }
+  return nullptr;
+}
+
+auto Router::Find(HttpMethod method, std::string_view target,
+                  RouteParams& params) const -> Match {
+  params.size_ = 0;
+  const Node* node = Lookup(*root_, Target(target).path(), params);
+  if (node == nullptr) {
+    return Match{.status = RouteStatus::NotFound, .handler = nullptr,
+                 .allow = {}};
+  }
+
+  const Endpoint& endpoint = *node->endpoint;
+  const auto index = static_cast<std::size_t>(method);
+  const Handler* handler = nullptr;
+  if (method != HttpMethod::Unknown && index < METHOD_COUNT &&
+      endpoint.handlers.at(index)) {
+    handler = &endpoint.handlers.at(index);
+  } else if (const auto& get_handler = endpoint.handlers.at(
+                 static_cast<std::size_t>(HttpMethod::Get));
+             method == HttpMethod::Head && get_handler) {
+    handler = &get_handler;
+  }
+  return Match{.status = handler != nullptr ? RouteStatus::Found
+                                            : RouteStatus::MethodNotAllowed,
+               .handler = handler,
+               .allow = endpoint.allow};
+}
+
+HttpResponse Router::Dispatch(const HttpRequest& request) const {
+  RouteParams params;
+  const Match match = Find(request.method(), request.path(), params);
+  if (match.status == RouteStatus::Found) {
+    return (*match.handler)(request, params);
+  }
+
+  if (match.status == RouteStatus::NotFound) {
+    HttpResponse response(HttpStatusCode::NotFound);
+    response.SetContentLength(0);
+    return response;
+  }
+  HttpResponse response(HttpStatusCode::MethodNotAllowed);
+  response.AddField(
+      HeaderField{.name = "allow", .value = std::string(match.allow)});
+  response.SetContentLength(0);
+  return response;
+}
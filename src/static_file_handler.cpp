@@ -0,0 +1,648 @@
+#include "static_file_handler.hpp"
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <system_error>
+#include <utility>
+
+#include "byte_range.hpp"
+#include "hash.hpp"
+#include "http_date.hpp"
+#include "http_tokenizer.hpp"
+#include "syscall_wrapper.hpp"
+
+using http1::StaticFileHandler;
+
+namespace {
+
+struct MimeType {
+  std::string_view extension;
+  std::string_view type;
+};
+
+constexpr std::array<MimeType, 34> MIME_TYPES = {{
+    {"html", "text/html; charset=utf-8"},
+    {"htm", "text/html; charset=utf-8"},
+    {"css", "text/css; charset=utf-8"},
+    {"js", "text/javascript; charset=utf-8"},
+    {"mjs", "text/javascript; charset=utf-8"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"xml", "application/xml"},
+    {"txt", "text/plain; charset=utf-8"},
+    {"csv", "text/csv; charset=utf-8"},
+    {"md", "text/markdown; charset=utf-8"},
+    {"svg", "image/svg+xml"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"avif", "image/avif"},
+    {"ico", "image/x-icon"},
+    {"bmp", "image/bmp"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"otf", "font/otf"},
+    {"pdf", "application/pdf"},
+    {"zip", "application/zip"},
+    {"gz", "application/gzip"},
+    {"wasm", "application/wasm"},
+    {"mp4", "video/mp4"},
+    {"webm", "video/webm"},
+    {"mp3", "audio/mpeg"},
+    {"ogg", "audio/ogg"},
+    {"wav", "audio/wav"},
+    {"pem", "application/x-pem-file"},
+}};
+
+constexpr std::string_view DEFAULT_MIME_TYPE = "application/octet-stream";
+constexpr std::size_t MAX_EXTENSION_SIZE = 8;
+constexpr std::size_t MIME_TABLE_SIZE = 256;
+
+// FNV-1a over the lowercased extension, mixed with seed
+constexpr std::uint32_t HashExtension(std::string_view extension,
+                                      std::uint32_t seed) noexcept {
+  std::uint32_t hash = 2166136261U ^ seed;
+  for (const char character : extension) {
+    hash ^= static_cast<unsigned char>(
+        http1::LOWERCASE_TABLE[static_cast<unsigned char>(character)]);
+    hash *= 16777619U;
+  }
+  return hash ^ (hash >> 16U);
+}
+
+// Smallest seed that maps every extension to its own slot
+constexpr std::uint32_t FindMimeSeed() {
+  for (std::uint32_t seed = 1; seed < 100000; ++seed) {
+    std::array<bool, MIME_TABLE_SIZE> used{};
+    bool collision = false;
+    for (const auto& mime_type : MIME_TYPES) {
+      const std::size_t slot =
+          HashExtension(mime_type.extension, seed) % MIME_TABLE_SIZE;
+      collision = collision || used.at(slot);
+      used.at(slot) = true;
+    }
+    if (!collision) {
+      return seed;
+    }
+  }
+  return 0;
+}
+
+constexpr std::uint32_t MIME_SEED = FindMimeSeed();
+static_assert(MIME_SEED != 0, "No perfect hash seed for MIME_TYPES");
+
+// Index into MIME_TYPES plus one, zero for empty slots
+constexpr auto MIME_TABLE = [] {
+  std::array<std::uint8_t, MIME_TABLE_SIZE> table{};
+  for (std::size_t index = 0; index < MIME_TYPES.size(); ++index) {
+    const std::size_t slot =
+        HashExtension(MIME_TYPES.at(index).extension, MIME_SEED) %
+        MIME_TABLE_SIZE;
+    table.at(slot) = static_cast<std::uint8_t>(index + 1);
+  }
+  return table;
+}();
+
+// Strong validator derived from the content, so that it is stable across
+// restarts and servers
+std::string MakeEtag(http1::ByteArrayView content) {
+  constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+  constexpr std::size_t HASH_DIGITS = 16;
+
+  std::string etag(HASH_DIGITS + 2, '"');
+  std::uint64_t hash = http1::Hash64(content);
+  for (std::size_t index = HASH_DIGITS; index > 0; --index) {
+    etag[index] = HEX_DIGITS[hash & 0xFU];
+    hash >>= 4U;
+  }
+  return etag;
+}
+
+// Weak comparison of RFC 9110 section 8.8.3.2, as If-None-Match requires
+bool EtagListMatches(std::string_view list, std::string_view etag) noexcept {
+  while (!list.empty()) {
+    const std::size_t end = list.find(',');
+    std::string_view candidate = list.substr(0, end);
+    list.remove_prefix(end == std::string_view::npos ? list.size() : end + 1);
+
+    const std::size_t first = candidate.find_first_not_of(" \t");
+    if (first == std::string_view::npos) {
+      continue;
+    }
+    candidate = candidate.substr(
+        first, candidate.find_last_not_of(" \t") - first + 1);
+
+    if (candidate == "*") {
+      return true;
+    }
+    if (candidate.starts_with("W/")) {
+      candidate.remove_prefix(2);
+    }
+    if (candidate == etag) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool IsNotModified(const http1::HttpRequest& request, std::string_view etag,
+                   std::time_t modified_time) {
+  // If-Modified-Since is ignored when If-None-Match is present
+  if (const auto if_none_match = request.FindField("if-none-match")) {
+    return EtagListMatches(*if_none_match, etag);
+  }
+  if (const auto if_modified_since = request.FindField("if-modified-since")) {
+    const auto since = http1::ParseHttpDate(*if_modified_since);
+    return since && modified_time <= *since;
+  }
+  return false;
+}
+
+// "bytes " and three 20 digit numbers
+constexpr std::size_t CONTENT_RANGE_WIDTH = 6 + 20 + 1 + 20 + 1 + 20;
+constexpr std::size_t CONTENT_LENGTH_WIDTH = 20;
+constexpr std::size_t PARTIAL_CONTENT_RANGE_SLOT = 0;
+
+constexpr std::uint32_t WATCHED_CHANGES =
+    IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE |
+    IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+constexpr std::array<http1::ContentCoding, http1::CONTENT_CODING_COUNT>
+    CODINGS = {http1::ContentCoding::Identity, http1::ContentCoding::Gzip,
+               http1::ContentCoding::Brotli};
+
+std::string SiblingPath(const std::string& path, http1::ContentCoding coding) {
+  const std::string_view suffix = http1::FileSuffixOf(coding);
+  return suffix.empty() ? path : path + "." + std::string(suffix);
+}
+
+bool SameFile(const struct stat& lhs, const struct stat& rhs) noexcept {
+  return lhs.st_ino == rhs.st_ino && lhs.st_dev == rhs.st_dev &&
+         lhs.st_size == rhs.st_size &&
+         lhs.st_mtim.tv_sec == rhs.st_mtim.tv_sec &&
+         lhs.st_mtim.tv_nsec == rhs.st_mtim.tv_nsec;
+}
+
+// Whether path is prefix itself or lies below it, so that "/static" does not
+// claim "/staticfoo"
+bool IsBelowPrefix(std::string_view path, std::string_view prefix) noexcept {
+  return path.starts_with(prefix) &&
+         (prefix.ends_with('/') || path.size() == prefix.size() ||
+          path[prefix.size()] == '/');
+}
+
+}  // namespace
+
+std::string_view http1::MimeTypeOf(std::string_view extension) noexcept {
+  if (extension.empty() || extension.size() > MAX_EXTENSION_SIZE) {
+    return DEFAULT_MIME_TYPE;
+  }
+
+  const std::uint8_t entry =
+      MIME_TABLE[HashExtension(extension, MIME_SEED) % MIME_TABLE_SIZE];
+  if (entry == 0) {
+    return DEFAULT_MIME_TYPE;
+  }
+
+  const auto& mime_type = MIME_TYPES.at(entry - 1);
+  return EqualsLowercase(mime_type.extension, extension) ? mime_type.type
+                                                         : DEFAULT_MIME_TYPE;
+}
+
+StaticFileHandler::StaticFileHandler(std::string prefix,
+                                     std::string document_root,
+                                     StaticFileOptions options)
+    : prefix_(std::move(prefix)),
+      document_root_(std::move(document_root)),
+      options_(std::move(options)) {
+  while (!document_root_.empty() && document_root_.back() == '/') {
+    document_root_.pop_back();
+  }
+}
+
+StaticFileHandler::~StaticFileHandler() {
+  if (inotify_fd_ >= 0) {
+    loop_->Unwatch(inotify_fd_);
+    close(inotify_fd_);
+  }
+}
+
+void StaticFileHandler::WatchChanges(TcpServerCore& loop) {
+  if (inotify_fd_ >= 0) {
+    return;
+  }
+
+  inotify_fd_ = wrap_syscall(inotify_init1(IN_NONBLOCK | IN_CLOEXEC),
+                             "Can not create inotify fd");
+  loop_ = &loop;
+  loop.Watch(inotify_fd_, EPOLLIN,
+             [this](std::uint32_t /*events*/) { ReadChanges(); });
+
+  // Files cached so far were loaded without a watch on their directory
+  cache_.clear();
+  cache_index_.clear();
+}
+
+auto StaticFileHandler::Handle(const HttpRequest& request)
+    -> std::optional<HttpResponse> {
+  if (!IsBelowPrefix(Target(request.path()).path(), prefix_)) {
+    return std::nullopt;
+  }
+
+  if (request.method() != HttpMethod::Get &&
+      request.method() != HttpMethod::Head) {
+    HttpResponse response(HttpStatusCode::MethodNotAllowed);
+    response.AddField(HeaderField{.name = "allow", .value = "GET, HEAD"});
+    response.SetContentLength(0);
+    return response;
+  }
+
+  const CachedFile* cached_file =
+      ResolvePath(request.path()) ? Lookup(Clock::now()) : nullptr;
+  if (cached_file == nullptr) {
+    HttpResponse response(HttpStatusCode::NotFound);
+    response.SetContentLength(0);
+    return response;
+  }
+
+  const Representation& representation = Negotiate(*cached_file, request);
+  const std::string_view etag = representation.fields.front().value;
+  const std::time_t modified_time =
+      representation.file->status().st_mtim.tv_sec;
+  if (IsNotModified(request, etag, modified_time)) {
+    return representation.not_modified;
+  }
+
+  const std::size_t size = representation.file->size();
+  const auto selection = SelectRanges(request, size, etag, modified_time);
+  if (selection.result == RangeResult::Satisfiable &&
+      selection.ranges.size() == 1) {
+    const ByteRange range = selection.ranges.front();
+    HttpResponse response(representation.partial_header);
+    response.SetSlot(PARTIAL_CONTENT_RANGE_SLOT,
+                     FormatContentRange(range, size));
+    response.SetFileBody(FileBody{.file = representation.file,
+                                  .offset = range.offset,
+                                  .size = range.size});
+    return response;
+  }
+  if (selection.result != RangeResult::Ignored) {
+    return MakeRangeResponse(selection, representation.file,
+                             cached_file->content_type, representation.fields);
+  }
+
+  HttpResponse response(representation.header);
+  if (request.method() == HttpMethod::Get) {
+    response.SetFileBody(
+        FileBody{.file = representation.file, .offset = 0, .size = size});
+  }
+  return response;
+}
+
+bool StaticFileHandler::ResolvePath(std::string_view target) {
+  target = Target(target).path();
+  target.remove_prefix(prefix_.size());
+
+  // Empty and "." segments are dropped, ".." is rejected instead of being
+  // resolved, so that no path can leave the document root.
+  relative_path_.clear();
+  while (!target.empty()) {
+    const std::size_t end = target.find('/');
+    const std::string_view segment = target.substr(0, end);
+    target.remove_prefix(end == std::string_view::npos ? target.size()
+                                                       : end + 1);
+
+    if (segment.empty() || segment == ".") {
+      continue;
+    }
+    if (segment == "..") {
+      return false;
+    }
+
+    // A decoded segment must not turn into a separator or a parent
+    // directory
+    relative_path_.push_back('/');
+    const std::size_t begin = relative_path_.size();
+    relative_path_.resize(begin + segment.size());
+    const auto decoded = PercentDecode(
+        segment, std::span<char>(&relative_path_[begin], segment.size()),
+        false);
+    if (!decoded || *decoded == "." || *decoded == ".." ||
+        decoded->find_first_of(std::string_view("/\0", 2)) !=
+            std::string_view::npos) {
+      return false;
+    }
+    relative_path_.resize(begin + decoded->size());
+  }
+  return true;
+}
+
+auto StaticFileHandler::Lookup(Clock::time_point now) -> const CachedFile* {
+  const auto index_iterator = cache_index_.find(relative_path_);
+  if (index_iterator != cache_index_.end()) {
+    const auto cache_iterator = index_iterator->second;
+    if (Revalidate(*cache_iterator, now)) {
+      // Move to the front of the LRU list
+      cache_.splice(cache_.begin(), cache_, cache_iterator);
+      return &*cache_iterator;
+    }
+
+    // Responses still being written keep their own reference to the file
+    cache_index_.erase(index_iterator);
+    cache_.erase(cache_iterator);
+  }
+
+  auto loaded = Load(now);
+  if (!loaded) {
+    return nullptr;
+  }
+
+  cache_.push_front(std::move(loaded.value()));
+  cache_index_.emplace(cache_.front().key, cache_.begin());
+  while (cache_index_.size() > options_.cache_capacity) {
+    cache_index_.erase(cache_.back().key);
+    cache_.pop_back();
+  }
+  return &cache_.front();
+}
+
+bool StaticFileHandler::Revalidate(CachedFile& cached_file,
+                                   Clock::time_point now) const {
+  // Changes evict the file right away when they are watched
+  if (inotify_fd_ >= 0 ||
+      now - cached_file.validated_at < options_.revalidate_interval) {
+    return true;
+  }
+
+  // Siblings appearing, disappearing or changing reload the file too
+  const auto& representations = cached_file.representations;
+  const auto identity_size = representations.front().file->status().st_size;
+  auto representation = representations.begin();
+  for (const ContentCoding coding : CODINGS) {
+    struct stat status {};
+    const bool exists =
+        stat(SiblingPath(cached_file.full_path, coding).c_str(), &status) ==
+        0;
+    if (representation != representations.end() &&
+        representation->coding == coding) {
+      if (!exists || !SameFile(status, representation->file->status())) {
+        return false;
+      }
+      ++representation;
+    } else if (exists && status.st_size < identity_size) {
+      return false;
+    }
+  }
+  cached_file.validated_at = now;
+  return true;
+}
+
+auto StaticFileHandler::Load(Clock::time_point now)
+    -> std::optional<CachedFile> {
+  std::string full_path = document_root_ + relative_path_;
+
+  struct stat status {};
+  if (stat(full_path.c_str(), &status) != 0) {
+    return std::nullopt;
+  }
+
+  // Watched before the file is opened, so that no change can be missed
+  if (S_ISDIR(status.st_mode)) {
+    full_path.append("/").append(options_.index_file);
+    AddDirectoryWatch(relative_path_);
+  } else {
+    AddDirectoryWatch(relative_path_.substr(0, relative_path_.rfind('/')));
+  }
+
+  std::vector<std::shared_ptr<const MappedFile>> files;
+  for (const ContentCoding coding : CODINGS) {
+    try {
+      files.push_back(
+          std::make_shared<const MappedFile>(SiblingPath(full_path, coding)));
+    } catch (const std::exception&) {
+      // Missing, unreadable and special files are all not found
+      if (coding == ContentCoding::Identity) {
+        return std::nullopt;
+      }
+      files.emplace_back();
+    }
+  }
+
+  const std::string_view file_name =
+      std::string_view(full_path).substr(full_path.rfind('/') + 1);
+  const std::size_t dot = file_name.rfind('.');
+  const std::string_view extension = dot == std::string_view::npos
+                                         ? std::string_view{}
+                                         : file_name.substr(dot + 1);
+  const std::string_view content_type = MimeTypeOf(extension);
+
+  // Siblings that do not save anything are not worth negotiating
+  const std::size_t identity_size = files.front()->size();
+  const bool negotiated =
+      std::any_of(std::next(files.begin()), files.end(), [&](const auto& file) {
+        return file && file->size() < identity_size;
+      });
+
+  CachedFile cached_file{.key = relative_path_,
+                         .full_path = std::move(full_path),
+                         .content_type = content_type,
+                         .representations = {},
+                         .validated_at = now};
+  for (std::size_t index = 0; index < files.size(); ++index) {
+    if (files[index] &&
+        (index == 0 || files[index]->size() < identity_size)) {
+      cached_file.representations.push_back(
+          MakeRepresentation(CODINGS.at(index), std::move(files[index]),
+                             content_type, negotiated));
+    }
+  }
+  return cached_file;
+}
+
+auto StaticFileHandler::MakeRepresentation(
+    ContentCoding coding, std::shared_ptr<const MappedFile> file,
+    std::string_view content_type, bool negotiated) -> Representation {
+  HeaderFields fields = {
+      HeaderField{.name = "etag", .value = MakeEtag(file->data())},
+      HeaderField{.name = "last-modified",
+                  .value = FormatHttpDate(file->status().st_mtim.tv_sec)}};
+  if (coding != ContentCoding::Identity) {
+    fields.push_back(HeaderField{.name = "content-encoding",
+                                 .value = std::string(NameOf(coding))});
+  }
+  if (negotiated) {
+    fields.push_back(HeaderField{.name = "vary", .value = "accept-encoding"});
+  }
+
+  HeaderFields header_fields = {HeaderField{
+      .name = "content-type", .value = std::string(content_type)}};
+  header_fields.insert(header_fields.end(), fields.begin(), fields.end());
+  header_fields.push_back(HeaderField{.name = "accept-ranges",
+                                      .value = "bytes"});
+
+  HeaderTemplate partial_header(
+      HttpStatusCode::PartialContent, header_fields,
+      {TemplateSlot{.name = "content-range", .width = CONTENT_RANGE_WIDTH},
+       TemplateSlot{.name = "content-length", .width = CONTENT_LENGTH_WIDTH}});
+
+  header_fields.insert(std::next(header_fields.begin()),
+                       HeaderField{.name = "content-length",
+                                   .value = std::to_string(file->size())});
+  HeaderTemplate header(HttpStatusCode::OK, header_fields, {});
+
+  // A 304 carries the fields a 200 would use to update a cached response
+  HttpResponse not_modified(HttpStatusCode::NotModified);
+  for (const auto& field : fields) {
+    if (field.name != "content-encoding") {
+      not_modified.AddField(field);
+    }
+  }
+
+  return Representation{.coding = coding,
+                        .file = std::move(file),
+                        .header = std::move(header),
+                        .partial_header = std::move(partial_header),
+                        .fields = std::move(fields),
+                        .not_modified = PreparedResponse(not_modified)};
+}
+
+auto StaticFileHandler::Negotiate(const CachedFile& cached_file,
+                                  const HttpRequest& request) noexcept
+    -> const Representation& {
+  const auto& representations = cached_file.representations;
+  if (representations.size() == 1) {
+    return representations.front();
+  }
+
+  const auto accept_encoding = request.FindField("accept-encoding");
+  const AcceptedCodings accepted = accept_encoding
+                                       ? ParseAcceptEncoding(*accept_encoding)
+                                       : AcceptedCodings();
+
+  // Highest quality wins, then the smallest file. Identity is sent even
+  // when it is not acceptable, as RFC 9110 allows.
+  const Representation* best = &representations.front();
+  std::uint16_t best_quality = accepted.quality(best->coding);
+  for (const auto& representation : representations) {
+    const std::uint16_t quality = accepted.quality(representation.coding);
+    if (quality > best_quality ||
+        (quality == best_quality && quality > 0 &&
+         representation.file->size() < best->file->size())) {
+      best = &representation;
+      best_quality = quality;
+    }
+  }
+  return *best;
+}
+
+void StaticFileHandler::Evict(const std::string& key) {
+  const auto index_iterator = cache_index_.find(key);
+  if (index_iterator == cache_index_.end()) {
+    return;
+  }
+  cache_.erase(index_iterator->second);
+  cache_index_.erase(index_iterator);
+}
+
+void StaticFileHandler::EvictBelow(std::string_view directory_key) {
+  for (auto cache_iterator = cache_.begin(); cache_iterator != cache_.end();) {
+    const std::string_view key = cache_iterator->key;
+    if (key == directory_key ||
+        (key.starts_with(directory_key) &&
+         key.substr(directory_key.size()).starts_with('/'))) {
+      cache_index_.erase(cache_iterator->key);
+      cache_iterator = cache_.erase(cache_iterator);
+    } else {
+      ++cache_iterator;
+    }
+  }
+}
+
+void StaticFileHandler::AddDirectoryWatch(const std::string& directory_key) {
+  if (inotify_fd_ < 0) {
+    return;
+  }
+
+  // Watching the same directory again returns its existing descriptor
+  const std::string directory = document_root_ + directory_key;
+  const int watch_descriptor =
+      inotify_add_watch(inotify_fd_, directory.c_str(), WATCHED_CHANGES);
+  if (watch_descriptor >= 0) {
+    watched_directories_[watch_descriptor] = directory_key;
+  }
+}
+
+void StaticFileHandler::ReadChanges() {
+  alignas(inotify_event) std::array<char, 4096> buffer{};
+  while (true) {
+    const ssize_t size = read(inotify_fd_, buffer.data(), buffer.size());
+    if (size <= 0) {
+      break;
+    }
+
+    for (ssize_t offset = 0; offset < size;) {
+      inotify_event event{};
+      std::memcpy(&event, std::next(buffer.data(), offset), sizeof(event));
+      const char* name_data = std::next(
+          buffer.data(), offset + static_cast<ssize_t>(sizeof(event)));
+      offset += static_cast<ssize_t>(sizeof(event) + event.len);
+
+      if ((event.mask & IN_Q_OVERFLOW) != 0U) {
+        // Changes were lost, nothing in the cache can be trusted
+        cache_.clear();
+        cache_index_.clear();
+        continue;
+      }
+
+      const auto directory_iterator = watched_directories_.find(event.wd);
+      if (directory_iterator == watched_directories_.end()) {
+        continue;
+      }
+      const std::string& directory_key = directory_iterator->second;
+
+      if ((event.mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) != 0U) {
+        EvictBelow(directory_key);
+        if ((event.mask & IN_IGNORED) != 0U) {
+          watched_directories_.erase(directory_iterator);
+        }
+        continue;
+      }
+
+      const std::string key =
+          directory_key + "/" + std::string(name_data, strnlen(name_data,
+                                                               event.len));
+      if ((event.mask & IN_ISDIR) != 0U) {
+        EvictBelow(key);
+        continue;
+      }
+
+      Evict(key);
+
+      // Precompressed siblings are cached with their original
+      std::string_view original = key;
+      for (const ContentCoding coding : CODINGS) {
+        const std::string_view suffix = FileSuffixOf(coding);
+        if (!suffix.empty() && original.ends_with(suffix) &&
+            original.substr(0, original.size() - suffix.size())
+                .ends_with('.')) {
+          original.remove_suffix(suffix.size() + 1);
+          Evict(std::string(original));
+        }
+      }
+      if (original.ends_with("/" + options_.index_file)) {
+        // Also cached under the directory's own path
+        Evict(directory_key);
+      }
+    }
+  }
+}
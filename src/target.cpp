@@ -0,0 +1,273 @@
+#include "target.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#include "http_tokenizer.hpp"
+
+using http1::QueryParams;
+
+namespace {
+
+constexpr std::uint64_t LOW_BITS = 0x0101010101010101ULL;
+constexpr std::uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+// High bit set in every zero byte of word. Bytes above the first zero byte
+// may be flagged too, so only the lowest flag is exact.
+constexpr std::uint64_t ZeroBytes(std::uint64_t word) noexcept {
+  return (word - LOW_BITS) & ~word & HIGH_BITS;
+}
+
+constexpr int HexValue(char character) noexcept {
+  if (character >= '0' && character <= '9') {
+    return character - '0';
+  }
+  const char lowercase = http1::LOWERCASE_TABLE[static_cast<unsigned char>(
+      character)];
+  if (lowercase >= 'a' && lowercase <= 'f') {
+    return lowercase - 'a' + 10;
+  }
+  return -1;
+}
+
+}  // namespace
+
+QueryParams::Iterator::Iterator(std::string_view query) noexcept
+    : rest_(query) {
+  ++*this;
+}
+
+auto QueryParams::Iterator::operator++() noexcept -> Iterator& {
+  while (!rest_.empty()) {
+    const std::size_t end = rest_.find('&');
+    const std::string_view param = rest_.substr(0, end);
+    rest_.remove_prefix(end == std::string_view::npos ? rest_.size()
+                                                      : end + 1);
+    if (param.empty()) {
+      continue;
+    }
+
+    const std::size_t equals = param.find('=');
+    param_.name = param.substr(0, equals);
+    param_.value = equals == std::string_view::npos
+                       ? param.substr(param.size())
+                       : param.substr(equals + 1);
+    return *this;
+  }
+
+  *this = Iterator();
+  return *this;
+}
+
+auto QueryParams::Iterator::operator++(int) noexcept -> Iterator {
+  Iterator previous = *this;
+  ++*this;
+  return previous;
+}
+
+std::optional<std::string_view> QueryParams::Find(
+    std::string_view name) const noexcept {
+  for (const QueryParam& param : *this) {
+    if (param.name == name) {
+      return param.value;
+    }
+  }
+  return std::nullopt;
+}
+
+std::size_t http1::FindEscape(std::string_view text,
+                              bool plus_as_space) noexcept {
+  constexpr std::uint64_t PERCENTS = LOW_BITS * '%';
+  constexpr std::uint64_t PLUSES = LOW_BITS * '+';
+
+  std::size_t index = 0;
+  for (; index + sizeof(std::uint64_t) <= text.size();
+       index += sizeof(std::uint64_t)) {
+    const std::uint64_t word = LoadPacked(std::next(text.data(), index));
+    std::uint64_t found = ZeroBytes(word ^ PERCENTS);
+    if (plus_as_space) {
+      found |= ZeroBytes(word ^ PLUSES);
+    }
+    if (found != 0) {
+      return index + static_cast<std::size_t>(std::countr_zero(found)) / 8;
+    }
+  }
+
+  while (index < text.size() && text[index] != '%' &&
+         (!plus_as_space || text[index] != '+')) {
+    ++index;
+  }
+  return index;
+}
+
+std::optional<std::string_view> http1::PercentDecode(
+    std::string_view encoded, std::span<char> output,
+    bool plus_as_space) noexcept {
+  if (output.size() < encoded.size()) {
+    return std::nullopt;
+  }
+
+  std::size_t written = 0;
+  while (true) {
+    const std::size_t run = FindEscape(encoded, plus_as_space);
+    if (run > 0) {
+      // Overlaps when decoding in place, output never overtakes encoded
+      std::memmove(&output[written], encoded.data(), run);
+      written += run;
+    }
+    encoded.remove_prefix(run);
+    if (encoded.empty()) {
+      break;
+    }
+
+    if (encoded.front() == '+') {
+      output[written++] = ' ';
+      encoded.remove_prefix(1);
+      continue;
+    }
+
+    if (encoded.size() < 3) {
+      return std::nullopt;
+    }
+    const int high = HexValue(encoded[1]);
+    const int low = HexValue(encoded[2]);
+    if (high < 0 || low < 0) {
+      return std::nullopt;
+    }
+    output[written++] = static_cast<char>((high << 4) | low);
+    encoded.remove_prefix(3);
+  }
+  return std::string_view(output.data(), written);
+}
+
+namespace {
+
+// ALPHA, DIGIT, "-", ".", "_" and "~" (RFC 3986 section 2.3)
+constexpr bool IsUnreserved(char character) noexcept {
+  return (character >= 'a' && character <= 'z') ||
+         (character >= 'A' && character <= 'Z') ||
+         (character >= '0' && character <= '9') || character == '-' ||
+         character == '.' || character == '_' || character == '~';
+}
+
+constexpr char UppercaseHex(char character) noexcept {
+  return character >= 'a' && character <= 'f'
+             ? static_cast<char>(character - 'a' + 'A')
+             : character;
+}
+
+// True for an escape that normalization leaves as it is
+constexpr bool IsNormalEscape(std::string_view escape,
+                              const http1::PathOptions& options) noexcept {
+  if (escape.size() < 3 || HexValue(escape[1]) < 0 || HexValue(escape[2]) < 0 ||
+      UppercaseHex(escape[1]) != escape[1] ||
+      UppercaseHex(escape[2]) != escape[2]) {
+    return false;
+  }
+  const auto byte = static_cast<char>((HexValue(escape[1]) << 4) |
+                                      HexValue(escape[2]));
+  return !IsUnreserved(byte) &&
+         (byte != '/' || options.encoded_slash == http1::EncodedSlash::Keep);
+}
+
+// True when the segment starting at path[begin] is "." or ".."
+constexpr bool IsDotSegment(std::string_view path, std::size_t begin) noexcept {
+  const std::string_view segment =
+      path.substr(begin, path.find('/', begin) - begin);
+  return segment == "." || segment == "..";
+}
+
+}  // namespace
+
+http1::NormalizedPath http1::NormalizePath(
+    std::span<char> path, const PathOptions& options) noexcept {
+  const std::string_view input(path.data(), path.size());
+  if (!input.starts_with('/')) {
+    return NormalizedPath{.status = PathStatus::Normal, .size = input.size()};
+  }
+
+  // Scans for the first segment needing a change
+  std::size_t segment_begin = 1;
+  std::size_t index = 0;
+  for (; index < input.size(); ++index) {
+    const char character = input[index];
+    if (character == '/') {
+      segment_begin = index + 1;
+      if (segment_begin < input.size() &&
+          ((options.collapse_slashes && input[segment_begin] == '/') ||
+           IsDotSegment(input, segment_begin))) {
+        break;
+      }
+    } else if (character == '%') {
+      if (!IsNormalEscape(input.substr(index, 3), options)) {
+        break;
+      }
+      index += 2;
+    }
+  }
+  if (index >= input.size()) {
+    return NormalizedPath{.status = PathStatus::Normal, .size = input.size()};
+  }
+
+  // Rewrites segment by segment from there. Output never overtakes input,
+  // as decoding and dropping segments only shrink the path.
+  std::size_t read = segment_begin;
+  std::size_t write = segment_begin;
+  while (true) {
+    const std::size_t output_begin = write;
+    bool decoded_slash = false;
+    while (read < input.size() && input[read] != '/') {
+      if (input[read] != '%') {
+        path[write++] = input[read++];
+        continue;
+      }
+
+      if (read + 2 >= input.size() || HexValue(input[read + 1]) < 0 ||
+          HexValue(input[read + 2]) < 0) {
+        return NormalizedPath{.status = PathStatus::Invalid, .size = 0};
+      }
+      const auto byte = static_cast<char>((HexValue(input[read + 1]) << 4) |
+                                          HexValue(input[read + 2]));
+      if (byte == '/' && options.encoded_slash == EncodedSlash::Reject) {
+        return NormalizedPath{.status = PathStatus::Invalid, .size = 0};
+      }
+      if (byte == '/' && options.encoded_slash == EncodedSlash::Decode) {
+        decoded_slash = true;
+        break;
+      }
+      if (IsUnreserved(byte)) {
+        path[write++] = byte;
+      } else {
+        path[write++] = '%';
+        path[write++] = UppercaseHex(input[read + 1]);
+        path[write++] = UppercaseHex(input[read + 2]);
+      }
+      read += 3;
+    }
+
+    const std::string_view segment(&path[output_begin], write - output_begin);
+    const bool last = read >= input.size();
+    read += decoded_slash ? 3 : 1;
+
+    if (segment == ".") {
+      write = output_begin;
+    } else if (segment == "..") {
+      // Drops the previous segment, the root stays
+      write = output_begin > 1 ? output_begin - 1 : output_begin;
+      while (path[write - 1] != '/') {
+        --write;
+      }
+    } else if (segment.empty() && options.collapse_slashes) {
+      // The separator before it is kept for the next segment
+    } else if (!last) {
+      path[write++] = '/';
+    }
+
+    if (last) {
+      break;
+    }
+  }
+
+  return NormalizedPath{.status = PathStatus::Normalized, .size = write};
+}
@@ -3,37 +3,124 @@
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <ctime>
 #include <gsl/narrow>
+#include <stdexcept>
+#include <utility>
 
 #include "syscall_wrapper.hpp"
 
+using http1::TcpMetrics;
 using http1::TcpServer;
-
-TcpServer::Socket::Socket(int socket_fd, TcpServer& server)
-    : socket_fd_(socket_fd), server_(server) {}
-
-void TcpServer::Socket::Write(const ByteArrayView& data,
-                              const std::optional<CallBack>& callback) const {
-  server_.TryWrite(socket_fd_, data, callback);
+using http1::TcpServerCore;
+
+void TcpMetrics::WriteTo(MetricsWriter& writer) const {
+  writer.Family("http1_connections_accepted_total", "counter",
+                "Accepted client connections.");
+  writer.Sample("http1_connections_accepted_total", {},
+                accepted_connections.value());
+  writer.Family("http1_connections_closed_total", "counter",
+                "Closed client connections.");
+  writer.Sample("http1_connections_closed_total", {},
+                closed_connections.value());
+  writer.Family("http1_connections_active", "gauge",
+                "Open client connections.");
+  writer.Sample("http1_connections_active", {}, active_connections.value());
+  writer.Family("http1_received_bytes_total", "counter",
+                "Bytes received from clients.");
+  writer.Sample("http1_received_bytes_total", {}, received_bytes.value());
+  writer.Family("http1_sent_bytes_total", "counter",
+                "Bytes handed to the kernel for clients.");
+  writer.Sample("http1_sent_bytes_total", {}, sent_bytes.value());
+  writer.Family("http1_partial_writes_total", "counter",
+                "Writes the socket buffer could not take whole.");
+  writer.Sample("http1_partial_writes_total", {}, partial_writes.value());
+  writer.Family("http1_queued_write_bytes", "gauge",
+                "Bytes waiting in write queues.");
+  writer.Sample("http1_queued_write_bytes", {}, queued_write_bytes.value());
+  writer.Family("http1_loop_wakeups_total", "counter",
+                "Returns of epoll_wait.");
+  writer.Sample("http1_loop_wakeups_total", {}, wakeups.value());
+  writer.Family("http1_loop_events_total", "counter",
+                "Ready events reported by epoll_wait.");
+  writer.Sample("http1_loop_events_total", {}, events.value());
 }
 
-void TcpServer::Socket::Close() const { server_.AddToCloseQueue(socket_fd_); }
-
-TcpServer::TcpServer(std::uint16_t port, std::size_t receive_buffer_size)
+TcpServerCore::TcpServerCore(std::uint16_t port,
+                             std::size_t receive_buffer_size)
     : port_(port) {
   receive_buffer.resize(receive_buffer_size, std::byte{0});
+  epoll_fd_ = wrap_syscall(epoll_create(1), "Can create epoll");
+  event_fd_ = wrap_syscall(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC),
+                           "Can not create event fd");
+  AddEvent(event_fd_, EPOLLIN | EPOLLET);
+  loop_time_ = std::time(nullptr);
 }
 
-TcpServer::~TcpServer() {
+TcpServerCore::~TcpServerCore() {
+  close(event_fd_);
   close(epoll_fd_);
   close(server_fd_);
 }
 
-void TcpServer::Start() {
+void TcpServerCore::Post(CallBack task) {
+  posted_tasks_.Push(std::move(task));
+
+  // Only the first post after the loop drained the queue has to wake it up
+  if (!wakeup_pending_.exchange(true)) {
+    const std::uint64_t increment = 1;
+    wrap_syscall(write(event_fd_, &increment, sizeof(increment)),
+                 "Can not wake up event loop");
+  }
+}
+
+void TcpServerCore::Defer(CallBack task) {
+  deferred_tasks_.push_back(std::move(task));
+}
+
+void TcpServerCore::Watch(int fd, std::uint32_t events,
+                          WatchCallBack callback) {
+  const auto watcher_iterator = watch_table_.find(fd);
+  const bool update = watcher_iterator != watch_table_.end() &&
+                      watcher_iterator->second.active;
+
+  AddEvent(fd, events, update);
+  watch_table_[fd] = Watcher{.callback = std::move(callback), .active = true};
+}
+
+void TcpServerCore::Unwatch(int fd) {
+  const auto watcher_iterator = watch_table_.find(fd);
+  if (watcher_iterator == watch_table_.end() ||
+      !watcher_iterator->second.active) {
+    return;
+  }
+
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+
+  // The callback may be the one calling Unwatch, so it is only destroyed at
+  // the end of the iteration.
+  watcher_iterator->second.active = false;
+  unwatched_fds_.push_back(fd);
+}
+
+std::uint16_t TcpServerCore::port() const {
+  sockaddr_in address{};
+  socklen_t address_size = sizeof(address);
+  wrap_syscall(getsockname(server_fd_, reinterpret_cast<sockaddr*>(&address),
+                           &address_size),
+               "Can not get server address");
+  return ntohs(address.sin_port);
+}
+
+void TcpServerCore::Listen() {
   server_fd_ = wrap_syscall(socket(AF_INET, SOCK_STREAM, 0),
                             "Can not create TCP socket");
 
@@ -54,44 +141,65 @@ void TcpServer::Start() {
                "Can not bind server socket");
   wrap_syscall(listen(server_fd_, SOMAXCONN), "Can not start listening");
 
-  epoll_fd_ = wrap_syscall(epoll_create(1), "Can create epoll");
-
   AddEvent(server_fd_, EPOLLIN | EPOLLOUT | EPOLLET);
 
-  LoopEvents();
+  loop_monitor_.SetLoopThread();
+  running_ = true;
 }
 
-void TcpServer::LoopEvents() {
-  constexpr int MAX_EPOLL_EVENTS = 64;
-  std::array<epoll_event, MAX_EPOLL_EVENTS> epoll_event_list{};
-  while (true) {
-    const int number_of_fds = wrap_syscall(
-        epoll_wait(epoll_fd_, epoll_event_list.data(), MAX_EPOLL_EVENTS, -1),
-        "Error occurred while waiting for new events");
-    for (int fd_iterator = 0; fd_iterator < number_of_fds; ++fd_iterator) {
-      auto& current_event = epoll_event_list.at(fd_iterator);
-      if (current_event.data.fd == server_fd_) {
-        AcceptNewClients();
-      } else {
-        if ((current_event.events & EPOLLIN) != 0U) {
-          ReceiveData(current_event.data.fd);
-        }
-        if ((current_event.events & EPOLLOUT) != 0U) {
-          ContinueWrite(current_event.data.fd);
-        }
-      }
+void TcpServerCore::Stop() {
+  Post([this] { running_ = false; });
+}
+
+int TcpServerCore::WaitForEvents(
+    std::array<epoll_event, MAX_EPOLL_EVENTS>& event_list) {
+  // Do not block while tasks deferred by the last iteration are waiting
+  const int timeout = deferred_tasks_.empty() ? -1 : 0;
+  loop_monitor_.EndIteration();
+  int number_of_fds =
+      epoll_wait(epoll_fd_, event_list.data(), MAX_EPOLL_EVENTS, timeout);
+  // Interrupted by a signal handler, e.g. of a Watchdog capturing the stack
+  if (number_of_fds < 0 && errno == EINTR) {
+    number_of_fds = 0;
+  }
+  wrap_syscall(number_of_fds, "Error occurred while waiting for new events");
+  loop_monitor_.BeginIteration();
+
+  // The coarse clock is served from the vDSO without entering the kernel
+  timespec now{};
+  clock_gettime(CLOCK_REALTIME_COARSE, &now);
+  loop_time_ = now.tv_sec;
 
-      if ((current_event.events & EPOLLHUP) != 0U ||
-          (current_event.events & EPOLLRDHUP) != 0U) {
-        AddToCloseQueue(current_event.data.fd);
+  tcp_metrics_.wakeups.Add();
+  tcp_metrics_.events.Add(static_cast<std::uint64_t>(number_of_fds));
+  return number_of_fds;
+}
+
+bool TcpServerCore::HandleLoopEvent(const epoll_event& event) {
+  if (!watch_table_.empty()) {
+    const auto watcher_iterator = watch_table_.find(event.data.fd);
+    if (watcher_iterator != watch_table_.end()) {
+      if (watcher_iterator->second.active) {
+        watcher_iterator->second.callback(event.events);
       }
+      return true;
     }
+  }
 
-    ConsumeCloseQueue();
+  if (event.data.fd == server_fd_) {
+    AcceptNewClients();
+    return true;
   }
+
+  if (event.data.fd == event_fd_) {
+    RunPostedTasks();
+    return true;
+  }
+
+  return false;
 }
 
-void TcpServer::SetNonBlocking(int socket_fd) {
+void TcpServerCore::SetNonBlocking(int socket_fd) {
   const int DEFAULT_FLAGS =
       wrap_syscall(fcntl(socket_fd, F_GETFL, 0), "Can not get socket flags");
 
@@ -100,8 +208,8 @@ void TcpServer::SetNonBlocking(int socket_fd) {
                "Can not enable non-blocking for socket");
 }
 
-void TcpServer::AddEvent(int socket_fd, std::uint32_t event_flags,
-                         bool update) const {
+void TcpServerCore::AddEvent(int socket_fd, std::uint32_t event_flags,
+                             bool update) const {
   epoll_event event{};
   event.events = event_flags;
   event.data.fd = socket_fd;
@@ -110,7 +218,7 @@ void TcpServer::AddEvent(int socket_fd, std::uint32_t event_flags,
                "Can not add/update socket event");
 }
 
-void TcpServer::AcceptNewClients() {
+void TcpServerCore::AcceptNewClients() {
   while (true) {
     const int new_client_fd = accept(server_fd_, nullptr, nullptr);
 
@@ -123,54 +231,58 @@ void TcpServer::AcceptNewClients() {
 
     SetNonBlocking(new_client_fd);
     AddEvent(new_client_fd, EPOLLIN | EPOLLET | EPOLLRDHUP);
+    tcp_metrics_.accepted_connections.Add();
+    tcp_metrics_.active_connections.Add(1);
   }
 }
 
-void TcpServer::ReceiveData(int socket_fd) {
-  while (true) {
-    const ssize_t return_value =
-        recv(socket_fd, receive_buffer.data(), receive_buffer.size(), 0);
-    if (return_value == 0) {
-      break;
-    }
-
-    if (return_value < 0) {
-      if (errno != EAGAIN && errno != EWOULDBLOCK) {
-        AddToCloseQueue(socket_fd);
-      }
-      break;
-    }
+void TcpServerCore::CloseSocket(int socket_fd) {
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket_fd, nullptr);
+  // A socket queued for closing twice is only counted once
+  if (close(socket_fd) == 0) {
+    tcp_metrics_.closed_connections.Add();
+    tcp_metrics_.active_connections.Add(-1);
+  }
 
-    OnData(Socket(socket_fd, *this),
-           ByteArrayView(receive_buffer.data(),
-                         static_cast<std::size_t>(return_value)));
+  const auto pending_iterator = write_task_table.find(socket_fd);
+  if (pending_iterator == write_task_table.end()) {
+    return;
   }
+  for (auto& task_queue = pending_iterator->second; !task_queue.empty();
+       task_queue.pop()) {
+    tcp_metrics_.queued_write_bytes.Add(
+        -static_cast<std::int64_t>(RemainingSize(task_queue.front())));
+  }
+  write_task_table.erase(pending_iterator);
 }
 
-void TcpServer::CloseSocket(int socket_fd) {
-  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket_fd, nullptr);
-  close(socket_fd);
-  write_task_table.erase(socket_fd);
-  OnClose(Socket(socket_fd, *this));
+void TcpServerCore::AddToCloseQueue(int socket_fd) {
+  close_queue.push(socket_fd);
 }
 
-void TcpServer::AddToCloseQueue(int socket_fd) { close_queue.push(socket_fd); }
-
-void TcpServer::ConsumeCloseQueue() {
-  while (!close_queue.empty()) {
-    CloseSocket(close_queue.front());
-    close_queue.pop();
+void TcpServerCore::TryWrite(int socket_fd, const ByteArrayView& data,
+                             CallBack callback) {
+  // Keep the byte order of the stream when earlier writes are still pending
+  const auto pending_iterator = write_task_table.find(socket_fd);
+  if (pending_iterator != write_task_table.end() &&
+      !pending_iterator->second.empty()) {
+    pending_iterator->second.push(WriteTask{.data = ByteArray(data),
+                                            .written_size = 0,
+                                            .callback = std::move(callback)});
+    tcp_metrics_.queued_write_bytes.Add(
+        static_cast<std::int64_t>(data.size()));
+    return;
   }
-}
 
-void TcpServer::TryWrite(int socket_fd, const ByteArrayView& data,
-                         const std::optional<CallBack>& callback) {
   const auto return_value = send(socket_fd, data.data(), data.size(), 0);
+  if (return_value > 0) {
+    tcp_metrics_.sent_bytes.Add(static_cast<std::size_t>(return_value));
+  }
 
   if (return_value >= 0 &&
       static_cast<std::size_t>(return_value) == data.size()) {
     if (callback) {
-      callback.value()();
+      callback();
     }
     return;
   }
@@ -180,50 +292,231 @@ void TcpServer::TryWrite(int socket_fd, const ByteArrayView& data,
     return;
   }
 
-  write_task_table[socket_fd].push(WriteTask{
-      .data = ByteArray(data),
-      .written_size =
-          (return_value > 0) ? static_cast<std::size_t>(return_value) : 0,
-      .callback = callback});
+  tcp_metrics_.partial_writes.Add();
+  QueueWrite(socket_fd, ByteArray(data),
+             (return_value > 0) ? static_cast<std::size_t>(return_value) : 0,
+             std::move(callback));
+}
+
+void TcpServerCore::TryWrite(int socket_fd,
+                             std::span<const ByteArrayView> parts,
+                             CallBack callback) {
+  if (parts.size() > MAX_WRITE_PARTS) {
+    throw std::invalid_argument("Too many parts for a gather write");
+  }
+
+  std::size_t total_size = 0;
+  std::array<iovec, MAX_WRITE_PARTS> io_vectors{};
+  for (std::size_t index = 0; index < parts.size(); ++index) {
+    // writev never writes through iov_base
+    io_vectors.at(index) = iovec{
+        .iov_base = const_cast<std::byte*>(parts[index].data()),
+        .iov_len = parts[index].size()};
+    total_size += parts[index].size();
+  }
+
+  std::size_t written_size = 0;
+  const auto pending_iterator = write_task_table.find(socket_fd);
+  if (pending_iterator == write_task_table.end() ||
+      pending_iterator->second.empty()) {
+    const auto return_value = writev(socket_fd, io_vectors.data(),
+                                     gsl::narrow<int>(parts.size()));
+    if (return_value > 0) {
+      tcp_metrics_.sent_bytes.Add(static_cast<std::size_t>(return_value));
+    }
+    if (return_value >= 0 &&
+        static_cast<std::size_t>(return_value) == total_size) {
+      if (callback) {
+        callback();
+      }
+      return;
+    }
+
+    if (return_value < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      AddToCloseQueue(socket_fd);
+      return;
+    }
+    written_size =
+        (return_value > 0) ? static_cast<std::size_t>(return_value) : 0;
+    tcp_metrics_.partial_writes.Add();
+  }
+
+  // Only the unwritten rest is copied into the write queue
+  ByteArray rest;
+  rest.reserve(total_size - written_size);
+  for (const auto& part : parts) {
+    const std::size_t skipped = std::min(written_size, part.size());
+    rest.append(part.substr(skipped));
+    written_size -= skipped;
+  }
+
+  if (pending_iterator != write_task_table.end() &&
+      !pending_iterator->second.empty()) {
+    tcp_metrics_.queued_write_bytes.Add(
+        static_cast<std::int64_t>(rest.size()));
+    pending_iterator->second.push(WriteTask{.data = std::move(rest),
+                                            .written_size = 0,
+                                            .callback = std::move(callback)});
+    return;
+  }
+  QueueWrite(socket_fd, std::move(rest), 0, std::move(callback));
+}
+
+void TcpServerCore::QueueWrite(int socket_fd, ByteArray data,
+                               std::size_t written_size, CallBack callback) {
+  tcp_metrics_.queued_write_bytes.Add(
+      static_cast<std::int64_t>(data.size() - written_size));
+  write_task_table[socket_fd].push(WriteTask{.data = std::move(data),
+                                             .written_size = written_size,
+                                             .callback = std::move(callback)});
 
   // Add write mask
   AddEvent(socket_fd, EPOLLIN | EPOLLET | EPOLLRDHUP | EPOLLOUT, true);
 }
 
-void TcpServer::ContinueWrite(int socket_fd) {
+void TcpServerCore::TrySendFile(int socket_fd, FileRange file,
+                                CallBack callback) {
+  auto& task_queue = write_task_table[socket_fd];
+  task_queue.push(WriteTask{.data = {},
+                            .written_size = 0,
+                            .callback = std::move(callback),
+                            .file = file});
+  tcp_metrics_.queued_write_bytes.Add(static_cast<std::int64_t>(file.size));
+  if (task_queue.size() > 1) {
+    // Sent by ContinueWrite once earlier writes are done
+    return;
+  }
+
+  FlushWriteQueue(socket_fd, task_queue);
+  if (!task_queue.empty()) {
+    // Add write mask
+    AddEvent(socket_fd, EPOLLIN | EPOLLET | EPOLLRDHUP | EPOLLOUT, true);
+  }
+}
+
+void TcpServerCore::ContinueWrite(int socket_fd) {
   auto& task_queue = write_task_table[socket_fd];
+  FlushWriteQueue(socket_fd, task_queue);
 
+  if (task_queue.empty()) {
+    // Remove write mask
+    AddEvent(socket_fd, EPOLLIN | EPOLLET | EPOLLRDHUP, true);
+    return;
+  }
+}
+
+void TcpServerCore::FlushWriteQueue(int socket_fd,
+                                    std::queue<WriteTask>& task_queue) {
   while (!task_queue.empty()) {
     auto& task = task_queue.front();
 
+    const WriteStatus status = WriteSome(socket_fd, task);
+    if (status == WriteStatus::Failed) {
+      AddToCloseQueue(socket_fd);
+      break;
+    }
+    if (status == WriteStatus::Blocked) {
+      break;
+    }
+
+    if (task.callback) {
+      task.callback();
+    }
+    task_queue.pop();
+  }
+}
+
+auto TcpServerCore::RemainingSize(const WriteTask& task) noexcept
+    -> std::size_t {
+  return (task.file ? task.file->size : task.data.size()) - task.written_size;
+}
+
+auto TcpServerCore::WriteSome(int socket_fd, WriteTask& task) -> WriteStatus {
+  const auto record_sent = [this](std::size_t size) {
+    tcp_metrics_.sent_bytes.Add(size);
+    tcp_metrics_.queued_write_bytes.Add(-static_cast<std::int64_t>(size));
+  };
+
+  if (!task.file) {
     const auto return_value = send(
         socket_fd,
         std::next(task.data.data(),
                   gsl::narrow<ByteArray::difference_type>(task.written_size)),
         task.data.size() - task.written_size, 0);
-
-    if (return_value >= 0 && static_cast<std::size_t>(return_value) ==
-                                 (task.data.size() - task.written_size)) {
-      if (task.callback) {
-        task.callback.value()();
+    if (return_value < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        tcp_metrics_.partial_writes.Add();
+        return WriteStatus::Blocked;
       }
-      task_queue.pop();
-      continue;
+      return WriteStatus::Failed;
     }
 
-    if (return_value < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-      AddToCloseQueue(socket_fd);
-      break;
+    // A short send means the socket buffer is full
+    record_sent(static_cast<std::size_t>(return_value));
+    task.written_size += static_cast<std::size_t>(return_value);
+    if (task.written_size < task.data.size()) {
+      tcp_metrics_.partial_writes.Add();
+      return WriteStatus::Blocked;
     }
+    return WriteStatus::Done;
+  }
 
-    task.written_size +=
-        (return_value > 0) ? static_cast<std::size_t>(return_value) : 0;
-    break;
+  // sendfile also stops short at its per call limit, so keep going until
+  // the socket blocks
+  while (task.written_size < task.file->size) {
+    auto offset = gsl::narrow<off_t>(task.file->offset + task.written_size);
+    const auto return_value =
+        sendfile(socket_fd, task.file->fd, &offset,
+                 task.file->size - task.written_size);
+    if (return_value < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        tcp_metrics_.partial_writes.Add();
+        return WriteStatus::Blocked;
+      }
+      return WriteStatus::Failed;
+    }
+    if (return_value == 0) {
+      // The file was truncated, the promised length can not be sent
+      return WriteStatus::Failed;
+    }
+    record_sent(static_cast<std::size_t>(return_value));
+    task.written_size += static_cast<std::size_t>(return_value);
   }
+  return WriteStatus::Done;
+}
 
-  if (task_queue.empty()) {
-    // Remove write mask
-    AddEvent(socket_fd, EPOLLIN | EPOLLET | EPOLLRDHUP, true);
-    return;
+void TcpServerCore::RunPostedTasks() {
+  std::uint64_t counter = 0;
+  while (read(event_fd_, &counter, sizeof(counter)) > 0) {
+  }
+
+  wakeup_pending_.store(false);
+  while (auto task = posted_tasks_.Pop()) {
+    task.value()();
+  }
+}
+
+void TcpServerCore::RunDeferredTasks() {
+  // Tasks deferred from here on run in the next iteration
+  std::vector<CallBack> tasks;
+  tasks.swap(deferred_tasks_);
+  for (auto& task : tasks) {
+    task();
   }
-}
\ No newline at end of file
+}
+
+void TcpServerCore::RemoveUnwatched() {
+  for (const int fd : unwatched_fds_) {
+    const auto watcher_iterator = watch_table_.find(fd);
+    if (watcher_iterator != watch_table_.end() &&
+        !watcher_iterator->second.active) {
+      watch_table_.erase(watcher_iterator);
+    }
+  }
+  unwatched_fds_.clear();
+}
+
+TcpServer::TcpServer(std::uint16_t port, std::size_t receive_buffer_size)
+    : BasicTcpServer(port, receive_buffer_size) {}
+
+TcpServer::~TcpServer() = default;
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "thread_pool.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+using http1::ThreadPool;
+
+ThreadPool::ThreadPool(std::size_t worker_count, std::size_t queue_capacity)
+    : queue_capacity_(queue_capacity), queues_(worker_count) {
+  if (worker_count == 0) {
+    throw std::invalid_argument("Thread pool needs at least one worker");
+  }
+
+  workers_.reserve(worker_count);
+  for (std::size_t index = 0; index < worker_count; ++index) {
+    workers_.emplace_back([this, index] { RunWorker(index); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  stopping_.store(true, std::memory_order_release);
+  available_.release(static_cast<std::ptrdiff_t>(workers_.size()));
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+bool ThreadPool::TrySubmit(Task task) {
+  if (queued_.fetch_add(1, std::memory_order_acq_rel) >= queue_capacity_) {
+    queued_.fetch_sub(1, std::memory_order_acq_rel);
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  auto& queue =
+      queues_[next_queue_.fetch_add(1, std::memory_order_relaxed) %
+              queues_.size()];
+  {
+    const std::lock_guard lock(queue.mutex);
+    queue.tasks.push_back(PendingTask{
+        .task = std::move(task),
+        .submit_time = std::chrono::steady_clock::now()});
+  }
+
+  submitted_.fetch_add(1, std::memory_order_relaxed);
+  available_.release();
+  return true;
+}
+
+auto ThreadPool::stats() const noexcept -> Stats {
+  return Stats{
+      .queue_depth = queued_.load(std::memory_order_relaxed),
+      .queue_capacity = queue_capacity_,
+      .submitted = submitted_.load(std::memory_order_relaxed),
+      .rejected = rejected_.load(std::memory_order_relaxed),
+      .completed = completed_.load(std::memory_order_relaxed),
+      .total_wait_time = std::chrono::nanoseconds(
+          total_wait_ns_.load(std::memory_order_relaxed)),
+      .max_wait_time = std::chrono::nanoseconds(
+          max_wait_ns_.load(std::memory_order_relaxed))};
+}
+
+void ThreadPool::RunWorker(std::size_t index) {
+  while (true) {
+    // Every release matches one queued task or one stop request. A scan can
+    // race with a thief and miss the task this token stands for, so retry
+    // until it shows up instead of dropping the token.
+    available_.acquire();
+
+    auto pending = TakeTask(index);
+    while (!pending) {
+      if (stopping_.load(std::memory_order_acquire)) {
+        return;
+      }
+      std::this_thread::yield();
+      pending = TakeTask(index);
+    }
+
+    queued_.fetch_sub(1, std::memory_order_acq_rel);
+    RecordWait(std::chrono::steady_clock::now() - pending->submit_time);
+
+    pending->task();
+    completed_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+auto ThreadPool::TakeTask(std::size_t index) -> std::optional<PendingTask> {
+  {
+    auto& own = queues_[index];
+    const std::lock_guard lock(own.mutex);
+    if (!own.tasks.empty()) {
+      auto pending = std::move(own.tasks.front());
+      own.tasks.pop_front();
+      return pending;
+    }
+  }
+
+  for (std::size_t offset = 1; offset < queues_.size(); ++offset) {
+    auto& victim = queues_[(index + offset) % queues_.size()];
+    const std::lock_guard lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      auto pending = std::move(victim.tasks.back());
+      victim.tasks.pop_back();
+      return pending;
+    }
+  }
+
+  return std::nullopt;
+}
+
+void ThreadPool::RecordWait(std::chrono::nanoseconds wait_time) noexcept {
+  const auto wait_ns = static_cast<std::uint64_t>(wait_time.count());
+  total_wait_ns_.fetch_add(wait_ns, std::memory_order_relaxed);
+
+  auto current_max = max_wait_ns_.load(std::memory_order_relaxed);
+  while (wait_ns > current_max &&
+         !max_wait_ns_.compare_exchange_weak(current_max, wait_ns,
+                                             std::memory_order_relaxed)) {
+  }
+}
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include "virtual_hosts.hpp"
+
+#include <bit>
+#include <stdexcept>
+#include <utility>
+
+#include "http_tokenizer.hpp"
+
+using http1::HttpResponse;
+using http1::HttpStatusCode;
+using http1::VirtualHosts;
+
+namespace {
+
+// FNV-1a over the lowercased name
+constexpr std::uint64_t HashName(std::string_view name) noexcept {
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (const char character : name) {
+    hash ^= static_cast<unsigned char>(
+        http1::LOWERCASE_TABLE[static_cast<unsigned char>(character)]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+constexpr bool IsNameChar(char character) noexcept {
+  return (character >= 'a' && character <= 'z') ||
+         (character >= 'A' && character <= 'Z') ||
+         (character >= '0' && character <= '9') || character == '-' ||
+         character == '.' || character == '_';
+}
+
+constexpr bool IsAddressChar(char character) noexcept {
+  return (character >= '0' && character <= '9') ||
+         (character >= 'a' && character <= 'f') ||
+         (character >= 'A' && character <= 'F') || character == ':' ||
+         character == '.';
+}
+
+constexpr bool IsPort(std::string_view port) noexcept {
+  for (const char character : port) {
+    if (character < '0' || character > '9') {
+      return false;
+    }
+  }
+  return port.size() <= 5;
+}
+
+std::string Lowercase(std::string_view name) {
+  std::string lowercase(name.size(), ' ');
+  for (std::size_t index = 0; index < name.size(); ++index) {
+    lowercase[index] =
+        http1::LOWERCASE_TABLE[static_cast<unsigned char>(name[index])];
+  }
+  return lowercase;
+}
+
+}  // namespace
+
+std::optional<std::string_view> http1::HostNameOf(
+    std::string_view host) noexcept {
+  host = TrimWhitespace(host);
+
+  std::string_view name;
+  std::string_view rest;
+  if (host.starts_with('[')) {
+    // IP-literal, e.g. "[::1]:8080"
+    const std::size_t end = host.find(']');
+    if (end == std::string_view::npos || end == 1) {
+      return std::nullopt;
+    }
+    name = host.substr(0, end + 1);
+    rest = host.substr(end + 1);
+    for (const char character : name.substr(1, name.size() - 2)) {
+      if (!IsAddressChar(character)) {
+        return std::nullopt;
+      }
+    }
+  } else {
+    const std::size_t colon = host.find(':');
+    name = host.substr(0, colon);
+    rest = colon == std::string_view::npos ? std::string_view()
+                                           : host.substr(colon);
+    if (name.ends_with('.')) {
+      name.remove_suffix(1);
+    }
+    for (const char character : name) {
+      if (!IsNameChar(character)) {
+        return std::nullopt;
+      }
+    }
+  }
+
+  if (name.empty() ||
+      (!rest.empty() && (!rest.starts_with(':') || !IsPort(rest.substr(1))))) {
+    return std::nullopt;
+  }
+  return name;
+}
+
+void VirtualHosts::Add(std::string_view host, Handler handler) {
+  const bool is_wildcard = host.starts_with("*.");
+  if (is_wildcard) {
+    host.remove_prefix(2);
+  }
+  const auto name = HostNameOf(host);
+  if (!name || name->size() != host.size()) {
+    throw std::invalid_argument("Invalid virtual host name");
+  }
+
+  (is_wildcard ? wildcards_ : exact_)
+      .Add(Lowercase(*name), std::move(handler));
+}
+
+void VirtualHosts::SetDefault(Handler handler) {
+  default_handler_ = std::move(handler);
+}
+
+auto VirtualHosts::Find(std::string_view host) const noexcept
+    -> const Handler* {
+  const auto name = HostNameOf(host);
+  if (!name) {
+    return default_handler_ ? &default_handler_ : nullptr;
+  }
+
+  if (const Handler* handler = exact_.Find(*name, HashName(*name))) {
+    return handler;
+  }
+
+  if (!wildcards_.empty()) {
+    // Parent domains from the longest to the shortest
+    std::string_view parent = *name;
+    for (std::size_t dot = parent.find('.'); dot != std::string_view::npos;
+         dot = parent.find('.')) {
+      parent.remove_prefix(dot + 1);
+      if (const Handler* handler = wildcards_.Find(parent, HashName(parent))) {
+        return handler;
+      }
+    }
+  }
+  return default_handler_ ? &default_handler_ : nullptr;
+}
+
+HttpResponse VirtualHosts::Dispatch(const HttpRequest& request) const {
+  const auto host = request.FindField("host");
+  if (!host && request.version() == HttpVersion::Http11) {
+    HttpResponse response(HttpStatusCode::BadRequest);
+    response.SetContentLength(0);
+    return response;
+  }
+
+  // HTTP/1.0 requests without a host field go to the default handler
+  const Handler* handler = host ? Find(*host)
+                           : default_handler_ ? &default_handler_
+                                              : nullptr;
+  if (handler == nullptr) {
+    HttpResponse response(HttpStatusCode::MisdirectedRequest);
+    response.SetContentLength(0);
+    return response;
+  }
+  return (*handler)(request);
+}
+
+void VirtualHosts::SiteTable::Add(std::string name, Handler handler) {
+  const std::uint64_t hash = HashName(name);
+  if (!sites_.empty() && Find(name, hash) != nullptr) {
+    throw std::invalid_argument("Virtual host added twice");
+  }
+  sites_.push_back(Site{
+      .name = std::move(name), .hash = hash, .handler = std::move(handler)});
+  Rebuild();
+}
+
+void VirtualHosts::SiteTable::Rebuild() {
+  // At most half full, so that probe sequences stay short
+  slots_.assign(std::bit_ceil(2 * sites_.size()), EMPTY);
+  const std::size_t mask = slots_.size() - 1;
+  for (std::size_t index = 0; index < sites_.size(); ++index) {
+    std::size_t slot = sites_[index].hash & mask;
+    while (slots_[slot] != EMPTY) {
+      slot = (slot + 1) & mask;
+    }
+    slots_[slot] = static_cast<std::uint32_t>(index);
+  }
+}
+
+auto VirtualHosts::SiteTable::Find(std::string_view name,
+                                   std::uint64_t hash) const noexcept
+    -> const Handler* {
+  if (slots_.empty()) {
+    return nullptr;
+  }
+  const std::size_t mask = slots_.size() - 1;
+  for (std::size_t slot = hash & mask; slots_[slot] != EMPTY;
+       slot = (slot + 1) & mask) {
+    const Site& site = sites_[slots_[slot]];
+    if (site.hash == hash && EqualsLowercase(site.name, name)) {
+      return &site.handler;
+    }
+  }
+  return nullptr;
+}
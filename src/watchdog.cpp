@@ -0,0 +1,183 @@
+#include "watchdog.hpp"
+
+#include <execinfo.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <string_view>
+
+using http1::Watchdog;
+
+namespace {
+
+constexpr int MAX_STACK_FRAMES = 64;
+constexpr double NANOSECONDS_PER_MILLISECOND = 1e6;
+
+// Where the signal handler writes stacks, set by the Watchdog capturing them
+std::atomic<int> stack_fd = -1;
+
+// Runs on the stalled thread. backtrace and backtrace_symbols_fd do not
+// allocate once libgcc has been loaded, which the Watchdog does up front.
+void WriteStack(int /*signal*/) {
+  const int saved_errno = errno;
+  std::array<void*, MAX_STACK_FRAMES> frames{};
+  const int frame_count = backtrace(frames.data(), MAX_STACK_FRAMES);
+
+  const int fd = stack_fd.load(std::memory_order_relaxed);
+  constexpr std::string_view HEADER = "stack of the stalled loop thread:\n";
+  if (write(fd, HEADER.data(), HEADER.size()) >= 0) {
+    backtrace_symbols_fd(frames.data(), frame_count, fd);
+  }
+  errno = saved_errno;
+}
+
+void AppendMilliseconds(std::string& output, std::uint64_t nanoseconds) {
+  std::array<char, 32> digits{};
+  const auto result = std::to_chars(
+      digits.data(), digits.data() + digits.size(),
+      static_cast<double>(nanoseconds) / NANOSECONDS_PER_MILLISECOND,
+      std::chars_format::fixed, 3);
+  output.append(digits.data(), result.ptr).append(" ms");
+}
+
+void WriteAll(int fd, std::string_view text) {
+  while (!text.empty()) {
+    const ssize_t return_value = write(fd, text.data(), text.size());
+    if (return_value < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    text.remove_prefix(static_cast<std::size_t>(return_value));
+  }
+}
+
+}  // namespace
+
+Watchdog::Watchdog(int fd, WatchdogOptions options)
+    : fd_(fd), options_(options) {
+  if (options_.capture_stack) {
+    // The first backtrace loads libgcc, which must not happen in the handler
+    std::array<void*, 1> frames{};
+    backtrace(frames.data(), 1);
+    stack_fd.store(fd_, std::memory_order_relaxed);
+
+    struct sigaction action {};
+    action.sa_handler = WriteStack;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(options_.stack_signal, &action, nullptr);
+  }
+
+  thread_ = std::thread([this] { Run(); });
+}
+
+Watchdog::~Watchdog() {
+  {
+    const std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  stop_condition_.notify_one();
+  thread_.join();
+
+  for (const auto& loop : loops_) {
+    loop.monitor->SetWatched(false);
+  }
+
+  // A signal sent before the join may still be pending on a loop thread,
+  // which the default action of e.g. SIGUSR2 would terminate
+  if (options_.capture_stack) {
+    struct sigaction action {};
+    action.sa_handler = SIG_IGN;
+    sigemptyset(&action.sa_mask);
+    sigaction(options_.stack_signal, &action, nullptr);
+  }
+}
+
+void Watchdog::Watch(LoopMonitor& monitor) {
+  monitor.SetWatched(true);
+  const std::lock_guard lock(mutex_);
+  loops_.push_back(WatchedLoop{.monitor = &monitor, .reported_since = 0});
+}
+
+void Watchdog::FormatStall(const LoopMonitor& monitor,
+                           std::uint64_t busy_time, std::string& output) {
+  output.append("event loop stalled for ");
+  AppendMilliseconds(output, busy_time);
+
+  if (const auto request = monitor.request()) {
+    output.append(" in ")
+        .append(request->method)
+        .append(" ")
+        .append(request->path)
+        .append(" of connection ")
+        .append(std::to_string(request->connection_id))
+        .append(", handled for ");
+    const std::uint64_t now = MonotonicNanoseconds();
+    AppendMilliseconds(output, now > request->start_time
+                                   ? now - request->start_time
+                                   : 0);
+  } else {
+    output.append(" outside of request handlers");
+  }
+
+  HistogramSnapshot iterations;
+  iterations.Merge(monitor.iteration_durations());
+  output.append("\nloop iterations: ")
+      .append(std::to_string(iterations.count()))
+      .append(", p50 ");
+  AppendMilliseconds(output, iterations.ValueAtQuantile(0.5));
+  output.append(", p99 ");
+  AppendMilliseconds(output, iterations.ValueAtQuantile(0.99));
+  output.append(", p99.9 ");
+  AppendMilliseconds(output, iterations.ValueAtQuantile(0.999));
+  output.append(", max ");
+  AppendMilliseconds(output, iterations.ValueAtQuantile(1.0));
+  output.append("\n");
+}
+
+void Watchdog::Run() {
+  const auto interval = std::max(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          options_.threshold / 4),
+      std::chrono::milliseconds(1));
+
+  std::unique_lock lock(mutex_);
+  while (!stop_condition_.wait_for(lock, interval,
+                                   [this] { return stopping_; })) {
+    for (auto& loop : loops_) {
+      Check(loop);
+    }
+  }
+}
+
+void Watchdog::Check(WatchedLoop& loop) {
+  const std::uint64_t busy_since = loop.monitor->busy_since();
+  if (busy_since == 0 || busy_since == loop.reported_since) {
+    return;
+  }
+
+  const std::uint64_t now = MonotonicNanoseconds();
+  const auto threshold = static_cast<std::uint64_t>(
+      std::chrono::nanoseconds(options_.threshold).count());
+  if (now < busy_since || now - busy_since < threshold) {
+    return;
+  }
+
+  loop.reported_since = busy_since;
+  stalls_.fetch_add(1, std::memory_order_relaxed);
+
+  std::string report;
+  FormatStall(*loop.monitor, now - busy_since, report);
+  WriteAll(fd_, report);
+
+  // The loop may have moved on meanwhile, then the stack shows where it is
+  // now, but a thread that has left the loop is not signalled
+  if (options_.capture_stack && loop.monitor->busy_since() == busy_since) {
+    loop.monitor->SignalLoopThread(options_.stack_signal);
+  }
+}
@@ -0,0 +1,177 @@
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstring>
+#include <future>
+#include <string>
+#include <thread>
+
+#include "access_log.hpp"
+#include "loopback.hpp"
+#include "spsc_ring.hpp"
+
+namespace {
+
+using http1::AccessLog;
+using http1::AccessLogFormat;
+using http1::AccessRecord;
+using http1::PeerAddress;
+using http1::SpscRing;
+using loopback::Count;
+using loopback::ReadAll;
+
+AccessRecord MakeRecord(std::string_view path) {
+  AccessRecord record;
+  record.time = 1'792'315'800'123'456'789;  // 2026-10-18T09:30:00.123Z
+  record.duration = 87'654;
+  record.bytes = 512;
+  record.method = "GET";
+  record.version = "HTTP/1.1";
+  record.peer.family = AF_INET;
+  record.peer.port = 51234;
+  inet_pton(AF_INET, "192.0.2.1", record.peer.address.data());
+  record.status = 200;
+  record.SetPath(path);
+  return record;
+}
+
+}  // namespace
+
+TEST(AccessLog, SpscRing) {
+  SpscRing<int> ring(3);
+  EXPECT_EQ(4U, ring.capacity());
+
+  int value = 0;
+  EXPECT_FALSE(ring.TryPop(value));
+  for (int round = 0; round < 3; ++round) {
+    for (int index = 0; index < 4; ++index) {
+      EXPECT_TRUE(ring.TryPush(round * 10 + index));
+    }
+    EXPECT_FALSE(ring.TryPush(-1));
+    for (int index = 0; index < 4; ++index) {
+      EXPECT_TRUE(ring.TryPop(value));
+      EXPECT_EQ(round * 10 + index, value);
+    }
+    EXPECT_FALSE(ring.TryPop(value));
+  }
+}
+
+TEST(AccessLog, SpscRingAcrossThreads) {
+  constexpr int COUNT = 20'000;
+  SpscRing<int> ring(64);
+
+  std::thread producer([&ring] {
+    for (int value = 0; value < COUNT;) {
+      if (ring.TryPush(value)) {
+        ++value;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  int expected = 0;
+  while (expected < COUNT) {
+    int value = 0;
+    if (ring.TryPop(value)) {
+      EXPECT_EQ(expected, value);
+      ++expected;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+}
+
+TEST(AccessLog, Formats) {
+  std::string text;
+  AccessLog::Format(MakeRecord("/a?q=\"x\""), AccessLogFormat::Text, text);
+  EXPECT_EQ(
+      "192.0.2.1:51234 [2026-10-18T09:30:00.123Z] "
+      "\"GET /a?q=\\x22x\\x22 HTTP/1.1\" 200 512 87\n",
+      text);
+
+  std::string json;
+  AccessLog::Format(MakeRecord("/a\\\"\x01"), AccessLogFormat::Json, json);
+  EXPECT_EQ(
+      "{\"time\":\"2026-10-18T09:30:00.123Z\",\"peer\":\"192.0.2.1:51234\","
+      "\"method\":\"GET\",\"path\":\"/a\\\\\\\"\\u0001\","
+      "\"version\":\"HTTP/1.1\",\"status\":200,\"bytes\":512,"
+      "\"duration_us\":87}\n",
+      json);
+
+  std::string peers;
+  PeerAddress ipv6;
+  ipv6.family = AF_INET6;
+  ipv6.port = 8080;
+  inet_pton(AF_INET6, "2001:db8::1", ipv6.address.data());
+  ipv6.AppendTo(peers);
+  peers.push_back(' ');
+  PeerAddress().AppendTo(peers);
+  EXPECT_EQ("[2001:db8::1]:8080 -", peers);
+
+  const std::string long_path(300, 'a');
+  EXPECT_EQ(AccessRecord::MAX_PATH_SIZE,
+            MakeRecord(long_path).path_view().size());
+}
+
+TEST(AccessLog, WritesOrDropsEveryRecord) {
+  constexpr std::uint64_t COUNT = 200;
+  std::array<int, 2> pipe_fds{};
+  ASSERT_EQ(0, pipe(pipe_fds.data()));
+  std::future<std::string> written =
+      std::async(std::launch::async, ReadAll, pipe_fds[0]);
+
+  std::uint64_t dropped = 0;
+  {
+    AccessLog access_log(pipe_fds[1], {.ring_capacity = 16});
+    AccessLog::Producer& producer = access_log.AddProducer();
+    for (std::uint64_t index = 0; index < COUNT; ++index) {
+      producer.TryLog(MakeRecord(std::string("/").append(
+          std::to_string(index))));
+    }
+    dropped = access_log.dropped();
+    EXPECT_EQ(dropped, producer.dropped());
+  }
+  close(pipe_fds[1]);
+
+  const std::string text = written.get();
+  close(pipe_fds[0]);
+  EXPECT_EQ(COUNT - dropped, Count(text, "\n"));
+  EXPECT_TRUE(text.starts_with("192.0.2.1:51234 [2026-10-18T09:30:00.123Z] "
+                               "\"GET /0 HTTP/1.1\""));
+}
+
+TEST(AccessLog, LogsServerResponses) {
+  std::array<int, 2> pipe_fds{};
+  ASSERT_EQ(0, pipe(pipe_fds.data()));
+  std::future<std::string> written =
+      std::async(std::launch::async, ReadAll, pipe_fds[0]);
+
+  {
+    AccessLog access_log(pipe_fds[1], {.format = AccessLogFormat::Json});
+    loopback::NoContentServer server;
+    server.EnableAccessLog(access_log);
+    const loopback::RunningServer running(server);
+
+    const std::string received = loopback::Exchange(
+        running.port(),
+        "GET /first HTTP/1.1\r\n\r\nDELETE /second HTTP/1.0\r\n\r\n",
+        " 204 No Content\r\n", 2);
+    EXPECT_EQ(2U, Count(received, " 204 No Content\r\n"));
+  }
+  close(pipe_fds[1]);
+
+  const std::string text = written.get();
+  close(pipe_fds[0]);
+  EXPECT_EQ(2U, Count(text, "\n"));
+  EXPECT_EQ(2U, Count(text, "\"peer\":\"127.0.0.1:"));
+  EXPECT_NE(std::string::npos,
+            text.find("\"method\":\"GET\",\"path\":\"/first\","
+                      "\"version\":\"HTTP/1.1\",\"status\":204,"));
+  EXPECT_NE(std::string::npos,
+            text.find("\"method\":\"DELETE\",\"path\":\"/second\","
+                      "\"version\":\"HTTP/1.0\",\"status\":204,"));
+}
@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "byte_range.hpp"
+
+namespace {
+
+std::vector<http1::ByteRange> Ranges(
+    std::initializer_list<http1::ByteRange> ranges) {
+  return ranges;
+}
+
+std::string AsText(http1::ByteArrayView bytes) {
+  return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+}
+
+}  // namespace
+
+TEST(ByteRange, ParsesRangeSpecs) {
+  const auto selection = http1::ParseRange("bytes=0-9, 20-, -5,,", 100);
+  EXPECT_EQ(http1::RangeResult::Satisfiable, selection.result);
+  EXPECT_EQ(Ranges({{.offset = 0, .size = 10},
+                    {.offset = 20, .size = 80},
+                    {.offset = 95, .size = 5}}),
+            selection.ranges);
+
+  // Clipped to the representation
+  EXPECT_EQ(Ranges({{.offset = 90, .size = 10}}),
+            http1::ParseRange("Bytes=90-999999999999999999999999", 100).ranges);
+  EXPECT_EQ(Ranges({{.offset = 0, .size = 100}}),
+            http1::ParseRange("bytes=-500", 100).ranges);
+}
+
+TEST(ByteRange, RejectsInvalidAndUnsatisfiable) {
+  EXPECT_EQ(http1::RangeResult::Ignored,
+            http1::ParseRange("items=0-9", 100).result);
+  EXPECT_EQ(http1::RangeResult::Ignored,
+            http1::ParseRange("bytes=9-0", 100).result);
+  EXPECT_EQ(http1::RangeResult::Ignored,
+            http1::ParseRange("bytes=a-9", 100).result);
+  EXPECT_EQ(http1::RangeResult::Ignored,
+            http1::ParseRange("bytes=5", 100).result);
+  EXPECT_EQ(http1::RangeResult::Ignored,
+            http1::ParseRange("bytes=", 100).result);
+
+  std::string many = "bytes=0-0";
+  for (std::size_t index = 1; index <= http1::MAX_RANGES; ++index) {
+    const std::string position = std::to_string(index);
+    many.append(",").append(position).append("-").append(position);
+  }
+  EXPECT_EQ(http1::RangeResult::Ignored, http1::ParseRange(many, 100).result);
+
+  EXPECT_EQ(http1::RangeResult::Unsatisfiable,
+            http1::ParseRange("bytes=100-", 100).result);
+  EXPECT_EQ(http1::RangeResult::Unsatisfiable,
+            http1::ParseRange("bytes=-0", 100).result);
+  EXPECT_EQ(http1::RangeResult::Unsatisfiable,
+            http1::ParseRange("bytes=0-", 0).result);
+}
+
+TEST(ByteRange, IfRange) {
+  http1::HttpRequest request(http1::HttpMethod::Get, "/",
+                             http1::HttpVersion::Http11);
+  request.UpdateFields("range", "bytes=0-0");
+  EXPECT_EQ(http1::RangeResult::Satisfiable,
+            http1::SelectRanges(request, 10).result);
+
+  auto with_if_range = [&](const std::string& value) {
+    auto conditional = request;
+    conditional.UpdateFields("if-range", value);
+    return http1::SelectRanges(conditional, 10, "\"tag\"", 784111777).result;
+  };
+  EXPECT_EQ(http1::RangeResult::Satisfiable, with_if_range("\"tag\""));
+  EXPECT_EQ(http1::RangeResult::Ignored, with_if_range("\"other\""));
+  EXPECT_EQ(http1::RangeResult::Ignored, with_if_range("W/\"tag\""));
+  EXPECT_EQ(http1::RangeResult::Satisfiable,
+            with_if_range("Sun, 06 Nov 1994 08:49:37 GMT"));
+  EXPECT_EQ(http1::RangeResult::Ignored,
+            with_if_range("Sun, 06 Nov 1994 08:49:38 GMT"));
+
+  const http1::HttpRequest head(http1::HttpMethod::Head, "/",
+                                http1::HttpVersion::Http11);
+  EXPECT_EQ(http1::RangeResult::Ignored, http1::SelectRanges(head, 10).result);
+}
+
+TEST(ByteRange, CoalescesRanges) {
+  auto select = [](const std::string& value) {
+    http1::HttpRequest request(http1::HttpMethod::Get, "/",
+                               http1::HttpVersion::Http11);
+    request.UpdateFields("range", value);
+    return http1::SelectRanges(request, 10);
+  };
+
+  // Sorted, with overlapping and adjacent ranges merged
+  const auto merged = select("bytes=8-9,0-2,2-3,4-4");
+  EXPECT_EQ(http1::RangeResult::Satisfiable, merged.result);
+  EXPECT_EQ(Ranges({{.offset = 0, .size = 5}, {.offset = 8, .size = 2}}),
+            merged.ranges);
+  EXPECT_EQ(Ranges({{.offset = 3, .size = 3}}),
+            select("bytes=3-5,3-5").ranges);
+
+  // Ranges adding up to more than the representation are answered in full
+  EXPECT_EQ(http1::RangeResult::Ignored, select("bytes=0-,0-,0-").result);
+  EXPECT_EQ(http1::RangeResult::Ignored, select("bytes=0-5,2-7").result);
+}
+
+TEST(ByteRange, MakesResponses) {
+  constexpr std::string_view CONTENT = "0123456789";
+  const http1::ByteArrayView content(
+      reinterpret_cast<const std::byte*>(CONTENT.data()), CONTENT.size());
+
+  const auto single = http1::MakeRangeResponse(
+      http1::ParseRange("bytes=2-4", content.size()), content, "text/plain");
+  EXPECT_EQ(http1::HttpStatusCode::PartialContent, single.status_code());
+  EXPECT_EQ(std::next(content.data(), 2), single.body()->data());
+  EXPECT_EQ(
+      "HTTP/1.1 206 Partial Content\r\n"
+      "content-type: text/plain\r\n"
+      "content-range: bytes 2-4/10\r\n"
+      "content-length: 3\r\n"
+      "\r\n"
+      "234",
+      AsText(single.Serialize()));
+
+  const auto multiple = http1::MakeRangeResponse(
+      http1::ParseRange("bytes=0-1,-2", content.size()), content,
+      "text/plain",
+      {http1::HeaderField{.name = "etag", .value = "\"tag\""}});
+  const std::string serialized = AsText(multiple.Serialize());
+  EXPECT_NE(std::string::npos,
+            serialized.find("content-type: multipart/byteranges; boundary="));
+  EXPECT_NE(std::string::npos, serialized.find("etag: \"tag\"\r\n"));
+  EXPECT_NE(std::string::npos,
+            serialized.find("content-range: bytes 0-1/10\r\n\r\n01\r\n"));
+  EXPECT_NE(std::string::npos,
+            serialized.find("content-range: bytes 8-9/10\r\n\r\n89\r\n"));
+  EXPECT_TRUE(serialized.ends_with("--\r\n"));
+
+  // The owned body survives copies of the response
+  const http1::HttpResponse copy = multiple;
+  EXPECT_EQ(serialized, AsText(copy.Serialize()));
+
+  const auto unsatisfiable = http1::MakeRangeResponse(
+      http1::ParseRange("bytes=10-", content.size()), content, "text/plain");
+  EXPECT_EQ(
+      "HTTP/1.1 416 Range Not Satisfiable\r\n"
+      "content-range: bytes */10\r\n"
+      "content-length: 0\r\n"
+      "\r\n",
+      AsText(unsatisfiable.Serialize()));
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include "content_coding.hpp"
+
+namespace {
+
+using http1::ContentCoding;
+
+}  // namespace
+
+TEST(ContentCoding, Names) {
+  EXPECT_EQ("identity", http1::NameOf(ContentCoding::Identity));
+  EXPECT_EQ("gzip", http1::NameOf(ContentCoding::Gzip));
+  EXPECT_EQ("br", http1::NameOf(ContentCoding::Brotli));
+  EXPECT_EQ("gz", http1::FileSuffixOf(ContentCoding::Gzip));
+}
+
+TEST(ContentCoding, DefaultsToIdentity) {
+  const http1::AcceptedCodings accepted;
+  EXPECT_EQ(1000, accepted.quality(ContentCoding::Identity));
+  EXPECT_EQ(0, accepted.quality(ContentCoding::Gzip));
+
+  const auto empty = http1::ParseAcceptEncoding("");
+  EXPECT_EQ(1000, empty.quality(ContentCoding::Identity));
+  EXPECT_EQ(0, empty.quality(ContentCoding::Brotli));
+}
+
+TEST(ContentCoding, ParsesQualityValues) {
+  const auto accepted =
+      http1::ParseAcceptEncoding("GZIP;q=0.8, br ; Q=1.000,identity;q=0.05");
+  EXPECT_EQ(800, accepted.quality(ContentCoding::Gzip));
+  EXPECT_EQ(1000, accepted.quality(ContentCoding::Brotli));
+  EXPECT_EQ(50, accepted.quality(ContentCoding::Identity));
+
+  EXPECT_EQ(1000, http1::ParseAcceptEncoding("x-gzip")
+                      .quality(ContentCoding::Gzip));
+  EXPECT_EQ(0, http1::ParseAcceptEncoding("gzip;q=0")
+                   .quality(ContentCoding::Gzip));
+}
+
+TEST(ContentCoding, Wildcard) {
+  const auto accepted = http1::ParseAcceptEncoding("br;q=0, *;q=0.3");
+  EXPECT_EQ(0, accepted.quality(ContentCoding::Brotli));
+  EXPECT_EQ(300, accepted.quality(ContentCoding::Gzip));
+  EXPECT_EQ(300, accepted.quality(ContentCoding::Identity));
+
+  EXPECT_EQ(0, http1::ParseAcceptEncoding("*;q=0")
+                   .quality(ContentCoding::Identity));
+  EXPECT_EQ(1000, http1::ParseAcceptEncoding("*;q=0, identity")
+                      .quality(ContentCoding::Identity));
+}
+
+TEST(ContentCoding, SkipsMalformedElements) {
+  for (const auto* value :
+       {"gzip;q=2", "gzip;q=1.5", "gzip;q=0.1234", "gzip;q=", "gzip;level=1",
+        "gzip;q=.5", "gzip;q=0,5"}) {
+    const auto accepted = http1::ParseAcceptEncoding(value);
+    EXPECT_EQ(0, accepted.quality(ContentCoding::Gzip)) << value;
+  }
+  EXPECT_EQ(1000, http1::ParseAcceptEncoding("compress, , gzip")
+                      .quality(ContentCoding::Gzip));
+}
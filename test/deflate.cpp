@@ -0,0 +1,465 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "deflate.hpp"
+#include "hash.hpp"
+#include "http_server.hpp"
+
+namespace {
+
+http1::ByteArrayView AsBytes(std::string_view text) {
+  return {reinterpret_cast<const std::byte*>(text.data()), text.size()};
+}
+
+std::string AsText(http1::ByteArrayView bytes) {
+  return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+}
+
+// Minimal DEFLATE decoder after zlib's puff.c, so that the encoder is
+// checked without a third-party library
+class Inflater {
+ public:
+  explicit Inflater(http1::ByteArrayView input) : input_(input) {}
+
+  // Decodes blocks until the final one, or until input ends after a
+  // flushed block
+  std::string Inflate() {
+    bool last = false;
+    while (!last && (bit_position_ + 7) / 8 < input_.size()) {
+      last = Bits(1) == 1;
+      switch (Bits(2)) {
+        case 0:
+          Stored();
+          break;
+        case 1:
+          Fixed();
+          break;
+        case 2:
+          Dynamic();
+          break;
+        default:
+          throw std::runtime_error("Invalid block type");
+      }
+    }
+    final_block_seen_ = last;
+    return output_;
+  }
+
+  [[nodiscard]] bool final_block_seen() const { return final_block_seen_; }
+
+  // Input consumed, including the padding of the last byte
+  [[nodiscard]] std::size_t consumed() const { return (bit_position_ + 7) / 8; }
+
+ private:
+  struct Huffman {
+    std::array<std::uint16_t, 16> counts{};
+    std::vector<std::uint16_t> symbols;
+  };
+
+  static constexpr std::array<std::uint16_t, 29> LENGTH_BASE = {
+      3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+  static constexpr std::array<std::uint8_t, 29> LENGTH_EXTRA = {
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+  static constexpr std::array<std::uint16_t, 30> DISTANCE_BASE = {
+      1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+      33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+      1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+  static constexpr std::array<std::uint8_t, 30> DISTANCE_EXTRA = {
+      0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+      6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+  std::uint32_t Bits(unsigned count) {
+    std::uint32_t value = 0;
+    for (unsigned bit = 0; bit < count; ++bit, ++bit_position_) {
+      if (bit_position_ / 8 >= input_.size()) {
+        throw std::runtime_error("Input ends inside a block");
+      }
+      const auto byte =
+          static_cast<std::uint32_t>(input_[bit_position_ / 8]);
+      value |= ((byte >> (bit_position_ % 8)) & 1U) << bit;
+    }
+    return value;
+  }
+
+  static Huffman Build(const std::vector<std::uint8_t>& lengths) {
+    Huffman huffman;
+    for (const auto length : lengths) {
+      ++huffman.counts.at(length);
+    }
+    std::array<std::uint16_t, 16> offsets{};
+    for (std::size_t length = 1; length < 15; ++length) {
+      offsets.at(length + 1) =
+          static_cast<std::uint16_t>(offsets.at(length) +
+                                     huffman.counts.at(length));
+    }
+    huffman.symbols.resize(lengths.size());
+    for (std::size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+      if (lengths[symbol] != 0) {
+        huffman.symbols.at(offsets.at(lengths[symbol])++) =
+            static_cast<std::uint16_t>(symbol);
+      }
+    }
+    return huffman;
+  }
+
+  std::uint16_t Decode(const Huffman& huffman) {
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (std::size_t length = 1; length < 16; ++length) {
+      code |= static_cast<int>(Bits(1));
+      const int count = huffman.counts.at(length);
+      if (code - count < first) {
+        return huffman.symbols.at(static_cast<std::size_t>(index + code -
+                                                           first));
+      }
+      index += count;
+      first = (first + count) << 1;
+      code <<= 1;
+    }
+    throw std::runtime_error("Invalid Huffman code");
+  }
+
+  void Stored() {
+    bit_position_ = (bit_position_ + 7) / 8 * 8;
+    const std::uint32_t length = Bits(16);
+    if ((Bits(16) ^ 0xFFFFU) != length) {
+      throw std::runtime_error("Stored length mismatch");
+    }
+    for (std::uint32_t index = 0; index < length; ++index) {
+      output_.push_back(static_cast<char>(Bits(8)));
+    }
+  }
+
+  void Fixed() {
+    std::vector<std::uint8_t> lengths(288);
+    for (std::size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+      lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7
+                                                                          : 8;
+    }
+    Codes(Build(lengths), Build(std::vector<std::uint8_t>(30, 5)));
+  }
+
+  void Dynamic() {
+    static constexpr std::array<std::uint8_t, 19> ORDER = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    const std::uint32_t literal_count = Bits(5) + 257;
+    const std::uint32_t distance_count = Bits(5) + 1;
+    const std::uint32_t code_length_count = Bits(4) + 4;
+
+    std::vector<std::uint8_t> code_lengths(19);
+    for (std::uint32_t index = 0; index < code_length_count; ++index) {
+      code_lengths.at(ORDER.at(index)) = static_cast<std::uint8_t>(Bits(3));
+    }
+    const Huffman code_length_codes = Build(code_lengths);
+
+    std::vector<std::uint8_t> lengths;
+    while (lengths.size() < literal_count + distance_count) {
+      const std::uint16_t symbol = Decode(code_length_codes);
+      if (symbol < 16) {
+        lengths.push_back(static_cast<std::uint8_t>(symbol));
+        continue;
+      }
+      std::uint8_t repeated = 0;
+      std::uint32_t count = 0;
+      if (symbol == 16) {
+        if (lengths.empty()) {
+          throw std::runtime_error("Repeat without a length");
+        }
+        repeated = lengths.back();
+        count = 3 + Bits(2);
+      } else if (symbol == 17) {
+        count = 3 + Bits(3);
+      } else {
+        count = 11 + Bits(7);
+      }
+      lengths.insert(lengths.end(), count, repeated);
+    }
+    if (lengths.size() != literal_count + distance_count) {
+      throw std::runtime_error("Too many code lengths");
+    }
+
+    Codes(Build({lengths.begin(), lengths.begin() + literal_count}),
+          Build({lengths.begin() + literal_count, lengths.end()}));
+  }
+
+  void Codes(const Huffman& literals, const Huffman& distances) {
+    while (true) {
+      const std::uint16_t symbol = Decode(literals);
+      if (symbol < 256) {
+        output_.push_back(static_cast<char>(symbol));
+        continue;
+      }
+      if (symbol == 256) {
+        return;
+      }
+
+      const std::size_t length_code = symbol - 257U;
+      const std::size_t length =
+          LENGTH_BASE.at(length_code) + Bits(LENGTH_EXTRA.at(length_code));
+      const std::size_t distance_code = Decode(distances);
+      const std::size_t distance = DISTANCE_BASE.at(distance_code) +
+                                   Bits(DISTANCE_EXTRA.at(distance_code));
+      if (distance > output_.size() || distance > 32768) {
+        throw std::runtime_error("Distance too far back");
+      }
+      for (std::size_t index = 0; index < length; ++index) {
+        output_.push_back(output_[output_.size() - distance]);
+      }
+    }
+  }
+
+  http1::ByteArrayView input_;
+  std::size_t bit_position_ = 0;
+  std::string output_;
+  bool final_block_seen_ = false;
+};
+
+std::string Deflate(std::string_view text, int level) {
+  http1::ByteArray output;
+  http1::DeflateEncoder encoder(level);
+  encoder.Write(AsBytes(text), output);
+  encoder.Finish(output);
+  return AsText(output);
+}
+
+std::string Inflate(std::string_view compressed) {
+  Inflater inflater(AsBytes(compressed));
+  std::string result = inflater.Inflate();
+  EXPECT_TRUE(inflater.final_block_seen());
+  EXPECT_EQ(compressed.size(), inflater.consumed());
+  return result;
+}
+
+// Log-like text with repetitions at all distances, larger than two windows
+std::string MakeText(std::size_t size) {
+  std::mt19937 random(42);
+  constexpr std::array<std::string_view, 8> WORDS = {
+      "GET ",  "/index.html ", "HTTP/1.1 ", "200 ",
+      "304 ",  "user-agent: ", "curl/8.0 ", "\n"};
+  std::string text;
+  while (text.size() < size) {
+    text += WORDS.at(random() % WORDS.size());
+    text += std::to_string(random() % 1000);
+  }
+  text.resize(size);
+  return text;
+}
+
+std::string MakeRandom(std::size_t size) {
+  std::mt19937 random(7);
+  std::string bytes(size, '\0');
+  for (auto& byte : bytes) {
+    byte = static_cast<char>(random());
+  }
+  return bytes;
+}
+
+}  // namespace
+
+TEST(Deflate, RoundTripsEveryLevel) {
+  const std::string text = MakeText(200000);
+  const std::string random = MakeRandom(70000);
+  for (int level = http1::DeflateEncoder::MIN_LEVEL;
+       level <= http1::DeflateEncoder::MAX_LEVEL; ++level) {
+    EXPECT_EQ("", Inflate(Deflate("", level))) << level;
+    EXPECT_EQ("a", Inflate(Deflate("a", level))) << level;
+    EXPECT_EQ(text, Inflate(Deflate(text, level))) << level;
+    EXPECT_EQ(random, Inflate(Deflate(random, level))) << level;
+  }
+}
+
+TEST(Deflate, LongRunsAndMaximumMatches) {
+  const std::string run(100000, 'x');
+  std::string pattern;
+  for (int index = 0; index < 2000; ++index) {
+    pattern += "abcdefghijklmnopqrstuvwxyz0123456789"[index % 36];
+  }
+  for (const int level : {1, 4, 9}) {
+    const std::string compressed = Deflate(run, level);
+    EXPECT_LT(compressed.size(), 1000) << level;
+    EXPECT_EQ(run, Inflate(compressed)) << level;
+    EXPECT_EQ(pattern + run + pattern,
+              Inflate(Deflate(pattern + run + pattern, level)))
+        << level;
+  }
+}
+
+TEST(Deflate, HigherLevelsCompressBetter) {
+  const std::string text = MakeText(100000);
+  const std::size_t stored = Deflate(text, 0).size();
+  const std::size_t fast = Deflate(text, 1).size();
+  const std::size_t best = Deflate(text, 9).size();
+  EXPECT_GT(stored, text.size());
+  EXPECT_LT(fast, text.size() / 2);
+  EXPECT_LE(best, fast);
+}
+
+TEST(Deflate, IncompressibleInputIsStored) {
+  const std::string random = MakeRandom(100000);
+  // A stored block costs 5 bytes
+  EXPECT_LE(Deflate(random, 6).size(), random.size() + random.size() / 1000);
+}
+
+TEST(Deflate, StreamsWithFlush) {
+  const std::string text = MakeText(150000);
+  http1::DeflateEncoder encoder(5);
+  http1::ByteArray output;
+
+  std::string expected;
+  for (std::size_t offset = 0; offset < text.size(); offset += 7001) {
+    const std::string_view piece = std::string_view(text).substr(offset, 7001);
+    encoder.Write(AsBytes(piece), output);
+    expected += piece;
+    if (offset % 3 == 0) {
+      // Everything written so far is decodable
+      encoder.Flush(output);
+      Inflater inflater(output);
+      EXPECT_EQ(expected, inflater.Inflate());
+      EXPECT_FALSE(inflater.final_block_seen());
+    }
+  }
+  encoder.Finish(output);
+  EXPECT_EQ(text, Inflate(AsText(output)));
+}
+
+TEST(Deflate, RejectsInvalidLevels) {
+  EXPECT_THROW(http1::DeflateEncoder(-1), std::invalid_argument);
+  EXPECT_THROW(http1::DeflateEncoder(10), std::invalid_argument);
+}
+
+TEST(Gzip, HeaderAndTrailer) {
+  const std::string text = MakeText(5000);
+  const std::string gzip = AsText(http1::GzipCompress(AsBytes(text), 9));
+  ASSERT_GT(gzip.size(), 18);
+  EXPECT_EQ(std::string("\x1F\x8B\x08\x00\x00\x00\x00\x00\x02\x03", 10),
+            gzip.substr(0, 10));
+
+  const std::string_view deflate =
+      std::string_view(gzip).substr(10, gzip.size() - 18);
+  EXPECT_EQ(text, Inflate(deflate));
+
+  const std::uint32_t crc = http1::Crc32(AsBytes(text));
+  const std::string trailer = gzip.substr(gzip.size() - 8);
+  for (std::size_t index = 0; index < 4; ++index) {
+    EXPECT_EQ(static_cast<char>(crc >> (8 * index)), trailer[index]);
+    EXPECT_EQ(static_cast<char>(text.size() >> (8 * index)),
+              trailer[4 + index]);
+  }
+}
+
+TEST(CompressResponse, CompressesAcceptedTextBodies) {
+  const std::string body = MakeText(4000);
+  http1::HttpRequest request(http1::HttpMethod::Get, "/",
+                             http1::HttpVersion::Http11);
+  request.UpdateFields("accept-encoding", "gzip, br");
+
+  http1::HttpResponse response(http1::HttpStatusCode::OK);
+  response.AddField(http1::HeaderField{
+      .name = "content-type", .value = "application/json; charset=utf-8"});
+  response.AddField(http1::HeaderField{.name = "etag", .value = "\"v1\""});
+  response.SetBody(AsBytes(body));
+  response.SetContentLength(body.size());
+
+  ASSERT_TRUE(http1::CompressResponse(request, response));
+  EXPECT_EQ("gzip", response.FindField("content-encoding"));
+  EXPECT_EQ("accept-encoding", response.FindField("vary"));
+  EXPECT_EQ("W/\"v1\"", response.FindField("etag"));
+  EXPECT_EQ(response.body()->size(), response.content_length());
+
+  const std::string gzip = AsText(*response.body());
+  EXPECT_EQ(body,
+            Inflate(std::string_view(gzip).substr(10, gzip.size() - 18)));
+
+  // Already encoded
+  EXPECT_FALSE(http1::CompressResponse(request, response));
+}
+
+TEST(CompressResponse, RewritesContentLengthField) {
+  const std::string body = MakeText(4000);
+  http1::HttpRequest request(http1::HttpMethod::Get, "/",
+                             http1::HttpVersion::Http11);
+  request.UpdateFields("accept-encoding", "gzip");
+
+  http1::HttpResponse response(http1::HttpStatusCode::OK);
+  response.AddField(
+      http1::HeaderField{.name = "content-type", .value = "text/plain"});
+  response.AddField(http1::HeaderField{
+      .name = "content-length", .value = std::to_string(body.size())});
+  response.SetBody(AsBytes(body));
+
+  ASSERT_TRUE(http1::CompressResponse(request, response));
+  EXPECT_FALSE(response.content_length());
+  EXPECT_EQ(std::to_string(response.body()->size()),
+            response.FindField("content-length"));
+
+  // A field not matching the body is left alone, body included
+  http1::HttpResponse mismatched(http1::HttpStatusCode::OK);
+  mismatched.AddField(
+      http1::HeaderField{.name = "content-type", .value = "text/plain"});
+  mismatched.AddField(
+      http1::HeaderField{.name = "content-length", .value = "10"});
+  mismatched.SetBody(AsBytes(body));
+  EXPECT_FALSE(http1::CompressResponse(request, mismatched));
+  EXPECT_EQ(body.size(), mismatched.body()->size());
+}
+
+TEST(CompressResponse, SkipsWhatDoesNotPay) {
+  const std::string body = MakeText(4000);
+  http1::HttpRequest request(http1::HttpMethod::Get, "/",
+                             http1::HttpVersion::Http11);
+  request.UpdateFields("accept-encoding", "gzip");
+
+  auto make_response = [&](std::string_view content_type,
+                           std::string_view response_body) {
+    http1::HttpResponse response(http1::HttpStatusCode::OK);
+    response.AddField(http1::HeaderField{
+        .name = "content-type", .value = std::string(content_type)});
+    response.SetBody(AsBytes(response_body));
+    return response;
+  };
+
+  auto image = make_response("image/png", body);
+  EXPECT_FALSE(http1::CompressResponse(request, image));
+  EXPECT_FALSE(image.FindField("vary"));
+
+  auto tiny = make_response("text/plain", "small");
+  EXPECT_FALSE(http1::CompressResponse(request, tiny));
+
+  auto random = make_response("text/plain", MakeRandom(4000));
+  EXPECT_FALSE(http1::CompressResponse(request, random));
+
+  // Not accepted, but the response still varies
+  auto text = make_response("text/html", body);
+  const http1::HttpRequest plain(http1::HttpMethod::Get, "/",
+                                 http1::HttpVersion::Http11);
+  EXPECT_FALSE(http1::CompressResponse(plain, text));
+  EXPECT_EQ("accept-encoding", text.FindField("vary"));
+
+  http1::HttpRequest prefers_identity(http1::HttpMethod::Get, "/",
+                                      http1::HttpVersion::Http11);
+  prefers_identity.UpdateFields("accept-encoding", "gzip;q=0.5, identity");
+  EXPECT_FALSE(http1::CompressResponse(prefers_identity, text));
+}
+
+TEST(CompressResponse, CompressibleTypes) {
+  EXPECT_TRUE(http1::IsCompressible("text/html; charset=utf-8"));
+  EXPECT_TRUE(http1::IsCompressible("TEXT/CSS"));
+  EXPECT_TRUE(http1::IsCompressible("application/json"));
+  EXPECT_TRUE(http1::IsCompressible("application/ld+json"));
+  EXPECT_TRUE(http1::IsCompressible("image/svg+xml"));
+  EXPECT_TRUE(http1::IsCompressible("application/wasm"));
+  EXPECT_FALSE(http1::IsCompressible("image/jpeg"));
+  EXPECT_FALSE(http1::IsCompressible("application/gzip"));
+  EXPECT_FALSE(http1::IsCompressible("font/woff2"));
+  EXPECT_FALSE(http1::IsCompressible("json"));
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "loopback.hpp"
+
+using loopback::IdleServer;
+
+TEST(EventLoop, PostRunsOnLoopThread) {
+  IdleServer server;
+  std::thread loop([&server] { server.Start(); });
+
+  std::atomic<int> counter = 0;
+  std::thread::id task_thread;
+  for (int i = 0; i < 100; ++i) {
+    server.Post([&] {
+      task_thread = std::this_thread::get_id();
+      counter.fetch_add(1);
+    });
+  }
+  const auto loop_thread = loop.get_id();
+  server.Stop();
+  loop.join();
+
+  EXPECT_EQ(100, counter.load());
+  EXPECT_EQ(loop_thread, task_thread);
+}
+
+TEST(EventLoop, DeferRunsAfterCurrentTask) {
+  IdleServer server;
+  std::vector<int> order;
+
+  server.Post([&] {
+    server.Defer([&] {
+      order.push_back(3);
+      server.Stop();
+    });
+    order.push_back(1);
+  });
+  server.Post([&] { order.push_back(2); });
+
+  server.Start();
+
+  EXPECT_EQ((std::vector<int>{1, 2, 3}), order);
+}
+
+TEST(EventLoop, DeferFromDeferredTaskDoesNotBlock) {
+  IdleServer server;
+  int runs = 0;
+
+  std::function<void()> again = [&] {
+    if (++runs == 3) {
+      server.Stop();
+      return;
+    }
+    server.Defer(again);
+  };
+  server.Defer(again);
+
+  server.Start();
+
+  EXPECT_EQ(3, runs);
+}
+
+TEST(EventLoop, WatchUserFd) {
+  IdleServer server;
+  const int event_fd = eventfd(0, EFD_NONBLOCK);
+  ASSERT_GE(event_fd, 0);
+
+  std::uint64_t received = 0;
+  server.Watch(event_fd, EPOLLIN, [&](std::uint32_t events) {
+    EXPECT_NE(0U, events & EPOLLIN);
+    ASSERT_EQ(sizeof(received), read(event_fd, &received, sizeof(received)));
+    server.Unwatch(event_fd);
+    server.Stop();
+  });
+
+  std::thread loop([&server] { server.Start(); });
+  const std::uint64_t value = 42;
+  ASSERT_EQ(sizeof(value), write(event_fd, &value, sizeof(value)));
+  loop.join();
+  close(event_fd);
+
+  EXPECT_EQ(42, received);
+}
\ No newline at end of file
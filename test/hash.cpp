@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <set>
+#include <string_view>
+
+#include "hash.hpp"
+
+namespace {
+
+std::uint64_t HashOf(std::string_view text, std::uint64_t seed = 0) {
+  return http1::Hash64(
+      http1::ByteArrayView(reinterpret_cast<const std::byte*>(text.data()),
+                           text.size()),
+      seed);
+}
+
+std::uint32_t CrcOf(std::string_view text, std::uint32_t crc = 0) {
+  return http1::Crc32(
+      http1::ByteArrayView(reinterpret_cast<const std::byte*>(text.data()),
+                           text.size()),
+      crc);
+}
+
+}  // namespace
+
+TEST(Hash64, MatchesXxh64) {
+  EXPECT_EQ(0xEF46DB3751D8E999ULL, HashOf(""));
+  EXPECT_EQ(0xD24EC4F1A98C6E5BULL, HashOf("a"));
+  EXPECT_EQ(0x44BC2CF5AD770999ULL, HashOf("abc"));
+  EXPECT_EQ(0xFBCEA83C8A378BF1ULL,
+            HashOf("Nobody inspects the spammish repetition"));
+}
+
+TEST(Hash64, DependsOnEveryByteAndSeed) {
+  constexpr std::string_view TEXT =
+      "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+  // Every length exercises a different mix of stripes and tails
+  std::set<std::uint64_t> hashes;
+  for (std::size_t size = 0; size <= TEXT.size(); ++size) {
+    hashes.insert(HashOf(TEXT.substr(0, size)));
+  }
+  EXPECT_EQ(TEXT.size() + 1, hashes.size());
+
+  EXPECT_NE(HashOf(TEXT), HashOf(TEXT, 1));
+  EXPECT_NE(HashOf(TEXT.substr(1)), HashOf(TEXT.substr(0, TEXT.size() - 1)));
+}
+
+TEST(Crc32, MatchesGzip) {
+  EXPECT_EQ(0U, CrcOf(""));
+  EXPECT_EQ(0xE8B7BE43U, CrcOf("a"));
+  EXPECT_EQ(0xCBF43926U, CrcOf("123456789"));
+  EXPECT_EQ(0x414FA339U, CrcOf("The quick brown fox jumps over the lazy dog"));
+
+  // Continuing from a prefix gives the CRC of the whole
+  EXPECT_EQ(CrcOf("The quick brown fox jumps over the lazy dog"),
+            CrcOf(" over the lazy dog", CrcOf("The quick brown fox jumps")));
+}
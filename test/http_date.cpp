@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#include "http_date.hpp"
+#include "http_server.hpp"
+
+namespace {
+
+std::string FormatWithStrftime(std::time_t time) {
+  std::tm broken_down{};
+  gmtime_r(&time, &broken_down);
+  std::array<char, 64> buffer{};
+  const std::size_t size = std::strftime(buffer.data(), buffer.size(),
+                                         "%a, %d %b %Y %H:%M:%S GMT",
+                                         &broken_down);
+  return {buffer.data(), size};
+}
+
+}  // namespace
+
+TEST(HttpDate, FormatsFixdate) {
+  EXPECT_EQ("Thu, 01 Jan 1970 00:00:00 GMT", http1::FormatHttpDate(0));
+  EXPECT_EQ("Sun, 06 Nov 1994 08:49:37 GMT", http1::FormatHttpDate(784111777));
+}
+
+TEST(HttpDate, MatchesStrftime) {
+  constexpr std::array<std::time_t, 8> TIMES = {
+      0,           59,          86399,       951782400,  // 2000-02-29
+      1078099199,  1709164800,  4107542399,  1685271421};
+  for (const auto time : TIMES) {
+    EXPECT_EQ(FormatWithStrftime(time), http1::FormatHttpDate(time));
+  }
+
+  // Every day across a few leap and non-leap years
+  for (std::time_t time = 1577836800; time < 1704067200; time += 86400 + 7) {
+    EXPECT_EQ(FormatWithStrftime(time), http1::FormatHttpDate(time));
+  }
+}
+
+TEST(HttpDate, ParsesFixdate) {
+  EXPECT_EQ(784111777, http1::ParseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT"));
+  EXPECT_EQ(0, http1::ParseHttpDate("Thu, 01 Jan 1970 00:00:00 GMT"));
+
+  for (std::time_t time = 946684800; time < 1893456000; time += 9876543) {
+    EXPECT_EQ(time, http1::ParseHttpDate(http1::FormatHttpDate(time)));
+  }
+
+  EXPECT_FALSE(http1::ParseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT"));
+  EXPECT_FALSE(http1::ParseHttpDate("Sun Nov  6 08:49:37 1994"));
+  EXPECT_FALSE(http1::ParseHttpDate("Sun, 06 Foo 1994 08:49:37 GMT"));
+  EXPECT_FALSE(http1::ParseHttpDate("Sun, 06 Nov 1994 08:49:37 UTC"));
+  EXPECT_FALSE(http1::ParseHttpDate("Sun, 06 Nov 1994 25:49:37 GMT"));
+  EXPECT_FALSE(http1::ParseHttpDate("Sun, 0x Nov 1994 08:49:37 GMT"));
+}
+
+TEST(CommonFieldsCache, UpdatesOncePerSecond) {
+  http1::CommonFieldsCache cache;
+  cache.Update(784111777);
+  EXPECT_EQ("date: Sun, 06 Nov 1994 08:49:37 GMT\r\n", cache.lines());
+
+  EXPECT_FALSE(cache.Update(784111777));
+  EXPECT_TRUE(cache.Update(784111778));
+  EXPECT_EQ("date: Sun, 06 Nov 1994 08:49:38 GMT\r\n", cache.lines());
+}
+
+TEST(CommonFieldsCache, ServerName) {
+  http1::CommonFieldsCache cache;
+  cache.Update(0);
+  cache.SetServerName("http1");
+  EXPECT_EQ(
+      "date: Thu, 01 Jan 1970 00:00:00 GMT\r\n"
+      "server: http1\r\n",
+      cache.lines());
+
+  cache.SetServerName("");
+  EXPECT_EQ("date: Thu, 01 Jan 1970 00:00:00 GMT\r\n", cache.lines());
+}
+
+TEST(CommonFieldsCache, SerializedAfterStatusLine) {
+  http1::CommonFieldsCache cache;
+  cache.Update(0);
+
+  http1::HttpResponse response(http1::HttpStatusCode::NoContent);
+  const auto serialized = response.Serialize(cache.lines());
+  const std::string expected =
+      "HTTP/1.1 204 No Content\r\n"
+      "date: Thu, 01 Jan 1970 00:00:00 GMT\r\n"
+      "\r\n";
+  ASSERT_EQ(expected.size(), serialized.size());
+  EXPECT_EQ(expected.size(), response.SerializedSize(cache.lines()));
+  EXPECT_EQ(0, std::memcmp(expected.data(), serialized.data(),
+                           serialized.size()));
+}
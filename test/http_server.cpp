@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include "loopback.hpp"
+#include "tcp_server.hpp"
+
+namespace {
+
+using http1::HttpRequest;
+using http1::HttpResponse;
+using http1::HttpStatusCode;
+using loopback::Exchange;
+using loopback::RunningServer;
+
+// Servers are only destroyed through their most derived type
+static_assert(!std::is_destructible_v<http1::TcpServerCore>);
+
+// Echoes received bytes through non-virtual handlers
+class EchoTcpServer : public http1::BasicTcpServer<EchoTcpServer> {
+  friend BasicTcpServer<EchoTcpServer>;
+
+ public:
+  EchoTcpServer() : BasicTcpServer(0) {}
+
+ private:
+  void OnData(const Socket& socket, const http1::ByteArrayView& data) {
+    socket.Write(data);
+  }
+
+  void OnClose(const Socket& /*socket*/) {}
+};
+
+// Offloads /offload and records the threads requests were handled on
+class OffloadingServer : public http1::BasicHttpServer<OffloadingServer> {
+  friend BasicHttpServer<OffloadingServer>;
+
+ public:
+  OffloadingServer() : BasicHttpServer(0) {}
+
+  [[nodiscard]] std::thread::id ThreadOf(const std::string& path) {
+    const std::lock_guard lock(mutex_);
+    return path == "/offload" ? offloaded_thread_ : loop_thread_;
+  }
+
+ private:
+  [[nodiscard]] bool ShouldOffload(const HttpRequest& request) const {
+    return request.path() == "/offload";
+  }
+
+  HttpResponse OnRequest(const HttpRequest& request) {
+    {
+      const std::lock_guard lock(mutex_);
+      (request.path() == "/offload" ? offloaded_thread_ : loop_thread_) =
+          std::this_thread::get_id();
+    }
+    HttpResponse response(HttpStatusCode::NoContent);
+    response.SetContentLength(0);
+    return response;
+  }
+
+  std::mutex mutex_;
+  std::thread::id offloaded_thread_;
+  std::thread::id loop_thread_;
+};
+
+}  // namespace
+
+TEST(BasicTcpServer, DispatchesStatically) {
+  EchoTcpServer server;
+  const RunningServer running(server);
+  EXPECT_EQ("ping", Exchange(running.port(), "ping", "ping"));
+}
+
+TEST(BasicHttpServer, OffloadsSelectedRequests) {
+  OffloadingServer server;
+  server.EnableWorkerPool(1, 4);
+  std::thread::id loop_thread;
+  {
+    const RunningServer running(server);
+    server.Post([&loop_thread] { loop_thread = std::this_thread::get_id(); });
+
+    const std::string received = Exchange(
+        running.port(),
+        "GET /offload HTTP/1.1\r\n\r\nGET /inline HTTP/1.1\r\n\r\n",
+        " 204 No Content\r\n", 2);
+    EXPECT_EQ(2U, loopback::Count(received, " 204 No Content\r\n"));
+  }
+
+  EXPECT_EQ(loop_thread, server.ThreadOf("/inline"));
+  EXPECT_NE(std::thread::id(), server.ThreadOf("/offload"));
+  EXPECT_NE(loop_thread, server.ThreadOf("/offload"));
+}
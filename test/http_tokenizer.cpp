@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+
+#include "http_server.hpp"
+#include "http_tokenizer.hpp"
+
+TEST(HttpTokenizer, CharClassTable) {
+  EXPECT_NE(0, http1::ClassOf('a') & http1::TOKEN_CHAR);
+  EXPECT_NE(0, http1::ClassOf('~') & http1::TOKEN_CHAR);
+  EXPECT_EQ(0, http1::ClassOf(':') & http1::TOKEN_CHAR);
+  EXPECT_EQ(0, http1::ClassOf(' ') & http1::TOKEN_CHAR);
+  EXPECT_NE(0, http1::ClassOf('"') & http1::FIELD_VALUE_CHAR);
+  EXPECT_NE(0, http1::ClassOf('\xE9') & http1::FIELD_VALUE_CHAR);
+  EXPECT_EQ(0, http1::ClassOf('\x7F') & http1::FIELD_VALUE_CHAR);
+  EXPECT_NE(0, http1::ClassOf('\t') & http1::WHITESPACE_CHAR);
+  EXPECT_EQ(0, http1::ClassOf('\xE9') & http1::TARGET_CHAR);
+}
+
+TEST(HttpTokenizer, RequestLineAndFields) {
+  constexpr std::string_view HEADER =
+      "GET /index.html?x=1 HTTP/1.1\r\n"
+      "Host: example.com\r\n"
+      "X-Padded:  \t value with  spaces \t \r\n"
+      "Empty:\r\n"
+      "\r\n";
+
+  http1::HttpTokenizer tokenizer(HEADER);
+  const auto request_line = tokenizer.ParseRequestLine();
+  EXPECT_EQ("GET", request_line.method.In(HEADER));
+  EXPECT_EQ("/index.html?x=1", request_line.target.In(HEADER));
+  EXPECT_EQ("HTTP/1.1", request_line.version.In(HEADER));
+
+  http1::FieldTokens tokens;
+  std::string name;
+
+  ASSERT_TRUE(tokenizer.NextField(tokens, name));
+  EXPECT_EQ("host", name);
+  EXPECT_EQ("Host", tokens.name.In(HEADER));
+  EXPECT_EQ("example.com", tokens.value.In(HEADER));
+
+  ASSERT_TRUE(tokenizer.NextField(tokens, name));
+  EXPECT_EQ("x-padded", name);
+  EXPECT_EQ("value with  spaces", tokens.value.In(HEADER));
+
+  ASSERT_TRUE(tokenizer.NextField(tokens, name));
+  EXPECT_EQ("empty", name);
+  EXPECT_EQ("", tokens.value.In(HEADER));
+
+  EXPECT_FALSE(tokenizer.NextField(tokens, name));
+}
+
+TEST(HttpTokenizer, RejectsInvalidRequestLine) {
+  for (const std::string_view header :
+       {"GET\r\n\r\n", "G(T / HTTP/1.1\r\n\r\n", "GET  / HTTP/1.1\r\n\r\n",
+        "GET /a b HTTP/1.1\r\n\r\n", "GET / HTTP/1.1\n\r\n"}) {
+    http1::HttpTokenizer tokenizer(header);
+    EXPECT_THROW(tokenizer.ParseRequestLine(), http1::HttpParseError)
+        << header;
+  }
+}
+
+TEST(HttpTokenizer, RejectsInvalidFields) {
+  for (const std::string_view field :
+       {"Host : a\r\n", "Ho st: a\r\n", ": a\r\n", "Host a\r\n",
+        "Host: a\x01"
+        "b\r\n",
+        "Host: a\nb\r\n"}) {
+    const std::string header = std::string("GET / HTTP/1.1\r\n") +
+                               std::string(field) + "\r\n";
+    EXPECT_THROW(http1::HttpRequest::ParseHeader(header), http1::HttpParseError)
+        << field;
+  }
+}
+
+TEST(HttpTokenizer, RecognizesMethods) {
+  static_assert(http1::SerializeMethod(http1::HttpMethod::Options) ==
+                "OPTIONS");
+
+  for (const auto method :
+       {http1::HttpMethod::Get, http1::HttpMethod::Head,
+        http1::HttpMethod::Post, http1::HttpMethod::Put,
+        http1::HttpMethod::Delete, http1::HttpMethod::Connect,
+        http1::HttpMethod::Options, http1::HttpMethod::Trace,
+        http1::HttpMethod::Patch}) {
+    const std::string header =
+        std::string(http1::SerializeMethod(method)) + " / HTTP/1.1\r\n\r\n";
+    EXPECT_EQ(method, http1::HttpRequest::ParseHeader(header).method())
+        << header;
+  }
+
+  for (const std::string_view header :
+       {"GETS / HTTP/1.1\r\n\r\n", "get / HTTP/1.1\r\n\r\n",
+        "PATCHES / HTTP/1.1\r\n\r\n", "CONNECTS / HTTP/1.1\r\n\r\n"}) {
+    EXPECT_THROW(http1::HttpRequest::ParseHeader(header), http1::HttpParseError)
+        << header;
+  }
+}
+
+TEST(HttpTokenizer, RecognizesVersions) {
+  EXPECT_EQ(
+      http1::HttpVersion::Http10,
+      http1::HttpRequest::ParseHeader("GET / HTTP/1.0\r\n\r\n").version());
+  EXPECT_EQ(
+      http1::HttpVersion::Http11,
+      http1::HttpRequest::ParseHeader("GET / HTTP/1.1\r\n\r\n").version());
+
+  for (const std::string_view header :
+       {"GET / HTTP/2.0\r\n\r\n", "GET / HTTP/1.12\r\n\r\n",
+        "GET / http/1.1\r\n\r\n", "GET / HTTP/1\r\n\r\n"}) {
+    EXPECT_THROW(http1::HttpRequest::ParseHeader(header), http1::HttpParseError)
+        << header;
+  }
+}
@@ -0,0 +1,133 @@
+#ifndef HTTP1_TEST_LOOPBACK_HPP
+#define HTTP1_TEST_LOOPBACK_HPP
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "http_server.hpp"
+
+// Servers and clients talking over the loopback interface, shared by the
+// tests running real event loops
+namespace loopback {
+
+// Event loop ignoring its connections, e.g. for posted tasks and watched fds
+class IdleServer : public http1::TcpServer {
+ public:
+  IdleServer() : TcpServer(0) {}
+
+ private:
+  void OnData(const Socket& /*socket*/,
+              const http1::ByteArrayView& /*data*/) override {}
+  void OnClose(const Socket& /*socket*/) override {}
+};
+
+// Answers every request with 204 No Content, or 404 Not Found for /missing
+class NoContentServer : public http1::BasicHttpServer<NoContentServer> {
+  friend BasicHttpServer<NoContentServer>;
+
+ public:
+  NoContentServer() : BasicHttpServer(0) {}
+
+ private:
+  http1::HttpResponse OnRequest(const http1::HttpRequest& request) {
+    http1::HttpResponse response(request.path() == "/missing"
+                                     ? http1::HttpStatusCode::NotFound
+                                     : http1::HttpStatusCode::NoContent);
+    response.SetContentLength(0);
+    return response;
+  }
+};
+
+// Runs a server on a thread of its own while in scope
+template <class Server>
+class RunningServer {
+ public:
+  explicit RunningServer(Server& server)
+      : server_(server), loop_([&server] { server.Start(); }) {
+    // Posted tasks run once the loop listens
+    std::promise<std::uint16_t> port;
+    server.Post([&server, &port] { port.set_value(server.port()); });
+    port_ = port.get_future().get();
+  }
+
+  ~RunningServer() {
+    server_.Stop();
+    loop_.join();
+  }
+
+  RunningServer(const RunningServer& other) = delete;
+  RunningServer& operator=(const RunningServer& other) = delete;
+
+  [[nodiscard]] std::uint16_t port() const noexcept { return port_; }
+
+ private:
+  Server& server_;
+  std::thread loop_;
+  std::uint16_t port_ = 0;
+};
+
+inline bool Contains(std::string_view text, std::string_view part) {
+  return text.find(part) != std::string_view::npos;
+}
+
+inline std::size_t Count(std::string_view text, std::string_view needle) {
+  std::size_t count = 0;
+  for (std::size_t position = text.find(needle);
+       position != std::string_view::npos;
+       position = text.find(needle, position + needle.size())) {
+    ++count;
+  }
+  return count;
+}
+
+// Sends request on a new connection and reads until the response contains
+// end_marker end_marker_count times or the server closes the connection
+inline std::string Exchange(std::uint16_t port, std::string_view request,
+                            std::string_view end_marker,
+                            std::size_t end_marker_count = 1) {
+  const int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  std::string received;
+  if (connect(client_fd, reinterpret_cast<sockaddr*>(&address),
+              sizeof(address)) == 0) {
+    send(client_fd, request.data(), request.size(), 0);
+    std::array<char, 4096> buffer{};
+    while (Count(received, end_marker) < end_marker_count) {
+      const ssize_t size = recv(client_fd, buffer.data(), buffer.size(), 0);
+      if (size <= 0) {
+        break;
+      }
+      received.append(buffer.data(), static_cast<std::size_t>(size));
+    }
+  }
+  close(client_fd);
+  return received;
+}
+
+// Reads from fd until the writing end is closed
+inline std::string ReadAll(int fd) {
+  std::string text;
+  std::array<char, 4096> buffer{};
+  while (true) {
+    const ssize_t size = read(fd, buffer.data(), buffer.size());
+    if (size <= 0) {
+      return text;
+    }
+    text.append(buffer.data(), static_cast<std::size_t>(size));
+  }
+}
+
+}  // namespace loopback
+
+#endif
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "loopback.hpp"
+#include "metrics.hpp"
+#include "metrics_server.hpp"
+
+namespace {
+
+using http1::RequestPhase;
+using loopback::Contains;
+using loopback::Exchange;
+using loopback::NoContentServer;
+using loopback::RunningServer;
+
+}  // namespace
+
+TEST(Metrics, CountersAndGauges) {
+  http1::Counter counter;
+  counter.Add();
+  counter.Add(41);
+  EXPECT_EQ(42U, counter.value());
+
+  http1::Gauge gauge;
+  gauge.Add(3);
+  gauge.Add(-5);
+  EXPECT_EQ(-2, gauge.value());
+
+  static_assert(alignof(http1::TcpMetrics) == http1::CACHE_LINE_SIZE);
+  static_assert(alignof(http1::HttpMetrics) == http1::CACHE_LINE_SIZE);
+}
+
+TEST(Metrics, WritesTextFormat) {
+  std::string output;
+  http1::MetricsWriter writer(output);
+  writer.Family("requests_total", "counter", "Requests.");
+  writer.Sample("requests_total", "method=\"GET\"", std::uint64_t{7});
+  writer.Family("queue", "gauge", "Queue size.");
+  writer.Sample("queue", {}, std::int64_t{-1});
+
+  EXPECT_EQ(
+      "# HELP requests_total Requests.\n"
+      "# TYPE requests_total counter\n"
+      "requests_total{method=\"GET\"} 7\n"
+      "# HELP queue Queue size.\n"
+      "# TYPE queue gauge\n"
+      "queue -1\n",
+      output);
+}
+
+TEST(Metrics, HistogramBuckets) {
+  using http1::Histogram;
+
+  // Small values are exact, larger ones share a bucket only with values
+  // within 1%
+  for (std::uint64_t value = 0; value < 256; ++value) {
+    EXPECT_EQ(value, Histogram::HighestValueOf(Histogram::IndexOf(value)));
+  }
+  for (std::uint64_t value = 256; value < Histogram::MAX_VALUE;
+       value = value * 3 / 2 + 7) {
+    const std::uint64_t highest =
+        Histogram::HighestValueOf(Histogram::IndexOf(value));
+    EXPECT_LE(value, highest);
+    EXPECT_LE(highest - value, value / 100);
+    EXPECT_EQ(Histogram::IndexOf(value) + 1,
+              Histogram::IndexOf(highest + 1));
+  }
+  EXPECT_EQ(Histogram::BUCKET_COUNT - 1,
+            Histogram::IndexOf(Histogram::MAX_VALUE));
+}
+
+TEST(Metrics, HistogramQuantiles) {
+  auto histogram = std::make_unique<http1::Histogram>();
+  for (std::uint64_t value = 1; value <= 1000; ++value) {
+    histogram->Record(value * 1000);
+  }
+  // Clamped to the largest value
+  histogram->Record(~std::uint64_t{0});
+
+  http1::HistogramSnapshot snapshot;
+  EXPECT_EQ(0U, snapshot.ValueAtQuantile(0.5));
+  snapshot.Merge(*histogram);
+  snapshot.Merge(*histogram);
+  EXPECT_EQ(2002U, snapshot.count());
+
+  const auto near = [](std::uint64_t expected, std::uint64_t actual) {
+    return actual >= expected && actual - expected <= expected / 100;
+  };
+  EXPECT_PRED2(near, 500'000U, snapshot.ValueAtQuantile(0.5));
+  EXPECT_PRED2(near, 990'000U, snapshot.ValueAtQuantile(0.99));
+  EXPECT_PRED2(near, 999'000U, snapshot.ValueAtQuantile(0.998));
+  EXPECT_EQ(http1::Histogram::MAX_VALUE, snapshot.ValueAtQuantile(1.0));
+  EXPECT_PRED2(near, 1000U, snapshot.ValueAtQuantile(0.0));
+}
+
+TEST(Metrics, CountsServerActivity) {
+  NoContentServer server;
+  server.EnableMetrics();
+  const RunningServer running(server);
+
+  const std::string pipelined = Exchange(
+      running.port(),
+      "GET / HTTP/1.1\r\n\r\nPOST /missing HTTP/1.1\r\n\r\n"
+      "GET /%zz HTTP/1.1\r\n\r\n",
+      "HTTP/1.1 404 Not Found\r\n");
+  EXPECT_TRUE(Contains(pipelined, "HTTP/1.1 204 No Content\r\n"));
+
+  // The metrics request is parsed but not yet written when it is answered
+  const std::string metrics = Exchange(
+      running.port(), "GET /metrics HTTP/1.1\r\n\r\n",
+      "http1_request_phase_seconds_count{phase=\"write\"} 2\n");
+  EXPECT_TRUE(Contains(metrics, "text/plain; version=0.0.4"));
+  EXPECT_TRUE(Contains(metrics, "http1_requests_total{method=\"GET\"} 2\n"));
+  EXPECT_TRUE(Contains(metrics, "http1_requests_total{method=\"POST\"} 1\n"));
+  EXPECT_TRUE(Contains(metrics, "http1_responses_total{class=\"2xx\"} 1\n"));
+  EXPECT_TRUE(Contains(metrics, "http1_responses_total{class=\"4xx\"} 1\n"));
+  EXPECT_TRUE(Contains(metrics, "http1_parse_errors_total{kind=\"path\"} 1\n"));
+  EXPECT_TRUE(Contains(metrics, "http1_connections_accepted_total 2\n"));
+  EXPECT_TRUE(Contains(metrics, "http1_queued_write_bytes 0\n"));
+  EXPECT_TRUE(
+      Contains(metrics, "# TYPE http1_request_phase_seconds summary\n"));
+  EXPECT_TRUE(Contains(
+      metrics, "http1_request_phase_seconds_count{phase=\"parse\"} 3\n"));
+  EXPECT_TRUE(Contains(
+      metrics, "http1_request_phase_seconds_count{phase=\"handle\"} 2\n"));
+  EXPECT_TRUE(Contains(metrics,
+                       "http1_request_phase_seconds{phase=\"serialize\","
+                       "quantile=\"0.999\"} "));
+
+  EXPECT_EQ(2U, server.tcp_metrics().accepted_connections.value());
+  EXPECT_LT(0U, server.tcp_metrics().received_bytes.value());
+  EXPECT_LT(0U, server.tcp_metrics().sent_bytes.value());
+
+  const auto& phases = server.latency_metrics().phases;
+  for (const auto phase :
+       {RequestPhase::Parse, RequestPhase::Handle, RequestPhase::Serialize}) {
+    http1::HistogramSnapshot snapshot;
+    snapshot.Merge(phases[static_cast<std::size_t>(phase)]);
+    EXPECT_EQ(3U, snapshot.count());
+  }
+}
+
+TEST(Metrics, MetricsServer) {
+  NoContentServer server;
+  http1::MetricsServer metrics_server(
+      0, [&server](std::string& output) { server.WriteMetrics(output); });
+  const RunningServer running(server);
+  const RunningServer running_metrics(metrics_server);
+
+  Exchange(running.port(), "GET / HTTP/1.1\r\n\r\n", "\r\n\r\n");
+  const std::string metrics = Exchange(
+      running_metrics.port(), "GET / HTTP/1.1\r\n\r\n",
+      "http1_parse_errors_total{kind=\"field\"} 0\n");
+  EXPECT_TRUE(Contains(metrics, "http1_requests_total{method=\"GET\"} 1\n"));
+
+  const std::string rejected = Exchange(
+      running_metrics.port(), "POST / HTTP/1.1\r\n\r\n", "\r\n\r\n");
+  EXPECT_TRUE(rejected.starts_with("HTTP/1.1 405 Method Not Allowed\r\n"));
+}
@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "pipeline.hpp"
+#include "router.hpp"
+
+namespace {
+
+using http1::HeaderField;
+using http1::HttpMethod;
+using http1::HttpRequest;
+using http1::HttpResponse;
+using http1::HttpStatusCode;
+using http1::Pipeline;
+
+// Records its name on the way in and out, and answers 403 Forbidden for
+// paths starting with its name
+class Trace {
+ public:
+  Trace(std::string name, std::vector<std::string>* calls)
+      : name_(std::move(name)), calls_(calls) {}
+
+  template <class Next>
+  HttpResponse Handle(const HttpRequest& request, Next next) {
+    calls_->push_back(name_ + " in");
+    if (request.path().starts_with("/" + name_)) {
+      return HttpResponse(HttpStatusCode::Forbidden);
+    }
+    HttpResponse response = next(request);
+    response.AddField(HeaderField{.name = "x-trace", .value = name_});
+    calls_->push_back(name_ + " out");
+    return response;
+  }
+
+ private:
+  std::string name_;
+  std::vector<std::string>* calls_;
+};
+
+class Answer {
+ public:
+  explicit Answer(std::vector<std::string>* calls) : calls_(calls) {}
+
+  HttpResponse Handle(const HttpRequest& /*request*/) {
+    calls_->push_back("answer");
+    return HttpResponse(HttpStatusCode::OK);
+  }
+
+ private:
+  std::vector<std::string>* calls_;
+};
+
+HttpRequest Request(std::string_view header) {
+  return HttpRequest::ParseHeader(header);
+}
+
+std::vector<std::string> FieldValues(const HttpResponse& response,
+                                     std::string_view name) {
+  std::vector<std::string> values;
+  for (const auto& field : response.header_fields()) {
+    if (field.name == name) {
+      values.push_back(field.value);
+    }
+  }
+  return values;
+}
+
+}  // namespace
+
+TEST(Pipeline, CallsLayersInOrder) {
+  std::vector<std::string> calls;
+  Pipeline<Trace, Trace, Answer> pipeline(Trace("outer", &calls),
+                                          Trace("inner", &calls),
+                                          Answer(&calls));
+
+  const HttpResponse response =
+      pipeline.Handle(Request("GET / HTTP/1.1\r\n\r\n"));
+  EXPECT_EQ(HttpStatusCode::OK, response.status_code());
+  EXPECT_EQ((std::vector<std::string>{"outer in", "inner in", "answer",
+                                      "inner out", "outer out"}),
+            calls);
+  EXPECT_EQ((std::vector<std::string>{"inner", "outer"}),
+            FieldValues(response, "x-trace"));
+}
+
+TEST(Pipeline, ShortCircuits) {
+  std::vector<std::string> calls;
+  Pipeline<Trace, Trace, Answer> pipeline(Trace("outer", &calls),
+                                          Trace("inner", &calls),
+                                          Answer(&calls));
+
+  const HttpResponse response =
+      pipeline.Handle(Request("GET /inner HTTP/1.1\r\n\r\n"));
+  EXPECT_EQ(HttpStatusCode::Forbidden, response.status_code());
+  EXPECT_EQ((std::vector<std::string>{"outer in", "inner in", "outer out"}),
+            calls);
+  EXPECT_EQ(std::vector<std::string>{"outer"},
+            FieldValues(response, "x-trace"));
+}
+
+TEST(Pipeline, DispatchesToRouter) {
+  Pipeline<http1::RequestId, http1::Router> pipeline;
+  pipeline.layer<http1::Router>().Add(
+      HttpMethod::Get, "/hello",
+      [](const HttpRequest& /*request*/, const http1::RouteParams& /*params*/) {
+        return HttpResponse(HttpStatusCode::OK);
+      });
+
+  EXPECT_EQ(HttpStatusCode::OK,
+            pipeline.Handle(Request("GET /hello HTTP/1.1\r\n\r\n"))
+                .status_code());
+  const HttpResponse missing =
+      pipeline.Handle(Request("GET /missing HTTP/1.1\r\n\r\n"));
+  EXPECT_EQ(HttpStatusCode::NotFound, missing.status_code());
+  EXPECT_EQ(1U, FieldValues(missing, "x-request-id").size());
+}
+
+TEST(Pipeline, RequestIds) {
+  EXPECT_EQ("abc-123", http1::RequestId::Of(Request(
+                           "GET / HTTP/1.1\r\nX-Request-Id: abc-123\r\n\r\n")));
+
+  const std::string generated =
+      http1::RequestId::Of(Request("GET / HTTP/1.1\r\n\r\n"));
+  EXPECT_EQ(16U, generated.size());
+  EXPECT_EQ(std::string::npos,
+            generated.find_first_not_of("0123456789abcdef"));
+  EXPECT_NE(generated, http1::RequestId::Of(Request("GET / HTTP/1.1\r\n\r\n")));
+
+  // Ids that could forge log lines are replaced
+  EXPECT_EQ(16U, http1::RequestId::Of(
+                     Request("GET / HTTP/1.1\r\nX-Request-Id: a b\r\n\r\n"))
+                     .size());
+  EXPECT_EQ(16U, http1::RequestId::Of(
+                     Request("GET / HTTP/1.1\r\nX-Request-Id: " +
+                             std::string(65, 'a') + "\r\n\r\n"))
+                     .size());
+}
+
+TEST(Pipeline, Cors) {
+  Pipeline<http1::Cors, http1::Router> pipeline(
+      http1::Cors(http1::CorsOptions{
+          .allowed_origins = {"https://app.example"},
+          .allow_credentials = true}),
+      http1::Router());
+  pipeline.layer<http1::Router>().Add(
+      HttpMethod::Get, "/data",
+      [](const HttpRequest& /*request*/, const http1::RouteParams& /*params*/) {
+        return HttpResponse(HttpStatusCode::OK);
+      });
+
+  const HttpResponse preflight = pipeline.Handle(
+      Request("OPTIONS /data HTTP/1.1\r\nOrigin: https://app.example\r\n"
+              "Access-Control-Request-Method: GET\r\n\r\n"));
+  EXPECT_EQ(HttpStatusCode::NoContent, preflight.status_code());
+  EXPECT_EQ("https://app.example",
+            preflight.FindField("access-control-allow-origin"));
+  EXPECT_EQ("GET, HEAD, POST",
+            preflight.FindField("access-control-allow-methods"));
+  EXPECT_EQ("600", preflight.FindField("access-control-max-age"));
+  EXPECT_EQ("true", preflight.FindField("access-control-allow-credentials"));
+
+  const HttpResponse simple = pipeline.Handle(Request(
+      "GET /data HTTP/1.1\r\nOrigin: https://app.example\r\n\r\n"));
+  EXPECT_EQ(HttpStatusCode::OK, simple.status_code());
+  EXPECT_EQ("https://app.example",
+            simple.FindField("access-control-allow-origin"));
+  EXPECT_EQ("origin", simple.FindField("vary"));
+
+  // Other origins get the response without permission to read it, and
+  // preflights of them reach the router
+  const HttpResponse other = pipeline.Handle(
+      Request("OPTIONS /data HTTP/1.1\r\nOrigin: https://evil.example\r\n"
+              "Access-Control-Request-Method: GET\r\n\r\n"));
+  EXPECT_EQ(HttpStatusCode::MethodNotAllowed, other.status_code());
+  EXPECT_EQ(std::nullopt, other.FindField("access-control-allow-origin"));
+  EXPECT_EQ("origin", other.FindField("vary"));
+
+  const HttpResponse same_origin =
+      pipeline.Handle(Request("GET /data HTTP/1.1\r\n\r\n"));
+  EXPECT_TRUE(same_origin.header_fields().empty());
+}
+
+TEST(Pipeline, CorsAnyOrigin) {
+  Pipeline<http1::Cors, Answer> pipeline(http1::Cors(), Answer(nullptr));
+  std::vector<std::string> calls;
+  pipeline.layer<Answer>() = Answer(&calls);
+
+  const HttpResponse response = pipeline.Handle(
+      Request("GET / HTTP/1.1\r\nOrigin: https://any.example\r\n\r\n"));
+  EXPECT_EQ("*", response.FindField("access-control-allow-origin"));
+  EXPECT_EQ(std::nullopt, response.FindField("vary"));
+}
+
+TEST(Pipeline, Gzip) {
+  struct Text {
+    HttpResponse Handle(const HttpRequest& /*request*/) const {
+      const std::string text(4096, 'a');
+      HttpResponse response(HttpStatusCode::OK);
+      response.AddField(
+          HeaderField{.name = "content-type", .value = "text/plain"});
+      response.SetContentLength(text.size());
+      response.SetOwnedBody(http1::ByteArray(
+          reinterpret_cast<const std::byte*>(text.data()), text.size()));
+      return response;
+    }
+  };
+  Pipeline<http1::Gzip, Text> pipeline;
+
+  const HttpResponse compressed = pipeline.Handle(
+      Request("GET / HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n"));
+  EXPECT_EQ("gzip", compressed.FindField("content-encoding"));
+  EXPECT_GT(4096U, compressed.content_length().value());
+
+  const HttpResponse identity =
+      pipeline.Handle(Request("GET / HTTP/1.1\r\n\r\n"));
+  EXPECT_EQ(std::nullopt, identity.FindField("content-encoding"));
+  EXPECT_EQ(4096U, identity.content_length());
+}
@@ -49,7 +49,8 @@ constexpr const char* GET_REQUEST_WITHOUT_FIELDS =
     "\r\n";
 
 http1::HttpRequest expected_get_request() {
-  auto result = http1::HttpRequest(http1::HttpMethod::Get, "/", "HTTP/1.1");
+  auto result = http1::HttpRequest(http1::HttpMethod::Get, "/",
+                                   http1::HttpVersion::Http11);
   result.UpdateFields("host", "127.0.0.1:8000");
   result.UpdateFields("connection", "keep-alive");
   result.UpdateFields("cache-control", "max-age=0");
@@ -114,7 +115,8 @@ constexpr const char* POST_REQUEST_BODY =
     "}";
 
 http1::HttpRequest expected_post_request() {
-  auto result = http1::HttpRequest(http1::HttpMethod::Post, "/", "HTTP/1.1");
+  auto result = http1::HttpRequest(http1::HttpMethod::Post, "/",
+                                   http1::HttpVersion::Http11);
   result.UpdateFields("content-type", "application/json");
   result.UpdateFields("user-agent", "PostmanRuntime/7.29.3");
   result.UpdateFields("accept", "*/*");
@@ -433,3 +435,34 @@ TEST_F(RequestParserTest, AllPossibleThreeChunksOfThreeRequests) {
     }
   }
 }
+
+TEST(RequestParser, ReportsParseErrorKinds) {
+  const auto kind_of = [](std::string_view header) {
+    try {
+      http1::HttpRequest::ParseHeader(header);
+    } catch (const http1::HttpParseError& parse_error) {
+      return parse_error.kind();
+    }
+    ADD_FAILURE() << header;
+    return http1::HttpParseErrorKind::RequestLine;
+  };
+
+  EXPECT_EQ(http1::HttpParseErrorKind::RequestLine,
+            kind_of("GET  HTTP/1.1\r\n\r\n"));
+  EXPECT_EQ(http1::HttpParseErrorKind::RequestLine,
+            kind_of("GET / HTTP/1.1 x\r\n\r\n"));
+  EXPECT_EQ(http1::HttpParseErrorKind::RequestLine,
+            kind_of("GET / HTTP/1.1\n\r\n"));
+  EXPECT_EQ(http1::HttpParseErrorKind::Method,
+            kind_of("FETCH / HTTP/1.1\r\n\r\n"));
+  EXPECT_EQ(http1::HttpParseErrorKind::Version,
+            kind_of("GET / HTTP/2.0\r\n\r\n"));
+  EXPECT_EQ(http1::HttpParseErrorKind::Path,
+            kind_of("GET /%zz HTTP/1.1\r\n\r\n"));
+  EXPECT_EQ(http1::HttpParseErrorKind::Field,
+            kind_of("GET / HTTP/1.1\r\nno-colon\r\n\r\n"));
+  EXPECT_EQ(http1::HttpParseErrorKind::Field,
+            kind_of("GET / HTTP/1.1\r\nContent-Length: 12x\r\n\r\n"));
+  EXPECT_EQ(http1::HttpParseErrorKind::Field,
+            kind_of("GET / HTTP/1.1\r\nContent-Length: \r\n\r\n"));
+}
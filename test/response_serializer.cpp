@@ -1,7 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <array>
 #include <cstring>
 #include <string>
+#include <tuple>
 
 #include "http_server.hpp"
 
@@ -103,4 +105,207 @@ TEST(ResponseSerializer, SimpleResponse) {
   EXPECT_EQ(http1::ByteArray(reinterpret_cast<const std::byte*>(data.c_str()),
                              data.size()),
             response.Serialize());
-}
\ No newline at end of file
+}
+
+TEST(ResponseSerializer, DefaultReasonAndContentLength) {
+  http1::HttpResponse response{http1::HttpStatusCode::NotFound};
+  response.AddField(
+      http1::HeaderField{.name = "content-type", .value = "text/plain"});
+  response.SetContentLength(9);
+  response.SetBody(http1::ByteArrayView(
+      reinterpret_cast<const std::byte*>("not found"), 9));
+
+  const std::string expected =
+      "HTTP/1.1 404 Not Found\r\n"
+      "content-type: text/plain\r\n"
+      "content-length: 9\r\n"
+      "\r\n"
+      "not found";
+
+  const auto serialized = response.Serialize();
+  EXPECT_EQ(http1::ByteArray(reinterpret_cast<const std::byte*>(
+                                 expected.data()),
+                             expected.size()),
+            serialized);
+  EXPECT_EQ(serialized.size(), response.SerializedSize());
+}
+
+TEST(ResponseSerializer, AppendsToExistingBuffer) {
+  http1::HttpResponse response{
+      http1::HttpStatusCode::NetworkAuthenticationRequired};
+  response.SetContentLength(0);
+
+  const std::string expected =
+      "HTTP/1.1 511 Network Authentication Required\r\n"
+      "content-length: 0\r\n"
+      "\r\n";
+
+  http1::ByteArray buffer(reinterpret_cast<const std::byte*>("prefix"), 6);
+  buffer.reserve(256);
+  const auto* data = buffer.data();
+  response.SerializeTo(buffer);
+
+  EXPECT_EQ(data, buffer.data());
+  EXPECT_EQ(6 + expected.size(), buffer.size());
+  EXPECT_EQ(0, std::memcmp(expected.data(), std::next(buffer.data(), 6),
+                           expected.size()));
+}
+
+TEST(ResponseSerializer, RejectsInvalidStatusCode) {
+  const http1::HttpResponse response{static_cast<http1::HttpStatusCode>(999)};
+  EXPECT_THROW(std::ignore = response.SerializedSize(),
+               http1::HttpSerializeError);
+  EXPECT_THROW(response.Serialize(), http1::HttpSerializeError);
+}
+
+TEST(ResponseSerializer, RejectsSmallOutput) {
+  http1::HttpResponse response{http1::HttpStatusCode::OK};
+  std::array<std::byte, 8> output{};
+  EXPECT_THROW(response.SerializeTo(output), http1::HttpSerializeError);
+}
+
+TEST(ResponseSerializer, PreparedResponse) {
+  http1::HttpResponse response{http1::HttpStatusCode::OK};
+  response.AddField(
+      http1::HeaderField{.name = "content-type", .value = "text/plain"});
+  response.SetContentLength(2);
+  response.SetBody(
+      http1::ByteArrayView(reinterpret_cast<const std::byte*>("ok"), 2));
+
+  const http1::PreparedResponse prepared(response);
+  constexpr std::string_view COMMON_FIELDS = "server: test\r\n";
+  const std::string expected =
+      "HTTP/1.1 200 OK\r\n"
+      "server: test\r\n"
+      "content-type: text/plain\r\n"
+      "content-length: 2\r\n"
+      "\r\n"
+      "ok";
+
+  EXPECT_EQ(http1::ByteArray(reinterpret_cast<const std::byte*>(
+                                 "HTTP/1.1 200 OK\r\n"),
+                             17),
+            prepared.status_line());
+  EXPECT_EQ(http1::HttpStatusCode::OK, prepared.status_code());
+
+  // Copies share the buffer and serialize like the original response
+  const http1::HttpResponse returned = prepared;
+  ASSERT_TRUE(returned.prepared());
+  EXPECT_EQ(prepared.fields_and_body().data(),
+            returned.prepared()->fields_and_body().data());
+  EXPECT_EQ(response.Serialize(COMMON_FIELDS),
+            returned.Serialize(COMMON_FIELDS));
+  EXPECT_EQ(expected.size(), returned.SerializedSize(COMMON_FIELDS));
+
+  // Fields added later go before the prepared ones
+  http1::HttpResponse decorated = prepared;
+  decorated.AddField(http1::HeaderField{.name = "x-id", .value = "7"});
+  const std::string decorated_expected =
+      "HTTP/1.1 200 OK\r\n"
+      "server: test\r\n"
+      "x-id: 7\r\n"
+      "content-type: text/plain\r\n"
+      "content-length: 2\r\n"
+      "\r\n"
+      "ok";
+  const http1::ByteArray serialized = decorated.Serialize(COMMON_FIELDS);
+  EXPECT_EQ(decorated_expected,
+            std::string_view(reinterpret_cast<const char*>(serialized.data()),
+                             serialized.size()));
+  EXPECT_EQ(decorated_expected.size(),
+            decorated.SerializedSize(COMMON_FIELDS));
+}
+
+TEST(ResponseSerializer, OmitsBody) {
+  const auto to_text = [](const http1::ByteArray& bytes) {
+    return std::string(reinterpret_cast<const char*>(bytes.data()),
+                       bytes.size());
+  };
+
+  http1::HttpResponse response{http1::HttpStatusCode::OK};
+  response.SetBody(
+      http1::ByteArrayView(reinterpret_cast<const std::byte*>("ok"), 2));
+  const http1::PreparedResponse prepared(response);
+
+  // Without a content length, the omitted body still announces its length
+  response.OmitBody();
+  EXPECT_TRUE(response.body_omitted());
+  EXPECT_EQ("HTTP/1.1 200 OK\r\ncontent-length: 2\r\n\r\n",
+            to_text(response.Serialize()));
+
+  http1::HttpResponse prepared_head = prepared;
+  prepared_head.OmitBody();
+  EXPECT_EQ("HTTP/1.1 200 OK\r\nserver: test\r\n\r\n",
+            to_text(prepared_head.Serialize("server: test\r\n")));
+  EXPECT_EQ(prepared_head.Serialize("server: test\r\n").size(),
+            prepared_head.SerializedSize("server: test\r\n"));
+}
+
+TEST(ResponseSerializer, HeaderTemplate) {
+  const http1::HeaderTemplate json_template(
+      http1::HttpStatusCode::OK,
+      {http1::HeaderField{.name = "content-type",
+                          .value = "application/json"}},
+      {http1::TemplateSlot{.name = "content-length", .width = 4},
+       http1::TemplateSlot{.name = "etag", .width = 6}});
+  EXPECT_TRUE(json_template.has_content_length_slot());
+
+  http1::HttpResponse response(json_template);
+  response.SetSlot(1, "\"abc\"");
+  response.AddField(http1::HeaderField{.name = "x-extra", .value = "1"});
+  response.SetBody(
+      http1::ByteArrayView(reinterpret_cast<const std::byte*>("{}"), 2));
+
+  const std::string expected =
+      "HTTP/1.1 200 OK\r\n"
+      "date: now\r\n"
+      "content-type: application/json\r\n"
+      "content-length: 2   \r\n"
+      "etag: \"abc\" \r\n"
+      "x-extra: 1\r\n"
+      "\r\n"
+      "{}";
+  const auto serialized = response.Serialize("date: now\r\n");
+  EXPECT_EQ(expected.size(), response.SerializedSize("date: now\r\n"));
+  EXPECT_EQ(http1::ByteArray(reinterpret_cast<const std::byte*>(
+                                 expected.data()),
+                             expected.size()),
+            serialized);
+
+  // Unset slots stay blank
+  http1::HttpResponse blank(json_template);
+  blank.SetContentLength(1234);
+  const std::string blank_expected =
+      "HTTP/1.1 200 OK\r\n"
+      "content-type: application/json\r\n"
+      "content-length: 1234\r\n"
+      "etag:       \r\n"
+      "\r\n";
+  EXPECT_EQ(http1::ByteArray(reinterpret_cast<const std::byte*>(
+                                 blank_expected.data()),
+                             blank_expected.size()),
+            blank.Serialize());
+}
+
+TEST(ResponseSerializer, HeaderTemplateRejectsInvalidSlots) {
+  const http1::HeaderTemplate header_template(
+      http1::HttpStatusCode::OK, {},
+      {http1::TemplateSlot{.name = "content-length", .width = 2},
+       http1::TemplateSlot{.name = "etag", .width = 4}});
+
+  http1::HttpResponse response(header_template);
+  EXPECT_THROW(response.SetSlot(0, "1"), http1::HttpSerializeError);
+  EXPECT_THROW(response.SetSlot(1, "12345"), http1::HttpSerializeError);
+  EXPECT_THROW(response.SetSlot(1, "a\r\nb"), http1::HttpSerializeError);
+  EXPECT_THROW(response.SetSlot(2, "a"), http1::HttpSerializeError);
+
+  response.SetContentLength(100);
+  EXPECT_THROW(std::ignore = response.Serialize(), http1::HttpSerializeError);
+
+  EXPECT_THROW(http1::HeaderTemplate(
+                   http1::HttpStatusCode::OK, {},
+                   {http1::TemplateSlot{
+                       .name = "x-wide",
+                       .width = http1::HeaderTemplate::MAX_SLOT_STORAGE + 1}}),
+               http1::HttpSerializeError);
+}
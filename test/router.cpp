@@ -0,0 +1,271 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "loopback.hpp"
+#include "router.hpp"
+
+namespace {
+
+using http1::HttpMethod;
+using http1::HttpRequest;
+using http1::HttpResponse;
+using http1::HttpStatusCode;
+using http1::HttpVersion;
+using http1::Router;
+using http1::RouteParams;
+using http1::RouteStatus;
+
+// Handler answering with the given status and remembering its parameters
+Router::Handler Respond(HttpStatusCode status_code, std::string* captured) {
+  return [status_code, captured](const HttpRequest& /*request*/,
+                                 const RouteParams& params) {
+    captured->clear();
+    for (const auto& param : params) {
+      captured->append(param.name).append("=").append(param.value);
+      captured->append(";");
+    }
+    return HttpResponse(status_code);
+  };
+}
+
+Router::Handler Ignore() {
+  return [](const HttpRequest& /*request*/, const RouteParams& /*params*/) {
+    return HttpResponse(HttpStatusCode::OK);
+  };
+}
+
+RouteStatus StatusOf(const Router& router, HttpMethod method,
+                     std::string_view target) {
+  RouteParams params;
+  return router.Find(method, target, params).status;
+}
+
+// Serves a GET route with a body through a Router
+class RoutedServer : public http1::BasicHttpServer<RoutedServer> {
+  friend BasicHttpServer<RoutedServer>;
+
+ public:
+  RoutedServer() : BasicHttpServer(0) {
+    router_.Add(HttpMethod::Get, "/items/{id}",
+                [](const HttpRequest& /*request*/,
+                   const RouteParams& /*params*/) {
+                  static constexpr std::string_view BODY = "item";
+                  HttpResponse response(HttpStatusCode::OK);
+                  response.SetBody(http1::ByteArrayView(
+                      reinterpret_cast<const std::byte*>(BODY.data()),
+                      BODY.size()));
+                  response.SetContentLength(BODY.size());
+                  return response;
+                });
+  }
+
+ private:
+  HttpResponse OnRequest(const HttpRequest& request) {
+    return router_.Dispatch(request);
+  }
+
+  Router router_;
+};
+
+}  // namespace
+
+TEST(Router, MatchesLiteralRoutes) {
+  Router router;
+  std::string captured;
+  router.Add(HttpMethod::Get, "/", Respond(HttpStatusCode::OK, &captured));
+  router.Add(HttpMethod::Get, "/users",
+             Respond(HttpStatusCode::Accepted, &captured));
+  router.Add(HttpMethod::Get, "/user",
+             Respond(HttpStatusCode::Created, &captured));
+  router.Add(HttpMethod::Get, "/use",
+             Respond(HttpStatusCode::Found, &captured));
+  router.Add(HttpMethod::Get, "/api/orders",
+             Respond(HttpStatusCode::NoContent, &captured));
+
+  const auto status_of = [&router](std::string path) {
+    return router.Dispatch(HttpRequest(HttpMethod::Get, std::move(path),
+                                       HttpVersion::Http11))
+        .status_code();
+  };
+  EXPECT_EQ(HttpStatusCode::OK, status_of("/"));
+  EXPECT_EQ(HttpStatusCode::Accepted, status_of("/users"));
+  EXPECT_EQ(HttpStatusCode::Created, status_of("/user"));
+  EXPECT_EQ(HttpStatusCode::Found, status_of("/use"));
+  EXPECT_EQ(HttpStatusCode::NoContent, status_of("/api/orders?limit=10"));
+  EXPECT_EQ(HttpStatusCode::NotFound, status_of("/us"));
+  EXPECT_EQ(HttpStatusCode::NotFound, status_of("/users/"));
+  EXPECT_EQ(HttpStatusCode::NotFound, status_of("/api"));
+  EXPECT_EQ(HttpStatusCode::NotFound, status_of(""));
+}
+
+TEST(Router, CapturesParameters) {
+  Router router;
+  std::string captured;
+  router.Add(HttpMethod::Get, "/users/{id}",
+             Respond(HttpStatusCode::OK, &captured));
+  router.Add(HttpMethod::Get, "/users/{id}/posts/{post}",
+             Respond(HttpStatusCode::OK, &captured));
+  router.Add(HttpMethod::Get, "/users/me",
+             Respond(HttpStatusCode::Accepted, &captured));
+  router.Add(HttpMethod::Get, "/static/*path",
+             Respond(HttpStatusCode::OK, &captured));
+
+  const auto dispatch = [&router](std::string path) {
+    return router
+        .Dispatch(
+            HttpRequest(HttpMethod::Get, std::move(path), HttpVersion::Http11))
+        .status_code();
+  };
+  EXPECT_EQ(HttpStatusCode::OK, dispatch("/users/42"));
+  EXPECT_EQ("id=42;", captured);
+  EXPECT_EQ(HttpStatusCode::OK, dispatch("/users/42/posts/7?x=1"));
+  EXPECT_EQ("id=42;post=7;", captured);
+  EXPECT_EQ(HttpStatusCode::Accepted, dispatch("/users/me"));
+  EXPECT_EQ("", captured);
+  EXPECT_EQ(HttpStatusCode::OK, dispatch("/users/mel"));
+  EXPECT_EQ("id=mel;", captured);
+  EXPECT_EQ(HttpStatusCode::OK, dispatch("/static/css/site.css"));
+  EXPECT_EQ("path=css/site.css;", captured);
+  EXPECT_EQ(HttpStatusCode::OK, dispatch("/static/"));
+  EXPECT_EQ("path=;", captured);
+
+  EXPECT_EQ(HttpStatusCode::NotFound, dispatch("/users/"));
+  EXPECT_EQ(HttpStatusCode::NotFound, dispatch("/users/42/posts"));
+  EXPECT_EQ(HttpStatusCode::NotFound, dispatch("/static"));
+}
+
+TEST(Router, FallsBackToLessSpecificRoutes) {
+  Router router;
+  router.Add(HttpMethod::Get, "/files/new/edit", Ignore());
+  router.Add(HttpMethod::Get, "/files/{name}/download", Ignore());
+  router.Add(HttpMethod::Get, "/*rest", Ignore());
+
+  RouteParams params;
+  auto match = router.Find(HttpMethod::Get, "/files/new/download", params);
+  ASSERT_EQ(RouteStatus::Found, match.status);
+  ASSERT_EQ(1U, params.size());
+  EXPECT_EQ("new", params.Find("name"));
+
+  match = router.Find(HttpMethod::Get, "/files/new/other", params);
+  ASSERT_EQ(RouteStatus::Found, match.status);
+  ASSERT_EQ(1U, params.size());
+  EXPECT_EQ("files/new/other", params.Find("rest"));
+  EXPECT_EQ(std::nullopt, params.Find("name"));
+}
+
+TEST(Router, DispatchesByMethod) {
+  Router router;
+  std::string captured;
+  router.Add(HttpMethod::Get, "/items/{id}",
+             Respond(HttpStatusCode::OK, &captured));
+  router.Add(HttpMethod::Delete, "/items/{id}",
+             Respond(HttpStatusCode::NoContent, &captured));
+  router.Add(HttpMethod::Post, "/items", Respond(HttpStatusCode::Created,
+                                                 &captured));
+
+  const HttpResponse deleted = router.Dispatch(
+      HttpRequest(HttpMethod::Delete, "/items/3", HttpVersion::Http11));
+  EXPECT_EQ(HttpStatusCode::NoContent, deleted.status_code());
+  EXPECT_EQ("id=3;", captured);
+
+  // GET handlers answer HEAD
+  EXPECT_EQ(RouteStatus::Found, StatusOf(router, HttpMethod::Head, "/items/3"));
+
+  const HttpResponse not_allowed = router.Dispatch(
+      HttpRequest(HttpMethod::Put, "/items/3", HttpVersion::Http11));
+  EXPECT_EQ(HttpStatusCode::MethodNotAllowed, not_allowed.status_code());
+  EXPECT_EQ("GET, HEAD, DELETE", not_allowed.FindField("allow"));
+  EXPECT_EQ(0U, not_allowed.content_length());
+
+  EXPECT_EQ("POST", router
+                        .Dispatch(HttpRequest(HttpMethod::Get, "/items",
+                                              HttpVersion::Http11))
+                        .FindField("allow"));
+  EXPECT_EQ(RouteStatus::MethodNotAllowed,
+            StatusOf(router, HttpMethod::Unknown, "/items"));
+
+  const HttpResponse not_found = router.Dispatch(
+      HttpRequest(HttpMethod::Put, "/other", HttpVersion::Http11));
+  EXPECT_EQ(HttpStatusCode::NotFound, not_found.status_code());
+  EXPECT_EQ(std::nullopt, not_found.FindField("allow"));
+}
+
+TEST(Router, ManyRoutes) {
+  Router router;
+  for (int index = 0; index < 300; ++index) {
+    router.Add(HttpMethod::Get, "/api/v1/resource" + std::to_string(index),
+               Ignore());
+    router.Add(HttpMethod::Get,
+               "/api/v1/resource" + std::to_string(index) + "/{id}",
+               Ignore());
+  }
+
+  RouteParams params;
+  for (int index = 0; index < 300; ++index) {
+    const std::string path = "/api/v1/resource" + std::to_string(index);
+    EXPECT_EQ(RouteStatus::Found,
+              router.Find(HttpMethod::Get, path, params).status);
+    EXPECT_EQ(0U, params.size());
+    EXPECT_EQ(RouteStatus::Found,
+              router.Find(HttpMethod::Get, path + "/x", params).status);
+    EXPECT_EQ("x", params.Find("id"));
+  }
+  EXPECT_EQ(RouteStatus::NotFound,
+            StatusOf(router, HttpMethod::Get, "/api/v1/resource300"));
+}
+
+TEST(Router, RejectsInvalidRoutes) {
+  Router router;
+  router.Add(HttpMethod::Get, "/users/{id}", Ignore());
+
+  EXPECT_THROW(router.Add(HttpMethod::Get, "users", Ignore()),
+               std::invalid_argument);
+  EXPECT_THROW(router.Add(HttpMethod::Unknown, "/a", Ignore()),
+               std::invalid_argument);
+  EXPECT_THROW(router.Add(HttpMethod::Get, "/users/{id}", Ignore()),
+               std::invalid_argument);
+  EXPECT_THROW(router.Add(HttpMethod::Get, "/users/{name}/x", Ignore()),
+               std::invalid_argument);
+  EXPECT_THROW(router.Add(HttpMethod::Get, "/a/{id", Ignore()),
+               std::invalid_argument);
+  EXPECT_THROW(router.Add(HttpMethod::Get, "/a/{}", Ignore()),
+               std::invalid_argument);
+  EXPECT_THROW(router.Add(HttpMethod::Get, "/a/{id}x", Ignore()),
+               std::invalid_argument);
+  EXPECT_THROW(router.Add(HttpMethod::Get, "/a/x{id}", Ignore()),
+               std::invalid_argument);
+  EXPECT_THROW(router.Add(HttpMethod::Get, "/a/*", Ignore()),
+               std::invalid_argument);
+  EXPECT_THROW(router.Add(HttpMethod::Get, "/a/*rest/x", Ignore()),
+               std::invalid_argument);
+  EXPECT_THROW(
+      router.Add(HttpMethod::Get, "/{a}/{b}/{c}/{d}/{e}/{f}/{g}/{h}/{i}",
+                 Ignore()),
+      std::invalid_argument);
+
+  // Literal stars are fine, and so is a second method of a route
+  router.Add(HttpMethod::Get, "/a*b", Ignore());
+  router.Add(HttpMethod::Post, "/users/{id}", Ignore());
+  EXPECT_EQ(RouteStatus::Found, StatusOf(router, HttpMethod::Get, "/a*b"));
+}
+
+TEST(Router, ServerOmitsBodyOfHeadResponses) {
+  RoutedServer server;
+  const loopback::RunningServer running(server);
+
+  // The GET response right behind shows where the HEAD response ends
+  const std::string received = loopback::Exchange(
+      running.port(),
+      "HEAD /items/3 HTTP/1.1\r\n\r\nGET /items/3 HTTP/1.1\r\n\r\n",
+      "\r\n\r\nitem");
+
+  const std::size_t head_end = received.find("\r\n\r\nHTTP/1.1 200 OK\r\n");
+  ASSERT_NE(std::string::npos, head_end);
+  const std::string_view head =
+      std::string_view(received).substr(0, head_end + 4);
+  EXPECT_NE(std::string::npos, head.find("content-length: 4\r\n"));
+  EXPECT_TRUE(received.ends_with("\r\n\r\nitem"));
+  EXPECT_EQ(received.find("item"), received.rfind("item"));
+}
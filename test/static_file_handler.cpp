@@ -0,0 +1,421 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "http_date.hpp"
+#include "loopback.hpp"
+#include "static_file_handler.hpp"
+
+namespace {
+
+using loopback::IdleServer;
+
+class StaticFileHandlerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    std::string root_template =
+        (std::filesystem::temp_directory_path() / "http1-static-XXXXXX")
+            .string();
+    ASSERT_NE(nullptr, mkdtemp(root_template.data()));
+    root = root_template;
+
+    std::filesystem::create_directory(root / "docs");
+    WriteFile("index.html", "<h1>home</h1>");
+    WriteFile("docs/index.html", "<h1>docs</h1>");
+    WriteFile("style.CSS", "body {}");
+    WriteFile("data.bin", "\x01\x02");
+  }
+
+  void TearDown() override { std::filesystem::remove_all(root); }
+
+  void WriteFile(const std::string& name, std::string_view content) const {
+    std::ofstream file(root / name, std::ios::binary | std::ios::trunc);
+    file << content;
+  }
+
+  static http1::HttpRequest Request(
+      const std::string& path,
+      http1::HttpMethod method = http1::HttpMethod::Get) {
+    return {method, path, http1::HttpVersion::Http11};
+  }
+
+  static std::string Serialize(const http1::HttpResponse& response) {
+    const auto serialized = response.Serialize();
+    return {reinterpret_cast<const char*>(serialized.data()),
+            serialized.size()};
+  }
+
+  std::filesystem::path root;
+};
+
+// Serves the files under root, answering misses with 404 Not Found
+class FileServer : public http1::BasicHttpServer<FileServer> {
+  friend BasicHttpServer<FileServer>;
+
+ public:
+  explicit FileServer(const std::string& root)
+      : BasicHttpServer(0), files_("/", root) {}
+
+ private:
+  http1::HttpResponse OnRequest(const http1::HttpRequest& request) {
+    if (auto response = files_.Handle(request)) {
+      return std::move(*response);
+    }
+    http1::HttpResponse response(http1::HttpStatusCode::NotFound);
+    response.SetContentLength(0);
+    return response;
+  }
+
+  http1::StaticFileHandler files_;
+};
+
+}  // namespace
+
+TEST(MimeType, PerfectHashLookup) {
+  EXPECT_EQ("text/html; charset=utf-8", http1::MimeTypeOf("html"));
+  EXPECT_EQ("text/html; charset=utf-8", http1::MimeTypeOf("HTML"));
+  EXPECT_EQ("image/jpeg", http1::MimeTypeOf("jpg"));
+  EXPECT_EQ("image/jpeg", http1::MimeTypeOf("jpeg"));
+  EXPECT_EQ("font/woff2", http1::MimeTypeOf("woff2"));
+  EXPECT_EQ("application/octet-stream", http1::MimeTypeOf("bin"));
+  EXPECT_EQ("application/octet-stream", http1::MimeTypeOf(""));
+  EXPECT_EQ("application/octet-stream", http1::MimeTypeOf("htmlhtmlhtml"));
+}
+
+TEST_F(StaticFileHandlerTest, ServesFiles) {
+  http1::StaticFileHandler handler("/static", root.string());
+
+  EXPECT_FALSE(handler.Handle(Request("/other/index.html")));
+  EXPECT_FALSE(handler.Handle(Request("/staticfoo/style.css")));
+  EXPECT_FALSE(handler.Handle(Request("/static.css")));
+  EXPECT_TRUE(handler.Handle(Request("/static?v=1")));
+
+  const auto response = handler.Handle(Request("/static/style.CSS?v=1"));
+  ASSERT_TRUE(response);
+  ASSERT_TRUE(response->file_body());
+  EXPECT_EQ(7, response->file_body()->size);
+
+  const std::string serialized = Serialize(*response);
+  EXPECT_TRUE(serialized.starts_with("HTTP/1.1 200 OK\r\n"));
+  EXPECT_NE(std::string::npos,
+            serialized.find("content-type: text/css; charset=utf-8\r\n"));
+  EXPECT_NE(std::string::npos, serialized.find("content-length: 7\r\n"));
+  EXPECT_NE(std::string::npos, serialized.find("last-modified: "));
+  EXPECT_NE(std::string::npos, serialized.find("etag: \""));
+  EXPECT_TRUE(serialized.ends_with("\r\n\r\nbody {}"));
+
+  const auto head =
+      handler.Handle(Request("/static/data.bin", http1::HttpMethod::Head));
+  ASSERT_TRUE(head);
+  EXPECT_FALSE(head->file_body());
+  const std::string head_serialized = Serialize(*head);
+  EXPECT_NE(std::string::npos, head_serialized.find("content-length: 2\r\n"));
+  EXPECT_TRUE(head_serialized.ends_with("\r\n\r\n"));
+}
+
+TEST_F(StaticFileHandlerTest, AnswersConditionalRequests) {
+  http1::StaticFileHandler handler("/", root.string());
+
+  const auto full = handler.Handle(Request("/style.CSS"));
+  const std::string serialized = Serialize(*full);
+  const std::size_t etag_start = serialized.find("etag: ") + 6;
+  const std::string etag =
+      serialized.substr(etag_start, serialized.find('\r', etag_start) -
+                                        etag_start);
+  const std::size_t date_start = serialized.find("last-modified: ") + 15;
+  const std::string last_modified =
+      serialized.substr(date_start, http1::HTTP_DATE_SIZE);
+  EXPECT_EQ(18, etag.size());
+
+  const auto conditional = [&](const std::string& name,
+                               const std::string& value) {
+    auto request = Request("/style.CSS");
+    request.UpdateFields(name, value);
+    return handler.Handle(request).value();
+  };
+
+  const auto not_modified = conditional("if-none-match", etag);
+  EXPECT_EQ(http1::HttpStatusCode::NotModified, not_modified.status_code());
+  EXPECT_TRUE(not_modified.prepared());
+  EXPECT_FALSE(not_modified.file_body());
+  const std::string not_modified_serialized = Serialize(not_modified);
+  EXPECT_NE(std::string::npos, not_modified_serialized.find(etag));
+  EXPECT_TRUE(not_modified_serialized.ends_with("\r\n\r\n"));
+
+  EXPECT_EQ(http1::HttpStatusCode::NotModified,
+            conditional("if-none-match", "\"x\", W/" + etag).status_code());
+  EXPECT_EQ(http1::HttpStatusCode::NotModified,
+            conditional("if-none-match", "*").status_code());
+  EXPECT_EQ(http1::HttpStatusCode::OK,
+            conditional("if-none-match", "\"other\"").status_code());
+
+  EXPECT_EQ(http1::HttpStatusCode::NotModified,
+            conditional("if-modified-since", last_modified).status_code());
+  EXPECT_EQ(http1::HttpStatusCode::OK,
+            conditional("if-modified-since", "Thu, 01 Jan 1970 00:00:00 GMT")
+                .status_code());
+  EXPECT_EQ(http1::HttpStatusCode::OK,
+            conditional("if-modified-since", "yesterday").status_code());
+
+  // Same content, same validator
+  http1::StaticFileHandler other_handler("/", root.string());
+  EXPECT_NE(std::string::npos,
+            Serialize(other_handler.Handle(Request("/style.CSS")).value())
+                .find(etag));
+}
+
+TEST_F(StaticFileHandlerTest, ServesRanges) {
+  WriteFile("digits.txt", "0123456789");
+  http1::StaticFileHandler handler("/", root.string());
+
+  auto request = Request("/digits.txt");
+  request.UpdateFields("range", "bytes=3-5");
+  const auto single = handler.Handle(request).value();
+  EXPECT_EQ(http1::HttpStatusCode::PartialContent, single.status_code());
+  ASSERT_TRUE(single.file_body());
+  EXPECT_EQ(3, single.file_body()->offset);
+  EXPECT_EQ(3, single.file_body()->size);
+  const std::string serialized = Serialize(single);
+  EXPECT_NE(std::string::npos, serialized.find("content-range: bytes 3-5/10"));
+  EXPECT_NE(std::string::npos, serialized.find("content-length: 3 "));
+  EXPECT_TRUE(serialized.ends_with("\r\n\r\n345"));
+
+  auto multiple = Request("/digits.txt");
+  multiple.UpdateFields("range", "bytes=0-0,9-9");
+  const auto parts = handler.Handle(multiple).value();
+  EXPECT_FALSE(parts.body());
+  EXPECT_EQ(3U, parts.file_body_parts().size());
+  const std::string multipart = Serialize(parts);
+  EXPECT_TRUE(multipart.starts_with("HTTP/1.1 206 Partial Content\r\n"));
+  EXPECT_NE(std::string::npos, multipart.find("multipart/byteranges"));
+  EXPECT_NE(std::string::npos,
+            multipart.find("content-range: bytes 9-9/10\r\n\r\n9\r\n"));
+
+  // Overlapping ranges covering more than the file are answered in full
+  auto overlapping = Request("/digits.txt");
+  overlapping.UpdateFields("range", "bytes=0-,0-,0-");
+  EXPECT_EQ(http1::HttpStatusCode::OK,
+            handler.Handle(overlapping)->status_code());
+
+  auto unsatisfiable = Request("/digits.txt");
+  unsatisfiable.UpdateFields("range", "bytes=10-");
+  EXPECT_EQ(http1::HttpStatusCode::RangeNotSatisfiable,
+            handler.Handle(unsatisfiable)->status_code());
+
+  auto stale = Request("/digits.txt");
+  stale.UpdateFields("range", "bytes=3-5");
+  stale.UpdateFields("if-range", "\"stale\"");
+  const auto full = handler.Handle(stale).value();
+  EXPECT_EQ(http1::HttpStatusCode::OK, full.status_code());
+  EXPECT_NE(std::string::npos,
+            Serialize(full).find("accept-ranges: bytes\r\n"));
+}
+
+TEST_F(StaticFileHandlerTest, NegotiatesPrecompressedSiblings) {
+  WriteFile("app.js", std::string(64, 'x'));
+  WriteFile("app.js.gz", "gzip body");
+  WriteFile("app.js.br", "br body");
+  WriteFile("big.txt", "small");
+  WriteFile("big.txt.gz", "larger than the original");
+  http1::StaticFileHandler handler(
+      "/", root.string(),
+      http1::StaticFileOptions{.revalidate_interval =
+                                   std::chrono::milliseconds(0)});
+
+  auto with_encoding = [&](const std::string& path,
+                           const std::string& accept_encoding) {
+    auto request = Request(path);
+    if (!accept_encoding.empty()) {
+      request.UpdateFields("accept-encoding", accept_encoding);
+    }
+    return Serialize(handler.Handle(request).value());
+  };
+
+  const std::string identity = with_encoding("/app.js", "");
+  EXPECT_TRUE(identity.ends_with(std::string(64, 'x')));
+  EXPECT_EQ(std::string::npos, identity.find("content-encoding"));
+  EXPECT_NE(std::string::npos, identity.find("vary: accept-encoding\r\n"));
+
+  const std::string gzip = with_encoding("/app.js", "gzip");
+  EXPECT_TRUE(gzip.ends_with("gzip body"));
+  EXPECT_NE(std::string::npos, gzip.find("content-encoding: gzip\r\n"));
+  EXPECT_NE(std::string::npos,
+            gzip.find("content-type: text/javascript; charset=utf-8\r\n"));
+
+  // Equal quality prefers the smaller file
+  EXPECT_TRUE(with_encoding("/app.js", "gzip, br").ends_with("br body"));
+  EXPECT_TRUE(
+      with_encoding("/app.js", "br;q=0.5, gzip").ends_with("gzip body"));
+  EXPECT_TRUE(with_encoding("/app.js", "br;q=0, *").ends_with("gzip body"));
+  EXPECT_TRUE(
+      with_encoding("/app.js", "*;q=0").ends_with(std::string(64, 'x')));
+
+  // Each representation has its own validator
+  EXPECT_NE(identity.substr(identity.find("etag"), 24),
+            gzip.substr(gzip.find("etag"), 24));
+
+  // Siblings larger than the original are not served
+  const std::string big = with_encoding("/big.txt", "gzip");
+  EXPECT_TRUE(big.ends_with("small"));
+  EXPECT_EQ(std::string::npos, big.find("vary"));
+
+  WriteFile("big.txt.br", "br");
+  EXPECT_TRUE(with_encoding("/big.txt", "br").ends_with("\r\n\r\nbr"));
+}
+
+TEST_F(StaticFileHandlerTest, ServesDirectoryIndex) {
+  http1::StaticFileHandler handler("/", root.string());
+
+  const auto home = handler.Handle(Request("/"));
+  ASSERT_TRUE(home);
+  EXPECT_TRUE(Serialize(*home).ends_with("<h1>home</h1>"));
+
+  const auto docs = handler.Handle(Request("/docs/"));
+  ASSERT_TRUE(docs);
+  EXPECT_TRUE(Serialize(*docs).ends_with("<h1>docs</h1>"));
+}
+
+TEST_F(StaticFileHandlerTest, DecodesPathSegments) {
+  WriteFile("file name.txt", "spaced");
+  http1::StaticFileHandler handler("/", root.string());
+
+  const auto spaced = handler.Handle(Request("/file%20name.txt?x=%41"));
+  ASSERT_TRUE(spaced);
+  EXPECT_TRUE(Serialize(*spaced).ends_with("spaced"));
+  EXPECT_EQ(http1::HttpStatusCode::OK,
+            handler.Handle(Request("/%64ocs/index.html"))->status_code());
+  EXPECT_EQ(http1::HttpStatusCode::NotFound,
+            handler.Handle(Request("/docs%2Findex.html"))->status_code());
+  EXPECT_EQ(http1::HttpStatusCode::NotFound,
+            handler.Handle(Request("/index.html%00"))->status_code());
+  EXPECT_EQ(http1::HttpStatusCode::NotFound,
+            handler.Handle(Request("/file%2"))->status_code());
+}
+
+TEST_F(StaticFileHandlerTest, RejectsTraversalAndOtherMethods) {
+  http1::StaticFileHandler handler("/", (root / "docs").string());
+
+  EXPECT_EQ(http1::HttpStatusCode::NotFound,
+            handler.Handle(Request("/../index.html"))->status_code());
+  EXPECT_EQ(http1::HttpStatusCode::NotFound,
+            handler.Handle(Request("/./../../index.html"))->status_code());
+  EXPECT_EQ(http1::HttpStatusCode::NotFound,
+            handler.Handle(Request("/missing.html"))->status_code());
+  EXPECT_EQ(http1::HttpStatusCode::OK,
+            handler.Handle(Request("//./index.html"))->status_code());
+  EXPECT_EQ(http1::HttpStatusCode::NotFound,
+            handler.Handle(Request("/%2e%2e/index.html"))->status_code());
+  EXPECT_EQ(http1::HttpStatusCode::NotFound,
+            handler.Handle(Request("/..%2Findex.html"))->status_code());
+
+  const auto post =
+      handler.Handle(Request("/index.html", http1::HttpMethod::Post));
+  EXPECT_EQ(http1::HttpStatusCode::MethodNotAllowed, post->status_code());
+  EXPECT_NE(std::string::npos,
+            Serialize(*post).find("allow: GET, HEAD\r\n"));
+}
+
+TEST_F(StaticFileHandlerTest, RevalidatesChangedFiles) {
+  http1::StaticFileHandler handler(
+      "/", root.string(),
+      http1::StaticFileOptions{.revalidate_interval =
+                                   std::chrono::milliseconds(0)});
+
+  const auto before = handler.Handle(Request("/index.html"));
+  EXPECT_TRUE(Serialize(*before).ends_with("<h1>home</h1>"));
+
+  // A new inode, so the change is seen even within the same mtime tick
+  std::filesystem::remove(root / "index.html");
+  WriteFile("index.html", "<h1>changed</h1>");
+  const auto after = handler.Handle(Request("/index.html"));
+  EXPECT_TRUE(Serialize(*after).ends_with("<h1>changed</h1>"));
+
+  // In-flight responses keep the old file
+  EXPECT_TRUE(Serialize(*before).ends_with("<h1>home</h1>"));
+
+  std::filesystem::remove(root / "index.html");
+  EXPECT_EQ(http1::HttpStatusCode::NotFound,
+            handler.Handle(Request("/index.html"))->status_code());
+}
+
+TEST_F(StaticFileHandlerTest, EvictsLeastRecentlyUsed) {
+  http1::StaticFileHandler handler(
+      "/", root.string(), http1::StaticFileOptions{.cache_capacity = 2});
+
+  for (const auto* path : {"/index.html", "/style.CSS", "/data.bin",
+                           "/docs/index.html"}) {
+    EXPECT_EQ(http1::HttpStatusCode::OK,
+              handler.Handle(Request(path))->status_code());
+    EXPECT_LE(handler.cache_size(), 2);
+  }
+  EXPECT_EQ(2, handler.cache_size());
+}
+
+TEST_F(StaticFileHandlerTest, InotifyEvictsChangedFiles) {
+  IdleServer server;
+  http1::StaticFileHandler handler(
+      "/", root.string(),
+      http1::StaticFileOptions{.revalidate_interval = std::chrono::hours(1)});
+  handler.WatchChanges(server);
+
+  ASSERT_TRUE(handler.Handle(Request("/")));
+  const auto docs_before = handler.Handle(Request("/docs/index.html"));
+  EXPECT_EQ(2, handler.cache_size());
+
+  // Rewritten in place, so only the notification can reveal the change
+  WriteFile("index.html", "<h1>deployed</h1>");
+
+  const loopback::RunningServer running(server);
+  const auto on_loop = [&server](auto task) {
+    std::promise<decltype(task())> result;
+    server.Post([&result, &task] { result.set_value(task()); });
+    return result.get_future().get();
+  };
+
+  // The loop reads the notification whenever it arrives
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  std::size_t cache_size = 2;
+  while (cache_size != 1 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    cache_size = on_loop([&handler] { return handler.cache_size(); });
+  }
+  EXPECT_EQ(1, cache_size);
+
+  const std::string after = on_loop(
+      [&] { return Serialize(handler.Handle(Request("/")).value()); });
+  EXPECT_TRUE(after.ends_with("<h1>deployed</h1>"));
+  EXPECT_TRUE(Serialize(*docs_before).ends_with("<h1>docs</h1>"));
+}
+
+TEST_F(StaticFileHandlerTest, SendsMultipartRangesFromFile) {
+  WriteFile("digits.txt", "0123456789");
+  auto request = Request("/digits.txt");
+  request.UpdateFields("range", "bytes=0-1,8-9");
+  const std::string expected =
+      Serialize(http1::StaticFileHandler("/", root.string())
+                    .Handle(request)
+                    .value());
+  const std::string expected_body =
+      expected.substr(expected.find("\r\n\r\n") + 4);
+
+  FileServer server(root.string());
+  const loopback::RunningServer running(server);
+  const std::string received = loopback::Exchange(
+      running.port(),
+      "GET /digits.txt HTTP/1.1\r\nrange: bytes=0-1,8-9\r\n\r\n",
+      expected_body);
+  EXPECT_TRUE(received.starts_with("HTTP/1.1 206 Partial Content\r\n"));
+  EXPECT_TRUE(received.ends_with("\r\n\r\n" + expected_body));
+}
@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "loopback.hpp"
+#include "static_routes.hpp"
+
+namespace {
+
+using http1::HttpMethod;
+using http1::HttpRequest;
+using http1::HttpResponse;
+using http1::HttpStatusCode;
+using http1::HttpVersion;
+using http1::Route;
+using http1::StaticRouteTable;
+
+HttpResponse Health(const HttpRequest& /*request*/) {
+  return HttpResponse(HttpStatusCode::OK);
+}
+
+HttpResponse CreateUser(const HttpRequest& /*request*/) {
+  return HttpResponse(HttpStatusCode::Created);
+}
+
+HttpResponse ListUsers(const HttpRequest& /*request*/) {
+  return HttpResponse(HttpStatusCode::Accepted);
+}
+
+HttpResponse Head(const HttpRequest& /*request*/) {
+  return HttpResponse(HttpStatusCode::NoContent);
+}
+
+class Counter {
+ public:
+  HttpResponse Count(const HttpRequest& /*request*/) {
+    ++count_;
+    return HttpResponse(HttpStatusCode::OK);
+  }
+
+  [[nodiscard]] int count() const noexcept { return count_; }
+
+ private:
+  int count_ = 0;
+};
+
+HttpResponse Reset(Counter& /*counter*/, const HttpRequest& /*request*/) {
+  return HttpResponse(HttpStatusCode::ResetContent);
+}
+
+using Routes =
+    StaticRouteTable<Route<"/health", HttpMethod::Get, &Health>,
+                     Route<"/users", HttpMethod::Post, &CreateUser>,
+                     Route<"/users", HttpMethod::Get, &ListUsers>,
+                     Route<"/users/me", HttpMethod::Head, &Head>,
+                     Route<"/users/me", HttpMethod::Get, &ListUsers>,
+                     Route<"/", HttpMethod::Get, &Health>>;
+
+// Answers /health with a prepared response, as the example server does
+class PreparedServer : public http1::BasicHttpServer<PreparedServer> {
+  friend BasicHttpServer<PreparedServer>;
+
+ public:
+  PreparedServer() : BasicHttpServer(0), health_(MakeHealth()) {}
+
+ private:
+  static http1::PreparedResponse MakeHealth() {
+    static constexpr std::string_view BODY = "ok";
+    HttpResponse response(HttpStatusCode::OK);
+    response.SetBody(http1::ByteArrayView(
+        reinterpret_cast<const std::byte*>(BODY.data()), BODY.size()));
+    response.SetContentLength(BODY.size());
+    return http1::PreparedResponse(response);
+  }
+
+  HttpResponse Health(const HttpRequest& /*request*/) { return health_; }
+
+  using StaticRoutes = StaticRouteTable<
+      Route<"/health", HttpMethod::Get, &PreparedServer::Health>>;
+
+  HttpResponse OnRequest(const HttpRequest& /*request*/) {
+    HttpResponse response(HttpStatusCode::NotFound);
+    response.SetContentLength(0);
+    return response;
+  }
+
+  http1::PreparedResponse health_;
+};
+
+std::optional<HttpResponse> Dispatch(HttpMethod method, std::string path) {
+  return Routes::Dispatch(
+      HttpRequest(method, std::move(path), HttpVersion::Http11));
+}
+
+}  // namespace
+
+TEST(StaticRoutes, DispatchesExactPaths) {
+  EXPECT_EQ(HttpStatusCode::OK,
+            Dispatch(HttpMethod::Get, "/health")->status_code());
+  EXPECT_EQ(HttpStatusCode::OK, Dispatch(HttpMethod::Get, "/")->status_code());
+  EXPECT_EQ(HttpStatusCode::Created,
+            Dispatch(HttpMethod::Post, "/users")->status_code());
+  EXPECT_EQ(HttpStatusCode::Accepted,
+            Dispatch(HttpMethod::Get, "/users?page=2")->status_code());
+
+  EXPECT_EQ(std::nullopt, Dispatch(HttpMethod::Get, "/healt"));
+  EXPECT_EQ(std::nullopt, Dispatch(HttpMethod::Get, "/health/"));
+  EXPECT_EQ(std::nullopt, Dispatch(HttpMethod::Get, "/users/42"));
+  EXPECT_EQ(std::nullopt, Dispatch(HttpMethod::Get, ""));
+}
+
+TEST(StaticRoutes, DispatchesByMethod) {
+  // GET routes answer HEAD unless there is a HEAD route
+  EXPECT_EQ(HttpStatusCode::OK,
+            Dispatch(HttpMethod::Head, "/health")->status_code());
+  EXPECT_EQ(HttpStatusCode::NoContent,
+            Dispatch(HttpMethod::Head, "/users/me")->status_code());
+
+  const auto not_allowed = Dispatch(HttpMethod::Delete, "/users");
+  ASSERT_TRUE(not_allowed);
+  EXPECT_EQ(HttpStatusCode::MethodNotAllowed, not_allowed->status_code());
+  EXPECT_EQ("GET, HEAD, POST", not_allowed->FindField("allow"));
+  EXPECT_EQ(0U, not_allowed->content_length());
+
+  EXPECT_EQ(HttpStatusCode::MethodNotAllowed,
+            Dispatch(HttpMethod::Unknown, "/health")->status_code());
+}
+
+TEST(StaticRoutes, ServerOmitsBodyOfHeadResponses) {
+  PreparedServer server;
+  const loopback::RunningServer running(server);
+
+  // The GET response right behind shows where the HEAD response ends
+  const std::string received = loopback::Exchange(
+      running.port(),
+      "HEAD /health HTTP/1.1\r\n\r\nGET /health HTTP/1.1\r\n\r\n",
+      "\r\n\r\nok");
+
+  const std::size_t head_end =
+      received.find("\r\n\r\nHTTP/1.1 200 OK\r\n");
+  ASSERT_NE(std::string::npos, head_end);
+  EXPECT_NE(std::string::npos,
+            std::string_view(received)
+                .substr(0, head_end + 4)
+                .find("content-length: 2\r\n"));
+  EXPECT_TRUE(received.ends_with("\r\n\r\nok"));
+}
+
+TEST(StaticRoutes, PassesArgumentsToHandlers) {
+  using CounterRoutes =
+      StaticRouteTable<Route<"/count", HttpMethod::Post, &Counter::Count>,
+                       Route<"/reset", HttpMethod::Post, &Reset>,
+                       Route<"/health", HttpMethod::Get, &Health>>;
+
+  Counter counter;
+  const HttpRequest count(HttpMethod::Post, "/count", HttpVersion::Http11);
+  EXPECT_EQ(HttpStatusCode::OK,
+            CounterRoutes::Dispatch(count, counter)->status_code());
+  EXPECT_EQ(HttpStatusCode::OK,
+            CounterRoutes::Dispatch(count, counter)->status_code());
+  EXPECT_EQ(2, counter.count());
+
+  const HttpRequest reset(HttpMethod::Post, "/reset", HttpVersion::Http11);
+  EXPECT_EQ(HttpStatusCode::ResetContent,
+            CounterRoutes::Dispatch(reset, counter)->status_code());
+
+  // Handlers taking the request only ignore the arguments
+  const HttpRequest health(HttpMethod::Get, "/health", HttpVersion::Http11);
+  EXPECT_EQ(HttpStatusCode::OK,
+            CounterRoutes::Dispatch(health, counter)->status_code());
+}
+
+TEST(StaticRoutes, SimilarPaths) {
+  using SimilarRoutes = StaticRouteTable<
+      Route<"/a", HttpMethod::Get, &Health>,
+      Route<"/b", HttpMethod::Get, &CreateUser>,
+      Route<"/ab", HttpMethod::Get, &ListUsers>,
+      Route<"/ba", HttpMethod::Get, &Health>,
+      Route<"/api/v1/a", HttpMethod::Get, &CreateUser>,
+      Route<"/api/v1/b", HttpMethod::Get, &ListUsers>,
+      Route<"/api/v1/c", HttpMethod::Get, &Health>,
+      Route<"/api/v1/d", HttpMethod::Get, &CreateUser>,
+      Route<"/api/v2/a", HttpMethod::Get, &ListUsers>,
+      Route<"/api/v2/b", HttpMethod::Get, &Health>,
+      Route<"/api/v2/c", HttpMethod::Get, &CreateUser>,
+      Route<"/api/v2/d", HttpMethod::Get, &ListUsers>>;
+
+  const auto status_of = [](std::string path) {
+    return SimilarRoutes::Dispatch(
+               HttpRequest(HttpMethod::Get, std::move(path),
+                           HttpVersion::Http11))
+        ->status_code();
+  };
+  EXPECT_EQ(HttpStatusCode::OK, status_of("/a"));
+  EXPECT_EQ(HttpStatusCode::Created, status_of("/b"));
+  EXPECT_EQ(HttpStatusCode::Accepted, status_of("/ab"));
+  EXPECT_EQ(HttpStatusCode::OK, status_of("/ba"));
+  EXPECT_EQ(HttpStatusCode::Created, status_of("/api/v1/a"));
+  EXPECT_EQ(HttpStatusCode::Accepted, status_of("/api/v1/b"));
+  EXPECT_EQ(HttpStatusCode::OK, status_of("/api/v1/c"));
+  EXPECT_EQ(HttpStatusCode::Created, status_of("/api/v1/d"));
+  EXPECT_EQ(HttpStatusCode::Accepted, status_of("/api/v2/a"));
+  EXPECT_EQ(HttpStatusCode::OK, status_of("/api/v2/b"));
+  EXPECT_EQ(HttpStatusCode::Created, status_of("/api/v2/c"));
+  EXPECT_EQ(HttpStatusCode::Accepted, status_of("/api/v2/d"));
+  EXPECT_EQ(std::nullopt,
+            SimilarRoutes::Dispatch(HttpRequest(HttpMethod::Get, "/api/v3/a",
+                                                HttpVersion::Http11)));
+}
@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "http_server.hpp"
+#include "target.hpp"
+
+namespace {
+
+using http1::QueryParam;
+using http1::Target;
+
+std::vector<std::pair<std::string, std::string>> ParamsOf(
+    std::string_view query) {
+  std::vector<std::pair<std::string, std::string>> params;
+  for (const QueryParam& param : http1::QueryParams(query)) {
+    params.emplace_back(param.name, param.value);
+  }
+  return params;
+}
+
+std::optional<std::string> Decode(std::string_view encoded,
+                                  bool plus_as_space = false) {
+  std::string output(encoded.size(), '\0');
+  const auto decoded = http1::PercentDecode(encoded, output, plus_as_space);
+  if (!decoded) {
+    return std::nullopt;
+  }
+  return std::string(*decoded);
+}
+
+}  // namespace
+
+TEST(Target, SplitsPathAndQuery) {
+  constexpr Target with_query("/search?q=a+b&page=2");
+  static_assert(with_query.path() == "/search");
+  EXPECT_EQ("q=a+b&page=2", with_query.query());
+  EXPECT_TRUE(with_query.has_query());
+
+  const Target without_query("/index.html");
+  EXPECT_EQ("/index.html", without_query.path());
+  EXPECT_EQ("", without_query.query());
+  EXPECT_FALSE(without_query.has_query());
+
+  const Target empty_query("/a?");
+  EXPECT_EQ("/a", empty_query.path());
+  EXPECT_TRUE(empty_query.has_query());
+  EXPECT_EQ(empty_query.query_params().begin(),
+            empty_query.query_params().end());
+
+  const http1::HttpRequest request(http1::HttpMethod::Get, "/a/b?c=d",
+                                   http1::HttpVersion::Http11);
+  EXPECT_EQ("/a/b", request.target().path());
+  EXPECT_EQ("d", request.target().query_params().Find("c"));
+}
+
+TEST(Target, IteratesQueryParams) {
+  using Params = std::vector<std::pair<std::string, std::string>>;
+  EXPECT_EQ((Params{{"q", "a+b"}, {"page", "2"}}), ParamsOf("q=a+b&page=2"));
+  EXPECT_EQ((Params{{"flag", ""}, {"x", "=1"}, {"", "v"}}),
+            ParamsOf("&flag&&x==1&=v&"));
+  EXPECT_EQ(Params{}, ParamsOf(""));
+  EXPECT_EQ(Params{}, ParamsOf("&&"));
+
+  const http1::QueryParams params("a=1&b=2&a=3");
+  EXPECT_EQ("1", params.Find("a"));
+  EXPECT_EQ("2", params.Find("b"));
+  EXPECT_EQ(std::nullopt, params.Find("c"));
+
+  auto iterator = params.begin();
+  const auto first = iterator++;
+  EXPECT_EQ("a", first->name);
+  EXPECT_EQ("b", iterator->name);
+  EXPECT_EQ(3, std::distance(params.begin(), params.end()));
+}
+
+TEST(Target, FindsEscapes) {
+  EXPECT_EQ(0U, http1::FindEscape("", true));
+  EXPECT_EQ(3U, http1::FindEscape("abc", true));
+  EXPECT_EQ(9U, http1::FindEscape("abcdefghi%20", false));
+  EXPECT_EQ(1U, http1::FindEscape("a+%", true));
+  EXPECT_EQ(2U, http1::FindEscape("a+%", false));
+
+  // Every position within and after the 8 byte words
+  for (std::size_t position = 0; position < 40; ++position) {
+    std::string text(40, 'x');
+    text[position] = '%';
+    EXPECT_EQ(position, http1::FindEscape(text, false));
+    text[position] = '+';
+    EXPECT_EQ(position, http1::FindEscape(text, true));
+    EXPECT_EQ(text.size(), http1::FindEscape(text, false));
+  }
+
+  // Bytes next to '%' and '+', which the word arithmetic must not confuse
+  EXPECT_EQ(16U, http1::FindEscape("$&*,$&*,\xa5\xab\x24\x26\x2a\x2c\xff\x01%",
+                                   true));
+}
+
+TEST(Target, PercentDecodes) {
+  EXPECT_EQ("", Decode(""));
+  EXPECT_EQ("plain/path", Decode("plain/path"));
+  EXPECT_EQ("a b/c", Decode("a%20b%2Fc"));
+  EXPECT_EQ("a+b", Decode("a+b"));
+  EXPECT_EQ("a b c", Decode("a+b%20c", true));
+  EXPECT_EQ("\xff\x01", Decode("%fF%01"));
+  EXPECT_EQ("100%", Decode("100%25"));
+  EXPECT_EQ("long run before the escape: %",
+            Decode("long run before the escape: %25"));
+
+  EXPECT_EQ(std::nullopt, Decode("%"));
+  EXPECT_EQ(std::nullopt, Decode("a%2"));
+  EXPECT_EQ(std::nullopt, Decode("%zz"));
+  EXPECT_EQ(std::nullopt, Decode("%g0"));
+
+  std::array<char, 2> small{};
+  EXPECT_EQ(std::nullopt, http1::PercentDecode("abc", small, false));
+}
+
+TEST(Target, PercentDecodesInPlace) {
+  std::string text = "name%3Dvalue+with%20spaces and more text%21";
+  const auto decoded = http1::PercentDecode(text, text, true);
+  ASSERT_TRUE(decoded);
+  EXPECT_EQ("name=value with spaces and more text!", *decoded);
+  EXPECT_EQ(text.data(), decoded->data());
+}
+
+namespace {
+
+struct Normalized {
+  http1::PathStatus status;
+  std::string path;
+};
+
+Normalized Normalize(std::string path, const http1::PathOptions& options = {}) {
+  const auto normalized = http1::NormalizePath(path, options);
+  path.resize(normalized.size);
+  return Normalized{.status = normalized.status, .path = path};
+}
+
+}  // namespace
+
+TEST(NormalizePath, RecognizesNormalPaths) {
+  for (const std::string path :
+       {"/", "/index.html", "/a/b/", "/a/.b/..c/...", "/file%20name",
+        "/%2F", "*", "relative/../path", "/a.b/c..d"}) {
+    const auto normalized = Normalize(path);
+    EXPECT_EQ(http1::PathStatus::Normal, normalized.status) << path;
+    EXPECT_EQ(path, normalized.path);
+  }
+}
+
+TEST(NormalizePath, RemovesDotSegments) {
+  // Examples of RFC 3986 section 5.2.4 and 5.4
+  EXPECT_EQ("/a/g", Normalize("/a/b/c/./../../g").path);
+  EXPECT_EQ("/mid/6", Normalize("/mid/content=5/../6").path);
+  EXPECT_EQ("/a/", Normalize("/a/b/..").path);
+  EXPECT_EQ("/a/", Normalize("/a/b/../").path);
+  EXPECT_EQ("/a/", Normalize("/a/.").path);
+  EXPECT_EQ("/", Normalize("/..").path);
+  EXPECT_EQ("/", Normalize("/../../..").path);
+  EXPECT_EQ("/etc/passwd", Normalize("/../../etc/passwd").path);
+  EXPECT_EQ("/b", Normalize("/./a/../b").path);
+  EXPECT_EQ(http1::PathStatus::Normalized, Normalize("/a/./b").status);
+}
+
+TEST(NormalizePath, CollapsesSlashes) {
+  EXPECT_EQ("/a/b", Normalize("//a///b").path);
+  EXPECT_EQ("/a/", Normalize("/a//").path);
+  EXPECT_EQ("/", Normalize("//").path);
+  EXPECT_EQ("/b", Normalize("/a//..//b").path);
+
+  const http1::PathOptions keep_empty{.collapse_slashes = false};
+  const auto kept = Normalize("/a//b", keep_empty);
+  EXPECT_EQ(http1::PathStatus::Normal, kept.status);
+  EXPECT_EQ("/a//b", kept.path);
+  EXPECT_EQ("/a//c", Normalize("/a//b/../c", keep_empty).path);
+}
+
+TEST(NormalizePath, NormalizesEscapes) {
+  EXPECT_EQ("/~user/a-b_c.d", Normalize("/%7Euser/a%2db%5Fc%2ed").path);
+  EXPECT_EQ("/a%20b%C3%A9", Normalize("/a%20b%c3%a9").path);
+  EXPECT_EQ("/", Normalize("/a/%2e%2E").path);
+  EXPECT_EQ("/b", Normalize("/%2e%2e/a/%2E%2E/b").path);
+
+  EXPECT_EQ(http1::PathStatus::Invalid, Normalize("/a%").status);
+  EXPECT_EQ(http1::PathStatus::Invalid, Normalize("/a%2").status);
+  EXPECT_EQ(http1::PathStatus::Invalid, Normalize("/a%zz/../b").status);
+}
+
+TEST(NormalizePath, EncodedSlashPolicies) {
+  EXPECT_EQ("/a%2F..%2Fb",
+            Normalize("/a%2f..%2Fb",
+                      http1::PathOptions{
+                          .encoded_slash = http1::EncodedSlash::Keep})
+                .path);
+  EXPECT_EQ("/b", Normalize("/a%2F..%2Fb",
+                            http1::PathOptions{
+                                .encoded_slash = http1::EncodedSlash::Decode})
+                      .path);
+  EXPECT_EQ(http1::PathStatus::Invalid,
+            Normalize("/a%2Fb",
+                      http1::PathOptions{
+                          .encoded_slash = http1::EncodedSlash::Reject})
+                .status);
+}
+
+TEST(NormalizePath, ParsedRequests) {
+  const auto request = http1::HttpRequest::ParseHeader(
+      "GET /static/../a//b.html?x=/../y HTTP/1.1\r\n\r\n");
+  EXPECT_EQ("/a/b.html?x=/../y", request.path());
+
+  EXPECT_THROW(
+      http1::HttpRequest::ParseHeader("GET /a%zz HTTP/1.1\r\n\r\n"),
+      http1::HttpParseError);
+  EXPECT_THROW(http1::HttpRequest::ParseHeader(
+                   "GET /a%2Fb HTTP/1.1\r\n\r\n",
+                   http1::PathOptions{
+                       .encoded_slash = http1::EncodedSlash::Reject}),
+               http1::HttpParseError);
+}
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <latch>
+#include <thread>
+#include <vector>
+
+#include "mpsc_queue.hpp"
+#include "thread_pool.hpp"
+
+TEST(MpscQueue, PopFromEmptyQueue) {
+  http1::MpscQueue<int> queue;
+  EXPECT_FALSE(queue.Pop().has_value());
+}
+
+TEST(MpscQueue, KeepsOrderOfSingleProducer) {
+  http1::MpscQueue<int> queue;
+  for (int i = 0; i < 100; ++i) {
+    queue.Push(i);
+  }
+
+  for (int i = 0; i < 100; ++i) {
+    auto value = queue.Pop();
+    ASSERT_TRUE(value.has_value());
+    EXPECT_EQ(i, value.value());
+  }
+  EXPECT_FALSE(queue.Pop().has_value());
+}
+
+TEST(MpscQueue, ManyProducers) {
+  constexpr int PRODUCERS = 4;
+  constexpr int ITEMS_PER_PRODUCER = 10000;
+
+  http1::MpscQueue<int> queue;
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < PRODUCERS; ++producer) {
+    producers.emplace_back([&queue] {
+      for (int i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+        queue.Push(1);
+      }
+    });
+  }
+
+  int sum = 0;
+  while (sum < PRODUCERS * ITEMS_PER_PRODUCER) {
+    if (auto value = queue.Pop()) {
+      sum += value.value();
+    }
+  }
+
+  for (auto& producer : producers) {
+    producer.join();
+  }
+
+  EXPECT_EQ(PRODUCERS * ITEMS_PER_PRODUCER, sum);
+  EXPECT_FALSE(queue.Pop().has_value());
+}
+
+TEST(ThreadPool, RunsAllTasks) {
+  constexpr int TASKS = 1000;
+
+  std::atomic<int> counter = 0;
+  std::latch done(TASKS);
+  {
+    http1::ThreadPool pool(4, TASKS);
+    for (int i = 0; i < TASKS; ++i) {
+      ASSERT_TRUE(pool.TrySubmit([&] {
+        counter.fetch_add(1);
+        done.count_down();
+      }));
+    }
+    done.wait();
+
+    EXPECT_EQ(TASKS, pool.stats().submitted);
+    EXPECT_EQ(0, pool.stats().rejected);
+    EXPECT_EQ(0, pool.stats().queue_depth);
+  }
+
+  EXPECT_EQ(TASKS, counter.load());
+}
+
+TEST(ThreadPool, RejectsWhenQueueIsFull) {
+  std::latch release(1);
+  std::latch started(1);
+
+  http1::ThreadPool pool(1, 2);
+
+  // Occupy the only worker so later tasks stay queued
+  ASSERT_TRUE(pool.TrySubmit([&] {
+    started.count_down();
+    release.wait();
+  }));
+  started.wait();
+
+  EXPECT_TRUE(pool.TrySubmit([] {}));
+  EXPECT_TRUE(pool.TrySubmit([] {}));
+  EXPECT_FALSE(pool.TrySubmit([] {}));
+
+  const auto stats = pool.stats();
+  EXPECT_EQ(2, stats.queue_depth);
+  EXPECT_EQ(2, stats.queue_capacity);
+  EXPECT_EQ(1, stats.rejected);
+
+  release.count_down();
+}
+
+TEST(ThreadPool, RecordsWaitTime) {
+  std::latch release(1);
+  std::latch done(2);
+
+  http1::ThreadPool pool(1, 4);
+  ASSERT_TRUE(pool.TrySubmit([&] {
+    release.wait();
+    done.count_down();
+  }));
+  ASSERT_TRUE(pool.TrySubmit([&] { done.count_down(); }));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  release.count_down();
+  done.wait();
+
+  EXPECT_GE(pool.stats().max_wait_time, std::chrono::milliseconds(5));
+  EXPECT_GE(pool.stats().total_wait_time, pool.stats().max_wait_time);
+}
\ No newline at end of file
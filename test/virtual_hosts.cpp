@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "virtual_hosts.hpp"
+
+namespace {
+
+using http1::HttpMethod;
+using http1::HttpRequest;
+using http1::HttpResponse;
+using http1::HttpStatusCode;
+using http1::HttpVersion;
+using http1::VirtualHosts;
+
+// Handler answering with the given status
+VirtualHosts::Handler Respond(HttpStatusCode status_code) {
+  return [status_code](const HttpRequest& /*request*/) {
+    return HttpResponse(status_code);
+  };
+}
+
+HttpStatusCode StatusFor(const VirtualHosts& hosts, std::string_view host) {
+  const VirtualHosts::Handler* handler = hosts.Find(host);
+  if (handler == nullptr) {
+    return HttpStatusCode::MisdirectedRequest;
+  }
+  return (*handler)(HttpRequest()).status_code();
+}
+
+}  // namespace
+
+TEST(VirtualHosts, ExtractsHostNames) {
+  EXPECT_EQ("example.com", http1::HostNameOf("example.com"));
+  EXPECT_EQ("Example.COM", http1::HostNameOf("Example.COM.:8080"));
+  EXPECT_EQ("localhost", http1::HostNameOf(" localhost: "));
+  EXPECT_EQ("127.0.0.1", http1::HostNameOf("127.0.0.1:80"));
+  EXPECT_EQ("[::1]", http1::HostNameOf("[::1]:8080"));
+  EXPECT_EQ("[2001:db8::1]", http1::HostNameOf("[2001:db8::1]"));
+
+  for (const std::string_view malformed :
+       {"", ":80", ".", "a b", "a/b", "host:http", "host:123456", "[]",
+        "[::1", "[::1]x", "[zz::1]", "user@host"}) {
+    EXPECT_EQ(std::nullopt, http1::HostNameOf(malformed)) << malformed;
+  }
+}
+
+TEST(VirtualHosts, MatchesExactNames) {
+  VirtualHosts hosts;
+  hosts.Add("example.com", Respond(HttpStatusCode::OK));
+  hosts.Add("API.example.com", Respond(HttpStatusCode::Created));
+
+  EXPECT_EQ(HttpStatusCode::OK, StatusFor(hosts, "example.com"));
+  EXPECT_EQ(HttpStatusCode::OK, StatusFor(hosts, "EXAMPLE.com:8080"));
+  EXPECT_EQ(HttpStatusCode::OK, StatusFor(hosts, "example.com."));
+  EXPECT_EQ(HttpStatusCode::Created, StatusFor(hosts, "api.example.com"));
+  EXPECT_EQ(nullptr, hosts.Find("www.example.com"));
+  EXPECT_EQ(nullptr, hosts.Find("example.org"));
+  EXPECT_EQ(nullptr, hosts.Find("example.com/"));
+
+  EXPECT_THROW(hosts.Add("Example.com", Respond(HttpStatusCode::OK)),
+               std::invalid_argument);
+  EXPECT_THROW(hosts.Add("", Respond(HttpStatusCode::OK)),
+               std::invalid_argument);
+  EXPECT_THROW(hosts.Add("example.net:80", Respond(HttpStatusCode::OK)),
+               std::invalid_argument);
+  EXPECT_THROW(hosts.Add("*", Respond(HttpStatusCode::OK)),
+               std::invalid_argument);
+  EXPECT_THROW(hosts.Add("*.", Respond(HttpStatusCode::OK)),
+               std::invalid_argument);
+}
+
+TEST(VirtualHosts, FallsBackToWildcards) {
+  VirtualHosts hosts;
+  hosts.Add("*.example.com", Respond(HttpStatusCode::OK));
+  hosts.Add("*.eu.example.com", Respond(HttpStatusCode::Created));
+  hosts.Add("static.eu.example.com", Respond(HttpStatusCode::Accepted));
+
+  EXPECT_EQ(HttpStatusCode::OK, StatusFor(hosts, "www.example.com"));
+  EXPECT_EQ(HttpStatusCode::OK, StatusFor(hosts, "a.b.example.com"));
+  EXPECT_EQ(HttpStatusCode::OK, StatusFor(hosts, "eu.example.com"));
+  EXPECT_EQ(HttpStatusCode::Created, StatusFor(hosts, "www.eu.example.com"));
+  EXPECT_EQ(HttpStatusCode::Created, StatusFor(hosts, "a.b.EU.example.com"));
+  EXPECT_EQ(HttpStatusCode::Accepted,
+            StatusFor(hosts, "static.eu.example.com"));
+  EXPECT_EQ(nullptr, hosts.Find("example.com"));
+  EXPECT_EQ(nullptr, hosts.Find("wwwexample.com"));
+
+  hosts.SetDefault(Respond(HttpStatusCode::NotFound));
+  EXPECT_EQ(HttpStatusCode::NotFound, StatusFor(hosts, "example.com"));
+  EXPECT_EQ(HttpStatusCode::NotFound, StatusFor(hosts, "bad host"));
+}
+
+TEST(VirtualHosts, ManySites) {
+  VirtualHosts hosts;
+  for (int site = 0; site < 1000; ++site) {
+    hosts.Add("site" + std::to_string(site) + ".test",
+              [site](const HttpRequest& /*request*/) {
+                HttpResponse response(HttpStatusCode::OK);
+                response.AddField({"x-site", std::to_string(site)});
+                return response;
+              });
+  }
+
+  for (int site = 0; site < 1000; ++site) {
+    const auto* handler = hosts.Find("SITE" + std::to_string(site) + ".test");
+    ASSERT_NE(nullptr, handler);
+    EXPECT_EQ(std::to_string(site),
+              (*handler)(HttpRequest()).FindField("x-site"));
+  }
+  EXPECT_EQ(nullptr, hosts.Find("site1000.test"));
+}
+
+TEST(VirtualHosts, DispatchesRequests) {
+  VirtualHosts hosts;
+  hosts.Add("example.com", Respond(HttpStatusCode::OK));
+
+  const auto request = HttpRequest::ParseHeader(
+      "GET / HTTP/1.1\r\nHost: Example.com:8080\r\n\r\n");
+  EXPECT_EQ(HttpStatusCode::OK, hosts.Dispatch(request).status_code());
+
+  const auto unknown = HttpRequest::ParseHeader(
+      "GET / HTTP/1.1\r\nHost: example.org\r\n\r\n");
+  EXPECT_EQ(HttpStatusCode::MisdirectedRequest,
+            hosts.Dispatch(unknown).status_code());
+
+  const HttpRequest without_host(HttpMethod::Get, "/", HttpVersion::Http11);
+  EXPECT_EQ(HttpStatusCode::BadRequest,
+            hosts.Dispatch(without_host).status_code());
+
+  // HTTP/1.0 requests may omit the field and get the default site
+  const HttpRequest old_request(HttpMethod::Get, "/", HttpVersion::Http10);
+  EXPECT_EQ(HttpStatusCode::MisdirectedRequest,
+            hosts.Dispatch(old_request).status_code());
+  hosts.SetDefault(Respond(HttpStatusCode::NoContent));
+  EXPECT_EQ(HttpStatusCode::NoContent,
+            hosts.Dispatch(old_request).status_code());
+  EXPECT_EQ(HttpStatusCode::NoContent, hosts.Dispatch(unknown).status_code());
+}
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "loop_monitor.hpp"
+#include "loopback.hpp"
+#include "watchdog.hpp"
+
+namespace {
+
+using http1::HttpRequest;
+using http1::HttpResponse;
+using http1::HttpStatusCode;
+using http1::LoopMonitor;
+using http1::Watchdog;
+using loopback::Contains;
+
+// Answers /slow after blocking the loop for 150 ms
+class SlowServer : public http1::BasicHttpServer<SlowServer> {
+  friend BasicHttpServer<SlowServer>;
+
+ public:
+  SlowServer() : BasicHttpServer(0) {}
+
+ private:
+  HttpResponse OnRequest(const HttpRequest& request) {
+    if (request.path() == "/slow") {
+      std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    }
+    HttpResponse response(HttpStatusCode::NoContent);
+    response.SetContentLength(0);
+    return response;
+  }
+};
+
+}  // namespace
+
+TEST(Watchdog, PublishesInFlightRequest) {
+  auto monitor = std::make_unique<LoopMonitor>();
+  EXPECT_EQ(std::nullopt, monitor->request());
+
+  const std::string long_path = "/" + std::string(200, 'a');
+  monitor->BeginRequest("OPTIONS", long_path, 7);
+  const auto request = monitor->request();
+  ASSERT_TRUE(request);
+  EXPECT_EQ("OPTIONS", request->method);
+  EXPECT_EQ(long_path.substr(0, LoopMonitor::MAX_PATH_SIZE), request->path);
+  EXPECT_EQ(7U, request->connection_id);
+  EXPECT_LT(0U, request->start_time);
+
+  monitor->BeginRequest("GET", "/short", 8);
+  EXPECT_EQ("/short", monitor->request()->path);
+  monitor->EndRequest();
+  EXPECT_EQ(std::nullopt, monitor->request());
+
+  // Requests are only published once a Watchdog watches the loop
+  {
+    const http1::InFlightRequest in_flight(*monitor, "GET", "/", 9);
+    EXPECT_EQ(std::nullopt, monitor->request());
+  }
+  monitor->SetWatched(true);
+  {
+    const http1::InFlightRequest in_flight(*monitor, "GET", "/", 9);
+    EXPECT_EQ(9U, monitor->request()->connection_id);
+  }
+  EXPECT_EQ(std::nullopt, monitor->request());
+}
+
+TEST(Watchdog, RecordsIterations) {
+  auto monitor = std::make_unique<LoopMonitor>();
+  EXPECT_EQ(0U, monitor->busy_since());
+  monitor->BeginIteration();
+  EXPECT_LT(0U, monitor->busy_since());
+  monitor->EndIteration();
+  EXPECT_EQ(0U, monitor->busy_since());
+  // Without a started iteration there is nothing to record
+  monitor->EndIteration();
+
+  http1::HistogramSnapshot snapshot;
+  snapshot.Merge(monitor->iteration_durations());
+  EXPECT_EQ(1U, snapshot.count());
+
+  monitor->BeginRequest("GET", "/x", 3);
+  std::string report;
+  Watchdog::FormatStall(*monitor, 250'000'000, report);
+  EXPECT_TRUE(report.starts_with(
+      "event loop stalled for 250.000 ms in GET /x of connection 3, "
+      "handled for "));
+  EXPECT_TRUE(Contains(report, "\nloop iterations: 1, p50 "));
+}
+
+TEST(Watchdog, ReportsStalledLoop) {
+  std::array<int, 2> pipe_fds{};
+  ASSERT_EQ(0, pipe(pipe_fds.data()));
+  std::future<std::string> written =
+      std::async(std::launch::async, loopback::ReadAll, pipe_fds[0]);
+
+  {
+    SlowServer server;
+    {
+      const loopback::RunningServer running(server);
+      Watchdog watchdog(pipe_fds[1],
+                        {.threshold = std::chrono::milliseconds(50),
+                         .capture_stack = true});
+      watchdog.Watch(server.loop_monitor());
+
+      loopback::Exchange(running.port(), "GET /fast HTTP/1.1\r\n\r\n",
+                         "\r\n\r\n");
+      EXPECT_EQ(0U, watchdog.stalls());
+      loopback::Exchange(running.port(), "GET /slow HTTP/1.1\r\n\r\n",
+                         "\r\n\r\n");
+      EXPECT_EQ(1U, watchdog.stalls());
+    }
+    EXPECT_FALSE(server.loop_monitor().watched());
+
+    // A late signal finds no handler writing to the closed fd
+    struct sigaction action {};
+    sigaction(SIGUSR2, nullptr, &action);
+    EXPECT_EQ(SIG_IGN, action.sa_handler);
+
+    std::string metrics;
+    server.WriteMetrics(metrics);
+    EXPECT_TRUE(
+        Contains(metrics, "# TYPE http1_loop_iteration_seconds summary\n"));
+  }
+  close(pipe_fds[1]);
+
+  const std::string text = written.get();
+  close(pipe_fds[0]);
+  EXPECT_TRUE(Contains(text, "event loop stalled for "));
+  EXPECT_TRUE(Contains(text, " in GET /slow of connection 1, handled for "));
+  EXPECT_TRUE(Contains(text, "stack of the stalled loop thread:\n"));
+}
+
+TEST(Watchdog, IgnoresIdleLoop) {
+  SlowServer server;
+  const loopback::RunningServer running(server);
+  Watchdog watchdog(STDERR_FILENO,
+                    {.threshold = std::chrono::milliseconds(10)});
+  watchdog.Watch(server.loop_monitor());
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  EXPECT_EQ(0U, watchdog.stalls());
+}
+
+TEST(Watchdog, SignalsLoopThreadWhileRunning) {
+  SlowServer server;
+  // Signal 0 checks that the thread can be signalled without sending one
+  EXPECT_FALSE(server.loop_monitor().SignalLoopThread(0));
+  {
+    const loopback::RunningServer running(server);
+    EXPECT_TRUE(server.loop_monitor().SignalLoopThread(0));
+  }
+  EXPECT_FALSE(server.loop_monitor().SignalLoopThread(0));
+}